@@ -52,6 +52,8 @@ const std::string compiledScriptSuffix = ".ncs";
 const std::string disassembledScriptSuffix = ".ncs.pcode";
 const std::string dependencyFileSuffix = ".d";
 const std::string debugSymbolsFileSuffix = ".ndb";
+const std::string moduleUsageReportFile = "module_usage_report.txt";
+const std::string engineComparisonReportFile = "engine_comparison.csv";
 
 // Current Windows official sizes for icons
 // https://docs.microsoft.com/en-us/windows/win32/uxguide/vis-icons
@@ -0,0 +1,274 @@
+/** @file ErfArchive.cpp
+ * Read-only access to script resources inside ERF based archives (.erf, .hak, .mod)
+ *
+ **/
+ // Copyright (C) 2022 - Leonardo Silva
+ // The License.txt file describes the conditions under which this software may be distributed.
+
+#ifdef _WINDOWS
+#include "pch.h"
+#endif
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#ifndef _WINDOWS
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "ErfArchive.h"
+
+using namespace NWScriptPlugin;
+
+// ERF header layout (all values little endian)
+constexpr size_t erfHeaderSize = 160;
+constexpr size_t erfEntryCountOffset = 16;
+constexpr size_t erfKeyListOffset = 24;
+constexpr size_t erfResourceListOffset = 28;
+constexpr size_t erfResourceListEntrySize = 8;
+
+// Tables are read in blocks of this many entries, so a damaged header can't make us allocate the whole file
+constexpr uint64_t erfTableBlockEntries = 4096;
+
+static uint32_t readUInt32(const uint8_t* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t readUInt16(const uint8_t* p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+// Orders by type first, then name, so lookups compare the cheap key before the string
+static bool indexEntryLess(uint16_t lType, const char* lName, uint16_t rType, const char* rName)
+{
+    if (lType != rType)
+        return lType < rType;
+    return strcmp(lName, rName) < 0;
+}
+
+bool ErfArchive::isArchiveFile(const std::filesystem::path& filePath)
+{
+    std::string ext = filePath.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    return ext == ".hak" || ext == ".erf" || ext == ".mod";
+}
+
+bool ErfArchive::open(const std::filesystem::path& filePath)
+{
+    close();
+    _path = filePath;
+
+#ifdef _WINDOWS
+    HANDLE hFile = ::CreateFileW(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return false;
+    _file = hFile;
+
+    LARGE_INTEGER fileSize;
+    if (!::GetFileSizeEx(hFile, &fileSize))
+    {
+        close();
+        return false;
+    }
+    _fileSize = static_cast<uint64_t>(fileSize.QuadPart);
+#else
+    _file = ::open(filePath.c_str(), O_RDONLY);
+    if (_file < 0)
+        return false;
+
+    off_t fileSize = ::lseek(_file, 0, SEEK_END);
+    if (fileSize < 0)
+    {
+        close();
+        return false;
+    }
+    _fileSize = static_cast<uint64_t>(fileSize);
+#endif
+
+    if (!buildIndex())
+    {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void ErfArchive::close()
+{
+#ifdef _WINDOWS
+    if (_file)
+        ::CloseHandle(static_cast<HANDLE>(_file));
+    _file = nullptr;
+#else
+    if (_file >= 0)
+        ::close(_file);
+    _file = -1;
+#endif
+
+    _fileSize = 0;
+    _index.clear();
+    _index.shrink_to_fit();
+}
+
+bool ErfArchive::readAt(uint64_t offset, void* buffer, size_t size) const
+{
+    if (offset > _fileSize || size > _fileSize - offset)
+        return false;
+
+#ifdef _WINDOWS
+    // Positioned reads don't share a file pointer, so include prefetch threads may read at the same time
+    OVERLAPPED overlapped = {};
+    overlapped.Offset = static_cast<DWORD>(offset);
+    overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+    DWORD bytesRead = 0;
+    return ::ReadFile(static_cast<HANDLE>(_file), buffer, static_cast<DWORD>(size), &bytesRead, &overlapped) && bytesRead == size;
+#else
+    uint8_t* destination = static_cast<uint8_t*>(buffer);
+    while (size > 0)
+    {
+        ssize_t bytesRead = ::pread(_file, destination, size, static_cast<off_t>(offset));
+        if (bytesRead <= 0)
+            return false;
+        destination += bytesRead;
+        offset += bytesRead;
+        size -= bytesRead;
+    }
+    return true;
+#endif
+}
+
+bool ErfArchive::buildIndex()
+{
+    static const char* const fileTypes[] = { "ERF ", "HAK ", "MOD ", "NWM ", "SAV " };
+
+    uint8_t header[erfHeaderSize];
+    if (!readAt(0, header, erfHeaderSize))
+        return false;
+
+    bool validType = false;
+    for (const char* type : fileTypes)
+        validType |= memcmp(header, type, 4) == 0;
+    if (!validType)
+        return false;
+
+    // V1.0 archives (NWN1) carry 16 character resource names, V1.1 (NWN2) carry 32.
+    size_t resRefLength;
+    if (memcmp(header + 4, "V1.0", 4) == 0)
+        resRefLength = 16;
+    else if (memcmp(header + 4, "V1.1", 4) == 0)
+        resRefLength = 32;
+    else
+        return false;
+
+    const size_t keySize = resRefLength + 8;
+    const uint64_t entryCount = readUInt32(header + erfEntryCountOffset);
+    const uint64_t keyList = readUInt32(header + erfKeyListOffset);
+    const uint64_t resourceList = readUInt32(header + erfResourceListOffset);
+
+    if (keyList + entryCount * keySize > _fileSize ||
+        resourceList + entryCount * erfResourceListEntrySize > _fileSize)
+        return false;
+
+    // Script keys first, remembering which resource list entry each one points at
+    std::vector<std::pair<uint32_t, IndexEntry>> scripts;
+    std::vector<uint8_t> block;
+    for (uint64_t first = 0; first < entryCount; first += erfTableBlockEntries)
+    {
+        uint64_t count = std::min(erfTableBlockEntries, entryCount - first);
+        block.resize(static_cast<size_t>(count * keySize));
+        if (!readAt(keyList + first * keySize, block.data(), block.size()))
+            return false;
+
+        for (uint64_t i = 0; i < count; i++)
+        {
+            const uint8_t* key = block.data() + i * keySize;
+            uint32_t resId = readUInt32(key + resRefLength);
+            uint16_t resType = readUInt16(key + resRefLength + 4);
+
+            if (resType != ResNSS && resType != ResNCS && resType != ResNDB)
+                continue;
+            if (resId >= entryCount)
+                continue;
+
+            IndexEntry entry;
+            size_t nameLength = strnlen(reinterpret_cast<const char*>(key), resRefLength);
+            for (size_t c = 0; c < nameLength; c++)
+                entry.resRef[c] = (char)std::tolower(key[c]);
+            entry.resRef[nameLength] = 0;
+            entry.resType = resType;
+            entry.keyIndex = static_cast<uint32_t>(first + i);
+            entry.offset = 0;
+            entry.size = 0;
+            scripts.emplace_back(resId, entry);
+        }
+    }
+
+    // Then their places in the file, walking the resource list once in the same blocks
+    std::sort(scripts.begin(), scripts.end(), [](const auto& l, const auto& r) { return l.first < r.first; });
+    uint64_t blockFirst = 0, blockCount = 0;
+    for (auto& script : scripts)
+    {
+        if (script.first >= blockFirst + blockCount)
+        {
+            blockFirst = script.first - script.first % erfTableBlockEntries;
+            blockCount = std::min(erfTableBlockEntries, entryCount - blockFirst);
+            block.resize(static_cast<size_t>(blockCount * erfResourceListEntrySize));
+            if (!readAt(resourceList + blockFirst * erfResourceListEntrySize, block.data(), block.size()))
+                return false;
+        }
+
+        const uint8_t* resource = block.data() + (script.first - blockFirst) * erfResourceListEntrySize;
+        uint32_t offset = readUInt32(resource);
+        uint32_t size = readUInt32(resource + 4);
+        if ((uint64_t)offset + size > _fileSize)
+            continue;
+
+        script.second.offset = offset;
+        script.second.size = size;
+        _index.push_back(script.second);
+    }
+
+    // The first of any duplicated names wins, as it would on a linear scan of the keys
+    std::sort(_index.begin(), _index.end(), [](const IndexEntry& l, const IndexEntry& r) {
+        if (l.resType != r.resType || strcmp(l.resRef, r.resRef) != 0)
+            return indexEntryLess(l.resType, l.resRef, r.resType, r.resRef);
+        return l.keyIndex < r.keyIndex; });
+    _index.shrink_to_fit();
+
+    return true;
+}
+
+char* ErfArchive::load(const std::string& resRef, uint16_t resType, size_t& size) const
+{
+    if (resRef.size() > 32)
+        return nullptr;
+
+    char name[33];
+    size_t nameLength = resRef.size();
+    for (size_t c = 0; c < nameLength; c++)
+        name[c] = (char)std::tolower((unsigned char)resRef[c]);
+    name[nameLength] = 0;
+
+    auto it = std::lower_bound(_index.begin(), _index.end(), name, [resType](const IndexEntry& e, const char* n) {
+        return indexEntryLess(e.resType, e.resRef, resType, n); });
+
+    if (it == _index.end() || it->resType != resType || strcmp(it->resRef, name) != 0)
+        return nullptr;
+
+    char* contents = new char[it->size + 1];
+    if (!readAt(it->offset, contents, it->size))
+    {
+        delete[] contents;
+        return nullptr;
+    }
+
+    contents[it->size] = 0;
+    size = it->size;
+    return contents;
+}
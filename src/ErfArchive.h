@@ -0,0 +1,86 @@
+/** @file ErfArchive.h
+ * Read-only access to script resources inside ERF based archives (.erf, .hak, .mod)
+ *
+ **/
+ // Copyright (C) 2022 - Leonardo Silva
+ // The License.txt file describes the conditions under which this software may be distributed.
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace NWScriptPlugin {
+
+	// The key and resource tables of the archive are read once into a sorted index of the script
+	// resources it holds; the resources themselves are read from the file on demand. Nothing but the
+	// tables is ever loaded, so archives of any size can be opened by 32 bit builds too.
+	// The file stays open (shared for reading) until close().
+	class ErfArchive {
+	public:
+		// Resource types we index. Everything else inside the archive is skipped.
+		static constexpr uint16_t ResNSS = 2009;
+		static constexpr uint16_t ResNCS = 2010;
+		static constexpr uint16_t ResNDB = 2064;
+
+		ErfArchive() = default;
+		ErfArchive(const ErfArchive&) = delete;
+		ErfArchive& operator=(const ErfArchive&) = delete;
+
+		~ErfArchive() {
+			close();
+		}
+
+		// Opens the archive and builds its index. Returns false if the file is not a valid ERF V1.0/V1.1 archive.
+		bool open(const std::filesystem::path& filePath);
+		void close();
+
+		bool isOpen() const {
+#ifdef _WINDOWS
+			return _file != nullptr;
+#else
+			return _file >= 0;
+#endif
+		}
+
+		const std::filesystem::path& path() const {
+			return _path;
+		}
+
+		// Number of script resources indexed
+		size_t size() const {
+			return _index.size();
+		}
+
+		// Finds a resource by name (case insensitive) and type and reads it into a new[] allocated,
+		// NULL-terminated buffer owned by the caller. Returns nullptr if not present or unreadable.
+		char* load(const std::string& resRef, uint16_t resType, size_t& size) const;
+
+		// Whether the file extension names an ERF based archive
+		static bool isArchiveFile(const std::filesystem::path& filePath);
+
+	private:
+		struct IndexEntry {
+			char resRef[33];
+			uint16_t resType;
+			uint32_t keyIndex;
+			uint32_t offset;
+			uint32_t size;
+		};
+
+		std::filesystem::path _path;
+		std::vector<IndexEntry> _index;
+		uint64_t _fileSize = 0;
+
+#ifdef _WINDOWS
+		void* _file = nullptr;
+#else
+		int _file = -1;
+#endif
+
+		bool readAt(uint64_t offset, void* buffer, size_t size) const;
+		bool buildIndex();
+	};
+}
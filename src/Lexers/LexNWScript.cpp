@@ -15,7 +15,12 @@
 
 #include "pch.h"
 
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+
 #include "LexNWScript.h"
+#include "Native Compiler/xxhash.h"
 
 /*
 * 
@@ -30,6 +35,8 @@ Sci_Position SCI_METHOD LexerNWScript::PropertySet(const char *key, const char *
 			if (options.identifiersAllowDollars) {
 				setWord.Add('$');
 			}
+		} else if (strcmp(key, "lexer.nwscript.large.file.threshold") == 0) {
+			largeFileDecided = false;
 		}
 		return 0;
 	}
@@ -40,8 +47,77 @@ const char * SCI_METHOD LexerNWScript::PropertyGet(const char *key) {
 	return osNWScript.PropertyGet(key);
 }
 
+namespace {
+
+	// Parsed keyword lists, bucketed by the fingerprint of their text. The text is kept
+	// alongside so a fingerprint collision can never hand out the wrong list. Entries
+	// expire once the last lexer using them lets go.
+	class WordListCache {
+		std::mutex mutex;
+		std::unordered_map<uint64_t, std::vector<std::weak_ptr<const SharedWordList::Parsed>>> entries;
+
+	public:
+		std::shared_ptr<const SharedWordList::Parsed> Get(const char* wl, size_t length, uint64_t fingerprint) {
+			std::lock_guard<std::mutex> lock(mutex);
+
+			for (const std::weak_ptr<const SharedWordList::Parsed>& entry : entries[fingerprint]) {
+				std::shared_ptr<const SharedWordList::Parsed> parsed = entry.lock();
+				if (parsed && parsed->text.size() == length && memcmp(parsed->text.data(), wl, length) == 0)
+					return parsed;
+			}
+
+			std::shared_ptr<SharedWordList::Parsed> parsed = std::make_shared<SharedWordList::Parsed>();
+			parsed->text.assign(wl, length);
+			parsed->words.Set(wl);
+
+			// Drop whatever expired since the last new list, then remember this one.
+			for (auto it = entries.begin(); it != entries.end();) {
+				std::vector<std::weak_ptr<const SharedWordList::Parsed>>& list = it->second;
+				list.erase(std::remove_if(list.begin(), list.end(), [](const auto& e) { return e.expired(); }), list.end());
+				if (list.empty() && it->first != fingerprint)
+					it = entries.erase(it);
+				else
+					++it;
+			}
+			entries[fingerprint].push_back(parsed);
+
+			return parsed;
+		}
+	};
+
+	WordListCache& SharedWordLists() {
+		static WordListCache cache;
+		return cache;
+	}
+
+	const std::shared_ptr<const SharedWordList::Parsed>& EmptyWordList() {
+		static const std::shared_ptr<const SharedWordList::Parsed> empty = std::make_shared<SharedWordList::Parsed>();
+		return empty;
+	}
+}
+
+SharedWordList::SharedWordList() : parsed(EmptyWordList()) {
+}
+
+bool SharedWordList::Set(const char* wl) {
+	const size_t lengthNew = strlen(wl);
+	const uint64_t fingerprintNew = XXH64(wl, lengthNew, 0);
+
+	// Same text as before: nothing to parse nor compare. The fingerprint only rules
+	// out most changes cheaply; the text itself decides.
+	if (fingerprintNew == fingerprint && lengthNew == parsed->text.size() && memcmp(parsed->text.data(), wl, lengthNew) == 0)
+		return false;
+
+	std::shared_ptr<const Parsed> parsedNew = SharedWordLists().Get(wl, lengthNew, fingerprintNew);
+	const bool changed = parsedNew != parsed && parsedNew->words != parsed->words;
+
+	parsed = std::move(parsedNew);
+	fingerprint = fingerprintNew;
+	return changed;
+}
+
 Sci_Position SCI_METHOD LexerNWScript::WordListSet(int n, const char *wl) {
-	WordList *wordListN = nullptr;
+	SharedWordList *wordListN = nullptr;
 
 	// All keywordClass(es) from LexNWScript.xml
 	switch (n) {
@@ -75,11 +151,8 @@ Sci_Position SCI_METHOD LexerNWScript::WordListSet(int n, const char *wl) {
 	}
 	Sci_Position firstModification = -1;
 	if (wordListN) {
-		WordList wlNew;
-		wlNew.Set(wl);
-		if (*wordListN != wlNew) {
-			wordListN->Set(wl);
-			firstModification = 0; 
+		if (wordListN->Set(wl)) {
+			firstModification = 0;
 		}
 	}
 	return firstModification;
@@ -112,6 +185,23 @@ void SCI_METHOD LexerNWScript::Lex(Sci_PositionU startPos, Sci_Position length,
 	bool inRERange = false;
 	bool seenDocKeyBrace = false;
 
+	// Huge documents (generated tables and data scripts) skip the preprocessor tracking and the
+	// long word lists, so typing stays responsive. Switching modes drops the per line state and
+	// restyles (and refolds) the whole document, since everything before startPos used the other mode.
+	if (!largeFileDecided) {
+		largeFileDecided = true;
+		if (IsLargeFile(pAccess) != largeFileMode) {
+			largeFileMode = !largeFileMode;
+			largeFileRefold = true;
+			vlls = PPStates();
+			ppDefineHistory.clear();
+			startPos = 0;
+			length = pAccess->Length();
+			initStyle = SCE_C_DEFAULT;
+		}
+	}
+	const bool largeFile = largeFileMode;
+
 	Sci_Position lineCurrent = styler.GetLine(startPos);
 	if ((MaskActive(initStyle) == SCE_C_PREPROCESSOR) ||
       (MaskActive(initStyle) == SCE_C_COMMENTLINE) ||
@@ -142,7 +232,7 @@ void SCI_METHOD LexerNWScript::Lex(Sci_PositionU startPos, Sci_Position length,
 
 	// Truncate ppDefineHistory before current line
 
-	if (!options.updatePreprocessor)
+	if (!options.updatePreprocessor || largeFile)
 		ppDefineHistory.clear();
 
 	std::vector<PPDefinition>::iterator itInvalid = std::find_if(ppDefineHistory.begin(), ppDefineHistory.end(),
@@ -198,7 +288,8 @@ void SCI_METHOD LexerNWScript::Lex(Sci_PositionU startPos, Sci_Position length,
 		if (sc.atLineEnd) {
 			lineCurrent++;
 			lineEndNext = styler.LineEnd(lineCurrent);
-			vlls.Add(lineCurrent, preproc);
+			if (!largeFile)
+				vlls.Add(lineCurrent, preproc);
 			if (rawStringTerminator != "") {
 				rawSTNew.Set(lineCurrent-1, rawStringTerminator);
 			}
@@ -209,7 +300,8 @@ void SCI_METHOD LexerNWScript::Lex(Sci_PositionU startPos, Sci_Position length,
 			if ((sc.currentPos+1) >= lineEndNext) {
 				lineCurrent++;
 				lineEndNext = styler.LineEnd(lineCurrent);
-				vlls.Add(lineCurrent, preproc);
+				if (!largeFile)
+					vlls.Add(lineCurrent, preproc);
 				if (rawStringTerminator != "") {
 					rawSTNew.Set(lineCurrent-1, rawStringTerminator);
 				}
@@ -254,22 +346,24 @@ void SCI_METHOD LexerNWScript::Lex(Sci_PositionU startPos, Sci_Position length,
 					} else {
 						sc.GetCurrentLowered(s, sizeof(s));
 					}
-					if (keywordsInstructions.InList(s)) {    // instre1 stylers.xml keywordClass from notepad++
+					if (keywordsInstructions->InList(s)) {    // instre1 stylers.xml keywordClass from notepad++
 						lastWordWasUUID = strcmp(s, "uuid") == 0;
 						sc.ChangeState(SCE_C_WORD|activitySet);
-					} else if (keywordsInstr2.InList(s) || keywordsCommonTypes.InList(s)) { // notepad's instre2 or type1 (shared between langs)
+					} else if (keywordsInstr2->InList(s) || keywordsCommonTypes->InList(s)) { // notepad's instre2 or type1 (shared between langs)
 						sc.ChangeState(SCE_C_WORD2|activitySet);
-					} else if (keywordsEngineTypes.InList(s)) {				// type2
+					} else if (keywordsEngineTypes->InList(s)) {				// type2
 						sc.ChangeState(SCE_C_ENGINETYPE|activitySet);
-					} else if (keywordsObjectTypes.InList(s)) {				// type3
+					} else if (keywordsObjectTypes->InList(s)) {				// type3
 						sc.ChangeState(SCE_C_OBJECTTYPE|activitySet);
-					} else if (keywordsEngineConstants.InList(s)) {			// type4
+					} else if (largeFile) {
+						// Constants and functions lists are too long to search for every identifier
+					} else if (keywordsEngineConstants->InList(s)) {			// type4
 						sc.ChangeState(SCE_C_ENGINECONSTANT|activitySet);
-					} else if (keywordsUserConstants.InList(s)) {			// type5
+					} else if (keywordsUserConstants->InList(s)) {			// type5
 						sc.ChangeState(SCE_C_USERCONSTANT|activitySet);
-					} else if (keywordsEngineFunctions.InList(s)) {			// type6
+					} else if (keywordsEngineFunctions->InList(s)) {			// type6
 						sc.ChangeState(SCE_C_ENGINEFUNCTION|activitySet);
-					} else if (keywordsUserFunctions.InList(s)) {			// type7
+					} else if (keywordsUserFunctions->InList(s)) {			// type7
 						sc.ChangeState(SCE_C_USERFUNCTION|activitySet);
 					} else {
 						int subStyle = classifierIdentifiers.ValueFor(s);
@@ -396,7 +490,7 @@ void SCI_METHOD LexerNWScript::Lex(Sci_PositionU startPos, Sci_Position length,
 					}
 					if (!(IsASpace(sc.ch) || (sc.ch == 0))) {
 						sc.ChangeState(SCE_C_COMMENTDOCKEYWORDERROR|activitySet);
-					} else if (!keywordsCommonTypes.InList(s + 1)) {
+					} else if (!keywordsCommonTypes->InList(s + 1)) {
 						int subStyleCDKW = classifierDocKeyWords.ValueFor(s+1);
 						if (subStyleCDKW >= 0) {
 							sc.ChangeState(subStyleCDKW|activitySet);
@@ -537,7 +631,8 @@ void SCI_METHOD LexerNWScript::Lex(Sci_PositionU startPos, Sci_Position length,
 			// State exit processing consumed characters up to end of line.
 			lineCurrent++;
 			lineEndNext = styler.LineEnd(lineCurrent);
-			vlls.Add(lineCurrent, preproc);
+			if (!largeFile)
+				vlls.Add(lineCurrent, preproc);
 		}
 
 		// Determine if a new state should be entered.
@@ -581,7 +676,7 @@ void SCI_METHOD LexerNWScript::Lex(Sci_PositionU startPos, Sci_Position length,
 					sc.SetState(SCE_C_COMMENTLINEDOC|activitySet);
 				else
 					sc.SetState(SCE_C_COMMENTLINE|activitySet);
-			} else if (sc.ch == '/'
+			} else if (sc.ch == '/' && !largeFile
 				   && (setOKBeforeRE.Contains(chPrevNonWhite)
 				       || followsReturnKeyword(sc, styler))
 				   && (!setCouldBePostOp.Contains(chPrevNonWhite)
@@ -624,7 +719,7 @@ void SCI_METHOD LexerNWScript::Lex(Sci_PositionU startPos, Sci_Position length,
 				} else if (sc.Match("include")) {
 					isIncludePreprocessor = true;
 				} else {
-					if (options.trackPreprocessor) {
+					if (options.trackPreprocessor && !largeFile) {
 						// If #if is nested too deeply (>31 levels) the active/inactive appearance
 						// will stop reflecting the code.
 						if (sc.Match("ifdef") || sc.Match("ifndef")) {
@@ -763,6 +858,14 @@ void SCI_METHOD LexerNWScript::Fold(Sci_PositionU startPos, Sci_Position length,
 
 	LexAccessor styler(pAccess);
 
+	// Fold levels above startPos were computed in the other large file mode
+	if (largeFileRefold) {
+		largeFileRefold = false;
+		startPos = 0;
+		length = pAccess->Length();
+		initStyle = SCE_C_DEFAULT;
+	}
+
 	const Sci_PositionU endPos = startPos + length;
 	int visibleChars = 0;
 	bool inLineComment = false;
@@ -777,6 +880,10 @@ void SCI_METHOD LexerNWScript::Fold(Sci_PositionU startPos, Sci_Position length,
 	int styleNext = MaskActive(styler.StyleAt(startPos));
 	int style = MaskActive(initStyle);
 	const bool userDefinedFoldMarkers = !options.foldExplicitStart.empty() && !options.foldExplicitEnd.empty();
+	// Large files only fold on braces
+	const bool largeFile = largeFileMode;
+	const bool foldComment = options.foldComment && !largeFile;
+	const bool foldPreprocessor = options.foldPreprocessor && !largeFile;
 	for (Sci_PositionU i = startPos; i < endPos; i++) {
 		const char ch = chNext;
 		chNext = styler.SafeGetCharAt(i + 1);
@@ -786,7 +893,7 @@ void SCI_METHOD LexerNWScript::Fold(Sci_PositionU startPos, Sci_Position length,
 		const bool atEOL = i == (lineStartNext-1);
 		if ((style == SCE_C_COMMENTLINE) || (style == SCE_C_COMMENTLINEDOC))
 			inLineComment = true;
-		if (options.foldComment && options.foldCommentMultiline && IsStreamCommentStyle(style) && !inLineComment) {
+		if (foldComment && options.foldCommentMultiline && IsStreamCommentStyle(style) && !inLineComment) {
 			if (!IsStreamCommentStyle(stylePrev)) {
 				levelNext++;
 			} else if (!IsStreamCommentStyle(styleNext) && !atEOL) {
@@ -794,7 +901,7 @@ void SCI_METHOD LexerNWScript::Fold(Sci_PositionU startPos, Sci_Position length,
 				levelNext--;
 			}
 		}
-		if (options.foldComment && options.foldCommentExplicit && ((style == SCE_C_COMMENTLINE) || options.foldExplicitAnywhere)) {
+		if (foldComment && options.foldCommentExplicit && ((style == SCE_C_COMMENTLINE) || options.foldExplicitAnywhere)) {
 			if (userDefinedFoldMarkers) {
 				if (styler.Match(i, options.foldExplicitStart.c_str())) {
 					levelNext++;
@@ -812,7 +919,7 @@ void SCI_METHOD LexerNWScript::Fold(Sci_PositionU startPos, Sci_Position length,
 				}
 			}
 		}
-		if (options.foldPreprocessor && (style == SCE_C_PREPROCESSOR)) {
+		if (foldPreprocessor && (style == SCE_C_PREPROCESSOR)) {
 			if (ch == '#') {
 				Sci_PositionU j = i + 1;
 				while ((j < endPos) && IsASpaceOrTab(styler.SafeGetCharAt(j))) {
@@ -830,14 +937,14 @@ void SCI_METHOD LexerNWScript::Fold(Sci_PositionU startPos, Sci_Position length,
 			}
 		}
 		if (options.foldSyntaxBased && (style == SCE_C_OPERATOR)) {
-			if (ch == '{' || ch == '[' || ch == '(') {
+			if (ch == '{' || (!largeFile && (ch == '[' || ch == '('))) {
 				// Measure the minimum before a '{' to allow
 				// folding on "} else {"
 				if (options.foldAtElse && levelMinCurrent > levelNext) {
 					levelMinCurrent = levelNext;
 				}
 				levelNext++;
-			} else if (ch == '}' || ch == ']' || ch == ')') {
+			} else if (ch == '}' || (!largeFile && (ch == ']' || ch == ')'))) {
 				levelNext--;
 			}
 		}
@@ -846,7 +953,7 @@ void SCI_METHOD LexerNWScript::Fold(Sci_PositionU startPos, Sci_Position length,
 		if (atEOL || (i == endPos-1)) {
 			int levelUse = levelCurrent;
 			if ((options.foldSyntaxBased && options.foldAtElse) ||
-				(options.foldPreprocessor && options.foldPreprocessorAtElse)
+				(foldPreprocessor && options.foldPreprocessorAtElse)
 			) {
 				levelUse = levelMinCurrent;
 			}
@@ -23,7 +23,9 @@
 
 //#include <cstdlib>
 //#include <cassert>
+#include <cstdint>
 #include <map>
+#include <memory>
 #include <string>
 //#include <utility>
 #include <vector>
@@ -384,6 +386,7 @@ namespace {
 		bool foldPreprocessorAtElse;
 		bool foldCompact;
 		bool foldAtElse;
+		int largeFileThreshold;
 		OptionsNWScript() {
 			stylingWithinPreprocessor = false;
 			identifiersAllowDollars = true;
@@ -406,6 +409,7 @@ namespace {
 			foldPreprocessorAtElse = false;
 			foldCompact = false;
 			foldAtElse = false;
+			largeFileThreshold = 8 * 1024 * 1024;
 		}
 	};
 
@@ -490,6 +494,11 @@ namespace {
 			DefineProperty("fold.at.else", &OptionsNWScript::foldAtElse,
 				"This option enables C++ folding on a \"} else {\" line of an if statement.");
 
+			DefineProperty("lexer.nwscript.large.file.threshold", &OptionsNWScript::largeFileThreshold,
+				"Documents bigger than this size (in bytes) are lexed in large file mode: preprocessor conditionals "
+				"are not tracked, only keywords and types are classified and folding happens only on braces. "
+				"Set to 0 to always use the full lexer.");
+
 			DefineWordListSets(nwscriptWordLists);
 		}
 	};
@@ -538,6 +547,29 @@ namespace {
 
 }
 
+// A keyword list shared between every lexer instance that was given the same text.
+// The parsed lists are kept in a process-wide cache keyed by a fingerprint of the text,
+// so each distinct list is parsed once no matter how many documents are open, and setting
+// a list to the text it already holds only costs hashing and comparing it.
+class SharedWordList {
+public:
+	// A parsed list and the text it was parsed from, as held by the cache
+	struct Parsed {
+		std::string text;
+		WordList words;
+	};
+private:
+	std::shared_ptr<const Parsed> parsed;
+	uint64_t fingerprint = 0;
+public:
+	SharedWordList();
+	// Returns true if the words differ from the previous list
+	bool Set(const char* wl);
+	const WordList* operator->() const noexcept {
+		return &parsed->words;
+	}
+};
+
 class LexerNWScript : public ILexer5 {
 	bool caseSensitive;
 	CharacterSet setWord;
@@ -549,15 +581,15 @@ class LexerNWScript : public ILexer5 {
 	CharacterSet setWordStart;
 	PPStates vlls;
 	std::vector<PPDefinition> ppDefineHistory;
-	WordList keywordsInstructions;		// keywords  - instruction set
-	WordList keywordsInstr2;			// keywords2 - unused by NWScript
-	WordList keywordsCommonTypes;		// keywords3 - common types (const float int string struct vector void)
-	WordList keywordsEngineTypes;		// keywords4 - engine defined types (effect event location talent itemproperty sqlquery cassowary json)
-	WordList keywordsObjectTypes;		// keywords5 - object exclusive word
-	WordList keywordsEngineConstants;	// keywords6 - engine constants
-	WordList keywordsUserConstants;		// keywords7 - user defined constants
-	WordList keywordsEngineFunctions;	// keywords8 - engine functions
-	WordList keywordsUserFunctions;		// keywords8 - user defined functions
+	SharedWordList keywordsInstructions;		// keywords  - instruction set
+	SharedWordList keywordsInstr2;				// keywords2 - unused by NWScript
+	SharedWordList keywordsCommonTypes;			// keywords3 - common types (const float int string struct vector void)
+	SharedWordList keywordsEngineTypes;			// keywords4 - engine defined types (effect event location talent itemproperty sqlquery cassowary json)
+	SharedWordList keywordsObjectTypes;			// keywords5 - object exclusive word
+	SharedWordList keywordsEngineConstants;		// keywords6 - engine constants
+	SharedWordList keywordsUserConstants;		// keywords7 - user defined constants
+	SharedWordList keywordsEngineFunctions;		// keywords8 - engine functions
+	SharedWordList keywordsUserFunctions;		// keywords8 - user defined functions
 
 	WordList markerList;
 	WordList ppDefinitions;
@@ -586,6 +618,11 @@ class LexerNWScript : public ILexer5 {
 	enum { ssIdentifier, ssDocKeyword };
 	SubStyles subStyles;
 	std::string returnBuffer;
+	// Large file mode is decided on the first Lex of the document and kept until the threshold
+	// changes, so typing across the threshold doesn't switch modes halfway through the text.
+	bool largeFileMode = false;
+	bool largeFileDecided = false;
+	bool largeFileRefold = false;
 public:
 	explicit LexerNWScript(bool caseSensitive_) :
 		caseSensitive(caseSensitive_),
@@ -731,6 +768,9 @@ public:
 	static ILexer5* LexerFactoryNWScriptInsensitive() {
 		return new LexerNWScript(false);
 	}
+	bool IsLargeFile(IDocument* pAccess) const {
+		return options.largeFileThreshold > 0 && pAccess->Length() > options.largeFileThreshold;
+	}
 	constexpr static int MaskActive(int style) noexcept {
 		return style & ~inactiveFlag;
 	}
@@ -12,6 +12,7 @@
 
 #include "Utf8_16.h"
 #include "NWScriptCompiler.h"
+#include "Native Compiler/scriptinternal.h"
 #include "VersionInfoEx.h"
 
 using namespace NWScriptPlugin;
@@ -115,6 +116,10 @@ static std::map<int, std::string> CompileErrorTlk = {
     {629, "Error: Type does not have an optional parameter"},
     {630, "Error: Non constant in function declaration"},
     {631, "Error: Parsing constant vector"},
+    {639, "Error: Stack underflow"},
+    {640, "Error: Invalid op code"},
+    {642, "Error: Invalid command"},
+    {646, "Error: IP out of code segment"},
     {1594, "Error: Operand must be an integer lvalue"},
     {1595, "Error: Conditional requires second expression"},
     {1596, "Error: Conditional must have matching return types"},
@@ -158,6 +163,9 @@ static std::map<int, std::string> CompileErrorTlk = {
 #define NSC2009_COULD_NOT_WRITE_DEPENDENCY_FILE  "NSC2009"
 #define NSC2010_CANT_COMPILE_NWSCRIPT_NSS        "NSC2010"
 #define NSC2011_INCLUDE_FILE_IGNORED             "NSC2010"
+#define NSC2012_COULD_NOT_WRITE_USAGE_REPORT     "NSC2012"
+#define NSC2013_ENGINE_OUTPUT_DIVERGENCE         "NSC2013"
+#define NSC2014_COULD_NOT_WRITE_COMPARISON       "NSC2014"
 
 
 NWScriptCompiler::NWScriptCompiler() :
@@ -185,12 +193,30 @@ bool NWScriptCompiler::initialize() {
 }
 
 void NWScriptCompiler::reset() {
+    joinOutputWriter();
     _resourceManager = nullptr;
     _compilerNative = nullptr;
     _compilerLegacy = nullptr;
+    _includePrefetcher.clear();
     _includePaths.clear();
+    releaseArchives();
     _fetchPreprocessorOnly = false;
     _makeDependencyView = false;
+    _makeIncludeGraph = false;
+    _gatherUsageReport = false;
+    _usageReport.clear();
+    _comparisonReport.clear();
+    _verifiedScripts = 0;
+    _verificationMicroseconds = 0;
+    _fastPathScripts = 0;
+    _fastPathSource = nullptr;
+    _fastPathOutputs.clear();
+    _capturedCode.clear();
+    _captureCode = false;
+    _keepDisplayedOutput = false;
+    _displayedOutput = nullptr;
+    _outputWriteFailure.clear();
+    _sourceOverlay.clear();
     _sourcePath = "";
     _destDir = "";
     setMode(0);
@@ -326,6 +352,10 @@ void NWScriptCompiler::processFile(bool fromMemory, char* fileContents)
         _compilerLegacy->NscSetResourceCacheEnabled(true);
     }
 
+    // Archives are let go whenever the caller is done processing, so they are indexed again on the next run
+    if (!_archivesIndexed)
+        indexArchives();
+
     // Acquire information about NWN Resource Type of the file. Warning of ignored result is incorrect.
 #pragma warning (push)
 #pragma warning (disable : 6031)
@@ -333,9 +363,12 @@ void NWScriptCompiler::processFile(bool fromMemory, char* fileContents)
     fileResRef = _resourceManager->ResRef32FromStr(wstr2str(_sourcePath.stem()).c_str());
 #pragma warning (pop)
 
-    // Load file from disk if not from memory
+    // Load file from disk if not from memory (or overlaid by an editor buffer)
+    const char* overlayContents = getSourceOverlay(_sourcePath);
     if (fromMemory)
         inFileContents = fileContents;
+    else if (overlayContents && _compilerMode == 0)
+        inFileContents = overlayContents;
     else
     {
         if (!fileToBuffer(_sourcePath.c_str(), inFileContents))
@@ -374,8 +407,29 @@ void NWScriptCompiler::processFile(bool fromMemory, char* fileContents)
             bSuccess = compileScriptLegacy(inFileContents, fileResType, fileResRef);
         }
 
+        // Include graph costs come from an instrumented compile of the new library
+        if (_makeIncludeGraph)
+        {
+            _logger.log("Making include graph for: " + _sourcePath.string(), LogType::ConsoleMessage);
+            bSuccess = viewIncludeGraph(inFileContents, fileResType, fileResRef);
+        }
+
+        // Snippets are only supported by the new library
+        if (_compileSnippets)
+        {
+            _logger.log("Compiling snippets from manifest: " + _sourcePath.string(), LogType::ConsoleMessage);
+            bSuccess = compileSnippetManifest(inFileContents);
+        }
+
+        // Differential run of both libraries over the same source
+        if (_compareEngines)
+        {
+            _logger.log("Comparing compiler engines on: " + _sourcePath.string(), LogType::ConsoleMessage);
+            bSuccess = compareEngines(inFileContents, fileResType, fileResRef);
+        }
+
         // Use new library for compiling to support NWScript latest features
-        if (!_fetchPreprocessorOnly && !_makeDependencyView)
+        if (!_fetchPreprocessorOnly && !_makeDependencyView && !_makeIncludeGraph && !_compileSnippets && !_compareEngines)
         {
             _logger.log("Compiling script: " + _sourcePath.string(), LogType::ConsoleMessage);
             if (_settings->compilerEngine == 0)
@@ -394,6 +448,109 @@ void NWScriptCompiler::processFile(bool fromMemory, char* fileContents)
 }
 
 
+// Scripts up to this size with no #include directive are compiled through the fast path
+constexpr size_t fastPathMaxScriptSize = 64 * 1024;
+
+// Scans a script for #include directives, skipping comments and string literals so commented out
+// includes don't count. Include names are collected as lower case file stems; without a list to fill,
+// returns on the first include found.
+static bool findIncludes(std::string_view contents, std::vector<std::string>* includes)
+{
+    bool found = false;
+    const char* p = contents.data();
+    const char* end = p + contents.size();
+    while (p < end)
+    {
+        if (p[0] == '/' && p + 1 < end && p[1] == '/')
+        {
+            while (p < end && *p != '\n')
+                p++;
+        }
+        else if (p[0] == '/' && p + 1 < end && p[1] == '*')
+        {
+            p += 2;
+            while (p + 1 < end && !(p[0] == '*' && p[1] == '/'))
+                p++;
+            p += 2;
+        }
+        else if (*p == '"')
+        {
+            p++;
+            while (p < end && *p != '"' && *p != '\n')
+            {
+                if (*p == '\\')
+                    p++;
+                p++;
+            }
+            p++;
+        }
+        else if (*p == '#')
+        {
+            p++;
+            while (p < end && (*p == ' ' || *p == '\t'))
+                p++;
+            if (end - p < 7 || strncmp(p, "include", 7) != 0)
+                continue;
+
+            found = true;
+            if (!includes)
+                return true;
+
+            p += 7;
+            while (p < end && (*p == ' ' || *p == '\t'))
+                p++;
+            if (p >= end || *p != '"')
+                continue;
+
+            const char* nameStart = ++p;
+            while (p < end && *p != '"' && *p != '\n')
+                p++;
+            if (p < end && *p == '"' && p > nameStart)
+                includes->push_back(toLowerCase(fs::path(std::string(nameStart, p)).stem().string()));
+            p++;
+        }
+        else
+            p++;
+    }
+
+    return found;
+}
+
+// Returns true for small scripts that include nothing (nwscript.nss is implicit to every compile).
+static bool isFastPathScript(const std::string& contents)
+{
+    return contents.size() <= fastPathMaxScriptSize && !findIncludes(contents, nullptr);
+}
+
+// Writes one compiler output file, logging the failure according to its ResType.
+static int32_t writeCompiledOutput(const generic_string& outputPath, RESTYPE nResType, std::string&& dataRef)
+{
+    // Debug symbols to be displayed are handed over in memory
+    if (nResType == NWN::ResNDB && g_NWScriptCompilerV2->keepDisplayedOutput(outputPath, std::move(dataRef),
+        TEXT("Unable to write generated symbols output file: "), TEXT(NSC2006_COULD_NOT_GENERATE_SYMBOL_FILE)))
+        return 0;
+
+    if (!bufferToFile(outputPath, dataRef))
+    {
+        g_NWScriptCompilerV2->logger().log("", LogType::ConsoleMessage);
+
+        switch (nResType)
+        {
+        case NWN::ResNCS:
+            g_NWScriptCompilerV2->logger().log(TEXT("Unable to write compiled output file: ") + outputPath, LogType::Critical, TEXT(NSC2005_COULD_NOT_WRITE_COMPILED_FILE));
+            break;
+        case NWN::ResNDB:
+            g_NWScriptCompilerV2->logger().log(TEXT("Unable to write generated symbols output file: ") + outputPath, LogType::Critical, TEXT(NSC2006_COULD_NOT_GENERATE_SYMBOL_FILE));
+            break;
+        }
+
+        g_NWScriptCompilerV2->logger().log("", LogType::ConsoleMessage);
+        return -1;
+    }
+
+    return 0;
+}
+
 bool NWScriptCompiler::compileScriptNative(std::string& fileContents,
     const NWN::ResType& fileResType, const NWN::ResRef32& fileResRef)
 {
@@ -402,14 +559,47 @@ bool NWScriptCompiler::compileScriptNative(std::string& fileContents,
     uint32_t optimizationFlags = _settings->generateSymbols ? CSCRIPTCOMPILER_OPTIMIZE_NOTHING :
         _settings->optimizeScript ? CSCRIPTCOMPILER_OPTIMIZE_EVERYTHING : CSCRIPTCOMPILER_OPTIMIZE_NOTHING;
     _compilerNative->SetOptimizationFlags(optimizationFlags);
+    _compilerNative->SetRecordIncludeGraph(_makeIncludeGraph);
     _compilerNative->SetCompileConditionalOrMain(1);
     _compilerNative->SetIdentifierSpecification("nwscript");
     _compilerNative->SetOutputAlias("");
+    _compilerNative->SetVerifyFinalCode(TRUE);
+
+    // Small scripts that include nothing besides nwscript.nss (already loaded above) are compiled straight
+    // from the buffer we already hold, skipping the include path and resource probing, and have their outputs
+    // written together once the compile succeeds.
+    bool fastPath = isFastPathScript(fileContents);
+    if (fastPath)
+        _fastPathSource = &fileContents;
+    else
+        _includePrefetcher.start(fileContents, _includePaths, _archives);
 
     // Compile memory allocated file
     NativeCompileResult ret;
 
     ret.code = _compilerNative->CompileFile(_sourcePath.string());
+    _includePrefetcher.finish();
+
+    if (fastPath)
+    {
+        _fastPathSource = nullptr;
+        bool written = ret.code != 0 || flushFastPathOutputs();
+        _fastPathOutputs.clear();
+        if (!written)
+            return false;
+        if (ret.code == 0)
+            _fastPathScripts++;
+    }
+
+    if (ret.code == 0)
+    {
+        _verifiedScripts++;
+        _verificationMicroseconds += _compilerNative->GetVerifyFinalCodeMicroseconds();
+    }
+
+    // Include files return an error here, so only real entry scripts make into the usage report.
+    if (ret.code == 0 && _gatherUsageReport)
+        gatherUsageReport(fileContents);
 
     //ret.code = _compilerV2->CompileScriptChunk(fileContents, false);
 
@@ -462,6 +652,583 @@ bool NWScriptCompiler::compileScriptNative(std::string& fileContents,
 }
 
 
+const char* NWScriptCompiler::getFastPathSource(const std::string& fileStem) const
+{
+    if (!_fastPathSource || toLowerCase(fileStem) != toLowerCase(_sourcePath.stem().string()))
+        return nullptr;
+
+    return _fastPathSource->c_str();
+}
+
+void NWScriptCompiler::indexArchives()
+{
+    // Index the script resources of any archive sitting on the include directories. Only the key
+    // and resource tables are read here; contents are read on demand.
+    for (generic_string s : _settings->getIncludeDirsV())
+    {
+        std::error_code ec;
+        for (const fs::directory_entry& entry : fs::directory_iterator(s, ec))
+        {
+            if (!entry.is_regular_file(ec) || !ErfArchive::isArchiveFile(entry.path()))
+                continue;
+
+            auto archive = std::make_unique<ErfArchive>();
+            if (archive->open(entry.path()))
+            {
+                _logger.WriteText("INFO: Indexed %zu script resources from archive -> %s\n", archive->size(), entry.path().string().c_str());
+                _archives.push_back(std::move(archive));
+            }
+            else
+                _logger.log("Could not read archive: " + entry.path().string(), LogType::Warning);
+        }
+    }
+
+    _archivesIndexed = true;
+}
+
+void NWScriptCompiler::releaseArchives()
+{
+    _includePrefetcher.finish();
+    _archives.clear();
+    _archivesIndexed = false;
+}
+
+const char* NWScriptCompiler::getIncludeSourceOverlay(const std::string& fileStem) const
+{
+    if (_sourceOverlay.empty())
+        return nullptr;
+
+    // Several open scripts may share a name: the one next to the script being compiled wins, as on disk.
+    const char* sibling = getSourceOverlay(_sourcePath.parent_path() / (fileStem + ".nss"));
+    if (sibling)
+        return sibling;
+
+    // Otherwise a name only resolves to an editor buffer when no other open script has it
+    std::string stemKey = toLowerCase(fileStem);
+    const char* found = nullptr;
+    for (const auto& overlay : _sourceOverlay)
+    {
+        if (toLowerCase(fs::path(overlay.first).stem().string()) != stemKey)
+            continue;
+        if (found)
+            return nullptr;
+        found = overlay.second.c_str();
+    }
+
+    return found;
+}
+
+bool NWScriptCompiler::deferCompiledOutput(RESTYPE nResType, const uint8_t* pData, size_t nSize)
+{
+    if (!_fastPathSource)
+        return false;
+
+    _fastPathOutputs.emplace_back(nResType, std::string(reinterpret_cast<const char*>(pData), nSize));
+    return true;
+}
+
+bool NWScriptCompiler::keepDisplayedOutput(const generic_string& outputPath, std::string&& contents,
+    const generic_string& failureMessage, const generic_string& failureCode)
+{
+    if (!_keepDisplayedOutput)
+        return false;
+
+    _displayedOutput = std::make_shared<const std::string>(std::move(contents));
+    if (!_settings->writeDisplayedOutputToDisk)
+        return true;
+
+    // The writer shares the listing with the display, so neither waits for the other
+    std::lock_guard<std::mutex> lock(_outputWriterLock);
+    if (_outputWriter.joinable())
+        _outputWriter.join();
+
+    _outputWriter = std::thread([this, outputPath, output = _displayedOutput, failureMessage, failureCode]() {
+        if (!bufferToFile(outputPath, *output))
+        {
+            _outputWriteFailure = failureMessage + outputPath;
+            _outputWriteFailureCode = failureCode;
+        }
+    });
+
+    return true;
+}
+
+void NWScriptCompiler::finishDisplayedOutputWrite()
+{
+    generic_string failure;
+    generic_string failureCode;
+    {
+        std::lock_guard<std::mutex> lock(_outputWriterLock);
+        if (_outputWriter.joinable())
+            _outputWriter.join();
+        failure.swap(_outputWriteFailure);
+        failureCode.swap(_outputWriteFailureCode);
+    }
+
+    if (failure.empty())
+        return;
+
+    _logger.log("", LogType::ConsoleMessage);
+    _logger.log(failure, LogType::Critical, failureCode);
+    _logger.log("", LogType::ConsoleMessage);
+}
+
+bool NWScriptCompiler::flushFastPathOutputs()
+{
+    std::string outputStem = _destDir.string() + "\\" + _sourcePath.stem().string() + ".";
+
+    for (auto& output : _fastPathOutputs)
+    {
+        if (writeCompiledOutput(str2wstr(outputStem + _resourceManager->ResTypeToExt(output.first)), output.first, std::move(output.second)) != 0)
+            return false;
+    }
+
+    return true;
+}
+
+bool NWScriptCompiler::compileSnippetManifest(const std::string& manifestContents)
+{
+    // Snippets are only validated, so there is nothing to optimize or debug
+    _compilerNative->SetGenerateDebuggerOutput(0);
+    _compilerNative->SetOptimizationFlags(CSCRIPTCOMPILER_OPTIMIZE_NOTHING);
+    _compilerNative->SetCompileConditionalOrMain(1);
+    _compilerNative->SetIdentifierSpecification("nwscript");
+    _compilerNative->SetOutputAlias("");
+
+    std::string manifestName = _sourcePath.stem().string();
+    std::string manifestExt = _sourcePath.extension().string();
+    if (!manifestExt.empty())
+        manifestExt.erase(0, 1);
+
+    // Manifest format, one entry per line:
+    //   #include "name"     -> prepended to every snippet that follows
+    //   conditional: <expr> -> compiled as int StartingConditional() { return (<expr>); }
+    //   action: <code>      -> compiled as void main() { <code> }
+    //   // comment
+    std::string prelude;
+    std::string line;
+    std::stringstream manifest(manifestContents);
+    int lineNumber = 0;
+    int snippetCount = 0;
+    int failedCount = 0;
+    ULONGLONG clockStart = GetTickCount64();
+
+    while (std::getline(manifest, line))
+    {
+        lineNumber++;
+
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line.compare(first, 2, "//") == 0)
+            continue;
+        line = line.substr(first, line.find_last_not_of(" \t\r") - first + 1);
+
+        if (line.compare(0, 8, "#include") == 0)
+        {
+            prelude += line + "\n";
+            continue;
+        }
+
+        bool bConditional = line.compare(0, 12, "conditional:") == 0;
+        bool bAction = line.compare(0, 7, "action:") == 0;
+        if (!bConditional && !bAction)
+        {
+            _logger.log("Unrecognized manifest entry ignored: " + line, LogType::Warning, "", manifestName, manifestExt, std::to_string(lineNumber));
+            continue;
+        }
+
+        std::string snippet = line.substr(bConditional ? 12 : 7);
+        int32_t code;
+        if (bConditional)
+            code = prelude.empty() ? _compilerNative->CompileScriptConditional(snippet.c_str()) :
+                _compilerNative->CompileScriptChunk((prelude + "int StartingConditional(){return(" + snippet + ");}").c_str(), false);
+        else
+            code = prelude.empty() ? _compilerNative->CompileScriptChunk(snippet.c_str(), true) :
+                _compilerNative->CompileScriptChunk((prelude + "void main(){" + snippet + "}").c_str(), false);
+
+        snippetCount++;
+        if (code == 0)
+            continue;
+
+        failedCount++;
+        if (code == 1 || code == -1)
+            code = _compilerNative->GetCapturedErrorStrRef();
+
+        std::string errorText = _compilerNative->GetCapturedError()->CStr();
+        while (!errorText.empty() && (errorText.back() == '\n' || errorText.back() == '\r'))
+            errorText.pop_back();
+        if (errorText.empty())
+            errorText = CompileErrorTlk[abs(code)];
+
+        _logger.log(std::string(bConditional ? "Conditional" : "Action") + " snippet: " + errorText, LogType::Error,
+            "NSC" + std::to_string(abs(code)), manifestName, manifestExt, std::to_string(lineNumber));
+    }
+
+    double durationFloat = (double)(GetTickCount64() - clockStart) / (double)1000;
+    _logger.log("", LogType::ConsoleMessage);
+    _logger.log(std::format("Compiled {} snippets, {} failed, in {:.2f} seconds ({:.0f} snippets/second).", snippetCount, failedCount,
+        durationFloat, durationFloat > 0 ? snippetCount / durationFloat : (double)snippetCount), LogType::ConsoleMessage);
+
+    return failedCount == 0;
+}
+
+void NWScriptCompiler::gatherUsageReport(const std::string& fileContents)
+{
+    std::string scriptName = _sourcePath.stem().string();
+    std::string scriptKey = scriptName;
+    std::transform(scriptKey.begin(), scriptKey.end(), scriptKey.begin(), ::tolower);
+    _usageReport.entryScripts[scriptKey] = _sourcePath.filename().string();
+
+    for (const CExoString& include : _compilerNative->GetIncludedFileNames())
+    {
+        std::string includeKey = include.CStr();
+        std::transform(includeKey.begin(), includeKey.end(), includeKey.begin(), ::tolower);
+        ModuleUsageReport::IncludeUsage& usage = _usageReport.includes[includeKey];
+        usage.fileName = include.CStr();
+        usage.includedBy.insert(scriptKey);
+    }
+
+    for (const CScriptCompilerFunctionUsage& function : _compilerNative->GetFunctionUsage())
+    {
+        if (!function.m_bIncludeFile)
+            continue;
+
+        std::string includeKey = function.m_sFileName.CStr();
+        std::transform(includeKey.begin(), includeKey.end(), includeKey.begin(), ::tolower);
+
+        ModuleUsageReport::FunctionUsage& usage = _usageReport.functions[includeKey + "/" + function.m_sFunctionName.CStr()];
+        usage.fileName = function.m_sFileName.CStr();
+        usage.functionName = function.m_sFunctionName.CStr();
+        if (function.m_bReachable)
+        {
+            usage.reachableFrom++;
+            _usageReport.includes[includeKey].contributesTo.insert(scriptKey);
+        }
+    }
+
+    // Scripts are usually referenced by name from ExecuteScript, SetEventScript and the like,
+    // so we keep any string literal that could be a resref.
+    size_t start = fileContents.find('"');
+    while (start != std::string::npos)
+    {
+        size_t end = fileContents.find_first_of("\"\r\n", start + 1);
+        if (end == std::string::npos)
+            break;
+
+        if (fileContents[end] == '"' && end - start - 1 > 0 && end - start - 1 <= 32)
+        {
+            std::string literal = fileContents.substr(start + 1, end - start - 1);
+            std::transform(literal.begin(), literal.end(), literal.begin(), ::tolower);
+            if (literal != scriptKey)
+                _usageReport.stringLiterals.insert(literal);
+        }
+
+        start = fileContents.find('"', end + 1);
+    }
+}
+
+bool NWScriptCompiler::writeUsageReport(const fs::path& outputDir)
+{
+    // Include files and scripts that failed don't count, so say why nothing was written
+    if (_usageReport.empty())
+    {
+        _logger.log("", LogType::ConsoleMessage);
+        _logger.log(TEXT("Module usage report not written: no script with a main() or StartingConditional() compiled successfully."),
+            LogType::Warning, TEXT(NSC2012_COULD_NOT_WRITE_USAGE_REPORT));
+        return false;
+    }
+
+    std::vector<const ModuleUsageReport::FunctionUsage*> deadFunctions;
+    for (const auto& function : _usageReport.functions)
+    {
+        if (function.second.reachableFrom == 0)
+            deadFunctions.push_back(&function.second);
+    }
+
+    std::vector<const ModuleUsageReport::IncludeUsage*> unusedIncludes;
+    for (const auto& include : _usageReport.includes)
+    {
+        if (include.second.contributesTo.size() < include.second.includedBy.size())
+            unusedIncludes.push_back(&include.second);
+    }
+
+    std::vector<std::string> unreferencedScripts;
+    for (const auto& script : _usageReport.entryScripts)
+    {
+        if (!_usageReport.stringLiterals.contains(script.first))
+            unreferencedScripts.push_back(script.second);
+    }
+
+    std::stringstream sReport;
+    sReport << "Module usage report - " << _usageReport.entryScripts.size() << " scripts, "
+        << _usageReport.includes.size() << " includes, " << _usageReport.functions.size() << " include functions" << "\r\n\r\n";
+
+    sReport << "  1) Include functions not reachable from any script (" << deadFunctions.size() << ")\r\n\r\n";
+    for (const auto* function : deadFunctions)
+        sReport << "          " << function->fileName << textScriptSuffix << ": " << function->functionName << "\r\n";
+
+    sReport << "\r\n  2) Includes pulled in by scripts that reach none of their functions (" << unusedIncludes.size() << ")\r\n\r\n";
+    for (const auto* include : unusedIncludes)
+    {
+        sReport << "          " << include->fileName << textScriptSuffix << ": contributes nothing to "
+            << include->includedBy.size() - include->contributesTo.size() << " of " << include->includedBy.size() << " scripts";
+        if (include->contributesTo.empty())
+            sReport << " (never used)";
+        sReport << "\r\n";
+    }
+
+    sReport << "\r\n  3) Scripts whose name is not referenced by any compiled script (" << unreferencedScripts.size() << ")\r\n\r\n";
+    for (const std::string& script : unreferencedScripts)
+        sReport << "          " << script << "\r\n";
+
+    sReport << "\r\n  Notes: includes may still provide constants or structures; scripts attached to module\r\n"
+        << "  events or resources are only referenced from the toolset, not from other scripts.\r\n";
+
+    _logger.log("", LogType::ConsoleMessage);
+    _logger.log("Module usage: " + std::to_string(deadFunctions.size()) + " dead include functions, " +
+        std::to_string(unusedIncludes.size()) + " partially unused includes, " +
+        std::to_string(unreferencedScripts.size()) + " unreferenced scripts.", LogType::ConsoleMessage);
+
+    generic_string outputPath = str2wstr(properDirNameA(outputDir.string()) + "\\" + moduleUsageReportFile);
+    if (!bufferToFile(outputPath, sReport.str()))
+    {
+        _logger.log(TEXT("Could not write module usage report: ") + outputPath, LogType::Warning, TEXT(NSC2012_COULD_NOT_WRITE_USAGE_REPORT));
+        return false;
+    }
+
+    _logger.log(TEXT("Module usage report written to: ") + outputPath, LogType::ConsoleMessage);
+    return true;
+}
+
+// Decodes an NCS program into normalized instruction texts. The header and program size are dropped
+// and relative jumps are written as instruction distances, so one differently sized instruction doesn't
+// make every jump over it differ. Returns false if the program is malformed (instructions decoded
+// up to that point are kept).
+static bool normalizeNcs(const std::string& code, std::vector<std::string>& instructions, std::vector<size_t>& offsets)
+{
+    if (code.size() < CVIRTUALMACHINE_BINARY_SCRIPT_HEADER || code.compare(0, 8, "NCS V1.0") != 0)
+        return false;
+
+    // Instructions are decoded the way the native compiler's verifier does it, so that instruction sizes
+    // are only known in one place.
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(code.data());
+    const int32_t codeLength = static_cast<int32_t>(code.size());
+
+    bool wellFormed = true;
+    for (int32_t pos = CVIRTUALMACHINE_BINARY_SCRIPT_HEADER, size = 0; pos < codeLength; pos += size)
+    {
+        size = VirtualMachineInstructionSize(data, pos, codeLength);
+        if (size == 0)
+        {
+            wellFormed = false;
+            break;
+        }
+        offsets.push_back(static_cast<size_t>(pos));
+    }
+
+    instructions.reserve(offsets.size());
+    for (size_t i = 0; i < offsets.size(); i++)
+    {
+        size_t pos = offsets[i];
+        size_t size = (i + 1 < offsets.size()) ? offsets[i + 1] - pos :
+            static_cast<size_t>(VirtualMachineInstructionSize(data, static_cast<int32_t>(pos), codeLength));
+        uint8_t opcode = data[pos + CVIRTUALMACHINE_OPCODE_LOCATION];
+        uint8_t aux = data[pos + CVIRTUALMACHINE_AUXCODE_LOCATION];
+        const char* name = VirtualMachineOpCodeName(opcode);
+
+        std::string text = std::format("{} {:02x}", name ? name : "???", aux);
+
+        if (opcode == CVIRTUALMACHINE_OPCODE_JMP || opcode == CVIRTUALMACHINE_OPCODE_JSR ||
+            opcode == CVIRTUALMACHINE_OPCODE_JZ || opcode == CVIRTUALMACHINE_OPCODE_JNZ)
+        {
+            int32_t jump = VirtualMachineReadInt32(data + pos + CVIRTUALMACHINE_EXTRA_DATA_LOCATION);
+            size_t destination = static_cast<size_t>(static_cast<ptrdiff_t>(pos) + jump);
+            auto target = std::lower_bound(offsets.begin(), offsets.end(), destination);
+            if (target != offsets.end() && *target == destination)
+                text += std::format(" {:+}", static_cast<ptrdiff_t>(target - offsets.begin()) - static_cast<ptrdiff_t>(i));
+            else
+                text += std::format(" @{:+}", jump);
+        }
+        else if (size > 2)
+        {
+            text += ' ';
+            for (size_t j = pos + CVIRTUALMACHINE_EXTRA_DATA_LOCATION; j < pos + size; j++)
+                text += std::format("{:02x}", data[j]);
+        }
+
+        instructions.push_back(std::move(text));
+    }
+
+    return wellFormed;
+}
+
+bool NWScriptCompiler::captureCompiledCode(RESTYPE nResType, const uint8_t* pData, size_t nSize)
+{
+    if (!_captureCode)
+        return false;
+
+    // Debug symbols are not compared, so they are simply dropped
+    if (nResType == NWN::ResNCS)
+        _capturedCode.assign(reinterpret_cast<const char*>(pData), nSize);
+
+    return true;
+}
+
+bool NWScriptCompiler::compareEngines(std::string& fileContents,
+    const NWN::ResType& fileResType, const NWN::ResRef32& fileResRef)
+{
+    EngineComparisonReport::ScriptResult result;
+    result.fileName = _sourcePath.filename().string();
+
+    LARGE_INTEGER frequency, start, end;
+    QueryPerformanceFrequency(&frequency);
+
+    // Both engines compile the same source with the same settings, keeping the compiled code in memory
+    _captureCode = true;
+
+    _capturedCode.clear();
+    QueryPerformanceCounter(&start);
+    result.nativeSuccess = compileScriptNative(fileContents, fileResType, fileResRef);
+    QueryPerformanceCounter(&end);
+    result.nativeMilliseconds = static_cast<double>(end.QuadPart - start.QuadPart) * 1000.0 / frequency.QuadPart;
+    std::string nativeCode = std::move(_capturedCode);
+
+    _capturedCode.clear();
+    QueryPerformanceCounter(&start);
+    result.legacySuccess = compileScriptLegacy(fileContents, fileResType, fileResRef);
+    QueryPerformanceCounter(&end);
+    result.legacyMilliseconds = static_cast<double>(end.QuadPart - start.QuadPart) * 1000.0 / frequency.QuadPart;
+    std::string legacyCode = std::move(_capturedCode);
+
+    _captureCode = false;
+
+    // Include files: nothing to compare
+    if (result.nativeSuccess && result.legacySuccess && nativeCode.empty() && legacyCode.empty())
+        return true;
+
+    std::vector<std::string> nativeInstructions, legacyInstructions;
+    std::vector<size_t> nativeOffsets, legacyOffsets;
+    bool nativeDecoded = normalizeNcs(nativeCode, nativeInstructions, nativeOffsets);
+    bool legacyDecoded = normalizeNcs(legacyCode, legacyInstructions, legacyOffsets);
+
+    result.nativeSize = nativeCode.size();
+    result.legacySize = legacyCode.size();
+    result.nativeInstructions = nativeInstructions.size();
+    result.legacyInstructions = legacyInstructions.size();
+
+    std::string srcFileName = _sourcePath.stem().string();
+    std::string srcFileExt = _sourcePath.extension().string();
+    srcFileExt.erase(0, 1);  // Delete the . before the extension.
+
+    if (result.nativeSuccess != result.legacySuccess)
+    {
+        _logger.log(std::string("Script only compiles with the ") + (result.nativeSuccess ? "native" : "legacy") + " compiler engine.",
+            LogType::Warning, NSC2013_ENGINE_OUTPUT_DIVERGENCE, srcFileName, srcFileExt, "-");
+    }
+    else if (result.nativeSuccess)
+    {
+        size_t i = 0;
+        size_t common = std::min(nativeInstructions.size(), legacyInstructions.size());
+        while (i < common && nativeInstructions[i] == legacyInstructions[i])
+            i++;
+
+        if (i < common || nativeInstructions.size() != legacyInstructions.size() || !nativeDecoded || !legacyDecoded)
+        {
+            auto describe = [i](const std::vector<std::string>& instructions, const std::vector<size_t>& offsets, bool decoded) {
+                if (i < instructions.size())
+                    return std::format("{:06x} {}", offsets[i], instructions[i]);
+                return std::string(decoded ? "<end of program>" : "<malformed code>");
+            };
+
+            result.firstDivergence = static_cast<ptrdiff_t>(i);
+            result.nativeAtDivergence = describe(nativeInstructions, nativeOffsets, nativeDecoded);
+            result.legacyAtDivergence = describe(legacyInstructions, legacyOffsets, legacyDecoded);
+
+            _logger.log(std::format("Compiler engines diverge at instruction {}: native [{}], legacy [{}].", i,
+                result.nativeAtDivergence, result.legacyAtDivergence), LogType::Warning, NSC2013_ENGINE_OUTPUT_DIVERGENCE, srcFileName, srcFileExt, "-");
+        }
+    }
+
+    bool bSuccess = result.nativeSuccess || result.legacySuccess;
+    _comparisonReport.scripts.push_back(std::move(result));
+
+    return bSuccess;
+}
+
+bool NWScriptCompiler::writeComparisonReport(const fs::path& outputDir)
+{
+    if (_comparisonReport.empty())
+        return true;
+
+    size_t identical = 0, divergent = 0, singleEngine = 0, failed = 0;
+    double nativeTotal = 0, legacyTotal = 0;
+    size_t nativeBytes = 0, legacyBytes = 0;
+
+    std::stringstream sReport;
+    sReport << "script,native_ok,legacy_ok,native_ms,legacy_ms,native_bytes,legacy_bytes,"
+        << "native_instructions,legacy_instructions,first_divergence,native_at_divergence,legacy_at_divergence\r\n";
+
+    for (const auto& script : _comparisonReport.scripts)
+    {
+        if (!script.nativeSuccess && !script.legacySuccess)
+            failed++;
+        else if (script.nativeSuccess != script.legacySuccess)
+            singleEngine++;
+        else if (script.firstDivergence >= 0)
+            divergent++;
+        else
+            identical++;
+
+        nativeTotal += script.nativeMilliseconds;
+        legacyTotal += script.legacyMilliseconds;
+        nativeBytes += script.nativeSize;
+        legacyBytes += script.legacySize;
+
+        sReport << std::format("{},{},{},{:.3f},{:.3f},{},{},{},{},{},\"{}\",\"{}\"\r\n", script.fileName,
+            script.nativeSuccess ? 1 : 0, script.legacySuccess ? 1 : 0, script.nativeMilliseconds, script.legacyMilliseconds,
+            script.nativeSize, script.legacySize, script.nativeInstructions, script.legacyInstructions,
+            script.firstDivergence, script.nativeAtDivergence, script.legacyAtDivergence);
+    }
+
+    _logger.log("", LogType::ConsoleMessage);
+    _logger.log(std::format("Engine comparison: {} scripts, {} identical, {} divergent, {} compiled by one engine only, {} failed on both.",
+        _comparisonReport.scripts.size(), identical, divergent, singleEngine, failed), LogType::ConsoleMessage);
+    _logger.log(std::format("  Native: {:.2f} ms, {} bytes - Legacy: {:.2f} ms, {} bytes.",
+        nativeTotal, nativeBytes, legacyTotal, legacyBytes), LogType::ConsoleMessage);
+
+    generic_string outputPath = str2wstr(properDirNameA(outputDir.string()) + "\\" + engineComparisonReportFile);
+    if (!bufferToFile(outputPath, sReport.str()))
+    {
+        _logger.log(TEXT("Could not write engine comparison report: ") + outputPath, LogType::Warning, TEXT(NSC2014_COULD_NOT_WRITE_COMPARISON));
+        return false;
+    }
+
+    _logger.log(TEXT("Engine comparison report written to: ") + outputPath, LogType::ConsoleMessage);
+    return true;
+}
+
+bool NWScriptCompiler::viewIncludeGraph(std::string& fileContents,
+    const NWN::ResType& fileResType, const NWN::ResRef32& fileResRef)
+{
+    LARGE_INTEGER frequency, start, end;
+    QueryPerformanceFrequency(&frequency);
+
+    // One instrumented compile; the compiled code is kept in memory and dropped
+    _captureCode = true;
+    _capturedCode.clear();
+    QueryPerformanceCounter(&start);
+    bool compiled = compileScriptNative(fileContents, fileResType, fileResRef);
+    QueryPerformanceCounter(&end);
+    _captureCode = false;
+    _capturedCode.clear();
+
+    // Include files don't compile on their own, but their graph is still worth seeing
+    if (_compilerNative->GetIncludeGraph().empty())
+        return false;
+
+    MakeIncludeGraphView(compiled, static_cast<double>(end.QuadPart - start.QuadPart) * 1000.0 / frequency.QuadPart);
+    return true;
+}
+
 bool NWScriptCompiler::compileScriptLegacy(std::string& fileContents,
     const NWN::ResType& fileResType, const NWN::ResRef32& fileResRef)
 {
@@ -536,6 +1303,10 @@ bool NWScriptCompiler::compileScriptLegacy(std::string& fileContents,
     if (_makeDependencyView)
         return MakeDependenciesView(fileDependencies);
 
+    // Engine comparisons only keep the code in memory
+    if (_captureCode)
+        return captureCompiledCode(NWN::ResNCS, generatedCode.data(), generatedCode.size());
+
     // Now save code data
     generic_string outputPath = str2wstr(_destDir.string() + "\\" + _sourcePath.stem().string() + compiledScriptSuffix);
     dataRef.assign(reinterpret_cast<char*>(&generatedCode[0]), generatedCode.size());
@@ -553,7 +1324,8 @@ bool NWScriptCompiler::compileScriptLegacy(std::string& fileContents,
         dataRef.clear();
         outputPath = str2wstr(_destDir.string() + "\\" + _sourcePath.stem().string() + debugSymbolsFileSuffix);
         dataRef.assign(reinterpret_cast<char*>(&debugSymbols[0]), debugSymbols.size());
-        if (!bufferToFile(outputPath, dataRef))
+        if (!keepDisplayedOutput(outputPath, std::move(dataRef), TEXT("Could not write generated symbols output file: "), TEXT(NSC2006_COULD_NOT_GENERATE_SYMBOL_FILE))
+            && !bufferToFile(outputPath, dataRef))
         {
             _logger.log("", LogType::ConsoleMessage);
             _logger.log(TEXT("Could not write generated symbols output file: ") + outputPath, LogType::Critical, TEXT(NSC2006_COULD_NOT_GENERATE_SYMBOL_FILE));
@@ -597,7 +1369,9 @@ bool NWScriptCompiler::disassemblyBinary(std::string& fileContents,
     for (size_t i = 0; i < lineCount; i++)
         formatedCode << matches[i][0];
 
-    if (!bufferToFile(outputPath, formatedCode.str()))
+    std::string listing = formatedCode.str();
+    if (!keepDisplayedOutput(outputPath, std::move(listing), TEXT("Could not write disassembled output file: "), TEXT(NSC2008_COULD_NOT_WRITE_DISASSEMBLY_FILE))
+        && !bufferToFile(outputPath, listing))
     {
         _logger.log("", LogType::ConsoleMessage);
         _logger.log(TEXT("Could not write disassembled output file: ") + outputPath, LogType::Critical, TEXT(NSC2008_COULD_NOT_WRITE_DISASSEMBLY_FILE));
@@ -716,6 +1490,213 @@ bool NWScriptCompiler::MakeDependenciesFile(const std::set<std::string>& depende
 }
 
 
+void NWScriptCompiler::MakeIncludeGraphView(bool compiled, double compileMilliseconds)
+{
+    const std::vector<CScriptCompilerIncludeGraphEntry>& graph = _compilerNative->GetIncludeGraph();
+
+    // Parse times include the nested files, so each file's own time is what its children didn't take
+    std::vector<int64_t> selfMicroseconds(graph.size());
+    for (size_t i = 0; i < graph.size(); i++)
+    {
+        selfMicroseconds[i] += graph[i].m_nParseMicroseconds;
+        if (graph[i].m_nParent >= 0)
+            selfMicroseconds[graph[i].m_nParent] -= graph[i].m_nParseMicroseconds;
+    }
+
+    char timestamp[128]; time_t currTime;  struct tm currTimeP;
+    time(&currTime);
+    errno_t error = localtime_s(&currTimeP, &currTime);
+    strftime(timestamp, 64, "%B %d, %Y - %R", &currTimeP);
+
+    std::stringstream sgraph;
+    sgraph << "/*************************************************************************************** \r\n";
+    sgraph << " * Include graph of \"" << _sourcePath.filename().string() << "\"\r\n";
+    sgraph << " * Generated by NWScript Tools for Notepad++ on " << timestamp << "\r\n";
+    sgraph << " ***************************************************************************************/\r\n\r\n";
+
+    sgraph << std::format("  Compiled in {:.2f} ms, {:.2f} ms of it parsing {} files.\r\n", compileMilliseconds,
+        (double)graph[0].m_nParseMicroseconds / 1000.0, graph.size());
+    if (compiled)
+        sgraph << "  Functions are counted after dead function elimination (kept / implemented).\r\n";
+    else
+        sgraph << "  The script did not compile (see the log), so functions are not counted.\r\n";
+    sgraph << "  A file included more than once is only parsed, and listed, the first time.\r\n\r\n";
+
+    sgraph << std::format("  {:<48} {:>10} {:>8} {:>9} {:>9} {:>11}\r\n", "File", "Bytes", "Tokens", "Self ms", "Total ms", "Functions");
+    sgraph << "  " << std::string(100, '-') << "\r\n";
+
+    for (size_t i = 0; i < graph.size(); i++)
+    {
+        const CScriptCompilerIncludeGraphEntry& entry = graph[i];
+        std::string fileName = entry.m_nParent < 0 ? _sourcePath.filename().string() :
+            std::string(entry.m_sFileName.CStr()) + textScriptSuffix;
+        std::string functions = compiled ? std::format("{} / {}", entry.m_nReachableFunctions, entry.m_nFunctions) : "-";
+
+        sgraph << std::format("  {:<48} {:>10} {:>8} {:>9.2f} {:>9.2f} {:>11}\r\n",
+            std::string(entry.m_nDepth * 2, ' ') + fileName, entry.m_nSize, entry.m_nTokens,
+            (double)selfMicroseconds[i] / 1000.0, (double)entry.m_nParseMicroseconds / 1000.0, functions);
+    }
+
+    sgraph << "\r\n\r\n";
+    sgraph << "------------------[ END OF INCLUDE GRAPH ]------------------" << "\r\n\r\n";
+
+    _logger.setProcessorString(sgraph.str());
+}
+
+
+void IncludePrefetcher::start(const std::string& scriptContents, const std::vector<std::string>& includePaths,
+    const std::vector<std::unique_ptr<ErfArchive>>& archives)
+{
+    finish();
+
+    std::vector<std::string> includes;
+    findIncludes(scriptContents, &includes);
+    if (includes.empty())
+        return;
+
+    _includePaths = &includePaths;
+    _archives = &archives;
+
+    std::lock_guard<std::mutex> lock(_lock);
+    schedule(includes);
+    if (_queue.empty())
+        return;
+
+    // A few workers are enough to keep the disk busy; include trees are rarely wide
+    size_t workerCount = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, 4);
+    for (size_t i = 0; i < workerCount; i++)
+        _workers.emplace_back(&IncludePrefetcher::worker, this);
+}
+
+void IncludePrefetcher::finish()
+{
+    for (std::thread& t : _workers)
+        t.join();
+    _workers.clear();
+}
+
+bool IncludePrefetcher::take(const std::string& fileStem, Source& source)
+{
+    std::unique_lock<std::mutex> lock(_lock);
+
+    auto it = _entries.find(toLowerCase(fileStem));
+    if (it == _entries.end())
+        return false;
+
+    _changed.wait(lock, [&it]() { return it->second.done; });
+    if (!it->second.found || !it->second.source.contents)
+        return false;
+
+    source = it->second.source;
+    it->second.source.contents = nullptr;
+    return true;
+}
+
+void IncludePrefetcher::clear()
+{
+    finish();
+
+    for (auto& entry : _entries)
+        delete[] entry.second.source.contents;
+
+    _entries.clear();
+    _queue.clear();
+}
+
+// Called with the lock held
+void IncludePrefetcher::schedule(const std::vector<std::string>& includes)
+{
+    for (const std::string& include : includes)
+    {
+        // nwscript.nss is loaded once by the identifier specification
+        if (include == "nwscript" || _entries.contains(include))
+            continue;
+
+        _entries[include];
+        _queue.push_back(include);
+    }
+}
+
+void IncludePrefetcher::worker()
+{
+    std::unique_lock<std::mutex> lock(_lock);
+    while (true)
+    {
+        if (_queue.empty())
+        {
+            if (_inFlight == 0)
+                break;
+            _changed.wait(lock);
+            continue;
+        }
+
+        std::string fileStem = std::move(_queue.front());
+        _queue.pop_front();
+        _inFlight++;
+        lock.unlock();
+
+        Source source;
+        std::vector<std::string> includes;
+        bool found = load(fileStem, source);
+        if (found)
+            findIncludes(std::string_view(source.contents, source.size), &includes);
+
+        lock.lock();
+        Entry& entry = _entries[fileStem];
+        entry.source = std::move(source);
+        entry.found = found;
+        entry.done = true;
+        schedule(includes);
+        _inFlight--;
+        _changed.notify_all();
+    }
+}
+
+// Same search order as ResManLoadScriptSourceFile: loose files on the include paths, then archives
+bool IncludePrefetcher::load(const std::string& fileStem, Source& source)
+{
+    for (const std::string& includePath : *_includePaths)
+    {
+        std::string Str(includePath);
+#ifdef _WINDOWS
+        if (Str.back() != '\\')
+            Str += "\\";
+#else
+        if (Str.back() != '/')
+            Str += "/";
+#endif
+        Str += fileStem + ".nss";
+
+        size_t fileSize = 0;
+        char* fileContents = fileToNullTermBuffer(str2wstr(Str), &fileSize);
+        if (fileSize > 0)
+        {
+            source.contents = fileContents;
+            source.size = fileSize;
+            source.location = Str;
+            return true;
+        }
+        delete[] fileContents;
+    }
+
+    for (const auto& archive : *_archives)
+    {
+        size_t size = 0;
+        char* contents = archive->load(fileStem, ErfArchive::ResNSS, size);
+        if (!contents)
+            continue;
+
+        source.contents = contents;
+        source.size = size;
+        source.location = archive->path().string() + "/" + fileStem + ".nss";
+        source.fromArchive = true;
+        return true;
+    }
+
+    return false;
+}
+
+
 bool CacheResource(const char* ResFileContents, UINT32 ResFileLength, bool Allocated,
     const NWN::ResRef32& ResRef, NWN::ResType ResType, const std::string& sLocation)
 {
@@ -755,6 +1736,14 @@ BOOL NWScriptPlugin::ResManUpdateResourceDirectory(const char* sAlias)
 int32_t NWScriptPlugin::ResManWriteToFile(const char* sFileName, RESTYPE nResType, const uint8_t* pData, size_t nSize, bool bBinary)
 {
 
+    // Engine comparisons keep the compiled code in memory instead.
+    if (g_NWScriptCompilerV2->captureCompiledCode(nResType, pData, nSize))
+        return 0;
+
+    // Fast path compiles write everything at once when finished.
+    if (g_NWScriptCompilerV2->deferCompiledOutput(nResType, pData, nSize))
+        return 0;
+
     // Decides which type of file to write depending on ResType.
 
     std::string dataRef;
@@ -765,25 +1754,7 @@ int32_t NWScriptPlugin::ResManWriteToFile(const char* sFileName, RESTYPE nResTyp
         + "." + g_ResourceManager->ResTypeToExt(nResType)
     );
 
-    if (!bufferToFile(outputPath, dataRef))
-    {
-        g_NWScriptCompilerV2->logger().log("", LogType::ConsoleMessage);
-
-        switch (nResType)
-        {
-        case NWN::ResNCS:
-            g_NWScriptCompilerV2->logger().log(TEXT("Unable to write compiled output file: ") + outputPath, LogType::Critical, TEXT(NSC2005_COULD_NOT_WRITE_COMPILED_FILE));
-            break;
-        case NWN::ResNDB:
-            g_NWScriptCompilerV2->logger().log(TEXT("Unable to write generated symbols output file: ") + outputPath, LogType::Critical, TEXT(NSC2006_COULD_NOT_GENERATE_SYMBOL_FILE));
-            break;
-        }
-
-        g_NWScriptCompilerV2->logger().log("", LogType::ConsoleMessage);
-        return -1;
-    }
-
-    return 0;
+    return writeCompiledOutput(outputPath, nResType, std::move(dataRef));
 }
 
 const char* NWScriptPlugin::ResManLoadScriptSourceFile(const char* sFileName, RESTYPE nResType)
@@ -796,6 +1767,19 @@ const char* NWScriptPlugin::ResManLoadScriptSourceFile(const char* sFileName, RE
 
     std::string sFileNameStem = fs::path(sFileName).stem().string();
 
+    // Editor buffers overlaid by the caller win over anything cached or on disk
+    if (nResType == NWN::ResNSS)
+    {
+        // Fast path scripts are already in memory, and are not worth caching
+        const char* fastPathSource = g_NWScriptCompilerV2->getFastPathSource(sFileNameStem);
+        if (fastPathSource)
+            return fastPathSource;
+
+        const char* overlay = g_NWScriptCompilerV2->getIncludeSourceOverlay(sFileNameStem);
+        if (overlay)
+            return overlay;
+    }
+
     try
     {
         ResRef = g_ResourceManager->ResRef32FromStr(toLowerCase(sFileNameStem));
@@ -818,6 +1802,19 @@ const char* NWScriptPlugin::ResManLoadScriptSourceFile(const char* sFileName, RE
     size_t fileSize = 0;
     char* fileContents = NULL;
 
+    // Includes may already have been loaded in the background while the compiler was parsing
+    IncludePrefetcher::Source prefetched;
+    if (nResType == NWN::ResNSS && g_NWScriptCompilerV2->getIncludePrefetcher().take(sFileNameStem, prefetched))
+    {
+        CacheResource(prefetched.contents, (UINT32)prefetched.size, true, ResRef, (NWN::ResType)nResType, prefetched.location);
+        if (prefetched.fromArchive)
+            g_NWScriptCompilerV2->logger().WriteText("INFO: Loaded file from archive -> %s\n", prefetched.location.c_str());
+        else
+            g_NWScriptCompilerV2->logger().WriteText("INFO: Loaded File from disk path -> %s\n", prefetched.location.c_str());
+
+        return prefetched.contents;
+    }
+
     // Not found: try search include paths first.
     for (auto it = g_NWScriptCompilerV2->includePaths().begin(); it != g_NWScriptCompilerV2->includePaths().end(); ++it)
     {
@@ -850,6 +1847,20 @@ const char* NWScriptPlugin::ResManLoadScriptSourceFile(const char* sFileName, RE
         }            
     }
 
+    // Not found: try the archives on the include paths. Resources are read once into the cache.
+    for (const auto& archive : g_NWScriptCompilerV2->archives())
+    {
+        fileContents = archive->load(sFileNameStem, (uint16_t)nResType, fileSize);
+        if (!fileContents)
+            continue;
+
+        std::string res = archive->path().string() + "/" + sFileNameStem + "." + g_ResourceManager->ResTypeToExt(nResType);
+        CacheResource(fileContents, (UINT32)fileSize, true, ResRef, (NWN::ResType)nResType, res);
+        g_NWScriptCompilerV2->logger().WriteText("INFO: Loaded file from archive -> %s\n", res.c_str());
+
+        return fileContents;
+    }
+
     // Not found: try opening via resource files
     ResourceManager::FileHandle Handle = g_ResourceManager->OpenFile(ResRef, nResType);
 
@@ -9,6 +9,11 @@
 
 #include <string>
 #include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
 
 #include "Native Compiler/exobase.h"		// New oficial compiler provided by Beamdog itself.
 #include "Native Compiler/scriptcomp.h"		// 
@@ -17,6 +22,7 @@
 
 #include "Settings.h"
 #include "NWScriptLogger.h"
+#include "ErfArchive.h"
 
 namespace NWScriptPlugin
 {
@@ -50,6 +56,126 @@ namespace NWScriptPlugin
 
 	typedef std::map<ResourceCacheKey, ResourceCacheEntry> ResourceCache;
 
+	// Loads the include tree of a script on background threads while the compiler parses it.
+	// Only loose files on the include paths and archive entries are prefetched (the resource
+	// manager is not thread safe); anything else is left for the compiler's own lookup.
+	// Each include is scheduled at most once until clear(), so batches don't reload shared includes.
+	class IncludePrefetcher {
+	public:
+		struct Source {
+			char* contents = nullptr;
+			size_t size = 0;
+			std::string location;
+			bool fromArchive = false;
+		};
+
+		~IncludePrefetcher() {
+			clear();
+		}
+
+		// Schedules every include reachable from the script's contents
+		void start(const std::string& scriptContents, const std::vector<std::string>& includePaths,
+			const std::vector<std::unique_ptr<ErfArchive>>& archives);
+
+		// Waits for the background loading to finish
+		void finish();
+
+		// Hands the prefetched source over to the caller, waiting for it if still loading.
+		// Returns false if the file was never scheduled or couldn't be found on the include paths.
+		bool take(const std::string& fileStem, Source& source);
+
+		// Finishes and frees every source not taken
+		void clear();
+
+	private:
+		struct Entry {
+			bool done = false;
+			bool found = false;
+			Source source;
+		};
+
+		std::map<std::string, Entry> _entries;
+		std::deque<std::string> _queue;
+		std::vector<std::thread> _workers;
+		std::mutex _lock;
+		std::condition_variable _changed;
+		size_t _inFlight = 0;
+
+		const std::vector<std::string>* _includePaths = nullptr;
+		const std::vector<std::unique_ptr<ErfArchive>>* _archives = nullptr;
+
+		void schedule(const std::vector<std::string>& includes);
+		void worker();
+		bool load(const std::string& fileStem, Source& source);
+	};
+
+	// Function reachability and include usage aggregated over many native compiles
+	struct ModuleUsageReport
+	{
+		struct FunctionUsage
+		{
+			std::string fileName;
+			std::string functionName;
+			int reachableFrom = 0;
+		};
+
+		struct IncludeUsage
+		{
+			std::string fileName;
+			std::set<std::string> includedBy;
+			std::set<std::string> contributesTo;
+		};
+
+		// Keyed by lower case "include/function" and lower case include name
+		std::map<std::string, FunctionUsage> functions;
+		std::map<std::string, IncludeUsage> includes;
+		// Entry scripts (lower case resref -> file name) and every string literal seen in them
+		std::map<std::string, std::string> entryScripts;
+		std::set<std::string> stringLiterals;
+
+		void clear() {
+			functions.clear();
+			includes.clear();
+			entryScripts.clear();
+			stringLiterals.clear();
+		}
+
+		bool empty() const {
+			return entryScripts.empty();
+		}
+	};
+
+	// Per-script results of compiling the same sources with both compiler engines
+	struct EngineComparisonReport
+	{
+		struct ScriptResult
+		{
+			std::string fileName;
+			bool nativeSuccess = false;
+			bool legacySuccess = false;
+			double nativeMilliseconds = 0;
+			double legacyMilliseconds = 0;
+			size_t nativeSize = 0;
+			size_t legacySize = 0;
+			size_t nativeInstructions = 0;
+			size_t legacyInstructions = 0;
+			// Index of the first differing normalized instruction (-1 = identical streams)
+			ptrdiff_t firstDivergence = -1;
+			std::string nativeAtDivergence;
+			std::string legacyAtDivergence;
+		};
+
+		std::vector<ScriptResult> scripts;
+
+		void clear() {
+			scripts.clear();
+		}
+
+		bool empty() const {
+			return scripts.empty();
+		}
+	};
+
 	struct NativeCompileResult
 	{
 		int32_t code;
@@ -68,6 +194,10 @@ namespace NWScriptPlugin
 
 		NWScriptCompiler();
 
+		~NWScriptCompiler() {
+			joinOutputWriter();
+		}
+
 		bool isInitialized() {
 			return _resourceManager != nullptr;
 		}
@@ -124,12 +254,31 @@ namespace NWScriptPlugin
 			_makeDependencyView = true;
 		}
 
+		// Only write the include graph of the script, with per-file compile costs, to the logger (native compiler only)
+		void setViewIncludeGraph() {
+			setMode(0);
+			_makeIncludeGraph = true;
+		}
+
 		// Fetchs only preprocessor's output
 		void setFetchPreprocessorOnly() {
 			setMode(0);
 			_fetchPreprocessorOnly = true;
 		}
 
+		// Compiles the conditional/action snippets listed in a manifest file (native compiler only)
+		void setCompileSnippets() {
+			setMode(0);
+			_compileSnippets = true;
+		}
+
+		// Compiles every script with both engines and diffs their normalized NCS output. Nothing is written
+		// besides the comparison report.
+		void setCompareEngines() {
+			setMode(0);
+			_compareEngines = true;
+		}
+
 		// Clears the log
 		void clearLog() {
 			_logger.clear();
@@ -142,6 +291,9 @@ namespace NWScriptPlugin
 			_compilerMode = compilerMode;
 			_fetchPreprocessorOnly = false;
 			_makeDependencyView = false;
+			_makeIncludeGraph = false;
+			_compileSnippets = false;
+			_compareEngines = false;
 		}
 
 		inline int getMode() const {
@@ -152,10 +304,22 @@ namespace NWScriptPlugin
 			return _makeDependencyView;
 		}
 
+		inline bool isViewIncludeGraph() const {
+			return _makeIncludeGraph;
+		}
+
 		inline bool isFetchPreprocessorOnly() const {
 			return _fetchPreprocessorOnly;
 		}
 
+		inline bool isCompileSnippets() const {
+			return _compileSnippets;
+		}
+
+		inline bool isCompareEngines() const {
+			return _compareEngines;
+		}
+
 		NWScriptLogger& logger() {
 			return _logger;
 		}
@@ -166,13 +330,109 @@ namespace NWScriptPlugin
 
 		// Returns if an output path is required for operation
 		inline bool isOutputDirRequired() {
-			return !(_fetchPreprocessorOnly || _makeDependencyView);
+			return !(_fetchPreprocessorOnly || _makeDependencyView || _makeIncludeGraph || _compileSnippets || _compareEngines);
 		}
 
 		inline ResourceCache& getResourceCache() {
 			return _ResourceCache;
 		}
 
+		inline IncludePrefetcher& getIncludePrefetcher() {
+			return _includePrefetcher;
+		}
+
+		// Archives (.hak, .erf, .mod) found on the include directories, searched after the loose files
+		const std::vector<std::unique_ptr<ErfArchive>>& archives() const {
+			return _archives;
+		}
+
+		// Closes the archives, so the toolset or a packer can rewrite them. Call once processing
+		// (a single file or a whole batch) is done; the next file processed indexes them again.
+		void releaseArchives();
+
+		// In-memory script sources (eg: unsaved editor tabs) keyed by sourceOverlayKey() of their full path.
+		// These take precedence over the resource cache and any file on disk.
+		void setSourceOverlay(std::map<std::string, std::string>&& overlay) {
+			_sourceOverlay = std::move(overlay);
+		}
+
+		static std::string sourceOverlayKey(const fs::path& filePath) {
+			return toLowerCase(filePath.lexically_normal().string());
+		}
+
+		// Overlaid source of the script being compiled, if any
+		const char* getSourceOverlay(const fs::path& filePath) const {
+			auto it = _sourceOverlay.find(sourceOverlayKey(filePath));
+			return it != _sourceOverlay.end() ? it->second.c_str() : nullptr;
+		}
+
+		// Overlaid source of a script included by name (called from ResManLoadScriptSourceFile)
+		const char* getIncludeSourceOverlay(const std::string& fileStem) const;
+
+		// Gather function reachability of every script compiled by the native engine (batch operations)
+		void setGatherUsageReport(bool gather) {
+			_gatherUsageReport = gather;
+		}
+
+		inline bool isGatherUsageReport() const {
+			return _gatherUsageReport;
+		}
+
+		const ModuleUsageReport& usageReport() const {
+			return _usageReport;
+		}
+
+		// Writes the aggregated usage report into outputDir and a summary to the logger
+		bool writeUsageReport(const fs::path& outputDir);
+
+		// Scripts whose final code passed the native compiler verification since the last reset(), and the time spent on it
+		inline size_t verifiedScripts() const {
+			return _verifiedScripts;
+		}
+
+		inline double verificationMilliseconds() const {
+			return (double)_verificationMicroseconds / 1000.0;
+		}
+
+		// Scripts compiled through the no-include fast path since the last reset()
+		inline size_t fastPathScripts() const {
+			return _fastPathScripts;
+		}
+
+		// Source of the script being compiled through the fast path, if fileStem names it (called from ResManLoadScriptSourceFile)
+		const char* getFastPathSource(const std::string& fileStem) const;
+
+		// While on the fast path, compiled outputs are held until the compile finishes (called from ResManWriteToFile)
+		bool deferCompiledOutput(RESTYPE nResType, const uint8_t* pData, size_t nSize);
+
+		const EngineComparisonReport& comparisonReport() const {
+			return _comparisonReport;
+		}
+
+		// Writes the per-script engine comparison (CSV) into outputDir and a summary to the logger
+		bool writeComparisonReport(const fs::path& outputDir);
+
+		// While capturing, compiled code is kept in memory instead of written to disk (called from ResManWriteToFile)
+		bool captureCompiledCode(RESTYPE nResType, const uint8_t* pData, size_t nSize);
+
+		// Keeps the listings the caller auto-displays (debug symbols, disassembly) in memory. Writing them to disk
+		// is then optional (Settings::writeDisplayedOutputToDisk) and done on a background thread.
+		void setKeepDisplayedOutput(bool keep) {
+			_keepDisplayedOutput = keep;
+		}
+
+		// Hands over the listing kept by the last operation (empty if there's none)
+		std::shared_ptr<const std::string> takeDisplayedOutput() {
+			return std::move(_displayedOutput);
+		}
+
+		// Takes a listing to be displayed instead of writing it to outputPath right away. Returns false if not keeping them.
+		bool keepDisplayedOutput(const generic_string& outputPath, std::string&& contents,
+			const generic_string& failureMessage, const generic_string& failureCode);
+
+		// Waits for the background write of the displayed listing, logging if it failed
+		void finishDisplayedOutputWrite();
+
 
 		void processFile(bool fromMemory, char* fileContents);
 
@@ -180,6 +440,10 @@ namespace NWScriptPlugin
 
 		std::unique_ptr<ResourceManager> _resourceManager;
 		ResourceCache _ResourceCache;
+		std::map<std::string, std::string> _sourceOverlay;
+		ModuleUsageReport _usageReport;
+		EngineComparisonReport _comparisonReport;
+		std::string _capturedCode;
 		std::unique_ptr<CScriptCompiler> _compilerNative;
 
 		// # TODO: Remove old compiler references
@@ -187,11 +451,30 @@ namespace NWScriptPlugin
 
 		bool _fetchPreprocessorOnly = false;
 		bool _makeDependencyView = false;
+		bool _makeIncludeGraph = false;
+		bool _compileSnippets = false;
+		bool _gatherUsageReport = false;
+		bool _compareEngines = false;
+		bool _captureCode = false;
 		int _compilerMode = 0;
+		size_t _verifiedScripts = 0;
+		int64_t _verificationMicroseconds = 0;
+		size_t _fastPathScripts = 0;
+		const std::string* _fastPathSource = nullptr;
+		std::vector<std::pair<RESTYPE, std::string>> _fastPathOutputs;
+		bool _keepDisplayedOutput = false;
+		std::shared_ptr<const std::string> _displayedOutput;
+		std::thread _outputWriter;
+		std::mutex _outputWriterLock;
+		generic_string _outputWriteFailure;
+		generic_string _outputWriteFailureCode;
 		void (*_processingEndCallback)(HRESULT returnCode) = nullptr;
 
 		generic_string NWNHome;
 		std::vector<std::string> _includePaths;
+		std::vector<std::unique_ptr<ErfArchive>> _archives;
+		bool _archivesIndexed = false;
+		IncludePrefetcher _includePrefetcher;
 		fs::path _sourcePath;
 		fs::path _destDir;
 
@@ -199,6 +482,13 @@ namespace NWScriptPlugin
 
 		NWScriptLogger _logger;
 
+		// Waits for the background write of the displayed listing (if any)
+		void joinOutputWriter() {
+			std::lock_guard<std::mutex> lock(_outputWriterLock);
+			if (_outputWriter.joinable())
+				_outputWriter.join();
+		}
+
 		// Notify Caller of processing results
 		void notifyCaller(bool success) {
 			if (_processingEndCallback)
@@ -208,6 +498,9 @@ namespace NWScriptPlugin
 		// Load Base script resources
 		bool loadScriptResources();
 
+		// Opens the archives on the include directories
+		void indexArchives();
+
 		// Compile a plain text script into binary format
 		bool compileScriptLegacy(std::string& fileContents,
 			const NWN::ResType& fileResType, const NWN::ResRef32& fileResRef);
@@ -215,12 +508,30 @@ namespace NWScriptPlugin
 		bool compileScriptNative(std::string& fileContents,
 			const NWN::ResType& fileResType, const NWN::ResRef32& fileResRef);
 
+		// Writes the outputs deferred by a fast path compile, all at once
+		bool flushFastPathOutputs();
+
 		// Disassemble a binary file into a pcode assembly text format
 		bool disassemblyBinary(std::string& fileContents,
 			const NWN::ResType& fileResType, const NWN::ResRef32& fileResRef);
 
+		// Compiles every snippet of a manifest against the same identifier table and include cache
+		bool compileSnippetManifest(const std::string& manifestContents);
+
+		// Compiles the script with both engines, timing and diffing their outputs
+		bool compareEngines(std::string& fileContents,
+			const NWN::ResType& fileResType, const NWN::ResRef32& fileResRef);
+
+		// Compiles the script with the include graph recorded, keeping the compiled code in memory
+		bool viewIncludeGraph(std::string& fileContents,
+			const NWN::ResType& fileResType, const NWN::ResRef32& fileResRef);
+
+		// Adds the last native compile's reachability to the usage report
+		void gatherUsageReport(const std::string& fileContents);
+
 		// Dependencies files and views
 		bool MakeDependenciesView(const std::set<std::string>& dependencies);
 		bool MakeDependenciesFile(const std::set<std::string>& dependencies);
+		void MakeIncludeGraphView(bool compiled, double compileMilliseconds);
 	};
 }
\ No newline at end of file
@@ -46,6 +46,145 @@ void NWScriptLogger::log(const generic_string& message, LogType type, const gene
 	}
 }
 
+static void writeSpillString(std::fstream& file, const generic_string& value)
+{
+	uint32_t length = static_cast<uint32_t>(value.size());
+	file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+	file.write(reinterpret_cast<const char*>(value.data()), length * sizeof(TCHAR));
+}
+
+static generic_string readSpillString(std::fstream& file)
+{
+	uint32_t length = 0;
+	file.read(reinterpret_cast<char*>(&length), sizeof(length));
+	if (!file)
+		return generic_string();
+
+	generic_string value(length, 0);
+	file.read(reinterpret_cast<char*>(value.data()), length * sizeof(TCHAR));
+	return value;
+}
+
+void NWScriptLogger::MessageStore::push_back(const CompilerMessage& message)
+{
+	std::lock_guard<std::mutex> lock(_lock);
+
+	_types.push_back(static_cast<uint8_t>(message.messageType));
+	_counts[static_cast<size_t>(message.messageType)]++;
+	_recent.push_back(message);
+
+	// Spill a whole page at a time, so pages in the file always start at a multiple of _pageSize
+	if (_recent.size() >= _maxInMemory + _pageSize)
+		spillOldestPage();
+}
+
+NWScriptLogger::CompilerMessage NWScriptLogger::MessageStore::at(size_t index)
+{
+	std::lock_guard<std::mutex> lock(_lock);
+
+	if (index >= _spilledCount)
+		return _recent[index - _spilledCount];
+
+	size_t page = index / _pageSize;
+	if (_loadedPages.find(page) == _loadedPages.end())
+		loadPage(page);
+
+	return _loadedPages[page][index % _pageSize];
+}
+
+void NWScriptLogger::MessageStore::clear()
+{
+	std::lock_guard<std::mutex> lock(_lock);
+
+	_types.clear();
+	_counts = {};
+	_recent.clear();
+	_spilledCount = 0;
+	_pageOffsets.clear();
+	_loadedPages.clear();
+	_loadedPagesOrder.clear();
+	_spillFailed = false;
+
+	if (_spillFile.is_open())
+	{
+		_spillFile.close();
+		std::error_code ec;
+		fs::remove(_spillPath, ec);
+	}
+}
+
+bool NWScriptLogger::MessageStore::openSpillFile()
+{
+	std::error_code ec;
+	fs::path tempDir = fs::temp_directory_path(ec);
+	if (ec)
+		return false;
+
+	_spillPath = tempDir / std::format(TEXT("NWScript-Npp-messages-{}-{:x}.tmp"), GetCurrentProcessId(), reinterpret_cast<uintptr_t>(this));
+	_spillFile.open(_spillPath, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+
+	return _spillFile.is_open();
+}
+
+void NWScriptLogger::MessageStore::spillOldestPage()
+{
+	// If we can't have a spill file, everything just stays in memory
+	if (_spillFailed || (!_spillFile.is_open() && !openSpillFile()))
+	{
+		_spillFailed = true;
+		return;
+	}
+
+	_spillFile.clear();
+	_spillFile.seekp(0, std::ios::end);
+	_pageOffsets.push_back(_spillFile.tellp());
+
+	for (size_t i = 0; i < _pageSize; i++)
+	{
+		const CompilerMessage& message = _recent.front();
+		uint8_t messageType = static_cast<uint8_t>(message.messageType);
+		_spillFile.write(reinterpret_cast<const char*>(&messageType), sizeof(messageType));
+		writeSpillString(_spillFile, message.messageText);
+		writeSpillString(_spillFile, message.messageCode);
+		writeSpillString(_spillFile, message.fileName);
+		writeSpillString(_spillFile, message.fileExt);
+		writeSpillString(_spillFile, message.lineNumber);
+		writeSpillString(_spillFile, message.filePath.wstring());
+		_recent.pop_front();
+	}
+
+	_spilledCount += _pageSize;
+}
+
+void NWScriptLogger::MessageStore::loadPage(size_t page)
+{
+	std::vector<CompilerMessage> messages(_pageSize);
+
+	_spillFile.clear();
+	_spillFile.seekg(_pageOffsets[page]);
+
+	for (CompilerMessage& message : messages)
+	{
+		uint8_t messageType = static_cast<uint8_t>(LogType::ConsoleMessage);
+		_spillFile.read(reinterpret_cast<char*>(&messageType), sizeof(messageType));
+		message.messageType = static_cast<LogType>(messageType);
+		message.messageText = readSpillString(_spillFile);
+		message.messageCode = readSpillString(_spillFile);
+		message.fileName = readSpillString(_spillFile);
+		message.fileExt = readSpillString(_spillFile);
+		message.lineNumber = readSpillString(_spillFile);
+		message.filePath = readSpillString(_spillFile);
+	}
+
+	_loadedPages[page] = std::move(messages);
+	_loadedPagesOrder.push_back(page);
+	if (_loadedPagesOrder.size() > _maxLoadedPages)
+	{
+		_loadedPages.erase(_loadedPagesOrder.front());
+		_loadedPagesOrder.pop_front();
+	}
+}
+
 void NWScriptLogger::WriteText(const char* fmt, ...) {
 	va_list params;
 	va_start(params, fmt);
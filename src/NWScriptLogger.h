@@ -7,6 +7,10 @@
 
 #pragma once
 
+#include <deque>
+#include <fstream>
+#include <map>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -43,12 +47,80 @@ namespace NWScriptPlugin
 			}
 		};
 
+		// Bounded storage for compiler messages. The most recent ones are kept in memory, older ones are
+		// spilled to a temporary file and paged back in (one page at a time) when they are requested again.
+		// Message types are kept for every entry, so counts and filters never need to read the file.
+		class MessageStore {
+
+		public:
+
+			MessageStore(size_t maxInMemory = 4096, size_t pageSize = 256) : _maxInMemory(maxInMemory), _pageSize(pageSize) {}
+
+			~MessageStore() {
+				clear();
+			}
+
+			MessageStore(const MessageStore&) = delete;
+			MessageStore& operator=(const MessageStore&) = delete;
+
+			void push_back(const CompilerMessage& message);
+
+			// Returns the message at index, reading its page from the spill file if necessary
+			CompilerMessage at(size_t index);
+
+			LogType typeAt(size_t index) const {
+				std::lock_guard<std::mutex> lock(_lock);
+				return static_cast<LogType>(_types[index]);
+			}
+
+			size_t size() const {
+				std::lock_guard<std::mutex> lock(_lock);
+				return _types.size();
+			}
+
+			size_t count(LogType type) const {
+				std::lock_guard<std::mutex> lock(_lock);
+				return _counts[static_cast<size_t>(type)];
+			}
+
+			void clear();
+
+		private:
+
+			void spillOldestPage();
+			bool openSpillFile();
+			void loadPage(size_t page);
+
+			size_t _maxInMemory;
+			size_t _pageSize;
+
+			std::vector<uint8_t> _types;
+			std::array<size_t, 5> _counts = {};
+
+			// Messages [_spilledCount, size()) are in memory
+			std::deque<CompilerMessage> _recent;
+			size_t _spilledCount = 0;
+
+			// Spill file and the offset of every page written to it
+			fs::path _spillPath;
+			std::fstream _spillFile;
+			bool _spillFailed = false;
+			std::vector<std::streamoff> _pageOffsets;
+
+			// A few pages read back from the spill file, oldest first
+			std::map<size_t, std::vector<CompilerMessage>> _loadedPages;
+			std::deque<size_t> _loadedPagesOrder;
+			static const size_t _maxLoadedPages = 4;
+
+			mutable std::mutex _lock;
+		};
+
 		CompilerMessage operator[](size_t index) {
-			return compilerMessages[index];
+			return compilerMessages.at(index);
 		}
 
 		CompilerMessage getMessage(size_t index) {
-			return compilerMessages[index];
+			return compilerMessages.at(index);
 		}
 
 		fs::path getIncludeFile(size_t index) {
@@ -113,7 +185,7 @@ namespace NWScriptPlugin
 		virtual void WriteTextV(const char* fmt, va_list ap);
 
 	private:
-		std::vector<CompilerMessage> compilerMessages;
+		MessageStore compilerMessages;
 		std::vector<fs::path> includeFiles;
 		std::stringstream processorContents;
 
@@ -0,0 +1,372 @@
+//
+// SPDX-License-Identifier: GPL-3.0
+//
+// This file is part of the NWScript compiler open source release.
+//
+// The initial source release is licensed under GPL-3.0.
+//
+// All subsequent changes you submit are required to be licensed under MIT.
+//
+// However, the project overall will still be GPL-3.0.
+//
+// The intent is for the base game to be able to pick up changes you explicitly
+// submit for inclusion painlessly, while ensuring the overall project source code
+// remains available for everyone.
+//
+
+//::///////////////////////////////////////////////////////////////////////////
+//::
+//::  ErfTest.cpp
+//::
+//::  Tests of the archive reader the plugin uses to find scripts inside
+//::  .hak/.erf/.mod files on the include directories.  Archives are built
+//::  in memory, damaged on purpose where needed, and written to the temp
+//::  directory for ErfArchive to open.  Not part of the plugin project;
+//::  build and run it on its own:
+//::
+//::    g++ -std=c++17 -O2 -o erftest erftest.cpp ../ErfArchive.cpp && ./erftest
+//::
+//::///////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "../ErfArchive.h"
+
+using NWScriptPlugin::ErfArchive;
+
+static int32_t g_nChecks = 0;
+static int32_t g_nFailures = 0;
+
+#define CHECK(bCondition) Check((bCondition), #bCondition, __LINE__)
+
+static void Check(bool bCondition, const char *pchCondition, int32_t nLine)
+{
+	++g_nChecks;
+	if (!bCondition)
+	{
+		++g_nFailures;
+		printf("erftest.cpp(%d): FAILED: %s\n", nLine, pchCondition);
+	}
+}
+
+static void WriteUInt32(std::string &sData, size_t nOffset, uint32_t nValue)
+{
+	sData[nOffset]     = (char) (nValue & 0xff);
+	sData[nOffset + 1] = (char) ((nValue >> 8) & 0xff);
+	sData[nOffset + 2] = (char) ((nValue >> 16) & 0xff);
+	sData[nOffset + 3] = (char) ((nValue >> 24) & 0xff);
+}
+
+// Header fields the tests damage.
+#define ERF_ENTRY_COUNT    16
+#define ERF_KEY_LIST       24
+#define ERF_RESOURCE_LIST  28
+#define ERF_HEADER_SIZE    160
+
+// Lays out an archive the way the toolset does: header, key list, resource
+// list, then the resource data in key order.
+class CArchiveBuilder
+{
+public:
+	CArchiveBuilder(const char *pchType, const char *pchVersion) :
+		m_sType(pchType), m_sVersion(pchVersion), m_nResRefLength(strcmp(pchVersion, "V1.0") == 0 ? 16 : 32) {}
+
+	void Add(const std::string &sName, uint16_t nType, const std::string &sContents)
+	{
+		m_aResources.push_back({ sName, nType, sContents });
+	}
+
+	size_t GetKeySize() const { return m_nResRefLength + 8; }
+	size_t GetKeyList() const { return ERF_HEADER_SIZE; }
+	size_t GetResourceList() const { return GetKeyList() + m_aResources.size() * GetKeySize(); }
+
+	std::string Build() const
+	{
+		std::string sData(GetResourceList() + m_aResources.size() * 8, '\0');
+		memcpy(&sData[0], m_sType.data(), 4);
+		memcpy(&sData[4], m_sVersion.data(), 4);
+		WriteUInt32(sData, ERF_ENTRY_COUNT, (uint32_t) m_aResources.size());
+		WriteUInt32(sData, ERF_KEY_LIST, (uint32_t) GetKeyList());
+		WriteUInt32(sData, ERF_RESOURCE_LIST, (uint32_t) GetResourceList());
+
+		for (size_t nResource = 0; nResource < m_aResources.size(); nResource++)
+		{
+			const CResource &cResource = m_aResources[nResource];
+			size_t nKey = GetKeyList() + nResource * GetKeySize();
+			memcpy(&sData[nKey], cResource.m_sName.data(), std::min(cResource.m_sName.size(), m_nResRefLength));
+			WriteUInt32(sData, nKey + m_nResRefLength, (uint32_t) nResource);
+			sData[nKey + m_nResRefLength + 4] = (char) (cResource.m_nType & 0xff);
+			sData[nKey + m_nResRefLength + 5] = (char) (cResource.m_nType >> 8);
+
+			size_t nEntry = GetResourceList() + nResource * 8;
+			WriteUInt32(sData, nEntry, (uint32_t) sData.size());
+			WriteUInt32(sData, nEntry + 4, (uint32_t) cResource.m_sContents.size());
+			sData += cResource.m_sContents;
+		}
+		return sData;
+	}
+
+private:
+	struct CResource
+	{
+		std::string m_sName;
+		uint16_t m_nType;
+		std::string m_sContents;
+	};
+
+	std::string m_sType;
+	std::string m_sVersion;
+	size_t m_nResRefLength;
+	std::vector<CResource> m_aResources;
+};
+
+static std::filesystem::path WriteArchive(const std::string &sData)
+{
+	static int32_t nArchive = 0;
+	std::filesystem::path cPath = std::filesystem::temp_directory_path() / ("erftest_" + std::to_string(++nArchive) + ".hak");
+	std::ofstream cFile(cPath, std::ios::binary | std::ios::trunc);
+	cFile.write(sData.data(), sData.size());
+	return cPath;
+}
+
+static bool OpenArchive(ErfArchive &cArchive, const std::string &sData)
+{
+	std::filesystem::path cPath = WriteArchive(sData);
+	bool bOpened = cArchive.open(cPath);
+	return bOpened;
+}
+
+// Loads a resource and compares it; a NULL expectation means "not found".
+static bool Loads(const ErfArchive &cArchive, const std::string &sName, uint16_t nType, const char *pchExpected)
+{
+	size_t nSize = 0;
+	char *pchContents = cArchive.load(sName, nType, nSize);
+	bool bMatches;
+	if (pchExpected == NULL)
+	{
+		bMatches = (pchContents == NULL);
+	}
+	else
+	{
+		bMatches = pchContents != NULL && nSize == strlen(pchExpected) &&
+		           memcmp(pchContents, pchExpected, nSize) == 0 && pchContents[nSize] == '\0';
+	}
+	delete[] pchContents;
+	return bMatches;
+}
+
+static void TestVersion10()
+{
+	CArchiveBuilder cBuilder("HAK ", "V1.0");
+	cBuilder.Add("inc_common", ErfArchive::ResNSS, "int Common() { return 1; }");
+	cBuilder.Add("inc_common", ErfArchive::ResNCS, "NCS V1.0B");
+	cBuilder.Add("Mixed_Case", ErfArchive::ResNSS, "void main() {}");
+	cBuilder.Add("exactly16chars__", ErfArchive::ResNSS, "// full length name");
+	cBuilder.Add("empty", ErfArchive::ResNDB, "");
+	cBuilder.Add("model", 2002, "not a script");
+
+	ErfArchive cArchive;
+	CHECK(OpenArchive(cArchive, cBuilder.Build()));
+	CHECK(cArchive.isOpen());
+	CHECK(cArchive.size() == 5);
+
+	CHECK(Loads(cArchive, "inc_common", ErfArchive::ResNSS, "int Common() { return 1; }"));
+	CHECK(Loads(cArchive, "inc_common", ErfArchive::ResNCS, "NCS V1.0B"));
+	CHECK(Loads(cArchive, "inc_common", ErfArchive::ResNDB, NULL));
+	CHECK(Loads(cArchive, "exactly16chars__", ErfArchive::ResNSS, "// full length name"));
+	CHECK(Loads(cArchive, "empty", ErfArchive::ResNDB, ""));
+	CHECK(Loads(cArchive, "model", 2002, NULL));
+	CHECK(Loads(cArchive, "missing", ErfArchive::ResNSS, NULL));
+	CHECK(Loads(cArchive, "", ErfArchive::ResNSS, NULL));
+
+	// Resource names are not case sensitive, on either side.
+	CHECK(Loads(cArchive, "mixed_case", ErfArchive::ResNSS, "void main() {}"));
+	CHECK(Loads(cArchive, "MIXED_CASE", ErfArchive::ResNSS, "void main() {}"));
+	CHECK(Loads(cArchive, "INC_Common", ErfArchive::ResNSS, "int Common() { return 1; }"));
+
+	cArchive.close();
+	CHECK(!cArchive.isOpen());
+	CHECK(Loads(cArchive, "inc_common", ErfArchive::ResNSS, NULL));
+}
+
+static void TestVersion11()
+{
+	CArchiveBuilder cBuilder("MOD ", "V1.1");
+	std::string sLongName(32, 'x');
+	cBuilder.Add("nwn2_script", ErfArchive::ResNSS, "void main() { }");
+	cBuilder.Add(sLongName, ErfArchive::ResNSS, "// 32 characters");
+	cBuilder.Add("area_001", 2012, "not a script");
+
+	ErfArchive cArchive;
+	CHECK(OpenArchive(cArchive, cBuilder.Build()));
+	CHECK(cArchive.size() == 2);
+	CHECK(Loads(cArchive, "NWN2_Script", ErfArchive::ResNSS, "void main() { }"));
+	CHECK(Loads(cArchive, sLongName, ErfArchive::ResNSS, "// 32 characters"));
+	CHECK(Loads(cArchive, sLongName + "x", ErfArchive::ResNSS, NULL));
+
+	// The same names in a V1.0 archive get cut to 16 characters.
+	CArchiveBuilder cShort("ERF ", "V1.0");
+	cShort.Add(sLongName, ErfArchive::ResNSS, "// cut");
+	CHECK(OpenArchive(cArchive, cShort.Build()));
+	CHECK(Loads(cArchive, std::string(16, 'x'), ErfArchive::ResNSS, "// cut"));
+	CHECK(Loads(cArchive, sLongName, ErfArchive::ResNSS, NULL));
+}
+
+static void TestNotAnArchive()
+{
+	CArchiveBuilder cBuilder("HAK ", "V1.0");
+	cBuilder.Add("script", ErfArchive::ResNSS, "void main() {}");
+	std::string sValid = cBuilder.Build();
+	ErfArchive cArchive;
+
+	std::string sData = sValid;
+	memcpy(&sData[0], "KEY ", 4);
+	CHECK(!OpenArchive(cArchive, sData));
+
+	sData = sValid;
+	memcpy(&sData[4], "V2.0", 4);
+	CHECK(!OpenArchive(cArchive, sData));
+
+	CHECK(!OpenArchive(cArchive, sValid.substr(0, ERF_HEADER_SIZE - 1)));
+	CHECK(!OpenArchive(cArchive, ""));
+	CHECK(!cArchive.isOpen());
+	CHECK(!cArchive.open(std::filesystem::temp_directory_path() / "erftest_does_not_exist.hak"));
+
+	// An archive with nothing in it is fine.
+	CHECK(OpenArchive(cArchive, CArchiveBuilder("ERF ", "V1.0").Build()));
+	CHECK(cArchive.size() == 0);
+	CHECK(Loads(cArchive, "script", ErfArchive::ResNSS, NULL));
+}
+
+static void TestTruncatedTables()
+{
+	CArchiveBuilder cBuilder("HAK ", "V1.0");
+	for (int32_t nScript = 0; nScript < 10; nScript++)
+	{
+		cBuilder.Add("script" + std::to_string(nScript), ErfArchive::ResNSS, "void main() {}");
+	}
+	std::string sValid = cBuilder.Build();
+	ErfArchive cArchive;
+
+	CHECK(OpenArchive(cArchive, sValid));
+	CHECK(cArchive.size() == 10);
+
+	// The file ends inside the key list, or inside the resource list.
+	CHECK(!OpenArchive(cArchive, sValid.substr(0, cBuilder.GetKeyList() + 5 * cBuilder.GetKeySize())));
+	CHECK(!OpenArchive(cArchive, sValid.substr(0, cBuilder.GetResourceList() + 5 * 8)));
+
+	// The header claims more entries than the tables can hold.
+	std::string sData = sValid;
+	WriteUInt32(sData, ERF_ENTRY_COUNT, 0xffffffff);
+	CHECK(!OpenArchive(cArchive, sData));
+
+	sData = sValid;
+	WriteUInt32(sData, ERF_ENTRY_COUNT, (uint32_t) (sValid.size() / 8));
+	CHECK(!OpenArchive(cArchive, sData));
+
+	// The tables start past the end of the file.
+	sData = sValid;
+	WriteUInt32(sData, ERF_KEY_LIST, 0xfffffff0);
+	CHECK(!OpenArchive(cArchive, sData));
+
+	sData = sValid;
+	WriteUInt32(sData, ERF_RESOURCE_LIST, (uint32_t) sValid.size() - 8);
+	CHECK(!OpenArchive(cArchive, sData));
+}
+
+static void TestOutOfRangeEntries()
+{
+	CArchiveBuilder cBuilder("HAK ", "V1.0");
+	cBuilder.Add("good", ErfArchive::ResNSS, "void main() {}");
+	cBuilder.Add("past_end", ErfArchive::ResNSS, "1");
+	cBuilder.Add("wraps", ErfArchive::ResNSS, "2");
+	cBuilder.Add("too_long", ErfArchive::ResNSS, "3");
+	cBuilder.Add("bad_id", ErfArchive::ResNSS, "4");
+	std::string sData = cBuilder.Build();
+
+	// Each damaged entry is skipped on its own; the rest of the archive is usable.
+	size_t nResourceList = cBuilder.GetResourceList();
+	WriteUInt32(sData, nResourceList + 1 * 8, (uint32_t) sData.size() + 100);
+	WriteUInt32(sData, nResourceList + 2 * 8, 0xfffffff0);
+	WriteUInt32(sData, nResourceList + 2 * 8 + 4, 0x20);
+	WriteUInt32(sData, nResourceList + 3 * 8 + 4, (uint32_t) sData.size());
+	WriteUInt32(sData, cBuilder.GetKeyList() + 4 * cBuilder.GetKeySize() + 16, 5);
+
+	ErfArchive cArchive;
+	CHECK(OpenArchive(cArchive, sData));
+	CHECK(cArchive.size() == 1);
+	CHECK(Loads(cArchive, "good", ErfArchive::ResNSS, "void main() {}"));
+	CHECK(Loads(cArchive, "past_end", ErfArchive::ResNSS, NULL));
+	CHECK(Loads(cArchive, "wraps", ErfArchive::ResNSS, NULL));
+	CHECK(Loads(cArchive, "too_long", ErfArchive::ResNSS, NULL));
+	CHECK(Loads(cArchive, "bad_id", ErfArchive::ResNSS, NULL));
+}
+
+static void TestDuplicateNames()
+{
+	CArchiveBuilder cBuilder("HAK ", "V1.0");
+	cBuilder.Add("b_second", ErfArchive::ResNSS, "other");
+	cBuilder.Add("Dup", ErfArchive::ResNSS, "first");
+	cBuilder.Add("dup", ErfArchive::ResNSS, "second");
+	cBuilder.Add("DUP", ErfArchive::ResNSS, "third");
+	cBuilder.Add("dup", ErfArchive::ResNCS, "compiled");
+	cBuilder.Add("a_first", ErfArchive::ResNSS, "other");
+
+	// The first key of a name wins, as it would on a linear scan.
+	ErfArchive cArchive;
+	CHECK(OpenArchive(cArchive, cBuilder.Build()));
+	CHECK(Loads(cArchive, "dup", ErfArchive::ResNSS, "first"));
+	CHECK(Loads(cArchive, "DUP", ErfArchive::ResNSS, "first"));
+	CHECK(Loads(cArchive, "dup", ErfArchive::ResNCS, "compiled"));
+	CHECK(Loads(cArchive, "a_first", ErfArchive::ResNSS, "other"));
+	CHECK(Loads(cArchive, "b_second", ErfArchive::ResNSS, "other"));
+}
+
+static void TestLargeTables()
+{
+	// More entries than one block of the table reader, with the scripts
+	// scattered among other resources.
+	CArchiveBuilder cBuilder("HAK ", "V1.0");
+	for (int32_t nResource = 0; nResource < 10000; nResource++)
+	{
+		std::string sName = "res" + std::to_string(nResource);
+		cBuilder.Add(sName, nResource % 7 == 0 ? ErfArchive::ResNSS : 2002, sName);
+	}
+
+	ErfArchive cArchive;
+	CHECK(OpenArchive(cArchive, cBuilder.Build()));
+	CHECK(cArchive.size() == 1429);
+	CHECK(Loads(cArchive, "res0", ErfArchive::ResNSS, "res0"));
+	CHECK(Loads(cArchive, "res4096", ErfArchive::ResNSS, NULL));
+	CHECK(Loads(cArchive, "res4102", ErfArchive::ResNSS, "res4102"));
+	CHECK(Loads(cArchive, "res9996", ErfArchive::ResNSS, "res9996"));
+}
+
+int main()
+{
+	TestVersion10();
+	TestVersion11();
+	TestNotAnArchive();
+	TestTruncatedTables();
+	TestOutOfRangeEntries();
+	TestDuplicateNames();
+	TestLargeTables();
+
+	std::error_code cError;
+	for (const auto &cEntry : std::filesystem::directory_iterator(std::filesystem::temp_directory_path(), cError))
+	{
+		if (cEntry.path().filename().string().rfind("erftest_", 0) == 0)
+		{
+			std::filesystem::remove(cEntry.path(), cError);
+		}
+	}
+
+	printf("erftest: %d checks, %d failed\n", g_nChecks, g_nFailures);
+	return g_nFailures == 0 ? 0 : 1;
+}
@@ -47,6 +47,7 @@
 
 #include <stdint.h>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <stdlib.h>
 #include <string.h>
@@ -585,7 +586,7 @@ struct hash<CExoString>
 {
     std::size_t operator()(const CExoString& k) const
     {
-        return std::hash<std::string>{}(k.CStr());
+        return std::hash<std::string_view>{}(std::string_view(k.CStr(), k.GetLength()));
     }
 };
 }
@@ -0,0 +1,738 @@
+//
+// SPDX-License-Identifier: GPL-3.0
+//
+// This file is part of the NWScript compiler open source release.
+//
+// The initial source release is licensed under GPL-3.0.
+//
+// All subsequent changes you submit are required to be licensed under MIT.
+//
+// However, the project overall will still be GPL-3.0.
+//
+// The intent is for the base game to be able to pick up changes you explicitly
+// submit for inclusion painlessly, while ensuring the overall project source code
+// remains available for everyone.
+//
+
+//::///////////////////////////////////////////////////////////////////////////
+//::
+//::  NcsDiff.cpp
+//::
+//::  Compares two directories of compiled scripts (.ncs) and their debug
+//::  files (.ndb), e.g. a module built by the previous and the new compiler,
+//::  and lists only the scripts whose code means something different.
+//::  Identical files are told apart by a hash; the others are decoded and
+//::  compared function by function with the jump and call targets
+//::  renumbered, so code that only moved around does not show up.  Not part
+//::  of the plugin project; build it on its own:
+//::
+//::    g++ -std=c++17 -O2 -pthread -o ncsdiff ncsdiff.cpp scriptinterp.cpp
+//::
+//::///////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "exobase.h"
+#include "scriptcomp.h"
+#include "scriptinternal.h"
+#include "scriptinterp.h"
+
+#define XXH_INLINE_ALL
+#include "xxhash.h"
+
+static void PrintUsage()
+{
+	printf("usage: ncsdiff [options] old_dir new_dir\n"
+	       "  -j <threads>  worker threads (default: one per core)\n"
+	       "  -a            also list scripts whose code only moved and whose debug files changed\n"
+	       "  -q            print the summary only\n");
+}
+
+static BOOL ReadFile(const std::filesystem::path &cPath, std::string &sContents)
+{
+	// One read of the known size; a module can have thousands of these.
+	std::ifstream cFile(cPath, std::ios::binary | std::ios::ate);
+	if (!cFile)
+	{
+		return FALSE;
+	}
+	sContents.resize((size_t) cFile.tellg());
+	cFile.seekg(0);
+	return cFile.read(&sContents[0], sContents.size()) ? TRUE : FALSE;
+}
+
+// What is known about a script after the comparison.  The order is the
+// order of the listing.
+enum EScriptDifference
+{
+	SCRIPT_CHANGED,
+	SCRIPT_ADDED,
+	SCRIPT_REMOVED,
+	SCRIPT_UNREADABLE,
+	SCRIPT_LAYOUT_ONLY,
+	SCRIPT_DEBUG_ONLY,
+	SCRIPT_IDENTICAL,
+	SCRIPT_DIFFERENCE_COUNT
+};
+
+static const char *g_apchDifferenceNames[SCRIPT_DIFFERENCE_COUNT] =
+{
+	"changed", "added", "removed", "unreadable", "layout only", "debug info only", "identical"
+};
+
+class CScriptPair
+{
+public:
+	std::string m_sName;                // lower case, without extension
+	std::filesystem::path m_aCode[2];   // empty if missing
+	std::filesystem::path m_aDebug[2];
+
+	EScriptDifference m_eDifference = SCRIPT_IDENTICAL;
+	std::string m_sDetail;
+};
+
+// A compiled script cut into functions.  Every function gets a canonical
+// number: the entry point is 0, and the others are numbered in the order
+// they are first called, going through the functions in that same order.
+// This does not depend on where the compiler put them.
+class CDecodedScript
+{
+public:
+	std::vector<int32_t> m_aInstructionOffset;
+	std::vector<int32_t> m_aInstructionAtOffset;   // -1 where no instruction starts
+	std::vector<int32_t> m_aFunctionStart;         // first instruction, in file order
+	std::vector<int32_t> m_aFunctionOfInstruction; // index into m_aFunctionStart
+	std::vector<int32_t> m_aCanonicalNumber;       // by index into m_aFunctionStart
+	std::vector<int32_t> m_aCanonicalOrder;        // indices into m_aFunctionStart
+	std::unordered_map<int32_t, std::string> m_aFunctionName; // by code offset, from the .ndb
+
+	int32_t GetFunctionEnd(int32_t nFunction) const
+	{
+		return nFunction + 1 < (int32_t) m_aFunctionStart.size() ? m_aFunctionStart[nFunction + 1] : (int32_t) m_aInstructionOffset.size();
+	}
+};
+
+static BOOL IsJump(uint8_t nOpCode)
+{
+	return nOpCode == CVIRTUALMACHINE_OPCODE_JMP || nOpCode == CVIRTUALMACHINE_OPCODE_JSR ||
+	       nOpCode == CVIRTUALMACHINE_OPCODE_JZ || nOpCode == CVIRTUALMACHINE_OPCODE_JNZ;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static BOOL DecodeScript(const std::string &sCode, CDecodedScript &cScript, std::string &sError)
+////////////////////////////////////////////////////////////////////////////////
+//
+// Description: Finds the instructions and functions of a compiled script.
+//              A function starts at the first instruction and at every JSR
+//              target, and runs up to the next one.  Every jump has to land
+//              on an instruction.
+//
+////////////////////////////////////////////////////////////////////////////////
+{
+	const uint8_t *pCode = (const uint8_t *) sCode.data();
+	int32_t nCodeLength = (int32_t) sCode.size();
+
+	if (nCodeLength < CVIRTUALMACHINE_BINARY_SCRIPT_HEADER || memcmp(pCode, "NCS V1.0", 8) != 0 || pCode[8] != 0x42)
+	{
+		sError = "not a compiled script";
+		return FALSE;
+	}
+
+	cScript.m_aInstructionAtOffset.assign(nCodeLength, -1);
+	for (int32_t nOffset = CVIRTUALMACHINE_BINARY_SCRIPT_HEADER; nOffset < nCodeLength; )
+	{
+		int32_t nSize = VirtualMachineInstructionSize(pCode, nOffset, nCodeLength);
+		if (nSize == 0)
+		{
+			char achError[64];
+			snprintf(achError, sizeof(achError), "unknown or truncated instruction at 0x%08x", nOffset);
+			sError = achError;
+			return FALSE;
+		}
+		cScript.m_aInstructionAtOffset[nOffset] = (int32_t) cScript.m_aInstructionOffset.size();
+		cScript.m_aInstructionOffset.push_back(nOffset);
+		nOffset += nSize;
+	}
+
+	int32_t nInstructions = (int32_t) cScript.m_aInstructionOffset.size();
+	std::vector<BOOL> abFunctionStart(nInstructions, FALSE);
+	if (nInstructions > 0)
+	{
+		abFunctionStart[0] = TRUE;
+	}
+
+	for (int32_t nOffset : cScript.m_aInstructionOffset)
+	{
+		uint8_t nOpCode = pCode[nOffset + CVIRTUALMACHINE_OPCODE_LOCATION];
+		if (!IsJump(nOpCode))
+		{
+			continue;
+		}
+		int64_t nTarget = (int64_t) nOffset + VirtualMachineReadInt32(pCode + nOffset + CVIRTUALMACHINE_EXTRA_DATA_LOCATION);
+		if (nTarget < 0 || nTarget >= nCodeLength || cScript.m_aInstructionAtOffset[nTarget] < 0)
+		{
+			char achError[64];
+			snprintf(achError, sizeof(achError), "jump at 0x%08x does not land on an instruction", nOffset);
+			sError = achError;
+			return FALSE;
+		}
+		if (nOpCode == CVIRTUALMACHINE_OPCODE_JSR)
+		{
+			abFunctionStart[cScript.m_aInstructionAtOffset[nTarget]] = TRUE;
+		}
+	}
+
+	cScript.m_aFunctionOfInstruction.resize(nInstructions);
+	for (int32_t nInstruction = 0; nInstruction < nInstructions; nInstruction++)
+	{
+		if (abFunctionStart[nInstruction])
+		{
+			cScript.m_aFunctionStart.push_back(nInstruction);
+		}
+		cScript.m_aFunctionOfInstruction[nInstruction] = (int32_t) cScript.m_aFunctionStart.size() - 1;
+	}
+
+	// Number the functions in call order.  The order list doubles as the
+	// work queue.
+	int32_t nFunctions = (int32_t) cScript.m_aFunctionStart.size();
+	cScript.m_aCanonicalNumber.assign(nFunctions, -1);
+	auto Number = [&cScript](int32_t nFunction)
+	{
+		if (cScript.m_aCanonicalNumber[nFunction] < 0)
+		{
+			cScript.m_aCanonicalNumber[nFunction] = (int32_t) cScript.m_aCanonicalOrder.size();
+			cScript.m_aCanonicalOrder.push_back(nFunction);
+		}
+	};
+
+	for (int32_t nFunction = 0; nFunction < nFunctions; nFunction++)
+	{
+		// Functions nothing calls come last, in file order.
+		if (cScript.m_aCanonicalNumber[nFunction] >= 0)
+		{
+			continue;
+		}
+		Number(nFunction);
+		for (size_t nNext = cScript.m_aCanonicalOrder.size() - 1; nNext < cScript.m_aCanonicalOrder.size(); nNext++)
+		{
+			int32_t nCurrent = cScript.m_aCanonicalOrder[nNext];
+			for (int32_t nInstruction = cScript.m_aFunctionStart[nCurrent]; nInstruction < cScript.GetFunctionEnd(nCurrent); nInstruction++)
+			{
+				int32_t nOffset = cScript.m_aInstructionOffset[nInstruction];
+				if (pCode[nOffset + CVIRTUALMACHINE_OPCODE_LOCATION] == CVIRTUALMACHINE_OPCODE_JSR)
+				{
+					int32_t nTarget = nOffset + VirtualMachineReadInt32(pCode + nOffset + CVIRTUALMACHINE_EXTRA_DATA_LOCATION);
+					Number(cScript.m_aFunctionOfInstruction[cScript.m_aInstructionAtOffset[nTarget]]);
+				}
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+// Where a jump lands, as a canonical function number and an instruction
+// count from the start of that function.
+static std::pair<int32_t, int32_t> GetCanonicalTarget(const uint8_t *pCode, const CDecodedScript &cScript, int32_t nOffset)
+{
+	int32_t nTarget = cScript.m_aInstructionAtOffset[nOffset + VirtualMachineReadInt32(pCode + nOffset + CVIRTUALMACHINE_EXTRA_DATA_LOCATION)];
+	int32_t nFunction = cScript.m_aFunctionOfInstruction[nTarget];
+	return std::make_pair(cScript.m_aCanonicalNumber[nFunction], nTarget - cScript.m_aFunctionStart[nFunction]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static BOOL IsSameInstruction(const std::string asCode[2], const CDecodedScript acScript[2], const int32_t anInstruction[2])
+////////////////////////////////////////////////////////////////////////////////
+//
+// Description: Compares two instructions regardless of where the code is:
+//              jumps match if they land on the same instruction of the
+//              same canonical function.  Everything else is compared byte
+//              for byte.
+//
+////////////////////////////////////////////////////////////////////////////////
+{
+	const uint8_t *apCode[2];
+	int32_t anOffset[2], anSize[2];
+	for (int32_t nSide = 0; nSide < 2; nSide++)
+	{
+		const CDecodedScript &cScript = acScript[nSide];
+		int32_t nInstruction = anInstruction[nSide];
+		apCode[nSide] = (const uint8_t *) asCode[nSide].data();
+		anOffset[nSide] = cScript.m_aInstructionOffset[nInstruction];
+		anSize[nSide] = (nInstruction + 1 < (int32_t) cScript.m_aInstructionOffset.size() ?
+		                 cScript.m_aInstructionOffset[nInstruction + 1] : (int32_t) asCode[nSide].size()) - anOffset[nSide];
+	}
+
+	if (anSize[0] != anSize[1] || memcmp(apCode[0] + anOffset[0], apCode[1] + anOffset[1], CVIRTUALMACHINE_EXTRA_DATA_LOCATION) != 0)
+	{
+		return FALSE;
+	}
+	if (IsJump(apCode[0][anOffset[0] + CVIRTUALMACHINE_OPCODE_LOCATION]))
+	{
+		return GetCanonicalTarget(apCode[0], acScript[0], anOffset[0]) == GetCanonicalTarget(apCode[1], acScript[1], anOffset[1]);
+	}
+	return memcmp(apCode[0] + anOffset[0], apCode[1] + anOffset[1], anSize[0]) == 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static std::string DescribeInstruction(const std::string &sCode, const CDecodedScript &cScript, int32_t nInstruction)
+////////////////////////////////////////////////////////////////////////////////
+//
+// Description: Prints an instruction for the report: offset, mnemonic and
+//              operands, with the target of a jump spelled out.
+//
+////////////////////////////////////////////////////////////////////////////////
+{
+	if (nInstruction >= (int32_t) cScript.m_aInstructionOffset.size())
+	{
+		return "(end of code)";
+	}
+
+	const uint8_t *pCode = (const uint8_t *) sCode.data();
+	int32_t nOffset = cScript.m_aInstructionOffset[nInstruction];
+	int32_t nEnd = nInstruction + 1 < (int32_t) cScript.m_aInstructionOffset.size() ? cScript.m_aInstructionOffset[nInstruction + 1] : (int32_t) sCode.size();
+	uint8_t nOpCode = pCode[nOffset + CVIRTUALMACHINE_OPCODE_LOCATION];
+	const char *pchName = CScriptInterpreter::GetOpCodeName(nOpCode);
+
+	char achText[64];
+	snprintf(achText, sizeof(achText), "0x%08x %s %02x", nOffset, pchName ? pchName : "?", pCode[nOffset + CVIRTUALMACHINE_AUXCODE_LOCATION]);
+	std::string sText = achText;
+
+	if (IsJump(nOpCode))
+	{
+		snprintf(achText, sizeof(achText), " -> 0x%08x", nOffset + VirtualMachineReadInt32(pCode + nOffset + CVIRTUALMACHINE_EXTRA_DATA_LOCATION));
+		return sText + achText;
+	}
+
+	// Long string constants are cut short; the offset says where to look.
+	int32_t nShown = std::min(nEnd - nOffset - CVIRTUALMACHINE_EXTRA_DATA_LOCATION, 16);
+	if (nShown > 0)
+	{
+		sText += ' ';
+	}
+	for (int32_t nByte = 0; nByte < nShown; nByte++)
+	{
+		snprintf(achText, sizeof(achText), "%02x", pCode[nOffset + CVIRTUALMACHINE_EXTRA_DATA_LOCATION + nByte]);
+		sText += achText;
+	}
+	if (nShown < nEnd - nOffset - CVIRTUALMACHINE_EXTRA_DATA_LOCATION)
+	{
+		sText += "...";
+	}
+	return sText;
+}
+
+static std::string DescribeFunction(const CDecodedScript &cScript, int32_t nFunction)
+{
+	int32_t nOffset = cScript.m_aInstructionOffset[cScript.m_aFunctionStart[nFunction]];
+	auto iName = cScript.m_aFunctionName.find(nOffset);
+
+	char achText[32];
+	snprintf(achText, sizeof(achText), "0x%08x", nOffset);
+	return iName != cScript.m_aFunctionName.end() ? iName->second + " (" + achText + ")" : std::string(achText);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static BOOL CompareCode(const std::string asCode[2], const CDecodedScript acScript[2], int32_t &nCanonical, int32_t &nInstruction)
+////////////////////////////////////////////////////////////////////////////////
+//
+// Description: Compares two decoded scripts function by function in
+//              canonical order.  Returns TRUE if they are the same code
+//              laid out differently; otherwise where they first part ways,
+//              with nInstruction -1 if only the number of functions does.
+//
+////////////////////////////////////////////////////////////////////////////////
+{
+	int32_t nFunctions = (int32_t) std::min(acScript[0].m_aCanonicalOrder.size(), acScript[1].m_aCanonicalOrder.size());
+
+	for (nCanonical = 0; nCanonical < nFunctions; nCanonical++)
+	{
+		int32_t anStart[2], anLength[2];
+		for (int32_t nSide = 0; nSide < 2; nSide++)
+		{
+			int32_t nFunction = acScript[nSide].m_aCanonicalOrder[nCanonical];
+			anStart[nSide] = acScript[nSide].m_aFunctionStart[nFunction];
+			anLength[nSide] = acScript[nSide].GetFunctionEnd(nFunction) - anStart[nSide];
+		}
+
+		for (nInstruction = 0; nInstruction < std::max(anLength[0], anLength[1]); nInstruction++)
+		{
+			int32_t anInstruction[2] = { anStart[0] + nInstruction, anStart[1] + nInstruction };
+			if (nInstruction >= anLength[0] || nInstruction >= anLength[1] || !IsSameInstruction(asCode, acScript, anInstruction))
+			{
+				return FALSE;
+			}
+		}
+	}
+
+	nInstruction = -1;
+	return acScript[0].m_aCanonicalOrder.size() == acScript[1].m_aCanonicalOrder.size();
+}
+
+static std::string DescribeDifference(const std::string asCode[2], const CDecodedScript acScript[2], int32_t nCanonical, int32_t nInstruction)
+{
+	if (nInstruction < 0)
+	{
+		return std::to_string(acScript[0].m_aCanonicalOrder.size()) + " functions, now " + std::to_string(acScript[1].m_aCanonicalOrder.size());
+	}
+
+	std::string sDetail = "function";
+	for (int32_t nSide = 0; nSide < 2; nSide++)
+	{
+		sDetail += (nSide == 0 ? " " : " / ") + DescribeFunction(acScript[nSide], acScript[nSide].m_aCanonicalOrder[nCanonical]);
+	}
+	sDetail += ", instruction " + std::to_string(nInstruction) + ":";
+	for (int32_t nSide = 0; nSide < 2; nSide++)
+	{
+		int32_t nFunction = acScript[nSide].m_aCanonicalOrder[nCanonical];
+		int32_t nAt = acScript[nSide].m_aFunctionStart[nFunction] + nInstruction;
+		sDetail += nSide == 0 ? "\n      - " : "\n      + ";
+		sDetail += nAt < acScript[nSide].GetFunctionEnd(nFunction) ? DescribeInstruction(asCode[nSide], acScript[nSide], nAt) : std::string("(end of function)");
+	}
+	return sDetail;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void ReadDebugFile(const std::string &sDebug, std::vector<std::string> *pasLines, std::unordered_map<int32_t, std::string> *paFunctionName)
+////////////////////////////////////////////////////////////////////////////////
+//
+// Description: Reads a .ndb into its lines with the code offsets left out,
+//              sorted, so that two debug files compare equal when they
+//              describe the same functions, variables and source lines.
+//              Either output may be NULL.  The function names are kept by
+//              offset for the report.
+//
+//                f <start> <end> <parameters> <type> <name>
+//                v <start> <end> <stack location> <type> <name>
+//                l<file> <line> <start> <end>
+//
+////////////////////////////////////////////////////////////////////////////////
+{
+	// Fields are separated by single spaces.
+	for (size_t nStart = 0; nStart < sDebug.size(); )
+	{
+		size_t nEnd = sDebug.find('\n', nStart);
+		if (nEnd == std::string::npos)
+		{
+			nEnd = sDebug.size();
+		}
+		std::string sLine = sDebug.substr(nStart, nEnd - nStart);
+		nStart = nEnd + 1;
+		if (!sLine.empty() && sLine.back() == '\r')
+		{
+			sLine.pop_back();
+		}
+
+		size_t anSpace[4];
+		anSpace[0] = sLine.find(' ');
+		for (int32_t nField = 1; nField < 4; nField++)
+		{
+			anSpace[nField] = anSpace[nField - 1] == std::string::npos ? std::string::npos : sLine.find(' ', anSpace[nField - 1] + 1);
+		}
+
+		if (paFunctionName != NULL && sLine[0] == 'f' && anSpace[0] == 1)
+		{
+			(*paFunctionName)[(int32_t) strtol(sLine.c_str() + 2, NULL, 16)] = sLine.substr(sLine.rfind(' ') + 1);
+		}
+
+		if (pasLines == NULL)
+		{
+			continue;
+		}
+		if ((sLine[0] == 'f' || sLine[0] == 'v') && anSpace[0] == 1 && anSpace[2] != std::string::npos)
+		{
+			pasLines->push_back(sLine.erase(1, anSpace[2] - 1));
+		}
+		else if (sLine[0] == 'l' && anSpace[1] != std::string::npos)
+		{
+			pasLines->push_back(sLine.erase(anSpace[1]));
+		}
+		else
+		{
+			pasLines->push_back(std::move(sLine));
+		}
+	}
+
+	if (pasLines != NULL)
+	{
+		std::sort(pasLines->begin(), pasLines->end());
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void CompareScript(CScriptPair &cPair)
+////////////////////////////////////////////////////////////////////////////////
+//
+// Description: Works out what changed in one script.  Equal hashes settle
+//              it at once; otherwise the code is decoded and compared and,
+//              if it means the same, the debug files decide between
+//              "layout only" and "debug info only".
+//
+////////////////////////////////////////////////////////////////////////////////
+{
+	if (cPair.m_aCode[0].empty())
+	{
+		cPair.m_eDifference = SCRIPT_ADDED;
+		return;
+	}
+	if (cPair.m_aCode[1].empty())
+	{
+		cPair.m_eDifference = SCRIPT_REMOVED;
+		return;
+	}
+
+	std::string asCode[2], asDebug[2];
+	BOOL abHasDebug[2];
+	for (int32_t nSide = 0; nSide < 2; nSide++)
+	{
+		if (!ReadFile(cPair.m_aCode[nSide], asCode[nSide]))
+		{
+			cPair.m_eDifference = SCRIPT_UNREADABLE;
+			cPair.m_sDetail = "cannot read " + cPair.m_aCode[nSide].string();
+			return;
+		}
+		abHasDebug[nSide] = !cPair.m_aDebug[nSide].empty() && ReadFile(cPair.m_aDebug[nSide], asDebug[nSide]);
+	}
+
+	BOOL bSameCode = asCode[0].size() == asCode[1].size() &&
+	                 XXH64(asCode[0].data(), asCode[0].size(), 0) == XXH64(asCode[1].data(), asCode[1].size(), 0);
+	BOOL bSameDebug = abHasDebug[0] == abHasDebug[1] && asDebug[0].size() == asDebug[1].size() &&
+	                  XXH64(asDebug[0].data(), asDebug[0].size(), 0) == XXH64(asDebug[1].data(), asDebug[1].size(), 0);
+
+	if (bSameCode && bSameDebug)
+	{
+		cPair.m_eDifference = SCRIPT_IDENTICAL;
+		return;
+	}
+
+	if (!bSameCode)
+	{
+		CDecodedScript acScript[2];
+		for (int32_t nSide = 0; nSide < 2; nSide++)
+		{
+			std::string sError;
+			if (!DecodeScript(asCode[nSide], acScript[nSide], sError))
+			{
+				cPair.m_eDifference = SCRIPT_UNREADABLE;
+				cPair.m_sDetail = cPair.m_aCode[nSide].string() + ": " + sError;
+				return;
+			}
+		}
+
+		int32_t nCanonical, nInstruction;
+		if (!CompareCode(asCode, acScript, nCanonical, nInstruction))
+		{
+			// Function names only matter for the report.
+			for (int32_t nSide = 0; nSide < 2; nSide++)
+			{
+				ReadDebugFile(asDebug[nSide], NULL, &acScript[nSide].m_aFunctionName);
+			}
+			cPair.m_eDifference = SCRIPT_CHANGED;
+			cPair.m_sDetail = DescribeDifference(asCode, acScript, nCanonical, nInstruction);
+			return;
+		}
+	}
+
+	// The offsets in a debug file follow the code, so a layout change alone
+	// rewrites it too.  Only what is left without them counts.
+	if (abHasDebug[0] != abHasDebug[1])
+	{
+		cPair.m_eDifference = SCRIPT_DEBUG_ONLY;
+		cPair.m_sDetail = abHasDebug[0] ? "debug file removed" : "debug file added";
+		return;
+	}
+
+	std::vector<std::string> aasDebugLines[2];
+	if (!bSameDebug)
+	{
+		for (int32_t nSide = 0; nSide < 2; nSide++)
+		{
+			ReadDebugFile(asDebug[nSide], &aasDebugLines[nSide], NULL);
+		}
+	}
+
+	if (aasDebugLines[0] != aasDebugLines[1])
+	{
+		cPair.m_eDifference = SCRIPT_DEBUG_ONLY;
+		cPair.m_sDetail = "functions, variables or line numbers differ";
+	}
+	else
+	{
+		cPair.m_eDifference = bSameCode ? SCRIPT_IDENTICAL : SCRIPT_LAYOUT_ONLY;
+	}
+}
+
+static BOOL ListDirectory(const char *pchDirectory, int32_t nSide, std::map<std::string, CScriptPair> &aPairs)
+{
+	std::error_code cError;
+	std::filesystem::directory_iterator iEntry(pchDirectory, cError);
+	if (cError)
+	{
+		fprintf(stderr, "ncsdiff: cannot list %s: %s\n", pchDirectory, cError.message().c_str());
+		return FALSE;
+	}
+
+	for (const auto &cEntry : iEntry)
+	{
+		if (!cEntry.is_regular_file(cError))
+		{
+			continue;
+		}
+
+		// Resource names are not case sensitive.
+		std::string sExtension = cEntry.path().extension().string();
+		std::string sName = cEntry.path().stem().string();
+		std::transform(sExtension.begin(), sExtension.end(), sExtension.begin(), [](char c) { return (char) tolower((unsigned char) c); });
+		std::transform(sName.begin(), sName.end(), sName.begin(), [](char c) { return (char) tolower((unsigned char) c); });
+
+		if (sExtension == ".ncs" || sExtension == ".ndb")
+		{
+			CScriptPair &cPair = aPairs[sName];
+			cPair.m_sName = sName;
+			(sExtension == ".ncs" ? cPair.m_aCode : cPair.m_aDebug)[nSide] = cEntry.path();
+		}
+	}
+	return TRUE;
+}
+
+int main(int argc, char **argv)
+{
+	std::vector<const char *> apchDirectories;
+	int32_t nThreads = (int32_t) std::thread::hardware_concurrency();
+	BOOL bListAll = FALSE;
+	BOOL bQuiet = FALSE;
+
+	for (int nArg = 1; nArg < argc; nArg++)
+	{
+		const char *pchArg = argv[nArg];
+		BOOL bHasValue = (nArg + 1 < argc);
+
+		if (strcmp(pchArg, "-j") == 0 && bHasValue)
+		{
+			nThreads = atoi(argv[++nArg]);
+		}
+		else if (strcmp(pchArg, "-a") == 0)
+		{
+			bListAll = TRUE;
+		}
+		else if (strcmp(pchArg, "-q") == 0)
+		{
+			bQuiet = TRUE;
+		}
+		else if (pchArg[0] == '-')
+		{
+			PrintUsage();
+			return 2;
+		}
+		else
+		{
+			apchDirectories.push_back(pchArg);
+		}
+	}
+
+	if (apchDirectories.size() != 2)
+	{
+		PrintUsage();
+		return 2;
+	}
+
+	auto tStart = std::chrono::steady_clock::now();
+
+	std::map<std::string, CScriptPair> aPairsByName;
+	for (int32_t nSide = 0; nSide < 2; nSide++)
+	{
+		if (!ListDirectory(apchDirectories[nSide], nSide, aPairsByName))
+		{
+			return 2;
+		}
+	}
+
+	// A debug file without its script is not worth a line.
+	std::vector<CScriptPair> aPairs;
+	for (auto &cEntry : aPairsByName)
+	{
+		if (!cEntry.second.m_aCode[0].empty() || !cEntry.second.m_aCode[1].empty())
+		{
+			aPairs.push_back(std::move(cEntry.second));
+		}
+	}
+
+	// Scripts are independent, so the workers just take the next one.
+	nThreads = std::max(1, std::min(nThreads, (int32_t) aPairs.size()));
+	std::atomic<size_t> nNext(0);
+	auto Work = [&aPairs, &nNext]()
+	{
+		for (size_t nPair = nNext++; nPair < aPairs.size(); nPair = nNext++)
+		{
+			CompareScript(aPairs[nPair]);
+		}
+	};
+
+	std::vector<std::thread> aWorkers;
+	for (int32_t nThread = 1; nThread < nThreads; nThread++)
+	{
+		aWorkers.emplace_back(Work);
+	}
+	Work();
+	for (std::thread &cWorker : aWorkers)
+	{
+		cWorker.join();
+	}
+
+	int32_t anCount[SCRIPT_DIFFERENCE_COUNT] = {};
+	for (const CScriptPair &cPair : aPairs)
+	{
+		anCount[cPair.m_eDifference]++;
+	}
+
+	if (!bQuiet)
+	{
+		for (int32_t nDifference = 0; nDifference < SCRIPT_DIFFERENCE_COUNT; nDifference++)
+		{
+			if (nDifference == SCRIPT_IDENTICAL || (!bListAll && nDifference >= SCRIPT_LAYOUT_ONLY))
+			{
+				continue;
+			}
+			for (const CScriptPair &cPair : aPairs)
+			{
+				if (cPair.m_eDifference != nDifference)
+				{
+					continue;
+				}
+				printf("%-16s %s", g_apchDifferenceNames[nDifference], cPair.m_sName.c_str());
+				if (!cPair.m_sDetail.empty())
+				{
+					printf(": %s", cPair.m_sDetail.c_str());
+				}
+				printf("\n");
+			}
+		}
+	}
+
+	double fSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - tStart).count();
+
+	printf("%s%zu scripts in %.2f s on %d thread%s:", bQuiet ? "" : "\n", aPairs.size(), fSeconds, nThreads, nThreads == 1 ? "" : "s");
+	for (int32_t nDifference = 0; nDifference < SCRIPT_DIFFERENCE_COUNT; nDifference++)
+	{
+		printf("%s %d %s", nDifference == 0 ? "" : ",", anCount[nDifference], g_apchDifferenceNames[nDifference]);
+	}
+	printf("\n");
+
+	if (anCount[SCRIPT_UNREADABLE] != 0)
+	{
+		return 2;
+	}
+	return (anCount[SCRIPT_CHANGED] + anCount[SCRIPT_ADDED] + anCount[SCRIPT_REMOVED]) != 0 ? 1 : 0;
+}
@@ -0,0 +1,283 @@
+//
+// SPDX-License-Identifier: GPL-3.0
+//
+// This file is part of the NWScript compiler open source release.
+//
+// The initial source release is licensed under GPL-3.0.
+//
+// All subsequent changes you submit are required to be licensed under MIT.
+//
+// However, the project overall will still be GPL-3.0.
+//
+// The intent is for the base game to be able to pick up changes you explicitly
+// submit for inclusion painlessly, while ensuring the overall project source code
+// remains available for everyone.
+//
+
+//::///////////////////////////////////////////////////////////////////////////
+//::
+//::  NcsRun.cpp
+//::
+//::  Command line front end of CScriptInterpreter.  Runs one or more compiled
+//::  scripts and prints what they executed side by side, so the same script
+//::  compiled with different optimization flags can be compared.  Not part of
+//::  the plugin project; build it on its own:
+//::
+//::    g++ -std=c++17 -O2 -o ncsrun ncsrun.cpp scriptinterp.cpp
+//::
+//::///////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "exobase.h"
+#include "scriptcomp.h"
+#include "scriptinterp.h"
+
+static void PrintUsage()
+{
+	printf("usage: ncsrun [options] script.ncs [script.ncs ...]\n"
+	       "  -s <nwscript.nss>      action prototypes, required by scripts that call actions\n"
+	       "  -r <Action>=<v>[,<v>]  return values of an action stub; the last one repeats\n"
+	       "  -m <count>             instruction limit per run (default %d)\n"
+	       "  -n <count>             runs per script; the fastest time is reported (default 1)\n"
+	       "  -o <id>                object id of OBJECT_SELF (default 1)\n"
+	       "  -d                     do not run the action arguments of DelayCommand & co.\n",
+	       CSCRIPTINTERPRETER_DEFAULT_MAX_INSTRUCTIONS);
+}
+
+static BOOL ReadFile(const char *pchFileName, std::string &sContents)
+{
+	std::ifstream cFile(pchFileName, std::ios::binary);
+	if (!cFile)
+	{
+		return FALSE;
+	}
+	sContents.assign(std::istreambuf_iterator<char>(cFile), std::istreambuf_iterator<char>());
+	return TRUE;
+}
+
+static std::vector<std::string> SplitValues(const std::string &sValues)
+{
+	std::vector<std::string> asValues;
+	size_t nStart = 0;
+	for (;;)
+	{
+		size_t nComma = sValues.find(',', nStart);
+		asValues.push_back(sValues.substr(nStart, nComma - nStart));
+		if (nComma == std::string::npos)
+		{
+			return asValues;
+		}
+		nStart = nComma + 1;
+	}
+}
+
+class CScriptRun
+{
+public:
+	const char *m_pchFileName = NULL;
+	int32_t m_nResult = 0;
+	std::string m_sError;
+	int32_t m_nErrorOffset = -1;
+	BOOL m_bHasReturnValue = FALSE;
+	int32_t m_nReturnValue = 0;
+	CScriptInterpreterStatistics m_cStatistics;
+};
+
+int main(int argc, char **argv)
+{
+	CScriptInterpreter cInterpreter;
+	std::vector<std::pair<std::string, std::string>> aReturnValues;
+	std::vector<const char *> apchScripts;
+	int32_t nRepeat = 1;
+
+	for (int nArg = 1; nArg < argc; nArg++)
+	{
+		const char *pchArg = argv[nArg];
+		BOOL bHasValue = (nArg + 1 < argc);
+
+		if (strcmp(pchArg, "-s") == 0 && bHasValue)
+		{
+			std::string sSpecification;
+			if (!ReadFile(argv[++nArg], sSpecification))
+			{
+				fprintf(stderr, "ncsrun: cannot read %s\n", argv[nArg]);
+				return 2;
+			}
+			if (cInterpreter.LoadActionSpecification(sSpecification.data(), sSpecification.size()) < 0)
+			{
+				fprintf(stderr, "ncsrun: %s: %s\n", argv[nArg], cInterpreter.GetError().c_str());
+				return 2;
+			}
+		}
+		else if (strcmp(pchArg, "-r") == 0 && bHasValue)
+		{
+			std::string sOption = argv[++nArg];
+			size_t nEquals = sOption.find('=');
+			if (nEquals == std::string::npos)
+			{
+				PrintUsage();
+				return 2;
+			}
+			aReturnValues.emplace_back(sOption.substr(0, nEquals), sOption.substr(nEquals + 1));
+		}
+		else if (strcmp(pchArg, "-m") == 0 && bHasValue)
+		{
+			cInterpreter.SetMaxInstructions(strtoull(argv[++nArg], NULL, 0));
+		}
+		else if (strcmp(pchArg, "-n") == 0 && bHasValue)
+		{
+			nRepeat = std::max(1, atoi(argv[++nArg]));
+		}
+		else if (strcmp(pchArg, "-o") == 0 && bHasValue)
+		{
+			cInterpreter.SetObjectSelf((uint32_t) strtoul(argv[++nArg], NULL, 0));
+		}
+		else if (strcmp(pchArg, "-d") == 0)
+		{
+			cInterpreter.SetRunDeferredActions(FALSE);
+		}
+		else if (pchArg[0] == '-')
+		{
+			PrintUsage();
+			return 2;
+		}
+		else
+		{
+			apchScripts.push_back(pchArg);
+		}
+	}
+
+	if (apchScripts.empty())
+	{
+		PrintUsage();
+		return 2;
+	}
+
+	// Stubs are set once the prototypes are known, whatever the option order.
+	for (const auto &cReturnValue : aReturnValues)
+	{
+		if (!cInterpreter.SetActionReturnValues(cReturnValue.first, SplitValues(cReturnValue.second)))
+		{
+			fprintf(stderr, "ncsrun: cannot set the return values of %s to %s\n", cReturnValue.first.c_str(), cReturnValue.second.c_str());
+			return 2;
+		}
+	}
+
+	std::vector<CScriptRun> aRuns;
+	BOOL bFailed = FALSE;
+
+	for (const char *pchScript : apchScripts)
+	{
+		CScriptRun cRun;
+		cRun.m_pchFileName = pchScript;
+
+		std::string sCode;
+		if (!ReadFile(pchScript, sCode))
+		{
+			fprintf(stderr, "ncsrun: cannot read %s\n", pchScript);
+			return 2;
+		}
+
+		for (int32_t nRun = 0; nRun < nRepeat; nRun++)
+		{
+			cRun.m_nResult = cInterpreter.RunScript((const uint8_t *) sCode.data(), (int32_t) sCode.size());
+			if (nRun == 0 || cInterpreter.GetStatistics().m_nNanoseconds < cRun.m_cStatistics.m_nNanoseconds)
+			{
+				cRun.m_cStatistics = cInterpreter.GetStatistics();
+			}
+		}
+
+		cRun.m_sError = cInterpreter.GetError();
+		cRun.m_nErrorOffset = cInterpreter.GetErrorOffset();
+		cRun.m_bHasReturnValue = cInterpreter.GetReturnValue(cRun.m_nReturnValue);
+		bFailed |= (cRun.m_nResult != 0);
+		aRuns.push_back(std::move(cRun));
+	}
+
+	for (size_t nRun = 0; nRun < aRuns.size(); nRun++)
+	{
+		const CScriptRun &cRun = aRuns[nRun];
+		printf("[%zu] %s: ", nRun + 1, cRun.m_pchFileName);
+		if (cRun.m_nResult != 0)
+		{
+			printf("error %d at 0x%08x: %s\n", cRun.m_nResult, cRun.m_nErrorOffset, cRun.m_sError.c_str());
+		}
+		else if (cRun.m_bHasReturnValue)
+		{
+			printf("returned %d\n", cRun.m_nReturnValue);
+		}
+		else
+		{
+			printf("ok\n");
+		}
+	}
+
+	// One column per script from here on.
+	auto PrintRow = [&aRuns](const char *pchName, auto fnValue)
+	{
+		printf("%-20s", pchName);
+		for (const CScriptRun &cRun : aRuns)
+		{
+			printf(" %14llu", (unsigned long long) fnValue(cRun.m_cStatistics));
+		}
+		printf("\n");
+	};
+
+	printf("\n%-20s", "");
+	for (size_t nRun = 0; nRun < aRuns.size(); nRun++)
+	{
+		printf(" %11s[%zu]", "", nRun + 1);
+	}
+	printf("\n");
+	PrintRow("instructions", [](const CScriptInterpreterStatistics &c) { return c.m_nInstructions; });
+	PrintRow("stack high-water", [](const CScriptInterpreterStatistics &c) { return (uint64_t) c.m_nStackHighWater; });
+	PrintRow("call depth", [](const CScriptInterpreterStatistics &c) { return (uint64_t) c.m_nCallDepthHighWater; });
+	PrintRow("deferred actions", [](const CScriptInterpreterStatistics &c) { return c.m_nDeferredActions; });
+	PrintRow("time (ns)", [](const CScriptInterpreterStatistics &c) { return (uint64_t) c.m_nNanoseconds; });
+
+	printf("\n");
+	for (int32_t nOpCode = 0; nOpCode < 256; nOpCode++)
+	{
+		BOOL bExecuted = FALSE;
+		for (const CScriptRun &cRun : aRuns)
+		{
+			bExecuted |= (cRun.m_cStatistics.m_aOpCodeCount[nOpCode] != 0);
+		}
+		if (bExecuted)
+		{
+			const char *pchName = CScriptInterpreter::GetOpCodeName((uint8_t) nOpCode);
+			PrintRow(pchName ? pchName : "?", [nOpCode](const CScriptInterpreterStatistics &c) { return c.m_aOpCodeCount[nOpCode]; });
+		}
+	}
+
+	BOOL bActionHeader = FALSE;
+	for (int32_t nAction = 0; nAction < cInterpreter.GetActionCount(); nAction++)
+	{
+		BOOL bCalled = FALSE;
+		for (const CScriptRun &cRun : aRuns)
+		{
+			bCalled |= ((size_t) nAction < cRun.m_cStatistics.m_aActionCalls.size() && cRun.m_cStatistics.m_aActionCalls[nAction] != 0);
+		}
+		if (!bCalled)
+		{
+			continue;
+		}
+		if (!bActionHeader)
+		{
+			printf("\n");
+			bActionHeader = TRUE;
+		}
+		PrintRow(cInterpreter.GetActionName(nAction).c_str(), [nAction](const CScriptInterpreterStatistics &c) {
+			return (size_t) nAction < c.m_aActionCalls.size() ? c.m_aActionCalls[nAction] : 0; });
+	}
+
+	return bFailed ? 1 : 0;
+}
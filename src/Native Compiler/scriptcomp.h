@@ -16,6 +16,10 @@
 
 #pragma once
 
+#include <cstddef>
+#include <new>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "exobase.h"
@@ -33,9 +37,10 @@ class CScriptCompilerStructureFieldEntry;
 class CScriptCompilerSymbolTableEntry;
 class CScriptCompilerKeyWordEntry;
 class CScriptCompilerIdentifierHashTableEntry;
+class CScriptCompilerGlobalVariableUsage;
 
 // Defines required for static size of values.
-#define CSCRIPTCOMPILER_MAX_TABLE_FILENAMES  512
+#define CSCRIPTCOMPILER_TABLE_FILENAMES_BLOCK 64
 #define CSCRIPTCOMPILER_MAX_TOKEN_LENGTH     8192
 #define CSCRIPTCOMPILER_MAX_INCLUDE_LEVELS   16
 #define CSCRIPTCOMPILER_MAX_RUNTIME_VARS     8192
@@ -54,6 +59,12 @@ class CScriptCompilerIdentifierHashTableEntry;
 #define CSCRIPTCOMPILER_OPTIMIZE_FOLD_CONSTANTS                       0x00000002
 // Post processes generated instructions to merge sequences into shorter equivalents
 #define CSCRIPTCOMPILER_OPTIMIZE_MELD_INSTRUCTIONS                    0x00000004
+// Folds reads of global variables that are never written after a constant
+// initialization, and removes global variables that are never referenced.
+#define CSCRIPTCOMPILER_OPTIMIZE_GLOBAL_VARIABLES                     0x00000008
+// Lays out while/for loops with the condition at the bottom, entered through
+// a single jump, and ends do/while loops with one JNZ instead of JZ + JMP.
+#define CSCRIPTCOMPILER_OPTIMIZE_ROTATE_LOOPS                         0x00000010
 
 #define CSCRIPTCOMPILER_OPTIMIZE_NOTHING                              0x00000000
 #define CSCRIPTCOMPILER_OPTIMIZE_EVERYTHING                           0xFFFFFFFF
@@ -71,6 +82,81 @@ public:
 	int32_t m_nCharacterOnLine;
 	int32_t m_nTokenStatus;
 	int32_t m_nTokenCharacters;
+
+	// Index of this file in the parse tree file name table, resolved when the
+	// file creates its first parse tree node (-1 until then).
+	int32_t m_nParseTreeFileName;
+
+	// Entry of this file in the include graph, when it is being recorded.
+	int32_t m_nIncludeGraphEntry;
+};
+
+// One user-defined function seen by the last compile, and whether it can be
+// reached from the entry point (what dead function elimination keeps).
+class CScriptCompilerFunctionUsage
+{
+public:
+	CExoString m_sFunctionName;
+	CExoString m_sFileName;
+	BOOL m_bIncludeFile;
+	BOOL m_bReachable;
+};
+
+// One file loaded by the last compile, in the order they were loaded.  The
+// parse time of a file includes the files it pulls in; the functions are
+// only counted when the compile succeeded.
+class CScriptCompilerIncludeGraphEntry
+{
+public:
+	CExoString m_sFileName;
+	int32_t m_nParent;               // -1 for the compiled script
+	int32_t m_nDepth;
+	int32_t m_nSize;                 // in bytes
+	int32_t m_nTokens;
+	int64_t m_nParseMicroseconds;
+	int32_t m_nFunctions;
+	int32_t m_nReachableFunctions;
+};
+
+// Bump allocator for data that only lives as long as one compile.  Memory
+// is handed out from large chunks, each twice the size of the one before, and
+// nothing is freed individually: Reset() rewinds to the start in one step.
+// Objects with destructors must be destroyed by hand before the Reset().
+class CScriptCompilerArena
+{
+public:
+	CScriptCompilerArena() : m_nCurrentChunk(0), m_nCurrentChunkUsed(0) {}
+	CScriptCompilerArena(const CScriptCompilerArena &) = delete;
+	CScriptCompilerArena &operator=(const CScriptCompilerArena &) = delete;
+	~CScriptCompilerArena() { FreeChunks(); }
+
+	void *Allocate(size_t nSize, size_t nAlignment = alignof(std::max_align_t));
+
+	template <class T, class... Args>
+	T *New(Args&&... args)
+	{
+		return new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+	}
+
+	// Makes all of the memory available again.  If the last compile needed
+	// more than one chunk, they are merged into one so the next compile of
+	// the same size doesn't have to allocate at all.
+	void Reset();
+
+	size_t GetReservedSize() const;
+
+private:
+	struct Chunk
+	{
+		char  *m_pData;
+		size_t m_nSize;
+	};
+
+	void FreeChunks();
+
+	std::vector<Chunk> m_aChunks;
+	size_t m_nCurrentChunk;
+	size_t m_nCurrentChunkUsed;
 };
 
 class CScriptCompiler;
@@ -160,6 +246,23 @@ public:
 	void SetOptimizationFlags(uint32_t nFlags) { m_nOptimizationFlags = nFlags; }
 	uint32_t GetOptimizationFlags() { return m_nOptimizationFlags; }
 
+	///////////////////////////////////////////////////////////////////////
+	void SetVerifyFinalCode(BOOL bValue) { m_bVerifyFinalCode = bValue; }
+	int64_t GetVerifyFinalCodeMicroseconds() const { return m_nVerifyFinalCodeMicroseconds; }
+	//---------------------------------------------------------------------
+	// Desc.: When set, the stack discipline of the generated code is
+	//        checked before it is written out, and a script that fails
+	//        the check does not compile.  The time taken by the check on
+	//        the last compile is kept for statistics.
+	///////////////////////////////////////////////////////////////////////
+
+	///////////////////////////////////////////////////////////////////////
+	int64_t GetDetermineLocationOfCodeMicroseconds() const { return m_nDetermineLocationOfCodeMicroseconds; }
+	//---------------------------------------------------------------------
+	// Desc.: Time the last compile spent deciding which functions are
+	//        reachable and where their code goes, for statistics.
+	///////////////////////////////////////////////////////////////////////
+
 	///////////////////////////////////////////////////////////////////////
 	void SetAutomaticCleanUpAfterCompiles(BOOL bValue);
 	//---------------------------------------------------------------------
@@ -294,6 +397,29 @@ public:
 
     STRREF GetCapturedErrorStrRef() const { return m_nCapturedErrorStrRef; }
 
+	///////////////////////////////////////////////////////////////////////
+	const std::vector<CScriptCompilerFunctionUsage> &GetFunctionUsage() const { return m_aFunctionUsage; }
+	const std::vector<CExoString> &GetIncludedFileNames() const { return m_aIncludedFileNames; }
+	//---------------------------------------------------------------------
+	// Desc.: After a successful compile, these return every implemented
+	//        function (with the file it was defined in and whether it is
+	//        reachable from the entry point) and the names of all files
+	//        pulled in through #include.  Reachability is worked out from
+	//        the call graph whether or not dead functions are removed.
+	///////////////////////////////////////////////////////////////////////
+
+	///////////////////////////////////////////////////////////////////////
+	void SetRecordIncludeGraph(BOOL bValue) { m_bRecordIncludeGraph = bValue; }
+	const std::vector<CScriptCompilerIncludeGraphEntry> &GetIncludeGraph() const { return m_aIncludeGraph; }
+	//---------------------------------------------------------------------
+	// Desc.: When set, CompileFile() keeps one entry per file it loads
+	//        (the script and every #include, nested or not) with the
+	//        size, the number of tokens and the time spent parsing it.
+	//        Reading the identifier specification is not counted.  A
+	//        successful compile also fills in how many functions each
+	//        file implements and how many of them are reachable.
+	///////////////////////////////////////////////////////////////////////
+
 	int32_t WriteFinalCodeToFile(const CExoString &sFileName);
 	int32_t WriteDebuggerOutputToFile(CExoString sFileName);
 
@@ -382,6 +508,14 @@ private:
 	CScriptParseTreeNodeBlock *m_pCurrentParseTreeNodeBlock;
 	CScriptParseTreeNodeBlock *m_pParseTreeNodeBlockHead;
 	CScriptParseTreeNodeBlock *m_pParseTreeNodeBlockTail;
+	void CleanUsedParseTreeNodeBlocks();
+
+	// Compile-lifetime data (parse tree strings, file names, symbol lists)
+	// is allocated here and released all at once by Initialize().
+	CScriptCompilerArena m_cCompileArena;
+	CExoString *NewParseTreeString(const char *pchString) { return m_cCompileArena.New<CExoString>(pchString); }
+	CExoString *NewParseTreeString(CExoString &&sString) { return m_cCompileArena.New<CExoString>(std::move(sString)); }
+	void DeleteParseTreeString(CExoString *psString) { psString->~CExoString(); }
 
 	int32_t OutputWalkTreeError(int32_t nError, CScriptParseTreeNode *pNode);
 	int32_t PreVisitGenerateCode(CScriptParseTreeNode *pNode);
@@ -394,12 +528,15 @@ private:
 	void EmitModifyStackPointer(int32_t nModifyBy);
 
 	CExoString **m_ppsParseTreeFileNames;
+	int32_t m_nParseTreeFileNamesSize;
 	int32_t m_nNextParseTreeFileName;
 	int32_t m_nCurrentParseTreeFileName;
+	std::unordered_map<CExoString, int32_t> m_aParseTreeFileNameByName;  // Keyed by lower case name.
+	int32_t GetParseTreeFileName(const CExoString &sFileName, BOOL bAdd);
 	void StartLineNumberAtBinaryInstruction(int32_t nFileReference, int32_t nLineNumber, int32_t nBinaryInstruction);
 	void EndLineNumberAtBinaryInstruction(int32_t nFileReference, int32_t nLineNumber, int32_t nBinaryInstruction);
 	void ResolveDebuggingInformation();
-	void ResolveDebuggingInformationForIdentifier(int32_t nIdentifier);
+	void ResolveDebuggingInformationForIdentifier(int32_t nIdentifier, const std::vector<int32_t> *pLineNumberEntries, const std::vector<int32_t> *pSymbolTableEntries);
 
 	int32_t m_nCurrentLineNumber;
 	int32_t m_nCurrentLineNumberFileReference;
@@ -407,8 +544,12 @@ private:
 	int32_t m_nCurrentLineNumberBinaryStartInstruction;
 	int32_t m_nCurrentLineNumberBinaryEndInstruction;
 
+	// Debugger file names, in order of first line number entry.  Indexed
+	// by the parse tree file reference, m_pnTableFileNameReference holds
+	// each file's index in this table (-1 until it has a line).
 	int32_t m_nTableFileNames;
-	CExoString m_psTableFileNames[CSCRIPTCOMPILER_MAX_TABLE_FILENAMES];
+	std::vector<CExoString> m_psTableFileNames;
+	std::vector<int32_t> m_pnTableFileNameReference;
 	int32_t m_nLineNumberEntries;
 	int32_t m_nFinalLineNumberEntries;
 	std::vector<int32_t> m_pnTableInstructionFileReference;
@@ -421,18 +562,26 @@ private:
 	int32_t m_nSymbolTableVariables;
 	int32_t m_nFinalSymbolTableVariables;
 	std::vector<int32_t> m_pnSymbolTableVarType;
-	std::vector<CExoString> m_psSymbolTableVarName;
-	std::vector<CExoString> m_psSymbolTableVarStructureName;
+	std::vector<int32_t> m_pnSymbolTableVarName;            // Index into m_psSymbolTableNames.
+	std::vector<int32_t> m_pnSymbolTableVarStructureName;   // Index into m_psSymbolTableNames, -1 if not a struct.
 	std::vector<int32_t> m_pnSymbolTableVarStackLoc;
 	std::vector<int32_t> m_pnSymbolTableVarBegin;
 	std::vector<int32_t> m_pnSymbolTableVarEnd;
 	std::vector<int32_t> m_pnSymbolTableBinaryFinal;
 	std::vector<int32_t> m_pnSymbolTableBinarySortedOrder;
 
+	std::vector<CExoString> m_psSymbolTableNames;
+	std::unordered_map<CExoString, int32_t> m_aSymbolTableNameByName;
+	// Entries still waiting for their end instruction, keyed by stack location.
+	std::unordered_map<int32_t, std::vector<int32_t>> m_aSymbolTableOpenVarsByStackLoc;
+	int32_t GetSymbolTableName(const CExoString &sName);
+	int32_t AddSymbolTableVarEntry(int32_t nOccupiedVariables, int32_t nStackLoc);
+
 
 	void DeleteCompileStack();
 	void DeleteParseTree(BOOL bStack, CScriptParseTreeNode *pNode);
 	int32_t WalkParseTree(CScriptParseTreeNode *pNode);
+	BOOL    IsRotatedLoop(CScriptParseTreeNode *pNode);
 
 	void InitializeFinalCode();
 	void FinalizeFinalCode();
@@ -506,6 +655,9 @@ private:
 	int32_t m_nMaxStructureFields;
 	int32_t m_nStructureDefinition;
 	int32_t m_nStructureDefinitionFieldStart;
+	std::unordered_map<CExoString, int32_t> m_aStructureByName;
+	void    IndexStructure(int32_t nStructure);
+	int32_t GetStructure(const CExoString &sStructureName);
 	int32_t GetStructureField(const CExoString &sStructureName, const CExoString &sFieldName);
 	int32_t GetStructureSize(const CExoString &sStructureName);
 	int32_t GetIdentifierByName(const CExoString &sIdentifierName);
@@ -517,6 +669,8 @@ private:
 	int32_t AddToGlobalVariableList(CScriptParseTreeNode *pGlobalVariableNode);
 
 	BOOL ConstantFoldNode(CScriptParseTreeNode *pNode, BOOL bForce=FALSE);
+	BOOL ConstantFoldOperands(CScriptParseTreeNode *pNode);
+	std::vector<CScriptParseTreeNode *> m_pConstantFoldStack;
 
 	BOOL m_bConstantVariableDefinition;
 
@@ -587,6 +741,13 @@ private:
 	CScriptCompilerSymbolTableEntry *m_pSymbolLabelList;
 	int32_t         m_pSymbolLabelStartEntry[512];
 
+	// The call graph, recorded as the function calls are generated.  The
+	// caller is the identifier whose code is being written; callees are
+	// identifier ids, or -1 (#globals) and -2 (main/StartingConditional).
+	int32_t              m_nCallGraphCaller;
+	std::vector<int32_t> m_aCallGraphCallers;
+	std::vector<int32_t> m_aCallGraphCallees;
+
 	CExoString  GetFunctionNameFromSymbolSubTypes(int32_t nSubType1,int32_t nSubType2);
 	int32_t AddSymbolToQueryList(int32_t nLocationPointer, int32_t nSymbolType, int32_t nSymbolSubType1, int32_t nSymbolSubType2 = 0);
 	int32_t AddSymbolToLabelList(int32_t nLocationPointer, int32_t nSymbolType, int32_t nSymbolSubType1, int32_t nSymbolSubType2 = 0);
@@ -627,13 +788,35 @@ private:
 	// Second Stage Of Code Generation
 	int32_t         InstallLoader();
 	CScriptParseTreeNode *InsertGlobalVariablesInParseTree(CScriptParseTreeNode *pOldTree);
+	CScriptParseTreeNode *OptimizeGlobalVariables(CScriptParseTreeNode *pOldTree);
+	void            ScanGlobalVariableReferences(CScriptCompilerGlobalVariableUsage &cUsage, CScriptParseTreeNode *pNode, int32_t nDeclaringGlobal, BOOL bDeclaration);
+	void            MarkGlobalVariableWritten(CScriptCompilerGlobalVariableUsage &cUsage, CScriptParseTreeNode *pNode);
 	int32_t         OutputIdentifierError(const CExoString &sFunctionName, int32_t nError, int32_t nFileStackDrop = 0);
+	void            GroupCallGraph(std::vector<int32_t> &aFirstCall, std::vector<int32_t> &aCallees);
+	void            FindReachableFunctions(std::vector<BOOL> &abReachable);
 	int32_t         ValidateLocationOfIdentifier(const CExoString &sFunctionName);
 	int32_t         DetermineLocationOfCode();
+	void            RecordFunctionUsage();
 	int32_t         ResolveLabels();
 	int32_t         WriteResolvedOutput();
+	int32_t         VerifyFinalCode();
+	int32_t         OutputVerifyFinalCodeError(int32_t nError, int32_t nOffset, const CExoString &sReason);
+	int32_t         GetParameterStackSize(int32_t nIdentifier, int32_t nParameters);
+
+	BOOL            m_bVerifyFinalCode;
+	int64_t         m_nVerifyFinalCodeMicroseconds;
 
 	int32_t         m_nFinalBinarySize;
+	int64_t         m_nDetermineLocationOfCodeMicroseconds;
+
+	// Reachability of the last compile, see GetFunctionUsage().
+	std::vector<CScriptCompilerFunctionUsage> m_aFunctionUsage;
+	std::vector<CExoString> m_aIncludedFileNames;
+
+	// Files loaded by the last compile, see GetIncludeGraph().
+	BOOL            m_bRecordIncludeGraph;
+	std::vector<CScriptCompilerIncludeGraphEntry> m_aIncludeGraph;
+	int64_t         m_nIdentifierFileMicroseconds;
 
 	// Error generation.
 
@@ -46,6 +46,8 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <chrono>
+#include <utility>
 
 // external header files
 #include "exobase.h"
@@ -96,6 +98,7 @@ CScriptCompilerIdListEntry::CScriptCompilerIdListEntry()
 	m_nBinarySourceFinish = -1;
 	m_nBinaryDestinationStart = -1;
 	m_nBinaryDestinationFinish = -1;
+	m_nFileReference = -1;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -283,6 +286,104 @@ int32_t CScriptCompilerIdListEntry::ExpandParameterSpace()
 	return 0;
 }
 
+//::///////////////////////////////////////////////////////////////////////////
+//::
+//::  class CScriptCompilerArena
+//::
+//::///////////////////////////////////////////////////////////////////////////
+
+#define CSCRIPTCOMPILER_ARENA_FIRST_CHUNK_SIZE 65536
+
+///////////////////////////////////////////////////////////////////////////////
+//  CScriptCompilerArena::Allocate()
+///////////////////////////////////////////////////////////////////////////////
+//  Description:  Returns nSize bytes aligned to nAlignment (a power of two
+//                no larger than the default new alignment), moving on to the
+//                next chunk, or creating one, when the current one is full.
+///////////////////////////////////////////////////////////////////////////////
+
+void *CScriptCompilerArena::Allocate(size_t nSize, size_t nAlignment)
+{
+	while (m_nCurrentChunk < m_aChunks.size())
+	{
+		Chunk &cChunk = m_aChunks[m_nCurrentChunk];
+		size_t nOffset = (m_nCurrentChunkUsed + nAlignment - 1) & ~(nAlignment - 1);
+		if (nOffset + nSize <= cChunk.m_nSize)
+		{
+			m_nCurrentChunkUsed = nOffset + nSize;
+			return cChunk.m_pData + nOffset;
+		}
+
+		++m_nCurrentChunk;
+		m_nCurrentChunkUsed = 0;
+	}
+
+	size_t nChunkSize = m_aChunks.empty() ? CSCRIPTCOMPILER_ARENA_FIRST_CHUNK_SIZE : m_aChunks.back().m_nSize * 2;
+	while (nChunkSize < nSize)
+	{
+		nChunkSize *= 2;
+	}
+
+	Chunk cChunk;
+	cChunk.m_pData = new char[nChunkSize];
+	cChunk.m_nSize = nChunkSize;
+	m_aChunks.push_back(cChunk);
+
+	m_nCurrentChunk = m_aChunks.size() - 1;
+	m_nCurrentChunkUsed = nSize;
+	return cChunk.m_pData;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  CScriptCompilerArena::Reset()
+///////////////////////////////////////////////////////////////////////////////
+
+void CScriptCompilerArena::Reset()
+{
+	if (m_aChunks.size() > 1)
+	{
+		size_t nReservedSize = GetReservedSize();
+		FreeChunks();
+
+		Chunk cChunk;
+		cChunk.m_pData = new char[nReservedSize];
+		cChunk.m_nSize = nReservedSize;
+		m_aChunks.push_back(cChunk);
+	}
+
+	m_nCurrentChunk = 0;
+	m_nCurrentChunkUsed = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  CScriptCompilerArena::GetReservedSize()
+///////////////////////////////////////////////////////////////////////////////
+
+size_t CScriptCompilerArena::GetReservedSize() const
+{
+	size_t nReservedSize = 0;
+	for (const Chunk &cChunk : m_aChunks)
+	{
+		nReservedSize += cChunk.m_nSize;
+	}
+	return nReservedSize;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  CScriptCompilerArena::FreeChunks()
+///////////////////////////////////////////////////////////////////////////////
+
+void CScriptCompilerArena::FreeChunks()
+{
+	for (Chunk &cChunk : m_aChunks)
+	{
+		delete[] cChunk.m_pData;
+	}
+	m_aChunks.clear();
+	m_nCurrentChunk = 0;
+	m_nCurrentChunkUsed = 0;
+}
+
 //::///////////////////////////////////////////////////////////////////////////
 //::
 //::  class CScriptCompiler
@@ -306,6 +407,11 @@ CScriptCompiler::CScriptCompiler(RESTYPE nSource, RESTYPE nCompiled, RESTYPE nDe
 	m_sLanguageSource = "";
 	m_sOutputAlias = "OVERRIDE";
 	m_nOptimizationFlags = CSCRIPTCOMPILER_OPTIMIZE_EVERYTHING;
+	m_bVerifyFinalCode = FALSE;
+	m_nVerifyFinalCodeMicroseconds = 0;
+	m_nDetermineLocationOfCodeMicroseconds = 0;
+	m_bRecordIncludeGraph = FALSE;
+	m_nIdentifierFileMicroseconds = 0;
 	m_nIdentifierListState = 0;
 
 	m_pSRStack = NULL;
@@ -316,8 +422,10 @@ CScriptCompiler::CScriptCompiler(RESTYPE nSource, RESTYPE nCompiled, RESTYPE nDe
 	m_pcKeyWords = NULL;
 	m_pSymbolQueryList = NULL;
 	m_pSymbolLabelList = NULL;
+	m_nCallGraphCaller = -1;
 	m_pIdentifierHashTable = NULL;
 	m_ppsParseTreeFileNames = NULL;
+	m_nParseTreeFileNamesSize = 0;
 
 	m_pParseTreeNodeBlockHead = NULL;
 	m_pParseTreeNodeBlockTail = NULL;
@@ -382,6 +490,7 @@ CScriptCompiler::~CScriptCompiler()
 	}
 
 	// Delete linked list of ParseTreeNodeBlock structures.
+	CleanUsedParseTreeNodeBlocks();
 	if (m_pParseTreeNodeBlockHead)
 	{
 		CScriptParseTreeNodeBlock *pBlockPtr = m_pParseTreeNodeBlockHead;
@@ -460,16 +569,45 @@ void CScriptCompiler::ShutDown()
 
 	if (m_ppsParseTreeFileNames)
 	{
-		for (int32_t count = 0; count < CSCRIPTCOMPILER_MAX_TABLE_FILENAMES; count++)
+		for (int32_t count = 0; count < m_nParseTreeFileNamesSize; count++)
 		{
 			if (m_ppsParseTreeFileNames[count] != NULL)
 			{
-				delete m_ppsParseTreeFileNames[count];
+				m_ppsParseTreeFileNames[count]->~CExoString();
 				m_ppsParseTreeFileNames[count] = NULL;
 			}
 		}
 		delete[] m_ppsParseTreeFileNames;
 		m_ppsParseTreeFileNames = NULL;
+		m_nParseTreeFileNamesSize = 0;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  CScriptCompiler::CleanUsedParseTreeNodeBlocks()
+///////////////////////////////////////////////////////////////////////////////
+//  Description:  Cleans every parse tree node block handed out since the
+//                last Initialize(), which destroys the strings the nodes hold
+//                in the arena.  Blocks are used in order, so the ones past
+//                the current block are still clean.
+///////////////////////////////////////////////////////////////////////////////
+
+void CScriptCompiler::CleanUsedParseTreeNodeBlocks()
+{
+	if (m_pCurrentParseTreeNodeBlock == NULL)
+	{
+		return;
+	}
+
+	CScriptParseTreeNodeBlock *pBlock = m_pParseTreeNodeBlockHead;
+	while (pBlock != NULL)
+	{
+		pBlock->CleanBlockEntries();
+		if (pBlock == m_pCurrentParseTreeNodeBlock)
+		{
+			break;
+		}
+		pBlock = pBlock->m_pNextBlock;
 	}
 }
 
@@ -488,6 +626,10 @@ void CScriptCompiler::Initialize( )
 	m_sCapturedError = "";
     m_nCapturedErrorStrRef = 0;
 
+	m_aFunctionUsage.clear();
+	m_aIncludedFileNames.clear();
+	m_aIncludeGraph.clear();
+
 	m_nLines = 1;
 	m_nCharacterOnLine = 1;
 
@@ -511,8 +653,9 @@ void CScriptCompiler::Initialize( )
 
 	if (m_ppsParseTreeFileNames == NULL)
 	{
-		m_ppsParseTreeFileNames = new CExoString *[CSCRIPTCOMPILER_MAX_TABLE_FILENAMES];
-		for (int32_t count = 0; count < CSCRIPTCOMPILER_MAX_TABLE_FILENAMES; count++)
+		m_nParseTreeFileNamesSize = CSCRIPTCOMPILER_TABLE_FILENAMES_BLOCK;
+		m_ppsParseTreeFileNames = new CExoString *[m_nParseTreeFileNamesSize];
+		for (int32_t count = 0; count < m_nParseTreeFileNamesSize; count++)
 		{
 			m_ppsParseTreeFileNames[count] = NULL;
 		}
@@ -520,11 +663,11 @@ void CScriptCompiler::Initialize( )
 
 	int32_t count;
 
-	for (count = 0; count < CSCRIPTCOMPILER_MAX_TABLE_FILENAMES; count++)
+	for (count = 0; count < m_nParseTreeFileNamesSize; count++)
 	{
 		if (m_ppsParseTreeFileNames[count] != NULL)
 		{
-			delete m_ppsParseTreeFileNames[count];
+			m_ppsParseTreeFileNames[count]->~CExoString();
 			m_ppsParseTreeFileNames[count] = NULL;
 		}
 	}
@@ -536,12 +679,16 @@ void CScriptCompiler::Initialize( )
 
 	m_nCurrentParseTreeFileName = -1;
 	m_nNextParseTreeFileName = 0;
+	m_aParseTreeFileNameByName.clear();
+
+	// Nothing may point into the arena past this point.
+	CleanUsedParseTreeNodeBlocks();
+	m_cCompileArena.Reset();
 
 	m_nParseTreeNodeBlockEmptyNodes = -1;
 	m_pCurrentParseTreeNodeBlock = m_pParseTreeNodeBlockHead;
 	if (m_pCurrentParseTreeNodeBlock != NULL)
 	{
-		m_pCurrentParseTreeNodeBlock->CleanBlockEntries();
 		m_nParseTreeNodeBlockEmptyNodes = CSCRIPTCOMPILER_PARSETREENODEBLOCK_SIZE - 1;
 	}
 
@@ -604,6 +751,7 @@ void CScriptCompiler::Initialize( )
 	m_nMaxStructures = 0;
 	m_nMaxStructureFields = 0;
 	m_nStructureDefinition = 0;
+	m_aStructureByName.clear();
 	m_bGlobalVariableDefinition = FALSE;
 	m_nGlobalVariables = 0;
 	m_nGlobalVariableSize = 0;
@@ -658,12 +806,17 @@ void CScriptCompiler::Initialize( )
 	m_nCurrentLineNumberBinaryEndInstruction = 0;
 
 	m_nTableFileNames = 0;
+	m_psTableFileNames.clear();
+	m_pnTableFileNameReference.clear();
 
 	m_nFinalLineNumberEntries = 0;
 	m_nLineNumberEntries = 0;
 
 	m_nSymbolTableVariables = 0;
 	m_nFinalSymbolTableVariables = 0;
+	m_psSymbolTableNames.clear();
+	m_aSymbolTableNameByName.clear();
+	m_aSymbolTableOpenVarsByStackLoc.clear();
 
 	TokenInitialize();
 
@@ -932,6 +1085,9 @@ void CScriptCompiler::InitializePreDefinedStructures()
 	m_pcStructFieldList[2].m_nLocation = 8;
 	m_pcStructFieldList[2].m_pchType = CSCRIPTCOMPILER_TOKEN_KEYWORD_FLOAT;
 
+	m_aStructureByName.clear();
+	IndexStructure(0);
+
 }
 
 void CScriptCompiler::InitializeIncludeFile(int32_t nCompileFileLevel)
@@ -981,21 +1137,17 @@ void CScriptCompiler::ShutdownIncludeFile(int32_t nCompileFileLevel)
 //  Created By: Mark Brockington
 //  Created On: 08/05/99
 //  Description:  This routine will take the root of a compile tree, ensure that
-//                each of its branches have been deleted (recursively), and
-//                then we can delete the node itself!
+//                each of its branches have been deleted, and then we can
+//                delete the node itself!
 ///////////////////////////////////////////////////////////////////////////////
 
 void CScriptCompiler::DeleteParseTree(BOOL bStack, CScriptParseTreeNode *pNode)
 {
 	if (pNode != NULL)
 	{
-		// Delete all of the subtrees
-		DeleteParseTree(bStack, pNode->pLeft);
-		DeleteParseTree(bStack, pNode->pRight);
-
 		if (bStack == TRUE)
 		{
-			// Delete any references to this node from the stack.
+			// Delete any references to the tree from the stack.
 			int32_t i;
 
 			for (i=0; i <= m_nSRStackStates; i++)
@@ -1011,8 +1163,27 @@ void CScriptCompiler::DeleteParseTree(BOOL bStack, CScriptParseTreeNode *pNode)
 			}
 		}
 
-		// Finally delete the node itself.
-		DeleteScriptParseTreeNode(pNode);
+		// Delete all of the subtrees.  An explicit stack is used, since a
+		// long expression chain nests as deep as it has terms.
+		std::vector<CScriptParseTreeNode *> pDeleteNodes;
+		pDeleteNodes.push_back(pNode);
+		while (!pDeleteNodes.empty())
+		{
+			CScriptParseTreeNode *pCurrent = pDeleteNodes.back();
+			pDeleteNodes.pop_back();
+
+			if (pCurrent->pLeft != NULL)
+			{
+				pDeleteNodes.push_back(pCurrent->pLeft);
+			}
+			if (pCurrent->pRight != NULL)
+			{
+				pDeleteNodes.push_back(pCurrent->pRight);
+			}
+
+			// Finally delete the node itself.
+			DeleteScriptParseTreeNode(pCurrent);
+		}
 	}
 }
 
@@ -1223,6 +1394,8 @@ int32_t CScriptCompiler::CompileFile(const CExoString &sFileName)
 	}
 
 	m_pcIncludeFileStack[m_nCompileFileLevel].m_sCompiledScriptName = sFileName;
+	m_pcIncludeFileStack[m_nCompileFileLevel].m_nParseTreeFileName = -1;
+	m_pcIncludeFileStack[m_nCompileFileLevel].m_nIncludeGraphEntry = -1;
 
     const char* sTest = m_cAPI.ResManLoadScriptSourceFile(sFileName.CStr(), m_nResTypeSource);
 	if (!sTest)
@@ -1238,10 +1411,38 @@ int32_t CScriptCompiler::CompileFile(const CExoString &sFileName)
     pScript = m_pcIncludeFileStack[m_nCompileFileLevel].m_sSourceScript.CStr();
     nScriptLength = m_pcIncludeFileStack[m_nCompileFileLevel].m_sSourceScript.GetLength();
 
+	int32_t nIncludeGraphEntry = -1;
+	if (m_bRecordIncludeGraph)
+	{
+		CScriptCompilerIncludeGraphEntry cEntry;
+		cEntry.m_sFileName           = sFileName;
+		cEntry.m_nParent             = (m_nCompileFileLevel > 0) ? m_pcIncludeFileStack[m_nCompileFileLevel - 1].m_nIncludeGraphEntry : -1;
+		cEntry.m_nDepth              = m_nCompileFileLevel;
+		cEntry.m_nSize               = (int32_t) nScriptLength;
+		cEntry.m_nTokens             = 0;
+		cEntry.m_nParseMicroseconds  = 0;
+		cEntry.m_nFunctions          = 0;
+		cEntry.m_nReachableFunctions = 0;
+
+		nIncludeGraphEntry = (int32_t) m_aIncludeGraph.size();
+		m_aIncludeGraph.push_back(cEntry);
+		m_pcIncludeFileStack[m_nCompileFileLevel].m_nIncludeGraphEntry = nIncludeGraphEntry;
+	}
+
 	++m_nCompileFileLevel;
 
+	std::chrono::steady_clock::time_point tParseStart = std::chrono::steady_clock::now();
+	int64_t nIdentifierFileMicroseconds = m_nIdentifierFileMicroseconds;
+
 	int32_t nReturnValue = ParseSource(pScript,nScriptLength);
 
+	if (nIncludeGraphEntry >= 0)
+	{
+		m_aIncludeGraph[nIncludeGraphEntry].m_nParseMicroseconds =
+		    std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - tParseStart).count() -
+		    (m_nIdentifierFileMicroseconds - nIdentifierFileMicroseconds);
+	}
+
 	if (nReturnValue < 0)
 	{
 		// MGB - 02/15/2001 - DO NOT SUBTRACT ONE FROM COMPILEFILELEVEL.
@@ -1311,6 +1512,8 @@ int32_t CScriptCompiler::CompileScriptChunk(const CExoString &sScriptChunk, BOOL
 	}
 
 	m_pcIncludeFileStack[m_nCompileFileLevel].m_sCompiledScriptName = "!Chunk";
+	m_pcIncludeFileStack[m_nCompileFileLevel].m_nParseTreeFileName = -1;
+	m_pcIncludeFileStack[m_nCompileFileLevel].m_nIncludeGraphEntry = -1;
 
 	if (bWrapIntoMain)
 	{
@@ -1375,34 +1578,45 @@ int32_t CScriptCompiler::CompileScriptConditional(const CExoString &sScriptCondi
 	}
 
 	m_pcIncludeFileStack[m_nCompileFileLevel].m_sCompiledScriptName = "!Conditional";
+	m_pcIncludeFileStack[m_nCompileFileLevel].m_nParseTreeFileName = -1;
+	m_pcIncludeFileStack[m_nCompileFileLevel].m_nIncludeGraphEntry = -1;
+
+	// The expression becomes the body of an int StartingConditional(), and
+	// the compiler is forced into conditional mode for this call only, so
+	// that InstallLoader() accepts it regardless of the caller's settings.
+	BOOL bOldCompileConditionalFile = m_bCompileConditionalFile;
+	BOOL bOldCompileConditionalOrMain = m_bCompileConditionalOrMain;
+	m_bCompileConditionalFile = TRUE;
+	m_bCompileConditionalOrMain = FALSE;
 
-	nScriptLength = sScriptConditional.GetLength() + 22;
-	pScript = new char[nScriptLength + 22];
-	sprintf(pScript,"int main(){ return(%s);}",sScriptConditional.CStr());
+	nScriptLength = sScriptConditional.GetLength() + 36;
+	pScript = new char[nScriptLength + 1];
+	sprintf(pScript,"int StartingConditional(){return(%s);}",sScriptConditional.CStr());
 
 	++m_nCompileFileLevel;
 
 	int32_t nReturnValue = ParseSource(pScript,nScriptLength);
 
-	if (nReturnValue < 0)
+	if (nReturnValue >= 0)
 	{
-		return nReturnValue;
-	}
-
-	--m_nCompileFileLevel;
+		--m_nCompileFileLevel;
 
-	InitializeFinalCode();
+		InitializeFinalCode();
 
-	nReturnValue = GenerateFinalCodeFromParseTree("!Conditional");
+		nReturnValue = GenerateFinalCodeFromParseTree("!Conditional");
 
-	if (nReturnValue < 0)
-	{
-		return nReturnValue;
+		if (nReturnValue >= 0)
+		{
+			FinalizeFinalCode();
+			nReturnValue = 0;
+		}
 	}
 
-	FinalizeFinalCode();
+	m_bCompileConditionalFile = bOldCompileConditionalFile;
+	m_bCompileConditionalOrMain = bOldCompileConditionalOrMain;
 
-	return 0;
+	delete[] pScript;
+	return nReturnValue;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -1501,7 +1715,8 @@ int32_t CScriptCompiler::OutputError(int32_t nError, CExoString *psFileName, int
 
 // Destructively modify a node and all its children to decay it into a single
 // CONSTANT operation, if possible.
-// This function is safe to call multiple times on the same node.
+// This function is safe to call multiple times on the same node.  Every node
+// is only tried once, so folding the same tree again is cheap.
 BOOL CScriptCompiler::ConstantFoldNode(CScriptParseTreeNode *pNode, BOOL bForce)
 {
 	if (!bForce && !(m_nOptimizationFlags & CSCRIPTCOMPILER_OPTIMIZE_FOLD_CONSTANTS))
@@ -1512,13 +1727,52 @@ BOOL CScriptCompiler::ConstantFoldNode(CScriptParseTreeNode *pNode, BOOL bForce)
 
 	// Only fold operations that have two operands
 	// TODO: ~0 unary op?
-	if (!pNode->pLeft || !pNode->pRight)
+	if (!pNode->pLeft || !pNode->pRight || pNode->m_bConstantFoldAttempted)
 		return FALSE;
 
 	// In case of complex expression, start folding at the leaf nodes
 	// e.g.:  C = 3 + 2*4 - First fold 2*4 into 8, then 3+8 into 11
-	ConstantFoldNode(pNode->pLeft, bForce);
-	ConstantFoldNode(pNode->pRight, bForce);
+	// The tree is walked with an explicit stack, since a long chain like
+	// a + b + c + ... nests as deep as it has terms.  A node stays on the
+	// stack until both of its operands have been tried.
+	BOOL bFolded = FALSE;
+	m_pConstantFoldStack.clear();
+	m_pConstantFoldStack.push_back(pNode);
+	while (!m_pConstantFoldStack.empty())
+	{
+		CScriptParseTreeNode *pCurrent = m_pConstantFoldStack.back();
+		if (pCurrent->m_bConstantFoldAttempted == FALSE)
+		{
+			pCurrent->m_bConstantFoldAttempted = TRUE;
+			if (pCurrent->pLeft && pCurrent->pRight)
+			{
+				if (pCurrent->pRight->m_bConstantFoldAttempted == FALSE)
+				{
+					m_pConstantFoldStack.push_back(pCurrent->pRight);
+				}
+				if (pCurrent->pLeft->m_bConstantFoldAttempted == FALSE)
+				{
+					m_pConstantFoldStack.push_back(pCurrent->pLeft);
+				}
+			}
+			continue;
+		}
+
+		m_pConstantFoldStack.pop_back();
+		bFolded = ConstantFoldOperands(pCurrent);
+	}
+
+	// The node passed in is always the last one to be tried.
+	return bFolded;
+}
+
+
+// Decay a single node into a CONSTANT operation, if both of its operands
+// already are constants of the same type.
+BOOL CScriptCompiler::ConstantFoldOperands(CScriptParseTreeNode *pNode)
+{
+	if (!pNode->pLeft || !pNode->pRight)
+		return FALSE;
 
 	// Can only fold if the operands are constants.
 	if (pNode->pLeft->nOperation != CSCRIPTCOMPILER_OPERATION_CONSTANT_INTEGER &&
@@ -1606,8 +1860,10 @@ BOOL CScriptCompiler::ConstantFoldNode(CScriptParseTreeNode *pNode, BOOL bForce)
 
 	if (pNode->pLeft->nOperation == CSCRIPTCOMPILER_OPERATION_CONSTANT_STRING)
 	{
-		CExoString left = (pNode->pLeft->m_psStringData ? *pNode->pLeft->m_psStringData : CExoString(""));
-		CExoString right = (pNode->pRight->m_psStringData ? *pNode->pRight->m_psStringData : CExoString(""));
+		// Operands are read in place rather than copied for every fold.
+		CExoString sEmpty("");
+		const CExoString &left = (pNode->pLeft->m_psStringData ? *pNode->pLeft->m_psStringData : sEmpty);
+		const CExoString &right = (pNode->pRight->m_psStringData ? *pNode->pRight->m_psStringData : sEmpty);
 		CExoString result;
 		int resultBool = -1;
 		switch (pNode->nOperation)
@@ -1629,7 +1885,7 @@ BOOL CScriptCompiler::ConstantFoldNode(CScriptParseTreeNode *pNode, BOOL bForce)
 		else
 		{
 			pNode->nOperation = CSCRIPTCOMPILER_OPERATION_CONSTANT_STRING;
-			pNode->m_psStringData = new CExoString(result);
+			pNode->m_psStringData = NewParseTreeString(std::move(result));
 		}
 		return TRUE;
 	}
@@ -46,6 +46,8 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <algorithm>
+#include <chrono>
 
 // external header files
 #include "exobase.h"
@@ -81,7 +83,10 @@ int32_t CScriptCompiler::GenerateFinalCodeFromParseTree(CExoString sFileName)
 	PopSRStack(&nState,&nRule,&nTerm,&pCurrentTree,&pReturnTree);
 
 	m_nTotalCompileNodes = 1;
+	m_nVerifyFinalCodeMicroseconds = 0;
+	m_nDetermineLocationOfCodeMicroseconds = 0;
 
+	pReturnTree = OptimizeGlobalVariables(pReturnTree);
 	int32_t nReturnValue = InstallLoader();
 	pNewReturnTree = InsertGlobalVariablesInParseTree(pReturnTree);
 	if (nReturnValue >= 0)
@@ -99,7 +104,9 @@ int32_t CScriptCompiler::GenerateFinalCodeFromParseTree(CExoString sFileName)
 	}
 	else
 	{
+		std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
 		nReturnValue = DetermineLocationOfCode();
+		m_nDetermineLocationOfCodeMicroseconds = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - tStart).count();
 		if (nReturnValue >= 0)
 		{
 			nReturnValue = ResolveLabels();
@@ -110,6 +117,12 @@ int32_t CScriptCompiler::GenerateFinalCodeFromParseTree(CExoString sFileName)
 
 			nReturnValue = WriteResolvedOutput();
 		}
+		if (nReturnValue >= 0 && m_bVerifyFinalCode == TRUE)
+		{
+			std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+			nReturnValue = VerifyFinalCode();
+			m_nVerifyFinalCodeMicroseconds = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - tStart).count();
+		}
 		if (nReturnValue >= 0)
 		{
 			nReturnValue = WriteDebuggerOutputToFile(sFileName);
@@ -283,6 +296,7 @@ void CScriptCompiler::ClearUserDefinedIdentifiers()
 		m_pcIdentifierList[count].m_nBinarySourceFinish       = -1;
 		m_pcIdentifierList[count].m_nBinaryDestinationStart   = -1;
 		m_pcIdentifierList[count].m_nBinaryDestinationFinish  = -1;
+		m_pcIdentifierList[count].m_nFileReference            = -1;
 
 	}
 
@@ -301,23 +315,19 @@ void CScriptCompiler::ClearUserDefinedIdentifiers()
 
 void CScriptCompiler::ClearAllSymbolLists()
 {
-	if (m_pSymbolQueryList != NULL)
-	{
-		delete[] m_pSymbolQueryList;
-		m_pSymbolQueryList = NULL;
-	}
-
+	// Both lists are in the compile arena.
+	m_pSymbolQueryList = NULL;
 	m_nSymbolQueryListSize = 0;
 	m_nSymbolQueryList     = 0;
 
-	if (m_pSymbolLabelList != NULL)
-	{
-		delete[] m_pSymbolLabelList;
-		m_pSymbolLabelList = NULL;
-	}
+	m_pSymbolLabelList = NULL;
 
 	m_nSymbolLabelListSize = 0;
 	m_nSymbolLabelList     = 0;
+
+	m_nCallGraphCaller = -1;
+	m_aCallGraphCallers.clear();
+	m_aCallGraphCallees.clear();
 }
 
 
@@ -420,6 +430,374 @@ CScriptParseTreeNode *CScriptCompiler::InsertGlobalVariablesInParseTree(CScriptP
 	return pNewNode;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+//  CScriptCompiler::OptimizeGlobalVariables()
+///////////////////////////////////////////////////////////////////////////////
+// Description: Global variables that are never written after a constant
+//              initialization are folded into constants at every read, and
+//              global variables that are never referenced are removed.  If
+//              no global variables remain, the structure definitions are
+//              moved into the main tree so that no #globals prologue is
+//              generated.  Must be called before InstallLoader().
+///////////////////////////////////////////////////////////////////////////////
+
+CScriptParseTreeNode *CScriptCompiler::OptimizeGlobalVariables(CScriptParseTreeNode *pOldTree)
+{
+	if (m_pGlobalVariableParseTree == NULL ||
+	        !(m_nOptimizationFlags & CSCRIPTCOMPILER_OPTIMIZE_GLOBAL_VARIABLES))
+	{
+		return pOldTree;
+	}
+
+	CScriptCompilerGlobalVariableUsage cUsage;
+	CScriptParseTreeNode *pGroup;
+	CScriptParseTreeNode *pStatement;
+	int32_t nCount;
+
+	// Every global variable is a KEYWORD_DECLARATION statement in a statement
+	// list, optionally followed by the ASSIGNMENT statement that initializes it.
+	for (pGroup = m_pGlobalVariableParseTree->pRight; pGroup != NULL; pGroup = pGroup->pRight)
+	{
+		if (pGroup->pLeft == NULL || pGroup->pLeft->nOperation != CSCRIPTCOMPILER_OPERATION_STATEMENT_LIST)
+		{
+			continue;
+		}
+
+		for (pStatement = pGroup->pLeft->pLeft; pStatement != NULL; pStatement = pStatement->pRight)
+		{
+			CScriptParseTreeNode *pDeclaration = pStatement->pLeft;
+			if (pDeclaration == NULL ||
+			        pDeclaration->nOperation != CSCRIPTCOMPILER_OPERATION_KEYWORD_DECLARATION ||
+			        pDeclaration->pLeft == NULL ||
+			        pDeclaration->pRight == NULL ||
+			        pDeclaration->pRight->pLeft == NULL ||
+			        pDeclaration->pRight->pLeft->m_psStringData == NULL)
+			{
+				continue;
+			}
+
+			CScriptCompilerGlobalVariableEntry cEntry;
+			cEntry.m_sVarName = *(pDeclaration->pRight->pLeft->m_psStringData);
+			cEntry.m_nVarType = pDeclaration->pLeft->nOperation;
+			cEntry.m_pDeclarationList = pGroup->pLeft;
+			cEntry.m_pDeclaration = pStatement;
+
+			CScriptParseTreeNode *pNext = pStatement->pRight;
+			if (pNext != NULL &&
+			        pNext->pLeft != NULL &&
+			        pNext->pLeft->nOperation == CSCRIPTCOMPILER_OPERATION_ASSIGNMENT &&
+			        pNext->pLeft->pLeft != NULL &&
+			        pNext->pLeft->pRight != NULL &&
+			        pNext->pLeft->pRight->nOperation == CSCRIPTCOMPILER_OPERATION_VARIABLE &&
+			        pNext->pLeft->pRight->m_psStringData != NULL &&
+			        *(pNext->pLeft->pRight->m_psStringData) == cEntry.m_sVarName)
+			{
+				cEntry.m_pInitialization = pNext;
+				pStatement = pNext;
+			}
+
+			// Redeclarations are reported when the tree is walked, so leave
+			// both declarations alone.
+			int32_t nExisting = cUsage.Find(&cEntry.m_sVarName);
+			if (nExisting >= 0)
+			{
+				cUsage.m_aEntries[nExisting].m_bPinned = TRUE;
+				cEntry.m_bPinned = TRUE;
+			}
+			else
+			{
+				cUsage.m_aEntryByName[cEntry.m_sVarName.CStr()] = (int32_t) cUsage.m_aEntries.size();
+			}
+			cUsage.m_aEntries.push_back(cEntry);
+		}
+	}
+
+	int32_t nGlobals = (int32_t) cUsage.m_aEntries.size();
+
+	// Record every read and write.  An initializer may only read the globals
+	// declared before it.
+	for (nCount = 0; nCount < nGlobals; ++nCount)
+	{
+		if (cUsage.m_aEntries[nCount].m_pInitialization != NULL)
+		{
+			ScanGlobalVariableReferences(cUsage, cUsage.m_aEntries[nCount].m_pInitialization->pLeft->pLeft, nCount, FALSE);
+		}
+	}
+	ScanGlobalVariableReferences(cUsage, pOldTree, nGlobals, FALSE);
+
+	// Fold and remove, in declaration order, so that an initializer that
+	// reads a folded global can itself be folded.
+	for (nCount = 0; nCount < nGlobals; ++nCount)
+	{
+		CScriptCompilerGlobalVariableEntry &cEntry = cUsage.m_aEntries[nCount];
+		if (cEntry.m_bPinned == TRUE || cEntry.m_bWritten == TRUE)
+		{
+			continue;
+		}
+
+		CScriptParseTreeNode *pValue = NULL;
+		if (cEntry.m_pInitialization != NULL)
+		{
+			CScriptParseTreeNode *pExpression = cEntry.m_pInitialization->pLeft->pLeft;
+			if (pExpression->pLeft == NULL)
+			{
+				continue;
+			}
+
+			ConstantFoldNode(pExpression->pLeft, TRUE);
+			pValue = pExpression->pLeft;
+
+			if (pValue->nOperation == CSCRIPTCOMPILER_OPERATION_NEGATION &&
+			        pValue->pLeft != NULL &&
+			        (pValue->pLeft->nOperation == CSCRIPTCOMPILER_OPERATION_CONSTANT_INTEGER ||
+			         pValue->pLeft->nOperation == CSCRIPTCOMPILER_OPERATION_CONSTANT_FLOAT))
+			{
+				int32_t nConstantOperation = pValue->pLeft->nOperation;
+				int32_t nIntegerData = -pValue->pLeft->nIntegerData;
+				float fFloatData = -pValue->pLeft->fFloatData;
+				pValue->pLeft->Clean();
+				pValue->Clean();
+				pValue->nOperation = nConstantOperation;
+				pValue->nIntegerData = nIntegerData;
+				pValue->fFloatData = fFloatData;
+			}
+
+			// Anything but a constant could have side effects, so the
+			// initialization has to stay.
+			if (pValue->nOperation != CSCRIPTCOMPILER_OPERATION_CONSTANT_INTEGER &&
+			        pValue->nOperation != CSCRIPTCOMPILER_OPERATION_CONSTANT_FLOAT &&
+			        pValue->nOperation != CSCRIPTCOMPILER_OPERATION_CONSTANT_STRING &&
+			        pValue->nOperation != CSCRIPTCOMPILER_OPERATION_CONSTANT_OBJECT &&
+			        pValue->nOperation != CSCRIPTCOMPILER_OPERATION_CONSTANT_VECTOR &&
+			        pValue->nOperation != CSCRIPTCOMPILER_OPERATION_CONSTANT_LOCATION &&
+			        pValue->nOperation != CSCRIPTCOMPILER_OPERATION_CONSTANT_JSON)
+			{
+				continue;
+			}
+		}
+
+		if (cEntry.m_aReads.empty() == FALSE)
+		{
+			int32_t nConstantOperation;
+			if (cEntry.m_nVarType == CSCRIPTCOMPILER_OPERATION_KEYWORD_INT)
+			{
+				nConstantOperation = CSCRIPTCOMPILER_OPERATION_CONSTANT_INTEGER;
+			}
+			else if (cEntry.m_nVarType == CSCRIPTCOMPILER_OPERATION_KEYWORD_FLOAT)
+			{
+				nConstantOperation = CSCRIPTCOMPILER_OPERATION_CONSTANT_FLOAT;
+			}
+			else if (cEntry.m_nVarType == CSCRIPTCOMPILER_OPERATION_KEYWORD_STRING)
+			{
+				nConstantOperation = CSCRIPTCOMPILER_OPERATION_CONSTANT_STRING;
+			}
+			else
+			{
+				continue;
+			}
+
+			// A type mismatch is reported when the tree is walked.
+			if (pValue != NULL && pValue->nOperation != nConstantOperation)
+			{
+				continue;
+			}
+
+			for (CScriptParseTreeNode *pRead : cEntry.m_aReads)
+			{
+				if (pRead->m_psStringData != NULL)
+				{
+					DeleteParseTreeString(pRead->m_psStringData);
+					pRead->m_psStringData = NULL;
+				}
+				pRead->nOperation = nConstantOperation;
+				pRead->nIntegerData = (pValue != NULL) ? pValue->nIntegerData : 0;
+				pRead->fFloatData = (pValue != NULL) ? pValue->fFloatData : 0.0f;
+				if (nConstantOperation == CSCRIPTCOMPILER_OPERATION_CONSTANT_STRING)
+				{
+					pRead->m_psStringData = NewParseTreeString((pValue != NULL && pValue->m_psStringData != NULL) ? pValue->m_psStringData->CStr() : "");
+				}
+			}
+		}
+
+		// Unlink the declaration (and its initialization) from its statement list.
+		CScriptParseTreeNode *pLast = (cEntry.m_pInitialization != NULL) ? cEntry.m_pInitialization : cEntry.m_pDeclaration;
+		CScriptParseTreeNode *pAfter = pLast->pRight;
+		pLast->pRight = NULL;
+
+		if (cEntry.m_pDeclarationList->pLeft == cEntry.m_pDeclaration)
+		{
+			cEntry.m_pDeclarationList->pLeft = pAfter;
+		}
+		else
+		{
+			for (pStatement = cEntry.m_pDeclarationList->pLeft; pStatement != NULL; pStatement = pStatement->pRight)
+			{
+				if (pStatement->pRight == cEntry.m_pDeclaration)
+				{
+					pStatement->pRight = pAfter;
+					break;
+				}
+			}
+		}
+
+		DeleteParseTree(FALSE, cEntry.m_pDeclaration);
+	}
+
+	// Drop the statements that no longer declare anything, and check whether
+	// anything other than structure definitions is left.
+	BOOL bVariablesRemain = FALSE;
+	CScriptParseTreeNode *pPrevious = m_pGlobalVariableParseTree;
+	pGroup = m_pGlobalVariableParseTree->pRight;
+	while (pGroup != NULL)
+	{
+		CScriptParseTreeNode *pNextGroup = pGroup->pRight;
+		if (pGroup->pLeft != NULL &&
+		        pGroup->pLeft->nOperation == CSCRIPTCOMPILER_OPERATION_STATEMENT_LIST &&
+		        pGroup->pLeft->pLeft == NULL)
+		{
+			pPrevious->pRight = pNextGroup;
+			pGroup->pRight = NULL;
+			DeleteParseTree(FALSE, pGroup);
+		}
+		else
+		{
+			if (pGroup->pLeft == NULL || pGroup->pLeft->nOperation != CSCRIPTCOMPILER_OPERATION_STRUCTURE_DEFINITION)
+			{
+				bVariablesRemain = TRUE;
+			}
+			pPrevious = pGroup;
+		}
+		pGroup = pNextGroup;
+	}
+
+	if (bVariablesRemain == TRUE)
+	{
+		return pOldTree;
+	}
+
+	// Nothing is left for #globals to set up.  Structure definitions do not
+	// generate any code, so they can be walked ahead of the functions.
+	std::vector<CScriptParseTreeNode *> pStructureDefinitions;
+	pGroup = m_pGlobalVariableParseTree->pRight;
+	m_pGlobalVariableParseTree->pRight = NULL;
+	while (pGroup != NULL)
+	{
+		pStructureDefinitions.push_back(pGroup);
+		CScriptParseTreeNode *pNextGroup = pGroup->pRight;
+		pGroup->pRight = NULL;
+		pGroup = pNextGroup;
+	}
+
+	for (nCount = (int32_t) pStructureDefinitions.size() - 1; nCount >= 0; --nCount)
+	{
+		pOldTree = CreateScriptParseTreeNode(CSCRIPTCOMPILER_OPERATION_FUNCTIONAL_UNIT,pStructureDefinitions[nCount],pOldTree);
+	}
+
+	DeleteParseTree(FALSE, m_pGlobalVariableParseTree);
+	m_pGlobalVariableParseTree = NULL;
+
+	return pOldTree;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  CScriptCompiler::ScanGlobalVariableReferences()
+///////////////////////////////////////////////////////////////////////////////
+// Description: Records the reads and writes of global variables within a
+//              tree.  Globals whose names are redeclared (locals, parameters)
+//              or that are read before their declaration are pinned, since
+//              the name alone does not tell which variable is meant.
+///////////////////////////////////////////////////////////////////////////////
+
+void CScriptCompiler::ScanGlobalVariableReferences(CScriptCompilerGlobalVariableUsage &cUsage, CScriptParseTreeNode *pNode, int32_t nDeclaringGlobal, BOOL bDeclaration)
+{
+	// Iterate down the right branches (statement lists, functional units) so
+	// that long scripts do not recurse once per statement.
+	while (pNode != NULL)
+	{
+		if (pNode->nOperation == CSCRIPTCOMPILER_OPERATION_VARIABLE)
+		{
+			int32_t nGlobal = cUsage.Find(pNode->m_psStringData);
+			if (nGlobal >= 0)
+			{
+				if (bDeclaration == TRUE || nGlobal >= nDeclaringGlobal)
+				{
+					cUsage.m_aEntries[nGlobal].m_bPinned = TRUE;
+				}
+				else
+				{
+					cUsage.m_aEntries[nGlobal].m_aReads.push_back(pNode);
+				}
+			}
+			return;
+		}
+
+		if (pNode->nOperation == CSCRIPTCOMPILER_OPERATION_KEYWORD_DECLARATION)
+		{
+			pNode = pNode->pRight;
+			bDeclaration = TRUE;
+			continue;
+		}
+
+		if (pNode->nOperation == CSCRIPTCOMPILER_OPERATION_FUNCTION_PARAM_NAME)
+		{
+			int32_t nGlobal = cUsage.Find(pNode->m_psStringData);
+			if (nGlobal >= 0)
+			{
+				cUsage.m_aEntries[nGlobal].m_bPinned = TRUE;
+			}
+		}
+
+		if (pNode->nOperation == CSCRIPTCOMPILER_OPERATION_ASSIGNMENT)
+		{
+			MarkGlobalVariableWritten(cUsage, pNode->pRight);
+			pNode = pNode->pLeft;
+			continue;
+		}
+
+		if (pNode->nOperation == CSCRIPTCOMPILER_OPERATION_PRE_INCREMENT ||
+		        pNode->nOperation == CSCRIPTCOMPILER_OPERATION_PRE_DECREMENT ||
+		        pNode->nOperation == CSCRIPTCOMPILER_OPERATION_POST_INCREMENT ||
+		        pNode->nOperation == CSCRIPTCOMPILER_OPERATION_POST_DECREMENT)
+		{
+			MarkGlobalVariableWritten(cUsage, pNode->pLeft);
+			return;
+		}
+
+		// The right branch of a structure part is the field name.
+		if (pNode->nOperation == CSCRIPTCOMPILER_OPERATION_STRUCTURE_PART)
+		{
+			pNode = pNode->pLeft;
+			continue;
+		}
+
+		ScanGlobalVariableReferences(cUsage, pNode->pLeft, nDeclaringGlobal, bDeclaration);
+		pNode = pNode->pRight;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  CScriptCompiler::MarkGlobalVariableWritten()
+///////////////////////////////////////////////////////////////////////////////
+// Description: Marks the global variable behind an lvalue as written.
+///////////////////////////////////////////////////////////////////////////////
+
+void CScriptCompiler::MarkGlobalVariableWritten(CScriptCompilerGlobalVariableUsage &cUsage, CScriptParseTreeNode *pNode)
+{
+	while (pNode != NULL && pNode->nOperation == CSCRIPTCOMPILER_OPERATION_STRUCTURE_PART)
+	{
+		pNode = pNode->pLeft;
+	}
+
+	if (pNode != NULL && pNode->nOperation == CSCRIPTCOMPILER_OPERATION_VARIABLE)
+	{
+		int32_t nGlobal = cUsage.Find(pNode->m_psStringData);
+		if (nGlobal >= 0)
+		{
+			cUsage.m_aEntries[nGlobal].m_bWritten = TRUE;
+		}
+	}
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 //  CScriptCompiler::InstallLoader()
 ///////////////////////////////////////////////////////////////////////////////
@@ -521,6 +899,7 @@ int32_t CScriptCompiler::InstallLoader()
 	m_pcIdentifierList[m_nOccupiedIdentifiers].m_nIdentifierHash = HashString("#loader");
 	m_pcIdentifierList[m_nOccupiedIdentifiers].m_nIdentifierLength = 7;
 	m_pcIdentifierList[m_nOccupiedIdentifiers].m_nBinarySourceStart = m_nOutputCodeLength;
+	m_nCallGraphCaller = m_nOccupiedIdentifiers;
 	m_pcIdentifierList[m_nOccupiedIdentifiers].m_nBinaryDestinationStart = -1;
 	m_pcIdentifierList[m_nOccupiedIdentifiers].m_nBinaryDestinationFinish = -1;
 	m_pcIdentifierList[m_nOccupiedIdentifiers].m_nParameters = 0;
@@ -625,8 +1004,8 @@ int32_t CScriptCompiler::InstallLoader()
 //  Created On: 01/25/2000
 // Description: This function is responsible for determining which functions
 //              are required in the script, and which ones will be left out.
-//              Calls ValidateLocationOfIdentifier (recursively) to determine
-//              all of this.
+//              Calls ValidateLocationOfIdentifier to walk the call graph
+//              from #loader to determine all of this.
 ///////////////////////////////////////////////////////////////////////////////
 
 int32_t CScriptCompiler::DetermineLocationOfCode()
@@ -636,7 +1015,12 @@ int32_t CScriptCompiler::DetermineLocationOfCode()
 		// Here, we have to compress the language into something that
 		// we can deal with on a small level.
 		m_nFinalBinarySize = CVIRTUALMACHINE_BINARY_SCRIPT_HEADER;
-		return ValidateLocationOfIdentifier("#loader");
+		int32_t nReturnValue = ValidateLocationOfIdentifier("#loader");
+		if (nReturnValue >= 0)
+		{
+			RecordFunctionUsage();
+		}
+		return nReturnValue;
 
 	}
 	else
@@ -652,11 +1036,179 @@ int32_t CScriptCompiler::DetermineLocationOfCode()
 			}
 		}
 
+		RecordFunctionUsage();
 		return 0;
 	}
 
 }
 
+///////////////////////////////////////////////////////////////////////////////
+//  CScriptCompiler::RecordFunctionUsage()
+///////////////////////////////////////////////////////////////////////////////
+// Description: Called once every function has been placed.  Keeps a copy
+//              of which user-defined functions are reachable from the
+//              entry point, and which files they came from, so that tools
+//              compiling many scripts can aggregate the results (see
+//              GetFunctionUsage()).  Reachability comes from the call
+//              graph, whether or not dead functions are being removed.
+///////////////////////////////////////////////////////////////////////////////
+
+void CScriptCompiler::RecordFunctionUsage()
+{
+	m_aFunctionUsage.clear();
+	m_aIncludedFileNames.clear();
+
+	std::vector<BOOL> abReachable;
+	FindReachableFunctions(abReachable);
+
+	const CExoString &sMainFileName = m_pcIncludeFileStack[0].m_sCompiledScriptName;
+
+	for (int32_t count = 0; count < m_nNextParseTreeFileName; count++)
+	{
+		if (m_ppsParseTreeFileNames[count] != NULL &&
+		        m_ppsParseTreeFileNames[count]->CompareNoCase(sMainFileName) == FALSE)
+		{
+			m_aIncludedFileNames.push_back(*(m_ppsParseTreeFileNames[count]));
+		}
+	}
+
+	for (int32_t count = m_nMaxPredefinedIdentifierId; count < m_nOccupiedIdentifiers; count++)
+	{
+		CScriptCompilerIdListEntry &cEntry = m_pcIdentifierList[count];
+
+		// Skip prototypes and the internal #loader / #globals entries.
+		if (cEntry.m_nBinarySourceStart == -1 ||
+		        cEntry.m_psIdentifier.GetLength() == 0 ||
+		        cEntry.m_psIdentifier.CStr()[0] == '#')
+		{
+			continue;
+		}
+
+		CScriptCompilerFunctionUsage cUsage;
+		cUsage.m_sFunctionName = cEntry.m_psIdentifier;
+		cUsage.m_bReachable    = abReachable[count];
+		cUsage.m_bIncludeFile  = FALSE;
+		if (cEntry.m_nFileReference >= 0 && cEntry.m_nFileReference < m_nNextParseTreeFileName)
+		{
+			cUsage.m_sFileName    = *(m_ppsParseTreeFileNames[cEntry.m_nFileReference]);
+			cUsage.m_bIncludeFile = (cUsage.m_sFileName.CompareNoCase(sMainFileName) == FALSE);
+		}
+		m_aFunctionUsage.push_back(cUsage);
+	}
+
+	// Each file is loaded once, so its graph entry can be found by name.
+	for (CScriptCompilerIncludeGraphEntry &cEntry : m_aIncludeGraph)
+	{
+		for (const CScriptCompilerFunctionUsage &cUsage : m_aFunctionUsage)
+		{
+			if (cUsage.m_sFileName.CompareNoCase(cEntry.m_sFileName))
+			{
+				++cEntry.m_nFunctions;
+				if (cUsage.m_bReachable)
+				{
+					++cEntry.m_nReachableFunctions;
+				}
+			}
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  CScriptCompiler::GroupCallGraph()
+///////////////////////////////////////////////////////////////////////////////
+// Description: Groups the calls recorded during code generation by caller
+//              (counting sort), keeping the order in which they were
+//              generated within each function.  The calls made by
+//              identifier n are aCallees[aFirstCall[n]] up to
+//              aCallees[aFirstCall[n + 1]].
+///////////////////////////////////////////////////////////////////////////////
+
+void CScriptCompiler::GroupCallGraph(std::vector<int32_t> &aFirstCall, std::vector<int32_t> &aCallees)
+{
+	aFirstCall.assign(m_nOccupiedIdentifiers + 1, 0);
+	aCallees.assign(m_aCallGraphCallees.size(), 0);
+
+	for (size_t count = 0; count < m_aCallGraphCallers.size(); count++)
+	{
+		int32_t nCaller = m_aCallGraphCallers[count];
+		if (nCaller >= 0 && nCaller < m_nOccupiedIdentifiers)
+		{
+			++aFirstCall[nCaller + 1];
+		}
+	}
+
+	for (int32_t count = 0; count < m_nOccupiedIdentifiers; count++)
+	{
+		aFirstCall[count + 1] += aFirstCall[count];
+	}
+
+	std::vector<int32_t> aNextCall(aFirstCall.begin(), aFirstCall.end() - 1);
+	for (size_t count = 0; count < m_aCallGraphCallers.size(); count++)
+	{
+		int32_t nCaller = m_aCallGraphCallers[count];
+		if (nCaller >= 0 && nCaller < m_nOccupiedIdentifiers)
+		{
+			aCallees[aNextCall[nCaller]++] = m_aCallGraphCallees[count];
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  CScriptCompiler::FindReachableFunctions()
+///////////////////////////////////////////////////////////////////////////////
+// Description: Marks every identifier the call graph reaches from #loader,
+//              without placing any code.  This gives the same answer as
+//              dead function elimination, so the usage reports do not
+//              depend on that optimization being on.
+///////////////////////////////////////////////////////////////////////////////
+
+void CScriptCompiler::FindReachableFunctions(std::vector<BOOL> &abReachable)
+{
+	abReachable.assign(m_nOccupiedIdentifiers, FALSE);
+
+	int32_t nLoader = GetIdentifierByName("#loader");
+	if (nLoader < 0)
+	{
+		return;
+	}
+
+	std::vector<int32_t> aFirstCall;
+	std::vector<int32_t> aCallees;
+	GroupCallGraph(aFirstCall, aCallees);
+
+	int32_t pnStartingFunctions[4] = { -1, -1, -1, -1 };
+	std::vector<int32_t> aStack(1, nLoader);
+	abReachable[nLoader] = TRUE;
+
+	while (!aStack.empty())
+	{
+		int32_t nCaller = aStack.back();
+		aStack.pop_back();
+
+		for (int32_t count = aFirstCall[nCaller]; count < aFirstCall[nCaller + 1]; count++)
+		{
+			int32_t nCallee = aCallees[count];
+			if (nCallee < 0)
+			{
+				int32_t nStartingFunction = -nCallee;
+				if (pnStartingFunctions[nStartingFunction] == -1)
+				{
+					CExoString sNewFunctionName = (nStartingFunction == 3) ? CExoString("") :
+					                              GetFunctionNameFromSymbolSubTypes(0, nStartingFunction);
+					pnStartingFunctions[nStartingFunction] = GetIdentifierByName(sNewFunctionName);
+				}
+				nCallee = pnStartingFunctions[nStartingFunction];
+			}
+
+			if (nCallee >= 0 && nCallee < m_nOccupiedIdentifiers && !abReachable[nCallee])
+			{
+				abReachable[nCallee] = TRUE;
+				aStack.push_back(nCallee);
+			}
+		}
+	}
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 //  CScriptCompiler::ValidateLocationOfIdentifier()
 ///////////////////////////////////////////////////////////////////////////////
@@ -664,9 +1216,9 @@ int32_t CScriptCompiler::DetermineLocationOfCode()
 //  Created On: 01/25/2000
 // Description: This function is responsible for determining which functions
 //              are required in the script, and which ones will be left out.
-//              Calls itself recursively on all of the functions that are
-//              called within this function to see if they're already in the
-//              script, and add them if they aren't.
+//              Starting at sFunctionName, every function reachable in the
+//              call graph recorded during code generation is added to the
+//              script, in the same depth-first order the calls were made.
 ///////////////////////////////////////////////////////////////////////////////
 
 int32_t CScriptCompiler::ValidateLocationOfIdentifier(const CExoString &sFunctionName)
@@ -683,40 +1235,60 @@ int32_t CScriptCompiler::ValidateLocationOfIdentifier(const CExoString &sFunctio
 		return 0;
 	}
 
-	int32_t nFunctionSize = m_pcIdentifierList[nIdentifier].m_nBinarySourceFinish -
-	                    m_pcIdentifierList[nIdentifier].m_nBinarySourceStart;
+	std::vector<int32_t> aFirstCall;
+	std::vector<int32_t> aCallees;
+	GroupCallGraph(aFirstCall, aCallees);
 
-	m_pcIdentifierList[nIdentifier].m_nBinaryDestinationStart  = m_nFinalBinarySize;
-	m_pcIdentifierList[nIdentifier].m_nBinaryDestinationFinish = m_nFinalBinarySize + nFunctionSize;
+	// #globals and main are only looked up by name if something calls them.
+	int32_t pnStartingFunctions[4] = { -1, -1, -1, -1 };
+
+	// Identifier being placed, and the next of its calls to follow.
+	std::vector<std::pair<int32_t, int32_t>> aStack;
+
+	int32_t nCallee = nIdentifier;
+	for (;;)
+	{
+		if (nCallee >= 0 && m_pcIdentifierList[nCallee].m_nBinaryDestinationStart == -1)
+		{
+			int32_t nFunctionSize = m_pcIdentifierList[nCallee].m_nBinarySourceFinish -
+			                    m_pcIdentifierList[nCallee].m_nBinarySourceStart;
+
+			m_pcIdentifierList[nCallee].m_nBinaryDestinationStart  = m_nFinalBinarySize;
+			m_pcIdentifierList[nCallee].m_nBinaryDestinationFinish = m_nFinalBinarySize + nFunctionSize;
+
+			m_nFinalBinarySize += nFunctionSize;
+
+			aStack.push_back(std::make_pair(nCallee, aFirstCall[nCallee]));
+		}
 
-	m_nFinalBinarySize += nFunctionSize;
+		// Find the next call to follow.
+		nCallee = -1;
+		while (!aStack.empty() && aStack.back().second == aFirstCall[aStack.back().first + 1])
+		{
+			aStack.pop_back();
+		}
 
-	// Now, this is where it gets EXCITING.  We reference all of the
-	// functions that this routine could potentially call, and add
-	// them to the list, too!
+		if (aStack.empty())
+		{
+			break;
+		}
 
-	CExoString sNewFunctionName;
-	int32_t nReturnValue;
+		nCallee = aCallees[aStack.back().second++];
 
-	for (int32_t count = 0; count < m_nSymbolQueryList; count++)
-	{
-		if (m_pSymbolQueryList[count].m_nLocationPointer >= m_pcIdentifierList[nIdentifier].m_nBinarySourceStart &&
-		        m_pSymbolQueryList[count].m_nLocationPointer < m_pcIdentifierList[nIdentifier].m_nBinarySourceFinish)
+		if (nCallee < 0)
 		{
-			// Make sure the query is for a function label, and NOT a switch or continue statement.
-			if (m_pSymbolQueryList[count].m_nSymbolType == CSCRIPTCOMPILER_SYMBOL_TABLE_ENTRY_TYPE_FUNCTION_ENTRY)
+			int32_t nStartingFunction = -nCallee;
+			if (pnStartingFunctions[nStartingFunction] == -1)
 			{
-				sNewFunctionName = GetFunctionNameFromSymbolSubTypes(m_pSymbolQueryList[count].m_nSymbolSubType1,
-				                   m_pSymbolQueryList[count].m_nSymbolSubType2);
-
-				// Get the function name!
-				//sNewFunctionName = m_pSymbolQueryList[count].m_sSymbolName.Right(m_pSymbolQueryList[count].m_sSymbolName.GetLength() - 3);
-				nReturnValue     = ValidateLocationOfIdentifier(sNewFunctionName);
-				if (nReturnValue < 0)
+				CExoString sNewFunctionName = (nStartingFunction == 3) ? CExoString("") :
+				                              GetFunctionNameFromSymbolSubTypes(0, nStartingFunction);
+				pnStartingFunctions[nStartingFunction] = GetIdentifierByName(sNewFunctionName);
+				if (pnStartingFunctions[nStartingFunction] < 0)
 				{
-					return nReturnValue;
+					return OutputIdentifierError(sNewFunctionName,pnStartingFunctions[nStartingFunction],0);
 				}
 			}
+			nCallee = pnStartingFunctions[nStartingFunction];
 		}
 	}
 
@@ -1361,6 +1933,386 @@ int32_t CScriptCompiler::WriteResolvedOutput()
 	return 0;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+//  CScriptCompiler::GetParameterStackSize()
+///////////////////////////////////////////////////////////////////////////////
+// Description: Returns the number of bytes that the first nParameters
+//              parameters of a function take up on the run time stack.
+//              Action parameters are stored with STORE_STATE instead, and
+//              take no room at all.
+///////////////////////////////////////////////////////////////////////////////
+
+int32_t CScriptCompiler::GetParameterStackSize(int32_t nIdentifier, int32_t nParameters)
+{
+	int32_t nSize = 0;
+
+	for (int32_t count = 0; count < nParameters && count < m_pcIdentifierList[nIdentifier].m_nParameters; count++)
+	{
+		if (m_pcIdentifierList[nIdentifier].m_pchParameters[count] == CSCRIPTCOMPILER_TOKEN_KEYWORD_STRUCT)
+		{
+			nSize += GetStructureSize(m_pcIdentifierList[nIdentifier].m_psStructureParameterNames[count]);
+		}
+		else if (m_pcIdentifierList[nIdentifier].m_pchParameters[count] != CSCRIPTCOMPILER_TOKEN_KEYWORD_ACTION)
+		{
+			nSize += 4;
+		}
+	}
+
+	return nSize;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  CScriptCompiler::OutputVerifyFinalCodeError()
+///////////////////////////////////////////////////////////////////////////////
+// Description: Reports a problem found by VerifyFinalCode(), along with the
+//              offset of the instruction in the compiled script.
+///////////////////////////////////////////////////////////////////////////////
+
+int32_t CScriptCompiler::OutputVerifyFinalCodeError(int32_t nError, int32_t nOffset, const CExoString &sReason)
+{
+	CExoString sErrorText;
+	sErrorText.Format("%s (code verification, offset %d: %s)", m_cAPI.TlkResolve(-nError), nOffset, sReason.CStr());
+
+	OutputError(nError, &(m_pcIncludeFileStack[m_nCompileFileLevel].m_sCompiledScriptName), 0, sErrorText);
+
+	return STRREF_CSCRIPTCOMPILER_ERROR_ALREADY_PRINTED;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  CScriptCompiler::VerifyFinalCode()
+///////////////////////////////////////////////////////////////////////////////
+// Description: Checks the resolved code before it is written out.  The
+//              loader, every function called through JSR and every block
+//              saved with STORE_STATE is a subroutine of its own.  Each
+//              reachable instruction is visited once, following the
+//              basic blocks, while the depth of the run time stack is
+//              tracked relative to the start of its subroutine.
+//
+//              The depth has to agree wherever two paths join, SAVEBP and
+//              RESTOREBP have to pair up, every jump has to land on an
+//              instruction, and RETN has to leave a function with exactly
+//              its parameters removed from the stack.
+///////////////////////////////////////////////////////////////////////////////
+
+int32_t CScriptCompiler::VerifyFinalCode()
+{
+	const uint8_t *pCode = (const uint8_t *) m_pchOutputCode;
+	const int32_t nCodeLength = m_nOutputCodeLength;
+
+	const int32_t nNotAnInstruction = INT32_MIN;
+	const int32_t nNotVisited = INT32_MIN + 1;
+
+	CExoString sReason;
+
+	// Find where every instruction starts.  Everything else is the middle
+	// of an instruction, and nothing may jump there.
+	std::vector<int32_t> aDepth(nCodeLength, nNotAnInstruction);
+	int32_t nOffset = CVIRTUALMACHINE_BINARY_SCRIPT_HEADER;
+	while (nOffset < nCodeLength)
+	{
+		int32_t nSize = VirtualMachineInstructionSize(pCode, nOffset, nCodeLength);
+		if (nSize == 0)
+		{
+			return OutputVerifyFinalCodeError(STRREF_CVIRTUALMACHINE_ERROR_INVALID_OP_CODE, nOffset, "unknown or truncated instruction");
+		}
+		aDepth[nOffset] = nNotVisited;
+		nOffset += nSize;
+	}
+
+	// The bytes of parameters removed by a JSR to each function, by the
+	// location of the function.
+	std::vector<int32_t> aFunctionParameters(nCodeLength, -1);
+	for (int32_t count = m_nMaxPredefinedIdentifierId; count < m_nOccupiedIdentifiers; count++)
+	{
+		int32_t nStart = m_pcIdentifierList[count].m_nBinaryDestinationStart;
+		if (nStart >= CVIRTUALMACHINE_BINARY_SCRIPT_HEADER && nStart < nCodeLength)
+		{
+			aFunctionParameters[nStart] = GetParameterStackSize(count, m_pcIdentifierList[count].m_nParameters);
+		}
+	}
+
+	// Engine functions, by the id used in ACTION.
+	std::vector<int32_t> aEngineFunctions;
+	for (int32_t count = 0; count < m_nMaxPredefinedIdentifierId; count++)
+	{
+		if (m_pcIdentifierList[count].m_nIdentifierType == 1 && m_pcIdentifierList[count].m_nIdIdentifier >= 0)
+		{
+			if (m_pcIdentifierList[count].m_nIdIdentifier >= (int32_t) aEngineFunctions.size())
+			{
+				aEngineFunctions.resize(m_pcIdentifierList[count].m_nIdIdentifier + 1, -1);
+			}
+			aEngineFunctions[m_pcIdentifierList[count].m_nIdIdentifier] = count;
+		}
+	}
+
+	// Subroutines, and where they start.  The loader leaves the return
+	// value of a conditional script on the stack.  A function removes its
+	// parameters, and a saved block runs on its own copy of the stack.
+	std::vector<int32_t> aSubroutineReturnDepth;
+	std::vector<int32_t> aSubroutineFloor;
+	std::vector<int32_t> aSubroutineAt(nCodeLength, -1);
+
+	// The state of every visited instruction.
+	std::vector<int32_t> aSavedBasePointers(nCodeLength, 0);
+	std::vector<int32_t> aSubroutine(nCodeLength, -1);
+
+	struct VerifyPath
+	{
+		int32_t nOffset;
+		int32_t nDepth;
+		int32_t nSavedBasePointers;
+		int32_t nSubroutine;
+	};
+	std::vector<VerifyPath> aPaths;
+
+	aSubroutineReturnDepth.push_back(m_bCompileConditionalFile == TRUE ? 4 : 0);
+	aSubroutineFloor.push_back(0);
+	aSubroutineAt[CVIRTUALMACHINE_BINARY_SCRIPT_HEADER] = 0;
+	aPaths.push_back({ CVIRTUALMACHINE_BINARY_SCRIPT_HEADER, 0, 0, 0 });
+
+	while (!aPaths.empty())
+	{
+		VerifyPath cPath = aPaths.back();
+		aPaths.pop_back();
+
+		for (;;)
+		{
+			nOffset = cPath.nOffset;
+			if (nOffset < 0 || nOffset >= nCodeLength || aDepth[nOffset] == nNotAnInstruction)
+			{
+				return OutputVerifyFinalCodeError(STRREF_CVIRTUALMACHINE_ERROR_IP_OUT_OF_CODE_SEGMENT, nOffset, "execution does not continue at an instruction");
+			}
+
+			// Joining a path that has already been followed.
+			if (aDepth[nOffset] != nNotVisited)
+			{
+				if (aSubroutine[nOffset] != cPath.nSubroutine)
+				{
+					return OutputVerifyFinalCodeError(STRREF_CVIRTUALMACHINE_ERROR_STACK_UNDERFLOW, nOffset, "code is shared by two subroutines");
+				}
+				if (aDepth[nOffset] != cPath.nDepth)
+				{
+					sReason.Format("stack depth %d does not match %d on another path", cPath.nDepth, aDepth[nOffset]);
+					return OutputVerifyFinalCodeError(STRREF_CVIRTUALMACHINE_ERROR_STACK_UNDERFLOW, nOffset, sReason);
+				}
+				if (aSavedBasePointers[nOffset] != cPath.nSavedBasePointers)
+				{
+					return OutputVerifyFinalCodeError(STRREF_CVIRTUALMACHINE_ERROR_STACK_UNDERFLOW, nOffset, "SAVEBP nesting does not match another path");
+				}
+				break;
+			}
+
+			aDepth[nOffset] = cPath.nDepth;
+			aSavedBasePointers[nOffset] = cPath.nSavedBasePointers;
+			aSubroutine[nOffset] = cPath.nSubroutine;
+
+			const uint8_t *pInstruction = pCode + nOffset;
+			const uint8_t *pExtraData = pInstruction + CVIRTUALMACHINE_EXTRA_DATA_LOCATION;
+			uint8_t nAuxCode = pInstruction[CVIRTUALMACHINE_AUXCODE_LOCATION];
+			int32_t nNextOffset = nOffset + VirtualMachineInstructionSize(pCode, nOffset, nCodeLength);
+			int32_t nTarget = -1;
+			BOOL bEndOfPath = FALSE;
+
+			switch (pInstruction[CVIRTUALMACHINE_OPCODE_LOCATION])
+			{
+				case CVIRTUALMACHINE_OPCODE_RUNSTACK_ADD:
+				case CVIRTUALMACHINE_OPCODE_CONSTANT:
+					cPath.nDepth += 4;
+					break;
+
+				case CVIRTUALMACHINE_OPCODE_RUNSTACK_COPY:
+				case CVIRTUALMACHINE_OPCODE_RUNSTACK_COPY_BASE:
+					cPath.nDepth += VirtualMachineReadInt16(pExtraData + 4);
+					break;
+
+				case CVIRTUALMACHINE_OPCODE_EXECUTE_COMMAND:
+				{
+					int32_t nCommand = (uint16_t) VirtualMachineReadInt16(pExtraData);
+					int32_t nIdentifier = nCommand < (int32_t) aEngineFunctions.size() ? aEngineFunctions[nCommand] : -1;
+					if (nIdentifier < 0)
+					{
+						sReason.Format("ACTION calls unknown engine function %d", nCommand);
+						return OutputVerifyFinalCodeError(STRREF_CVIRTUALMACHINE_ERROR_INVALID_COMMAND, nOffset, sReason);
+					}
+
+					cPath.nDepth -= GetParameterStackSize(nIdentifier, pExtraData[2]);
+
+					int32_t nReturnType = m_pcIdentifierList[nIdentifier].m_nReturnType;
+					if (nReturnType == CSCRIPTCOMPILER_TOKEN_VECTOR_IDENTIFIER)
+					{
+						cPath.nDepth += 12;
+					}
+					else if (nReturnType == CSCRIPTCOMPILER_TOKEN_STRUCTURE_IDENTIFIER)
+					{
+						cPath.nDepth += GetStructureSize(m_pcIdentifierList[nIdentifier].m_psStructureReturnName);
+					}
+					else if (nReturnType != CSCRIPTCOMPILER_TOKEN_VOID_IDENTIFIER)
+					{
+						cPath.nDepth += 4;
+					}
+					break;
+				}
+
+				case CVIRTUALMACHINE_OPCODE_LOGICAL_AND:
+				case CVIRTUALMACHINE_OPCODE_LOGICAL_OR:
+				case CVIRTUALMACHINE_OPCODE_INCLUSIVE_OR:
+				case CVIRTUALMACHINE_OPCODE_EXCLUSIVE_OR:
+				case CVIRTUALMACHINE_OPCODE_BOOLEAN_AND:
+				case CVIRTUALMACHINE_OPCODE_GEQ:
+				case CVIRTUALMACHINE_OPCODE_GT:
+				case CVIRTUALMACHINE_OPCODE_LT:
+				case CVIRTUALMACHINE_OPCODE_LEQ:
+				case CVIRTUALMACHINE_OPCODE_SHIFT_LEFT:
+				case CVIRTUALMACHINE_OPCODE_SHIFT_RIGHT:
+				case CVIRTUALMACHINE_OPCODE_USHIFT_RIGHT:
+				case CVIRTUALMACHINE_OPCODE_MODULUS:
+					cPath.nDepth -= 4;
+					break;
+
+				// Vector arithmetic leaves a vector; scaling one by a float
+				// takes a vector and a float.
+				case CVIRTUALMACHINE_OPCODE_ADD:
+				case CVIRTUALMACHINE_OPCODE_SUB:
+				case CVIRTUALMACHINE_OPCODE_MUL:
+				case CVIRTUALMACHINE_OPCODE_DIV:
+					cPath.nDepth -= (nAuxCode == CVIRTUALMACHINE_AUXCODE_TYPETYPE_VECTOR_VECTOR) ? 12 : 4;
+					break;
+
+				case CVIRTUALMACHINE_OPCODE_EQUAL:
+				case CVIRTUALMACHINE_OPCODE_NOT_EQUAL:
+					if (nAuxCode == CVIRTUALMACHINE_AUXCODE_TYPETYPE_STRUCT_STRUCT)
+					{
+						cPath.nDepth -= 2 * (uint16_t) VirtualMachineReadInt16(pExtraData) - 4;
+					}
+					else if (nAuxCode == CVIRTUALMACHINE_AUXCODE_TYPETYPE_VECTOR_VECTOR)
+					{
+						cPath.nDepth -= 20;
+					}
+					else
+					{
+						cPath.nDepth -= 4;
+					}
+					break;
+
+				case CVIRTUALMACHINE_OPCODE_MODIFY_STACK_POINTER:
+					cPath.nDepth += VirtualMachineReadInt32(pExtraData);
+					break;
+
+				case CVIRTUALMACHINE_OPCODE_DE_STRUCT:
+					cPath.nDepth -= VirtualMachineReadInt16(pExtraData);
+					cPath.nDepth += VirtualMachineReadInt16(pExtraData + 4);
+					break;
+
+				case CVIRTUALMACHINE_OPCODE_SAVE_BASE_POINTER:
+					cPath.nDepth += 4;
+					cPath.nSavedBasePointers++;
+					break;
+
+				case CVIRTUALMACHINE_OPCODE_RESTORE_BASE_POINTER:
+					if (cPath.nSavedBasePointers == 0)
+					{
+						return OutputVerifyFinalCodeError(STRREF_CVIRTUALMACHINE_ERROR_STACK_UNDERFLOW, nOffset, "RESTOREBP without a matching SAVEBP");
+					}
+					cPath.nDepth -= 4;
+					cPath.nSavedBasePointers--;
+					break;
+
+				case CVIRTUALMACHINE_OPCODE_JMP:
+					nNextOffset = nOffset + VirtualMachineReadInt32(pExtraData);
+					nTarget = nNextOffset;
+					break;
+
+				case CVIRTUALMACHINE_OPCODE_JZ:
+				case CVIRTUALMACHINE_OPCODE_JNZ:
+					cPath.nDepth -= 4;
+					nTarget = nOffset + VirtualMachineReadInt32(pExtraData);
+					if (nTarget >= 0 && nTarget < nCodeLength && aDepth[nTarget] != nNotAnInstruction)
+					{
+						aPaths.push_back({ nTarget, cPath.nDepth, cPath.nSavedBasePointers, cPath.nSubroutine });
+					}
+					break;
+
+				case CVIRTUALMACHINE_OPCODE_JSR:
+					nTarget = nOffset + VirtualMachineReadInt32(pExtraData);
+					if (nTarget >= 0 && nTarget < nCodeLength && aDepth[nTarget] != nNotAnInstruction)
+					{
+						if (aFunctionParameters[nTarget] < 0)
+						{
+							return OutputVerifyFinalCodeError(STRREF_CVIRTUALMACHINE_ERROR_IP_OUT_OF_CODE_SEGMENT, nOffset, "JSR does not call the start of a function");
+						}
+						if (aSubroutineAt[nTarget] == -1)
+						{
+							aSubroutineAt[nTarget] = (int32_t) aSubroutineReturnDepth.size();
+							aSubroutineReturnDepth.push_back(-aFunctionParameters[nTarget]);
+							aSubroutineFloor.push_back(-aFunctionParameters[nTarget]);
+							aPaths.push_back({ nTarget, 0, 0, aSubroutineAt[nTarget] });
+						}
+						cPath.nDepth -= aFunctionParameters[nTarget];
+					}
+					break;
+
+				case CVIRTUALMACHINE_OPCODE_STORE_STATE:
+					nTarget = nOffset + nAuxCode;
+					if (nTarget >= 0 && nTarget < nCodeLength && aDepth[nTarget] != nNotAnInstruction &&
+					        aSubroutineAt[nTarget] == -1)
+					{
+						int32_t nSavedStack = VirtualMachineReadInt32(pExtraData + 4);
+						aSubroutineAt[nTarget] = (int32_t) aSubroutineReturnDepth.size();
+						aSubroutineReturnDepth.push_back(nSavedStack);
+						aSubroutineFloor.push_back(0);
+						aPaths.push_back({ nTarget, nSavedStack, 0, aSubroutineAt[nTarget] });
+					}
+					break;
+
+				case CVIRTUALMACHINE_OPCODE_RET:
+					if (cPath.nSavedBasePointers != 0)
+					{
+						return OutputVerifyFinalCodeError(STRREF_CVIRTUALMACHINE_ERROR_STACK_UNDERFLOW, nOffset, "RETN with a SAVEBP that was not restored");
+					}
+					if (cPath.nDepth != aSubroutineReturnDepth[cPath.nSubroutine])
+					{
+						sReason.Format("RETN with a stack depth of %d, expected %d", cPath.nDepth, aSubroutineReturnDepth[cPath.nSubroutine]);
+						return OutputVerifyFinalCodeError(STRREF_CVIRTUALMACHINE_ERROR_STACK_UNDERFLOW, nOffset, sReason);
+					}
+					bEndOfPath = TRUE;
+					break;
+
+				case CVIRTUALMACHINE_OPCODE_ASSIGNMENT:
+				case CVIRTUALMACHINE_OPCODE_ASSIGNMENT_BASE:
+				case CVIRTUALMACHINE_OPCODE_NEGATION:
+				case CVIRTUALMACHINE_OPCODE_ONES_COMPLEMENT:
+				case CVIRTUALMACHINE_OPCODE_BOOLEAN_NOT:
+				case CVIRTUALMACHINE_OPCODE_DECREMENT:
+				case CVIRTUALMACHINE_OPCODE_INCREMENT:
+				case CVIRTUALMACHINE_OPCODE_DECREMENT_BASE:
+				case CVIRTUALMACHINE_OPCODE_INCREMENT_BASE:
+				case CVIRTUALMACHINE_OPCODE_NO_OPERATION:
+					break;
+			}
+
+			if (nTarget != -1 && (nTarget < 0 || nTarget >= nCodeLength || aDepth[nTarget] == nNotAnInstruction))
+			{
+				return OutputVerifyFinalCodeError(STRREF_CVIRTUALMACHINE_ERROR_IP_OUT_OF_CODE_SEGMENT, nOffset, "jump does not land on an instruction");
+			}
+
+			if (cPath.nDepth < aSubroutineFloor[cPath.nSubroutine])
+			{
+				sReason.Format("stack depth %d is below the start of the subroutine", cPath.nDepth);
+				return OutputVerifyFinalCodeError(STRREF_CVIRTUALMACHINE_ERROR_STACK_UNDERFLOW, nOffset, sReason);
+			}
+
+			if (bEndOfPath == TRUE)
+			{
+				break;
+			}
+
+			cPath.nOffset = nNextOffset;
+		}
+	}
+
+	return 0;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 //  CScriptCompiler::PreVisitGenerateCode()
 ///////////////////////////////////////////////////////////////////////////////
@@ -1426,6 +2378,8 @@ int32_t CScriptCompiler::PreVisitGenerateCode(CScriptParseTreeNode *pNode)
 			m_pcIdentifierList[nIdentifier].m_nBinarySourceFinish      = -1;
 			m_pcIdentifierList[nIdentifier].m_nBinaryDestinationStart  = -1;
 			m_pcIdentifierList[nIdentifier].m_nBinaryDestinationFinish = -1;
+			m_pcIdentifierList[nIdentifier].m_nFileReference           = pNode->m_nFileReference;
+			m_nCallGraphCaller = nIdentifier;
 
 			/* CExoString sSymbolName;
 			sSymbolName.Format("FE_%s",m_sFunctionImpName.CStr()); */
@@ -1489,6 +2443,7 @@ int32_t CScriptCompiler::PreVisitGenerateCode(CScriptParseTreeNode *pNode)
 			m_pcIdentifierList[m_nOccupiedIdentifiers].m_nIdentifierHash = HashString("#globals");
 			m_pcIdentifierList[m_nOccupiedIdentifiers].m_nIdentifierLength = 8;
 			m_pcIdentifierList[m_nOccupiedIdentifiers].m_nBinarySourceStart = m_nOutputCodeLength;
+			m_nCallGraphCaller = m_nOccupiedIdentifiers;
 			m_pcIdentifierList[m_nOccupiedIdentifiers].m_nBinaryDestinationStart = -1;
 			m_pcIdentifierList[m_nOccupiedIdentifiers].m_nBinaryDestinationFinish = -1;
 			m_pcIdentifierList[m_nOccupiedIdentifiers].m_nParameters = 0;
@@ -1960,7 +2915,34 @@ int32_t CScriptCompiler::PreVisitGenerateCode(CScriptParseTreeNode *pNode)
 		return OutputWalkTreeError(STRREF_CSCRIPTCOMPILER_ERROR_UNKNOWN_STATE_IN_COMPILER,pNode);
 	}
 
-	if (pNode->nOperation == CSCRIPTCOMPILER_OPERATION_WHILE_BLOCK)
+	if (pNode->nOperation == CSCRIPTCOMPILER_OPERATION_WHILE_BLOCK && IsRotatedLoop(pNode))
+	{
+		// Set the label for continue jumps.
+		pNode->nIntegerData3 = m_nLoopIdentifier;
+		pNode->nIntegerData4 = m_nLoopStackDepth;
+		m_nLoopIdentifier = m_nOutputCodeLength;
+		m_nLoopStackDepth = m_nStackCurrentDepth;
+
+		if (m_nGenerateDebuggerOutput != 0)
+		{
+			StartLineNumberAtBinaryInstruction(pNode->m_nFileReference,pNode->nLine,m_nOutputCodeLength);
+		}
+
+		// The loop is entered by jumping over the body to the condition,
+		// which sits at the bottom.  The jump is patched in the InVisit
+		// call, once the condition's location is known.
+		pNode->nIntegerData2 = m_nOutputCodeLength;
+		EmitInstruction(CVIRTUALMACHINE_OPCODE_JMP, 0, 4);
+
+		if (m_nGenerateDebuggerOutput != 0)
+		{
+			EndLineNumberAtBinaryInstruction(pNode->m_nFileReference,pNode->nLine,m_nOutputCodeLength);
+		}
+
+		// The condition jumps back here while it holds.
+		pNode->nIntegerData = m_nOutputCodeLength;
+	}
+	else if (pNode->nOperation == CSCRIPTCOMPILER_OPERATION_WHILE_BLOCK)
 	{
 
 		// Set the label for continue jumps.
@@ -2141,13 +3123,9 @@ int32_t CScriptCompiler::InVisitGenerateCode(CScriptParseTreeNode *pNode)
 			return OutputWalkTreeError(STRREF_CSCRIPTCOMPILER_ERROR_UNKNOWN_STATE_IN_COMPILER,pNode);
 		}
 
-		int32_t count;
-		for (count = 0; count < m_nMaxStructures; count++)
+		if (GetStructure(*(pNode->pLeft->m_psStringData)) >= 0)
 		{
-			if (*(pNode->pLeft->m_psStringData) == m_pcStructList[count].m_psName)
-			{
-				return OutputWalkTreeError(STRREF_CSCRIPTCOMPILER_ERROR_STRUCTURE_REDEFINED,pNode);
-			}
+			return OutputWalkTreeError(STRREF_CSCRIPTCOMPILER_ERROR_STRUCTURE_REDEFINED,pNode);
 		}
 
 		m_pcStructList[m_nMaxStructures].m_psName = *(pNode->pLeft->m_psStringData);
@@ -2232,6 +3210,20 @@ int32_t CScriptCompiler::InVisitGenerateCode(CScriptParseTreeNode *pNode)
 		return GenerateCodeForSwitchLabels(pNode);
 	}
 
+	if (pNode->nOperation == CSCRIPTCOMPILER_OPERATION_WHILE_BLOCK && IsRotatedLoop(pNode))
+	{
+		// The body (and the continue label) has been generated; the
+		// condition starts here, so the entry jump can be resolved.
+		WriteByteSwap32(&m_pchOutputCode[pNode->nIntegerData2 + CVIRTUALMACHINE_EXTRA_DATA_LOCATION],
+		                m_nOutputCodeLength - pNode->nIntegerData2);
+
+		if (m_nGenerateDebuggerOutput != 0)
+		{
+			StartLineNumberAtBinaryInstruction(pNode->m_nFileReference,pNode->nLine,m_nOutputCodeLength);
+		}
+		return 0;
+	}
+
 	if (pNode->nOperation == CSCRIPTCOMPILER_OPERATION_WHILE_BLOCK)
 	{
 		//
@@ -2584,9 +3576,9 @@ int32_t CScriptCompiler::PostVisitGenerateCode(CScriptParseTreeNode *pNode)
 				{
 					if (pNode->m_psTypeName != NULL)
 					{
-						delete pNode->m_psTypeName;
+						DeleteParseTreeString(pNode->m_psTypeName);
 					}
-					(pNode->m_psTypeName) = new CExoString(pNode->pLeft->m_psTypeName->CStr());
+					(pNode->m_psTypeName) = NewParseTreeString(pNode->pLeft->m_psTypeName->CStr());
 				}
 
 				// CODE GENERATION
@@ -2745,16 +3737,7 @@ int32_t CScriptCompiler::PostVisitGenerateCode(CScriptParseTreeNode *pNode)
 				{
 					m_pcVarStackList[m_nOccupiedVariables].m_sVarStructureName = m_sVarStackVariableTypeName;
 
-					int32_t count;
-					BOOL bFoundStructure = FALSE;
-					for (count = 0; count < m_nMaxStructures; count++)
-					{
-						if (m_sVarStackVariableTypeName == m_pcStructList[count].m_psName)
-						{
-							bFoundStructure = TRUE;
-						}
-					}
-					if (bFoundStructure == FALSE)
+					if (GetStructure(m_sVarStackVariableTypeName) < 0)
 					{
 						return OutputWalkTreeError(STRREF_CSCRIPTCOMPILER_ERROR_UNDEFINED_STRUCTURE,pNode);
 					}
@@ -2843,19 +3826,19 @@ int32_t CScriptCompiler::PostVisitGenerateCode(CScriptParseTreeNode *pNode)
 				if (m_pcVarStackList[nCount].m_psVarName == *(pNode->m_psStringData))
 				{
 					// Now, we can get rid of the data.
-					delete (pNode->m_psStringData);
+					DeleteParseTreeString(pNode->m_psStringData);
 					pNode->m_psStringData = NULL;
 
 					pNode->nType = m_pcVarStackList[nCount].m_nVarType;
 
 					if (pNode->m_psTypeName != NULL)
 					{
-						delete pNode->m_psTypeName;
+						DeleteParseTreeString(pNode->m_psTypeName);
 					}
 
 					if (pNode->nType == CSCRIPTCOMPILER_TOKEN_KEYWORD_STRUCT)
 					{
-						pNode->m_psTypeName = new CExoString(m_pcVarStackList[nCount].m_sVarStructureName.CStr());
+						pNode->m_psTypeName = NewParseTreeString(m_pcVarStackList[nCount].m_sVarStructureName.CStr());
 					}
 					else
 					{
@@ -3054,7 +4037,7 @@ int32_t CScriptCompiler::PostVisitGenerateCode(CScriptParseTreeNode *pNode)
 		}
 
 		pNode->nType = CSCRIPTCOMPILER_TOKEN_KEYWORD_STRUCT;
-		pNode->m_psTypeName = new CExoString("vector");
+		pNode->m_psTypeName = NewParseTreeString("vector");
 
 		return 0;
 	}
@@ -3174,10 +4157,10 @@ int32_t CScriptCompiler::PostVisitGenerateCode(CScriptParseTreeNode *pNode)
 			{
 				if (pNode->m_psTypeName != NULL)
 				{
-					delete pNode->m_psTypeName;
+					DeleteParseTreeString(pNode->m_psTypeName);
 				}
 
-				(pNode->m_psTypeName) = new CExoString(pNode->pRight->m_psTypeName->CStr());
+				(pNode->m_psTypeName) = NewParseTreeString(pNode->pRight->m_psTypeName->CStr());
 			}
 		}
 		return 0;
@@ -3344,7 +4327,7 @@ int32_t CScriptCompiler::PostVisitGenerateCode(CScriptParseTreeNode *pNode)
 				{
 					if (pNode->m_psTypeName != NULL)
 					{
-						delete pNode->m_psTypeName;
+						DeleteParseTreeString(pNode->m_psTypeName);
 					}
 					pNode->m_psTypeName = NULL;
 
@@ -3372,7 +4355,7 @@ int32_t CScriptCompiler::PostVisitGenerateCode(CScriptParseTreeNode *pNode)
 					else if (m_pcIdentifierList[nCount].m_nReturnType == CSCRIPTCOMPILER_TOKEN_STRUCTURE_IDENTIFIER)
 					{
 						pNode->nType = CSCRIPTCOMPILER_TOKEN_KEYWORD_STRUCT;
-						pNode->m_psTypeName = new CExoString(m_pcIdentifierList[nCount].m_psStructureReturnName.CStr());
+						pNode->m_psTypeName = NewParseTreeString(m_pcIdentifierList[nCount].m_psStructureReturnName.CStr());
 					}
 
 					if (pNode->nIntegerData == 0)
@@ -3509,10 +4492,10 @@ int32_t CScriptCompiler::PostVisitGenerateCode(CScriptParseTreeNode *pNode)
 			{
 				if (pNode->m_psTypeName != NULL)
 				{
-					delete pNode->m_psTypeName;
+					DeleteParseTreeString(pNode->m_psTypeName);
 				}
 
-				(pNode->m_psTypeName) = new CExoString(pNode->pLeft->m_psTypeName->CStr());
+				(pNode->m_psTypeName) = NewParseTreeString(pNode->pLeft->m_psTypeName->CStr());
 			}
 		}
 
@@ -3601,6 +4584,45 @@ int32_t CScriptCompiler::PostVisitGenerateCode(CScriptParseTreeNode *pNode)
 		return 0;
 	}
 
+	if (pNode->nOperation == CSCRIPTCOMPILER_OPERATION_WHILE_BLOCK && IsRotatedLoop(pNode))
+	{
+		// The condition has been generated below the body: jump back to
+		// the body while it holds, and fall through to the break label.
+		if (m_pchStackTypes[m_nStackCurrentDepth-1] != CVIRTUALMACHINE_AUXCODE_TYPE_INTEGER)
+		{
+			return OutputWalkTreeError(STRREF_CSCRIPTCOMPILER_ERROR_INTEGER_NOT_AT_TOP_OF_STACK,pNode);
+		}
+		--m_nStackCurrentDepth;
+
+		int32_t nJnzLocation = m_nOutputCodeLength;
+		char *pJnzOffset = EmitInstruction(CVIRTUALMACHINE_OPCODE_JNZ, 0, 4);
+		WriteByteSwap32(pJnzOffset, pNode->nIntegerData - nJnzLocation);
+
+		if (m_nGenerateDebuggerOutput != 0)
+		{
+			EndLineNumberAtBinaryInstruction(pNode->m_nFileReference,pNode->nLine,m_nOutputCodeLength);
+		}
+
+		AddSymbolToLabelList(m_nOutputCodeLength, CSCRIPTCOMPILER_SYMBOL_TABLE_ENTRY_TYPE_BREAK,m_nLoopIdentifier,0);
+
+		pNode->nType = pNode->pLeft->nType;
+		if (pNode->nType == CSCRIPTCOMPILER_TOKEN_KEYWORD_STRUCT)
+		{
+			if (pNode->m_psTypeName != NULL)
+			{
+				DeleteParseTreeString(pNode->m_psTypeName);
+			}
+
+			pNode->m_psTypeName = NewParseTreeString(pNode->pLeft->m_psTypeName->CStr());
+		}
+
+		// Reset the loop identifier.
+		m_nLoopIdentifier = pNode->nIntegerData3;
+		m_nLoopStackDepth = pNode->nIntegerData4;
+
+		return 0;
+	}
+
 	if (pNode->nOperation == CSCRIPTCOMPILER_OPERATION_WHILE_BLOCK)
 	{
 
@@ -3624,41 +4646,80 @@ int32_t CScriptCompiler::PostVisitGenerateCode(CScriptParseTreeNode *pNode)
 		// the InVisit() [code located at pNode->nIntegerdata2].
 		// This is an awfully good thing to do.
 
-		nJmpLength = m_nOutputCodeLength - pNode->nIntegerData2;
-		m_pchOutputCode[pNode->nIntegerData2 + CVIRTUALMACHINE_EXTRA_DATA_LOCATION]     = (char) (((nJmpLength) >> 24) & 0x0ff);
-		m_pchOutputCode[pNode->nIntegerData2 + CVIRTUALMACHINE_EXTRA_DATA_LOCATION + 1] = (char) (((nJmpLength) >> 16) & 0x0ff);
-		m_pchOutputCode[pNode->nIntegerData2 + CVIRTUALMACHINE_EXTRA_DATA_LOCATION + 2] = (char) (((nJmpLength) >> 8 ) & 0x0ff);
-		m_pchOutputCode[pNode->nIntegerData2 + CVIRTUALMACHINE_EXTRA_DATA_LOCATION + 3] = (char) (((nJmpLength)      ) & 0x0ff);
+		nJmpLength = m_nOutputCodeLength - pNode->nIntegerData2;
+		m_pchOutputCode[pNode->nIntegerData2 + CVIRTUALMACHINE_EXTRA_DATA_LOCATION]     = (char) (((nJmpLength) >> 24) & 0x0ff);
+		m_pchOutputCode[pNode->nIntegerData2 + CVIRTUALMACHINE_EXTRA_DATA_LOCATION + 1] = (char) (((nJmpLength) >> 16) & 0x0ff);
+		m_pchOutputCode[pNode->nIntegerData2 + CVIRTUALMACHINE_EXTRA_DATA_LOCATION + 2] = (char) (((nJmpLength) >> 8 ) & 0x0ff);
+		m_pchOutputCode[pNode->nIntegerData2 + CVIRTUALMACHINE_EXTRA_DATA_LOCATION + 3] = (char) (((nJmpLength)      ) & 0x0ff);
+
+		// Generate a label for the end of the function (used by the break keyword)
+		/* CExoString sSymbolName;
+		sSymbolName.Format("_BR_%08x",m_nLoopIdentifier); */
+		AddSymbolToLabelList(m_nOutputCodeLength, CSCRIPTCOMPILER_SYMBOL_TABLE_ENTRY_TYPE_BREAK,m_nLoopIdentifier,0);
+
+
+		pNode->nType = pNode->pLeft->nType;
+		if (pNode->nType == CSCRIPTCOMPILER_TOKEN_KEYWORD_STRUCT)
+		{
+			if (pNode->m_psTypeName != NULL)
+			{
+				DeleteParseTreeString(pNode->m_psTypeName);
+			}
+
+			pNode->m_psTypeName = NewParseTreeString(pNode->pLeft->m_psTypeName->CStr());
+		}
+
+		// Reset the loop identifier.
+		m_nLoopIdentifier = pNode->nIntegerData3;
+		m_nLoopStackDepth = pNode->nIntegerData4;
+
+		return 0;
+
+	}
+
+	if (pNode->nOperation == CSCRIPTCOMPILER_OPERATION_WHILE_CHOICE)
+	{
+		// FOR TESTING PURPOSES
+		// We do nothing.  Why?  It's all done by WHILE_BLOCK
+		return 0;
+	}
+
+	if (pNode->nOperation == CSCRIPTCOMPILER_OPERATION_DOWHILE_BLOCK && IsRotatedLoop(pNode))
+	{
+		// CODE GENERATION
+		// A single JNZ back to _DW1_ does the work of the JZ/JMP pair below.
+
+		if (m_pchStackTypes[m_nStackCurrentDepth-1] != CVIRTUALMACHINE_AUXCODE_TYPE_INTEGER)
+		{
+			return OutputWalkTreeError(STRREF_CSCRIPTCOMPILER_ERROR_INTEGER_NOT_AT_TOP_OF_STACK,pNode);
+		}
+		--m_nStackCurrentDepth;
 
-		// Generate a label for the end of the function (used by the break keyword)
-		/* CExoString sSymbolName;
-		sSymbolName.Format("_BR_%08x",m_nLoopIdentifier); */
-		AddSymbolToLabelList(m_nOutputCodeLength, CSCRIPTCOMPILER_SYMBOL_TABLE_ENTRY_TYPE_BREAK,m_nLoopIdentifier,0);
+		int32_t nJnzLocation = m_nOutputCodeLength;
+		char *pJnzOffset = EmitInstruction(CVIRTUALMACHINE_OPCODE_JNZ, 0, 4);
+		WriteByteSwap32(pJnzOffset, pNode->nIntegerData - nJnzLocation);
 
+		AddSymbolToLabelList(m_nOutputCodeLength, CSCRIPTCOMPILER_SYMBOL_TABLE_ENTRY_TYPE_BREAK,m_nLoopIdentifier);
 
-		pNode->nType = pNode->pLeft->nType;
+		if (m_nGenerateDebuggerOutput != 0)
+		{
+			EndLineNumberAtBinaryInstruction(pNode->m_nFileReference,pNode->nLine,m_nOutputCodeLength);
+		}
+
+		pNode->nType = pNode->pRight->nType;
 		if (pNode->nType == CSCRIPTCOMPILER_TOKEN_KEYWORD_STRUCT)
 		{
 			if (pNode->m_psTypeName != NULL)
 			{
-				delete pNode->m_psTypeName;
+				DeleteParseTreeString(pNode->m_psTypeName);
 			}
 
-			pNode->m_psTypeName = new CExoString(pNode->pLeft->m_psTypeName->CStr());
+			pNode->m_psTypeName = NewParseTreeString(pNode->pRight->m_psTypeName->CStr());
 		}
 
 		// Reset the loop identifier.
 		m_nLoopIdentifier = pNode->nIntegerData3;
 		m_nLoopStackDepth = pNode->nIntegerData4;
-
-		return 0;
-
-	}
-
-	if (pNode->nOperation == CSCRIPTCOMPILER_OPERATION_WHILE_CHOICE)
-	{
-		// FOR TESTING PURPOSES
-		// We do nothing.  Why?  It's all done by WHILE_BLOCK
 		return 0;
 	}
 
@@ -3727,10 +4788,10 @@ int32_t CScriptCompiler::PostVisitGenerateCode(CScriptParseTreeNode *pNode)
 		{
 			if (pNode->m_psTypeName != NULL)
 			{
-				delete pNode->m_psTypeName;
+				DeleteParseTreeString(pNode->m_psTypeName);
 			}
 
-			pNode->m_psTypeName = new CExoString(pNode->pRight->m_psTypeName->CStr());
+			pNode->m_psTypeName = NewParseTreeString(pNode->pRight->m_psTypeName->CStr());
 		}
 
 		// Reset the loop identifier.
@@ -3799,10 +4860,10 @@ int32_t CScriptCompiler::PostVisitGenerateCode(CScriptParseTreeNode *pNode)
 		{
 			if (pNode->m_psTypeName != NULL)
 			{
-				delete pNode->m_psTypeName;
+				DeleteParseTreeString(pNode->m_psTypeName);
 			}
 
-			pNode->m_psTypeName = new CExoString(pNode->pLeft->m_psTypeName->CStr());
+			pNode->m_psTypeName = NewParseTreeString(pNode->pLeft->m_psTypeName->CStr());
 		}
 
 		return 0;
@@ -3817,10 +4878,10 @@ int32_t CScriptCompiler::PostVisitGenerateCode(CScriptParseTreeNode *pNode)
 		{
 			if (pNode->m_psTypeName != NULL)
 			{
-				delete pNode->m_psTypeName;
+				DeleteParseTreeString(pNode->m_psTypeName);
 			}
 
-			pNode->m_psTypeName = new CExoString(pNode->pRight->m_psTypeName->CStr());
+			pNode->m_psTypeName = NewParseTreeString(pNode->pRight->m_psTypeName->CStr());
 		}
 		return 0;
 	}
@@ -3869,10 +4930,10 @@ int32_t CScriptCompiler::PostVisitGenerateCode(CScriptParseTreeNode *pNode)
 		{
 			if (pNode->m_psTypeName != NULL)
 			{
-				delete pNode->m_psTypeName;
+				DeleteParseTreeString(pNode->m_psTypeName);
 			}
 
-			pNode->m_psTypeName = new CExoString(pNode->pLeft->m_psTypeName->CStr());
+			pNode->m_psTypeName = NewParseTreeString(pNode->pLeft->m_psTypeName->CStr());
 		}
 
 		// MGB - October 29, 2002 - END CHANGE
@@ -4473,9 +5534,9 @@ int32_t CScriptCompiler::PostVisitGenerateCode(CScriptParseTreeNode *pNode)
 					pNode->nType = CSCRIPTCOMPILER_TOKEN_KEYWORD_STRUCT;
 					if (pNode->m_psTypeName != NULL)
 					{
-						delete pNode->m_psTypeName;
+						DeleteParseTreeString(pNode->m_psTypeName);
 					}
-					pNode->m_psTypeName = new CExoString(pNode->pLeft->m_psTypeName->CStr());
+					pNode->m_psTypeName = NewParseTreeString(pNode->pLeft->m_psTypeName->CStr());
 					return 0;
 
 				}
@@ -4503,9 +5564,9 @@ int32_t CScriptCompiler::PostVisitGenerateCode(CScriptParseTreeNode *pNode)
 					pNode->nType = CSCRIPTCOMPILER_TOKEN_KEYWORD_STRUCT;
 					if (pNode->m_psTypeName != NULL)
 					{
-						delete pNode->m_psTypeName;
+						DeleteParseTreeString(pNode->m_psTypeName);
 					}
-					pNode->m_psTypeName = new CExoString(pNode->pLeft->m_psTypeName->CStr());
+					pNode->m_psTypeName = NewParseTreeString(pNode->pLeft->m_psTypeName->CStr());
 					return 0;
 				}
 			}
@@ -4534,9 +5595,9 @@ int32_t CScriptCompiler::PostVisitGenerateCode(CScriptParseTreeNode *pNode)
 					pNode->nType = CSCRIPTCOMPILER_TOKEN_KEYWORD_STRUCT;
 					if (pNode->m_psTypeName != NULL)
 					{
-						delete pNode->m_psTypeName;
+						DeleteParseTreeString(pNode->m_psTypeName);
 					}
-					pNode->m_psTypeName = new CExoString(pNode->pRight->m_psTypeName->CStr());
+					pNode->m_psTypeName = NewParseTreeString(pNode->pRight->m_psTypeName->CStr());
 					return 0;
 				}
 			}
@@ -4700,14 +5761,7 @@ int32_t CScriptCompiler::PostVisitGenerateCode(CScriptParseTreeNode *pNode)
 			}
 			else
 			{
-				int32_t count2;
-				for (count2 = 0; count2 < m_nMaxStructures; count2++)
-				{
-					if (m_pcStructFieldList[count].m_psStructureName == m_pcStructList[count2].m_psName)
-					{
-						nTotalSize += m_pcStructList[count2].m_nByteSize;
-					}
-				}
+				nTotalSize += GetStructureSize(m_pcStructFieldList[count].m_psStructureName);
 			}
 		}
 
@@ -4723,6 +5777,7 @@ int32_t CScriptCompiler::PostVisitGenerateCode(CScriptParseTreeNode *pNode)
 		m_nStructureDefinition = 0;
 
 		// Finally, add the structure definition to the ones that we can look at.
+		IndexStructure(m_nMaxStructures);
 		++m_nMaxStructures;
 
 		return 0;
@@ -4759,7 +5814,7 @@ int32_t CScriptCompiler::PostVisitGenerateCode(CScriptParseTreeNode *pNode)
 			pNode->nType = m_pcStructFieldList[nValue].m_pchType;
 			if (pNode->nType == CSCRIPTCOMPILER_TOKEN_KEYWORD_STRUCT)
 			{
-				pNode->m_psTypeName = new CExoString(m_pcStructFieldList[nValue].m_psStructureName.CStr());
+				pNode->m_psTypeName = NewParseTreeString(m_pcStructFieldList[nValue].m_psStructureName.CStr());
 			}
 
 			// Now, we update the pointer to the location of the variable.  In
@@ -5849,18 +6904,45 @@ int32_t CScriptCompiler::FoundReturnStatementOnAllBranches(CScriptParseTreeNode
 
 int32_t CScriptCompiler::GetStructureSize(const CExoString &sStructureName)
 {
+	int32_t nStructure = GetStructure(sStructureName);
+	return nStructure >= 0 ? m_pcStructList[nStructure].m_nByteSize : 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  CScriptCompiler::GetStructure()
+///////////////////////////////////////////////////////////////////////////////
+//  Description:  Returns the index of a completely defined structure in
+//                m_pcStructList, or -1.  Structure and field names are
+//                indexed once, when the definition is complete (see
+//                IndexStructure), so the code generator never compares
+//                names linearly on member accesses and size queries.
+///////////////////////////////////////////////////////////////////////////////
+
+int32_t CScriptCompiler::GetStructure(const CExoString &sStructureName)
+{
+	auto it = m_aStructureByName.find(sStructureName);
+	return it == m_aStructureByName.end() ? -1 : it->second;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  CScriptCompiler::IndexStructure()
+///////////////////////////////////////////////////////////////////////////////
+//  Description:  Adds a completely defined structure and its fields to the
+//                name lookups.  The first definition of a name wins, as it
+//                did with the linear searches.
+///////////////////////////////////////////////////////////////////////////////
+
+void CScriptCompiler::IndexStructure(int32_t nStructure)
+{
+	CScriptCompilerStructureEntry &cStructure = m_pcStructList[nStructure];
 
-	int32_t count;
+	m_aStructureByName.emplace(cStructure.m_psName, nStructure);
 
-	for (count = 0; count < m_nMaxStructures; count++)
+	cStructure.m_aFieldByName.clear();
+	for (int32_t count = cStructure.m_nFieldStart; count <= cStructure.m_nFieldEnd; count++)
 	{
-		if (sStructureName == m_pcStructList[count].m_psName)
-		{
-			return m_pcStructList[count].m_nByteSize;
-		}
+		cStructure.m_aFieldByName.emplace(m_pcStructFieldList[count].m_psVarName, count);
 	}
-
-	return 0;
 }
 
 
@@ -5929,24 +7011,15 @@ int32_t CScriptCompiler::GetIdentifierByName(const CExoString &sIdentifierName)
 int32_t CScriptCompiler::GetStructureField(const CExoString &sStructureName, const CExoString &sFieldName)
 {
 
-	int32_t count, count2;
-
-	for (count = 0; count < m_nMaxStructures; count++)
+	int32_t nStructure = GetStructure(sStructureName);
+	if (nStructure < 0)
 	{
-		if (sStructureName == m_pcStructList[count].m_psName)
-		{
-			for (count2 = m_pcStructList[count].m_nFieldStart; count2 <= m_pcStructList[count].m_nFieldEnd; count2++)
-			{
-				if (sFieldName == m_pcStructFieldList[count2].m_psVarName)
-				{
-					return count2;
-				}
-			}
-			return STRREF_CSCRIPTCOMPILER_ERROR_UNDEFINED_FIELD_IN_STRUCTURE;
-		}
+		return STRREF_CSCRIPTCOMPILER_ERROR_UNDEFINED_STRUCTURE;
 	}
 
-	return STRREF_CSCRIPTCOMPILER_ERROR_UNDEFINED_STRUCTURE;
+	const auto &aFields = m_pcStructList[nStructure].m_aFieldByName;
+	auto it = aFields.find(sFieldName);
+	return it == aFields.end() ? STRREF_CSCRIPTCOMPILER_ERROR_UNDEFINED_FIELD_IN_STRUCTURE : it->second;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -6025,65 +7098,63 @@ void CScriptCompiler::AddStructureToStack(const CExoString &sStructureName, BOOL
 {
 	int32_t count, count2;
 
-	for (count = 0; count < m_nMaxStructures; count++)
+	count = GetStructure(sStructureName);
+	if (count >= 0)
 	{
-		if (sStructureName == m_pcStructList[count].m_psName)
+		for (count2 = m_pcStructList[count].m_nFieldStart; count2 <= m_pcStructList[count].m_nFieldEnd; count2++)
 		{
-			for (count2 = m_pcStructList[count].m_nFieldStart; count2 <= m_pcStructList[count].m_nFieldEnd; count2++)
-			{
-				int32_t nFieldType = m_pcStructFieldList[count2].m_pchType;
-
-				if (nFieldType == CSCRIPTCOMPILER_TOKEN_KEYWORD_INT ||
-				        nFieldType == CSCRIPTCOMPILER_TOKEN_KEYWORD_FLOAT ||
-				        nFieldType == CSCRIPTCOMPILER_TOKEN_KEYWORD_STRING ||
-				        nFieldType == CSCRIPTCOMPILER_TOKEN_KEYWORD_OBJECT ||
-				        (nFieldType >= CSCRIPTCOMPILER_TOKEN_KEYWORD_ENGINE_STRUCTURE0 &&
-				         nFieldType <= CSCRIPTCOMPILER_TOKEN_KEYWORD_ENGINE_STRUCTURE9))
-				{
+			int32_t nFieldType = m_pcStructFieldList[count2].m_pchType;
 
-					int32_t nAuxCodeType = 0;
-
-					if (nFieldType == CSCRIPTCOMPILER_TOKEN_KEYWORD_INT)
-					{
-						nAuxCodeType = CVIRTUALMACHINE_AUXCODE_TYPE_INTEGER;
-					}
-					else if (nFieldType == CSCRIPTCOMPILER_TOKEN_KEYWORD_FLOAT)
-					{
-						nAuxCodeType = CVIRTUALMACHINE_AUXCODE_TYPE_FLOAT;
-					}
-					else if (nFieldType == CSCRIPTCOMPILER_TOKEN_KEYWORD_STRING)
-					{
-						nAuxCodeType = CVIRTUALMACHINE_AUXCODE_TYPE_STRING;
-					}
-					else if (nFieldType == CSCRIPTCOMPILER_TOKEN_KEYWORD_OBJECT)
-					{
-						nAuxCodeType = CVIRTUALMACHINE_AUXCODE_TYPE_OBJECT;
-					}
-					else if (nFieldType >= CSCRIPTCOMPILER_TOKEN_KEYWORD_ENGINE_STRUCTURE0 &&
-					         nFieldType <= CSCRIPTCOMPILER_TOKEN_KEYWORD_ENGINE_STRUCTURE9)
-					{
-						nAuxCodeType = CVIRTUALMACHINE_AUXCODE_TYPE_ENGST0 + (nFieldType - CSCRIPTCOMPILER_TOKEN_KEYWORD_ENGINE_STRUCTURE0);
-					}
+			if (nFieldType == CSCRIPTCOMPILER_TOKEN_KEYWORD_INT ||
+			        nFieldType == CSCRIPTCOMPILER_TOKEN_KEYWORD_FLOAT ||
+			        nFieldType == CSCRIPTCOMPILER_TOKEN_KEYWORD_STRING ||
+			        nFieldType == CSCRIPTCOMPILER_TOKEN_KEYWORD_OBJECT ||
+			        (nFieldType >= CSCRIPTCOMPILER_TOKEN_KEYWORD_ENGINE_STRUCTURE0 &&
+			         nFieldType <= CSCRIPTCOMPILER_TOKEN_KEYWORD_ENGINE_STRUCTURE9))
+			{
 
-					m_pchStackTypes[m_nStackCurrentDepth] = (char) nAuxCodeType;
-					++m_nStackCurrentDepth;
+				int32_t nAuxCodeType = 0;
 
-					// CODE GENERATION
-					if (bGenerateCode == TRUE)
-					{
-						m_pchOutputCode[m_nOutputCodeLength + CVIRTUALMACHINE_OPCODE_LOCATION] = CVIRTUALMACHINE_OPCODE_RUNSTACK_ADD;
-						m_pchOutputCode[m_nOutputCodeLength+CVIRTUALMACHINE_AUXCODE_LOCATION] = (char) nAuxCodeType;
-						m_nOutputCodeLength += CVIRTUALMACHINE_OPERATION_BASE_SIZE;
-						m_aOutputCodeInstructionBoundaries.push_back(m_nOutputCodeLength);
-					}
+				if (nFieldType == CSCRIPTCOMPILER_TOKEN_KEYWORD_INT)
+				{
+					nAuxCodeType = CVIRTUALMACHINE_AUXCODE_TYPE_INTEGER;
+				}
+				else if (nFieldType == CSCRIPTCOMPILER_TOKEN_KEYWORD_FLOAT)
+				{
+					nAuxCodeType = CVIRTUALMACHINE_AUXCODE_TYPE_FLOAT;
+				}
+				else if (nFieldType == CSCRIPTCOMPILER_TOKEN_KEYWORD_STRING)
+				{
+					nAuxCodeType = CVIRTUALMACHINE_AUXCODE_TYPE_STRING;
+				}
+				else if (nFieldType == CSCRIPTCOMPILER_TOKEN_KEYWORD_OBJECT)
+				{
+					nAuxCodeType = CVIRTUALMACHINE_AUXCODE_TYPE_OBJECT;
 				}
-				else if (nFieldType == CSCRIPTCOMPILER_TOKEN_KEYWORD_STRUCT)
+				else if (nFieldType >= CSCRIPTCOMPILER_TOKEN_KEYWORD_ENGINE_STRUCTURE0 &&
+				         nFieldType <= CSCRIPTCOMPILER_TOKEN_KEYWORD_ENGINE_STRUCTURE9)
 				{
-					// Function to recursively do all structures within the structure on the stack.
-					AddStructureToStack(m_pcStructFieldList[count2].m_psStructureName, bGenerateCode);
+					nAuxCodeType = CVIRTUALMACHINE_AUXCODE_TYPE_ENGST0 + (nFieldType - CSCRIPTCOMPILER_TOKEN_KEYWORD_ENGINE_STRUCTURE0);
 				}
 
+				m_pchStackTypes[m_nStackCurrentDepth] = (char) nAuxCodeType;
+				++m_nStackCurrentDepth;
+
+				// CODE GENERATION
+				if (bGenerateCode == TRUE)
+				{
+					m_pchOutputCode[m_nOutputCodeLength + CVIRTUALMACHINE_OPCODE_LOCATION] = CVIRTUALMACHINE_OPCODE_RUNSTACK_ADD;
+					m_pchOutputCode[m_nOutputCodeLength+CVIRTUALMACHINE_AUXCODE_LOCATION] = (char) nAuxCodeType;
+					m_nOutputCodeLength += CVIRTUALMACHINE_OPERATION_BASE_SIZE;
+					m_aOutputCodeInstructionBoundaries.push_back(m_nOutputCodeLength);
+				}
+			}
+			else if (nFieldType == CSCRIPTCOMPILER_TOKEN_KEYWORD_STRUCT)
+			{
+				// Function to recursively do all structures within the structure on the stack.
+				AddStructureToStack(m_pcStructFieldList[count2].m_psStructureName, bGenerateCode);
 			}
+
 		}
 	}
 }
@@ -6151,26 +7222,18 @@ int32_t CScriptCompiler::AddSymbolToLabelList(int32_t nLocationPointer, int32_t
 {
 	if (m_nSymbolLabelListSize == m_nSymbolLabelList)
 	{
-		CScriptCompilerSymbolTableEntry *m_pNewLabelList;
-
-		// Create a new list.
-
-		m_nSymbolLabelListSize += 8192;
-		m_pNewLabelList = new CScriptCompilerSymbolTableEntry[m_nSymbolLabelListSize];
+		// Double the list.  The old one stays in the arena until the next
+		// compile, so there is nothing to free.
+		int32_t nNewSize = (m_nSymbolLabelListSize == 0) ? 1024 : m_nSymbolLabelListSize * 2;
+		CScriptCompilerSymbolTableEntry *pNewLabelList = static_cast<CScriptCompilerSymbolTableEntry *>(
+		        m_cCompileArena.Allocate(sizeof(CScriptCompilerSymbolTableEntry) * nNewSize, alignof(CScriptCompilerSymbolTableEntry)));
 
 		if (m_pSymbolLabelList != NULL)
 		{
-			for (int32_t count = 0; count < m_nSymbolLabelList; ++count)
-			{
-				m_pNewLabelList[count].m_nSymbolType       = m_pSymbolLabelList[count].m_nSymbolType;
-				m_pNewLabelList[count].m_nSymbolSubType1   = m_pSymbolLabelList[count].m_nSymbolSubType1;
-				m_pNewLabelList[count].m_nSymbolSubType2   = m_pSymbolLabelList[count].m_nSymbolSubType2;
-				m_pNewLabelList[count].m_nLocationPointer  = m_pSymbolLabelList[count].m_nLocationPointer;
-				m_pNewLabelList[count].m_nNextEntryPointer = m_pSymbolLabelList[count].m_nNextEntryPointer;
-			}
-			delete[] m_pSymbolLabelList;
+			memcpy(pNewLabelList, m_pSymbolLabelList, sizeof(CScriptCompilerSymbolTableEntry) * m_nSymbolLabelList);
 		}
-		m_pSymbolLabelList = m_pNewLabelList;
+		m_pSymbolLabelList = pNewLabelList;
+		m_nSymbolLabelListSize = nNewSize;
 	}
 
 	m_pSymbolLabelList[m_nSymbolLabelList].m_nSymbolType      = nSymbolType;
@@ -6215,26 +7278,18 @@ int32_t CScriptCompiler::AddSymbolToQueryList(int32_t nLocationPointer, int32_t
 {
 	if (m_nSymbolQueryListSize == m_nSymbolQueryList)
 	{
-		CScriptCompilerSymbolTableEntry *m_pNewQueryList;
-
-		// Create a new list.
-
-		m_nSymbolQueryListSize += 8192;
-		m_pNewQueryList = new CScriptCompilerSymbolTableEntry[m_nSymbolQueryListSize];
+		// Double the list.  The old one stays in the arena until the next
+		// compile, so there is nothing to free.
+		int32_t nNewSize = (m_nSymbolQueryListSize == 0) ? 1024 : m_nSymbolQueryListSize * 2;
+		CScriptCompilerSymbolTableEntry *pNewQueryList = static_cast<CScriptCompilerSymbolTableEntry *>(
+		        m_cCompileArena.Allocate(sizeof(CScriptCompilerSymbolTableEntry) * nNewSize, alignof(CScriptCompilerSymbolTableEntry)));
 
 		if (m_pSymbolQueryList != NULL)
 		{
-			for (int32_t count = 0; count < m_nSymbolQueryList; ++count)
-			{
-				m_pNewQueryList[count].m_nSymbolType      = m_pSymbolQueryList[count].m_nSymbolType;
-				m_pNewQueryList[count].m_nSymbolSubType1  = m_pSymbolQueryList[count].m_nSymbolSubType1;
-				m_pNewQueryList[count].m_nSymbolSubType2  = m_pSymbolQueryList[count].m_nSymbolSubType2;
-				m_pNewQueryList[count].m_nLocationPointer = m_pSymbolQueryList[count].m_nLocationPointer;
-				m_pNewQueryList[count].m_nNextEntryPointer = m_pSymbolQueryList[count].m_nNextEntryPointer;
-			}
-			delete[] m_pSymbolQueryList;
+			memcpy(pNewQueryList, m_pSymbolQueryList, sizeof(CScriptCompilerSymbolTableEntry) * m_nSymbolQueryList);
 		}
-		m_pSymbolQueryList = m_pNewQueryList;
+		m_pSymbolQueryList = pNewQueryList;
+		m_nSymbolQueryListSize = nNewSize;
 	}
 
 	m_pSymbolQueryList[m_nSymbolQueryList].m_nSymbolType      = nSymbolType;
@@ -6244,6 +7299,22 @@ int32_t CScriptCompiler::AddSymbolToQueryList(int32_t nLocationPointer, int32_t
 	// m_nNextEntryPointer is not valid for query list.
 	++m_nSymbolQueryList;
 
+	// Function calls also go into the call graph, for dead function removal.
+	if (nSymbolType == CSCRIPTCOMPILER_SYMBOL_TABLE_ENTRY_TYPE_FUNCTION_ENTRY)
+	{
+		int32_t nCallee = -3;
+		if (nSymbolSubType1 != 0 && nSymbolSubType2 == 0)
+		{
+			nCallee = nSymbolSubType1;
+		}
+		else if (nSymbolSubType1 == 0 && nSymbolSubType2 != 0)
+		{
+			nCallee = (nSymbolSubType2 == 2) ? -2 : -1;
+		}
+		m_aCallGraphCallers.push_back(m_nCallGraphCaller);
+		m_aCallGraphCallees.push_back(nCallee);
+	}
+
 	return 0;
 }
 
@@ -6255,53 +7326,86 @@ int32_t CScriptCompiler::AddSymbolToQueryList(int32_t nLocationPointer, int32_t
 //  Created On: 07/22/99
 //  Description:  This routine will walk the compile tree, generating a postfix
 //                listing of the nodes (if necessary).
+//
+//                The walk uses an explicit stack rather than recursion, since
+//                long expression chains and else-if ladders nest as deep as
+//                they are long.  Each node is constant folded once, before
+//                its pre-visit; folding it again after its children have been
+//                walked could never change the result.
+//
+//                A rotated while loop has its children walked right to left,
+//                so that the body is generated before the condition.
 ///////////////////////////////////////////////////////////////////////////////
 
 int32_t CScriptCompiler::WalkParseTree(CScriptParseTreeNode *pNode)
 {
-	if (pNode != NULL)
+	// A Null pointer is not an error.
+	if (pNode == NULL)
 	{
-		//INT bPrinted = 0;
+		return 0;
+	}
 
+	// The next visit to make on each node of the stack.
+	enum { WALK_PRE_VISIT, WALK_IN_VISIT, WALK_POST_VISIT };
+	std::vector<CScriptParseTreeNode *> pWalkNodes;
+	std::vector<int32_t> nWalkVisits;
 
-		int nReturnCode;
+	pWalkNodes.push_back(pNode);
+	nWalkVisits.push_back(WALK_PRE_VISIT);
 
-		ConstantFoldNode(pNode);
-		nReturnCode = PreVisitGenerateCode(pNode);
+	while (!pWalkNodes.empty())
+	{
+		CScriptParseTreeNode *pCurrent = pWalkNodes.back();
+		CScriptParseTreeNode *pChild = NULL;
+		BOOL bFinished = FALSE;
+		int nReturnCode;
+		BOOL bBodyFirst = (pCurrent->nOperation == CSCRIPTCOMPILER_OPERATION_WHILE_BLOCK && IsRotatedLoop(pCurrent));
 
-		if (nReturnCode == 0)
+		if (nWalkVisits.back() == WALK_PRE_VISIT)
 		{
-			nReturnCode = WalkParseTree(pNode->pLeft);
+			ConstantFoldNode(pCurrent);
+			nReturnCode = PreVisitGenerateCode(pCurrent);
+			nWalkVisits.back() = WALK_IN_VISIT;
+			pChild = bBodyFirst ? pCurrent->pRight : pCurrent->pLeft;
 		}
-
-		if (nReturnCode == 0)
+		else if (nWalkVisits.back() == WALK_IN_VISIT)
 		{
-			ConstantFoldNode(pNode);
-			nReturnCode = InVisitGenerateCode(pNode);
+			nReturnCode = InVisitGenerateCode(pCurrent);
+			nWalkVisits.back() = WALK_POST_VISIT;
+			pChild = bBodyFirst ? pCurrent->pLeft : pCurrent->pRight;
 		}
-
-		if (nReturnCode == 0)
+		else
 		{
-			nReturnCode = WalkParseTree(pNode->pRight);
+			nReturnCode = PostVisitGenerateCode(pCurrent);
+			bFinished = TRUE;
 		}
 
-		if (nReturnCode == 0)
+		if (nReturnCode < 0)
 		{
-			ConstantFoldNode(pNode);
-			nReturnCode = PostVisitGenerateCode(pNode);
+			return nReturnCode;
 		}
 
-		if (nReturnCode > 0)
+		// A positive return code skips the rest of this node, but still
+		// counts as a success.
+		if (nReturnCode == 0 && bFinished == FALSE)
 		{
-			nReturnCode = 0;
+			if (pChild != NULL)
+			{
+				pWalkNodes.push_back(pChild);
+				nWalkVisits.push_back(WALK_PRE_VISIT);
+			}
+			continue;
 		}
 
+		pWalkNodes.pop_back();
+		nWalkVisits.pop_back();
+
 		// Oh, dear.  If there is not enough room, we should probably grow the
 		// output buffer by a bit!
 		// [36628] We make this check AFTER the data has been written without
 		// boundary checks. 200 bytes was not enough to protect from buffer
 		// overflows, raising to 16K. -virusman 2018/04/13
-		if (nReturnCode == 0 && m_nOutputCodeLength >= m_nOutputCodeSize - 16384)
+		if (m_nOutputCodeLength >= m_nOutputCodeSize - 16384)
 		{
 			m_nOutputCodeSize += CSCRIPTCOMPILER_MAX_CODE_SIZE;
 			char *pNewArray = new char[m_nOutputCodeSize];
@@ -6310,14 +7414,34 @@ int32_t CScriptCompiler::WalkParseTree(CScriptParseTreeNode *pNode)
 			m_pchOutputCode = pNewArray;
 			// return OutputWalkTreeError(STRREF_CSCRIPTCOMPILER_ERROR_SCRIPT_TOO_LARGE,pNode);
 		}
-
-		return nReturnCode;
 	}
 
-	// A Null pointer is not an error.
 	return 0;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+//  CScriptCompiler::IsRotatedLoop()
+///////////////////////////////////////////////////////////////////////////////
+//  Description:  Whether a loop node is generated with its condition at the
+//                bottom (CSCRIPTCOMPILER_OPTIMIZE_ROTATE_LOOPS).  A while
+//                loop (which for loops are made of) runs its body, then its
+//                condition and a JNZ back to the body, after one entry jump
+//                to the condition.  A do/while loop already has the
+//                condition at the bottom, and only loses the JMP after its
+//                JZ.
+///////////////////////////////////////////////////////////////////////////////
+
+BOOL CScriptCompiler::IsRotatedLoop(CScriptParseTreeNode *pNode)
+{
+	if (!(m_nOptimizationFlags & CSCRIPTCOMPILER_OPTIMIZE_ROTATE_LOOPS))
+	{
+		return FALSE;
+	}
+
+	return pNode->nOperation == CSCRIPTCOMPILER_OPERATION_WHILE_BLOCK ||
+	       pNode->nOperation == CSCRIPTCOMPILER_OPERATION_DOWHILE_BLOCK;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 //  CScriptCompiler::StartLineNumberAtBinaryInstruction()
 ///////////////////////////////////////////////////////////////////////////////
@@ -6372,26 +7496,14 @@ void CScriptCompiler::EndLineNumberAtBinaryInstruction(int32_t nFileReference, i
 	// We're at the last reference for a line, so we can write the information
 	// into the table.
 
-	// Fetch the file name reference.
-	CExoString *psCurrentLineNumberFileName = m_ppsParseTreeFileNames[m_nCurrentLineNumberFileReference];
-
-	int32_t nFileNameReference = -1;
-	for (int32_t nCount=0; nFileNameReference == -1 && nCount < m_nTableFileNames; ++nCount)
-	{
-		if (strcmp(m_psTableFileNames[nCount].CStr(),psCurrentLineNumberFileName->CStr()) == 0)
-		{
-			nFileNameReference = nCount;
-		}
-	}
+	// Fetch the file name reference, adding the file to the table on its first line.
+	int32_t nFileNameReference = m_pnTableFileNameReference[m_nCurrentLineNumberFileReference];
 
 	if (nFileNameReference == -1)
 	{
-		if (m_nTableFileNames >= CSCRIPTCOMPILER_MAX_TABLE_FILENAMES)
-		{
-			return;
-		}
-		m_psTableFileNames[m_nTableFileNames] = *psCurrentLineNumberFileName;
+		m_psTableFileNames.push_back(*(m_ppsParseTreeFileNames[m_nCurrentLineNumberFileReference]));
 		nFileNameReference = m_nTableFileNames;
+		m_pnTableFileNameReference[m_nCurrentLineNumberFileReference] = nFileNameReference;
 		++m_nTableFileNames;
 	}
 
@@ -6424,6 +7536,78 @@ void CScriptCompiler::EndLineNumberAtBinaryInstruction(int32_t nFileReference, i
 
 }
 
+///////////////////////////////////////////////////////////////////////////////
+//  CScriptCompiler::GetSymbolTableName()
+///////////////////////////////////////////////////////////////////////////////
+//  Description:  Returns the index of a variable or structure name in the
+//                symbol table name list, adding it if it isn't there yet.
+//                Every entry of the same name shares the one string.
+///////////////////////////////////////////////////////////////////////////////
+
+int32_t CScriptCompiler::GetSymbolTableName(const CExoString &sName)
+{
+	auto it = m_aSymbolTableNameByName.find(sName);
+	if (it != m_aSymbolTableNameByName.end())
+	{
+		return it->second;
+	}
+
+	int32_t nNewName = (int32_t) m_psSymbolTableNames.size();
+	m_psSymbolTableNames.push_back(sName);
+	m_aSymbolTableNameByName.emplace(sName, nNewName);
+	return nNewName;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  CScriptCompiler::AddSymbolTableVarEntry()
+///////////////////////////////////////////////////////////////////////////////
+//  Description:  Appends a symbol table entry for an occupied variable at the
+//                given stack location, with no begin or end set.  Returns
+//                the index of the new entry.
+///////////////////////////////////////////////////////////////////////////////
+
+int32_t CScriptCompiler::AddSymbolTableVarEntry(int32_t nOccupiedVariables, int32_t nStackLoc)
+{
+	if (m_pnSymbolTableVarType.size() == m_nSymbolTableVariables)
+	{
+		int32_t nSize = m_pnSymbolTableVarType.size() * 2;
+		if (nSize <= 16)
+		{
+			nSize = 16;
+		}
+
+		m_pnSymbolTableVarType.resize(nSize);
+		m_pnSymbolTableVarName.resize(nSize);
+		m_pnSymbolTableVarStructureName.resize(nSize);
+		m_pnSymbolTableVarStackLoc.resize(nSize);
+		m_pnSymbolTableVarBegin.resize(nSize);
+		m_pnSymbolTableVarEnd.resize(nSize);
+		m_pnSymbolTableBinaryFinal.resize(nSize);
+		m_pnSymbolTableBinarySortedOrder.resize(nSize);
+	}
+
+	int32_t nEntry = m_nSymbolTableVariables;
+
+	m_pnSymbolTableVarType[nEntry] = m_pcVarStackList[nOccupiedVariables].m_nVarType;
+	m_pnSymbolTableVarName[nEntry] = GetSymbolTableName(m_pcVarStackList[nOccupiedVariables].m_psVarName);
+	if (m_pcVarStackList[nOccupiedVariables].m_nVarType == CSCRIPTCOMPILER_TOKEN_KEYWORD_STRUCT)
+	{
+		m_pnSymbolTableVarStructureName[nEntry] = GetSymbolTableName(m_pcVarStackList[nOccupiedVariables].m_sVarStructureName);
+	}
+	else
+	{
+		m_pnSymbolTableVarStructureName[nEntry] = -1;
+	}
+	m_pnSymbolTableVarStackLoc[nEntry]       = nStackLoc;
+	m_pnSymbolTableVarBegin[nEntry]          = -1;
+	m_pnSymbolTableVarEnd[nEntry]            = -1;
+	m_pnSymbolTableBinaryFinal[nEntry]       = FALSE;
+	m_pnSymbolTableBinarySortedOrder[nEntry] = -1;
+	m_nSymbolTableVariables                 += 1;
+
+	return nEntry;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 //  CScriptCompiler::AddToSymbolTableVarStack()
 ///////////////////////////////////////////////////////////////////////////////
@@ -6437,36 +7621,12 @@ void CScriptCompiler::AddToSymbolTableVarStack(int32_t nOccupiedVariables, int32
 {
 	if (m_nGenerateDebuggerOutput != 0)
 	{
-		if (m_pnSymbolTableVarType.size() == m_nSymbolTableVariables)
-		{
-			int32_t nSize = m_pnSymbolTableVarType.size() * 2;
-			if (nSize <= 16)
-			{
-				nSize = 16;
-			}
-
-			m_pnSymbolTableVarType.resize(nSize);
-			m_psSymbolTableVarName.resize(nSize);
-			m_psSymbolTableVarStructureName.resize(nSize);
-			m_pnSymbolTableVarStackLoc.resize(nSize);
-			m_pnSymbolTableVarBegin.resize(nSize);
-			m_pnSymbolTableVarEnd.resize(nSize);
-			m_pnSymbolTableBinaryFinal.resize(nSize);
-			m_pnSymbolTableBinarySortedOrder.resize(nSize);
-		}
+		int32_t nStackLoc = nStackCurrentDepth * 4 - nGlobalVariableSize;
+		int32_t nEntry = AddSymbolTableVarEntry(nOccupiedVariables, nStackLoc);
+		m_pnSymbolTableVarBegin[nEntry] = m_nOutputCodeLength;
 
-		m_pnSymbolTableVarType[m_nSymbolTableVariables] = m_pcVarStackList[nOccupiedVariables].m_nVarType;
-		m_psSymbolTableVarName[m_nSymbolTableVariables] = m_pcVarStackList[nOccupiedVariables].m_psVarName;
-		if (m_pcVarStackList[nOccupiedVariables].m_nVarType == CSCRIPTCOMPILER_TOKEN_KEYWORD_STRUCT)
-		{
-			m_psSymbolTableVarStructureName[m_nSymbolTableVariables] = (m_pcVarStackList[nOccupiedVariables].m_sVarStructureName);
-		}
-		m_pnSymbolTableVarStackLoc[m_nSymbolTableVariables]       = nStackCurrentDepth * 4 - nGlobalVariableSize;
-		m_pnSymbolTableVarBegin[m_nSymbolTableVariables]          = m_nOutputCodeLength;
-		m_pnSymbolTableVarEnd[m_nSymbolTableVariables]            = -1;
-		m_pnSymbolTableBinaryFinal[m_nSymbolTableVariables]       = FALSE;
-		m_pnSymbolTableBinarySortedOrder[m_nSymbolTableVariables] = -1;
-		m_nSymbolTableVariables                                  += 1;
+		// The entry stays open until the variable leaves scope.
+		m_aSymbolTableOpenVarsByStackLoc[nStackLoc].push_back(nEntry);
 	}
 }
 
@@ -6483,40 +7643,36 @@ void CScriptCompiler::RemoveFromSymbolTableVarStack(int32_t nOccupiedVariables,
 {
 	if (m_nGenerateDebuggerOutput != 0)
 	{
+		int32_t nStackLoc = nStackCurrentDepth * 4 - nGlobalVariableSize;
 
-		int32_t nVarCount = m_nSymbolTableVariables - 1;
-		while (nVarCount >= 0)
+		// Only the open entries at this stack location can match, and the
+		// most recently added one wins.  Normally that is the last one, so
+		// this doesn't have to walk the whole symbol table any more.
+		auto itOpen = m_aSymbolTableOpenVarsByStackLoc.find(nStackLoc);
+		if (itOpen != m_aSymbolTableOpenVarsByStackLoc.end())
 		{
-			BOOL bMatch = TRUE;
-			if (m_pnSymbolTableVarType[nVarCount] != m_pcVarStackList[nOccupiedVariables].m_nVarType)
-			{
-				bMatch = FALSE;
-			}
-			if (bMatch == TRUE &&
-			        m_psSymbolTableVarName[nVarCount] != m_pcVarStackList[nOccupiedVariables].m_psVarName)
-			{
-				bMatch = FALSE;
-			}
-			if (bMatch == TRUE &&
-			        m_pnSymbolTableVarStackLoc[nVarCount] != nStackCurrentDepth * 4 - nGlobalVariableSize)
-			{
-				bMatch = FALSE;
-			}
+			std::vector<int32_t> &aOpenVars = itOpen->second;
+			int32_t nVarType = m_pcVarStackList[nOccupiedVariables].m_nVarType;
 
-			if (bMatch == TRUE &&
-			        m_pcVarStackList[nOccupiedVariables].m_nVarType == CSCRIPTCOMPILER_TOKEN_KEYWORD_STRUCT &&
-			        m_psSymbolTableVarStructureName[nVarCount] != (m_pcVarStackList[nOccupiedVariables].m_sVarStructureName))
+			for (int32_t nOpenCount = (int32_t) aOpenVars.size() - 1; nOpenCount >= 0; --nOpenCount)
 			{
-				bMatch = FALSE;
-			}
+				int32_t nVarCount = aOpenVars[nOpenCount];
+				if (m_pnSymbolTableVarType[nVarCount] != nVarType ||
+				        m_psSymbolTableNames[m_pnSymbolTableVarName[nVarCount]] != m_pcVarStackList[nOccupiedVariables].m_psVarName)
+				{
+					continue;
+				}
+
+				if (nVarType == CSCRIPTCOMPILER_TOKEN_KEYWORD_STRUCT &&
+				        m_psSymbolTableNames[m_pnSymbolTableVarStructureName[nVarCount]] != m_pcVarStackList[nOccupiedVariables].m_sVarStructureName)
+				{
+					continue;
+				}
 
-			if (bMatch == TRUE && m_pnSymbolTableVarEnd[nVarCount] == -1)
-			{
 				m_pnSymbolTableVarEnd[nVarCount] = m_nOutputCodeLength;
+				aOpenVars.erase(aOpenVars.begin() + nOpenCount);
 				return;
 			}
-
-			--nVarCount;
 		}
 
 		/////////////////////////////////////////////////////////////////
@@ -6528,36 +7684,8 @@ void CScriptCompiler::RemoveFromSymbolTableVarStack(int32_t nOccupiedVariables,
 		//
 		/////////////////////////////////////////////////////////////////
 
-		if (m_pnSymbolTableVarType.size() == m_nSymbolTableVariables)
-		{
-			int32_t nSize = m_pnSymbolTableVarType.size() * 2;
-			if (nSize <= 16)
-			{
-				nSize = 16;
-			}
-
-			m_pnSymbolTableVarType.resize(nSize);
-			m_psSymbolTableVarName.resize(nSize);
-			m_psSymbolTableVarStructureName.resize(nSize);
-			m_pnSymbolTableVarStackLoc.resize(nSize);
-			m_pnSymbolTableVarBegin.resize(nSize);
-			m_pnSymbolTableVarEnd.resize(nSize);
-			m_pnSymbolTableBinaryFinal.resize(nSize);
-			m_pnSymbolTableBinarySortedOrder.resize(nSize);
-		}
-
-		m_pnSymbolTableVarType[m_nSymbolTableVariables]           = m_pcVarStackList[nOccupiedVariables].m_nVarType;
-		m_psSymbolTableVarName[m_nSymbolTableVariables]           = m_pcVarStackList[nOccupiedVariables].m_psVarName;
-		if (m_pcVarStackList[nOccupiedVariables].m_nVarType == CSCRIPTCOMPILER_TOKEN_KEYWORD_STRUCT)
-		{
-			m_psSymbolTableVarStructureName[m_nSymbolTableVariables] = (m_pcVarStackList[nOccupiedVariables].m_sVarStructureName);
-		}
-		m_pnSymbolTableVarStackLoc[m_nSymbolTableVariables]       = nStackCurrentDepth * 4 - nGlobalVariableSize;
-		m_pnSymbolTableVarBegin[m_nSymbolTableVariables]          = -1;
-		m_pnSymbolTableVarEnd[m_nSymbolTableVariables]            = m_nOutputCodeLength;
-		m_pnSymbolTableBinaryFinal[m_nSymbolTableVariables]       = FALSE;
-		m_pnSymbolTableBinarySortedOrder[m_nSymbolTableVariables] = -1;
-		m_nSymbolTableVariables                                  += 1;
+		int32_t nEntry = AddSymbolTableVarEntry(nOccupiedVariables, nStackLoc);
+		m_pnSymbolTableVarEnd[nEntry] = m_nOutputCodeLength;
 	}
 
 }
@@ -6579,6 +7707,8 @@ void CScriptCompiler::ResolveDebuggingInformation()
 	// in this total.
 	m_nFinalLineNumberEntries = 0;
 
+	// Work out which functions end up in the final file, and in which order.
+	std::vector<int32_t> aResolveOrder;
 	{
 		int32_t nCurrentBinarySize = CVIRTUALMACHINE_BINARY_SCRIPT_HEADER;
 		while (nCurrentBinarySize < m_nFinalBinarySize)
@@ -6589,7 +7719,7 @@ void CScriptCompiler::ResolveDebuggingInformation()
 			{
 				if (nCurrentBinarySize == m_pcIdentifierList[nCount2].m_nBinaryDestinationStart)
 				{
-					ResolveDebuggingInformationForIdentifier(nCount2);
+					aResolveOrder.push_back(nCount2);
 					nCurrentBinarySize = m_pcIdentifierList[nCount2].m_nBinaryDestinationFinish;
 					bFoundIdentifier = TRUE;
 				}
@@ -6604,6 +7734,87 @@ void CScriptCompiler::ResolveDebuggingInformation()
 			}
 		}
 	}
+
+	// Each entry belongs to the first of these functions whose source
+	// range holds it.  When the ranges don't overlap that is the only
+	// function that holds it, so we can hand every function just its own
+	// entries (in the same order) instead of having each one scan the
+	// whole table.
+	std::vector<std::pair<int32_t, int32_t>> aRanges;
+	for (int32_t nOrder = 0; nOrder < (int32_t) aResolveOrder.size(); nOrder++)
+	{
+		const CScriptCompilerIdListEntry &cIdentifier = m_pcIdentifierList[aResolveOrder[nOrder]];
+		if (cIdentifier.m_nBinarySourceStart < cIdentifier.m_nBinarySourceFinish)
+		{
+			aRanges.emplace_back(cIdentifier.m_nBinarySourceStart, nOrder);
+		}
+	}
+	std::sort(aRanges.begin(), aRanges.end());
+
+	BOOL bDisjoint = TRUE;
+	for (size_t nRange = 1; nRange < aRanges.size(); nRange++)
+	{
+		if (aRanges[nRange].first < m_pcIdentifierList[aResolveOrder[aRanges[nRange - 1].second]].m_nBinarySourceFinish)
+		{
+			bDisjoint = FALSE;
+		}
+	}
+
+	if (bDisjoint == FALSE)
+	{
+		for (int32_t nIdentifier : aResolveOrder)
+		{
+			ResolveDebuggingInformationForIdentifier(nIdentifier, NULL, NULL);
+		}
+		return;
+	}
+
+	auto FindRange = [&](int32_t nInstruction) -> int32_t
+	{
+		auto it = std::upper_bound(aRanges.begin(), aRanges.end(), std::make_pair(nInstruction, INT32_MAX));
+		if (it == aRanges.begin())
+		{
+			return -1;
+		}
+		--it;
+		if (nInstruction >= m_pcIdentifierList[aResolveOrder[it->second]].m_nBinarySourceFinish)
+		{
+			return -1;
+		}
+		return it->second;
+	};
+
+	std::vector<std::vector<int32_t>> aLineNumberEntries(aResolveOrder.size());
+	std::vector<std::vector<int32_t>> aSymbolTableEntries(aResolveOrder.size());
+
+	for (int32_t nCount = 0; nCount < m_nLineNumberEntries; nCount++)
+	{
+		int32_t nOrder = FindRange(m_pnTableInstructionBinaryStart[nCount]);
+		if (nOrder != -1)
+		{
+			aLineNumberEntries[nOrder].push_back(nCount);
+		}
+	}
+
+	for (int32_t nCount = 0; nCount < m_nSymbolTableVariables; nCount++)
+	{
+		int32_t nInstruction = m_pnSymbolTableVarBegin[nCount];
+		if (nInstruction == -1)
+		{
+			nInstruction = m_pnSymbolTableVarEnd[nCount];
+		}
+
+		int32_t nOrder = FindRange(nInstruction);
+		if (nOrder != -1)
+		{
+			aSymbolTableEntries[nOrder].push_back(nCount);
+		}
+	}
+
+	for (int32_t nOrder = 0; nOrder < (int32_t) aResolveOrder.size(); nOrder++)
+	{
+		ResolveDebuggingInformationForIdentifier(aResolveOrder[nOrder], &aLineNumberEntries[nOrder], &aSymbolTableEntries[nOrder]);
+	}
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -6612,16 +7823,21 @@ void CScriptCompiler::ResolveDebuggingInformation()
 //  Created By: Mark Brockington
 //  Created On: August 29, 2002
 //  Description:  The routine that actually resolves line numbers and
-//                variables on a per-identifier (function) basis.
+//                variables on a per-identifier (function) basis.  The
+//                entries to look at can be narrowed down by passing lists
+//                of their indices; NULL checks every entry.
 ///////////////////////////////////////////////////////////////////////////////
 
-void CScriptCompiler::ResolveDebuggingInformationForIdentifier(int32_t nIdentifier)
+void CScriptCompiler::ResolveDebuggingInformationForIdentifier(int32_t nIdentifier, const std::vector<int32_t> *pLineNumberEntries, const std::vector<int32_t> *pSymbolTableEntries)
 {
 	int32_t nCount;
+	int32_t nEntries;
 
 	// Loop through all of the line number pairs that we have accumulated.
-	for (nCount = 0; nCount < m_nLineNumberEntries; nCount++)
+	nEntries = pLineNumberEntries ? (int32_t) pLineNumberEntries->size() : m_nLineNumberEntries;
+	for (int32_t nEntry = 0; nEntry < nEntries; nEntry++)
 	{
+		nCount = pLineNumberEntries ? (*pLineNumberEntries)[nEntry] : nEntry;
 
 		// Has the entry been resolved?
 		if (m_pnTableInstructionBinaryFinal[nCount] == FALSE)
@@ -6655,8 +7871,11 @@ void CScriptCompiler::ResolveDebuggingInformationForIdentifier(int32_t nIdentifi
 	}
 
 	// Loop through all of the symbol table entries we have accumulated.
-	for (nCount = 0; nCount < m_nSymbolTableVariables; nCount++)
+	nEntries = pSymbolTableEntries ? (int32_t) pSymbolTableEntries->size() : m_nSymbolTableVariables;
+	for (int32_t nEntry = 0; nEntry < nEntries; nEntry++)
 	{
+		nCount = pSymbolTableEntries ? (*pSymbolTableEntries)[nEntry] : nEntry;
+
 		// Has the entry been resolved?
 		if (m_pnSymbolTableBinaryFinal[nCount] == FALSE)
 		{
@@ -6740,12 +7959,10 @@ CExoString CScriptCompiler::GenerateDebuggerTypeAbbreviation(int32_t nType, CExo
 	else if (nType == CSCRIPTCOMPILER_TOKEN_KEYWORD_STRUCT ||
 	         nType == CSCRIPTCOMPILER_TOKEN_STRUCTURE_IDENTIFIER)
 	{
-		for (int32_t count = 0; count < m_nMaxStructures; count++)
+		int32_t nStructure = GetStructure(sStructureName);
+		if (nStructure >= 0)
 		{
-			if (m_pcStructList[count].m_psName == sStructureName)
-			{
-				sReturnValue.Format("t%04d",count);
-			}
+			sReturnValue.Format("t%04d",nStructure);
 		}
 	}
 
@@ -6783,7 +8000,7 @@ int32_t CScriptCompiler::WriteDebuggerOutputToFile(CExoString sFileName)
 			int32_t count;
 			for (count = 0; count < m_nTableFileNames; count++)
 			{
-				nMaxSize += m_psTableFileNames[count].GetLength() + 5;
+				nMaxSize += m_psTableFileNames[count].GetLength() + 15;
 			}
 			for (count = 0; count < m_nMaxStructures; count++)
 			{
@@ -6809,7 +8026,7 @@ int32_t CScriptCompiler::WriteDebuggerOutputToFile(CExoString sFileName)
 				int32_t nSTEntry = m_pnSymbolTableBinarySortedOrder[count];
 				if (m_pnSymbolTableBinaryFinal[nSTEntry] == TRUE)
 				{
-					nMaxSize += nMaxTypeNameSize + m_psSymbolTableVarName[nSTEntry].GetLength() + 31;
+					nMaxSize += nMaxTypeNameSize + m_psSymbolTableNames[m_pnSymbolTableVarName[nSTEntry]].GetLength() + 31;
 				}
 			}
 			for (count = 0; count < m_nFinalLineNumberEntries; count++)
@@ -6817,7 +8034,7 @@ int32_t CScriptCompiler::WriteDebuggerOutputToFile(CExoString sFileName)
 				int32_t nLNEntry = m_pnTableInstructionBinarySortedOrder[count];
 				if (m_pnTableInstructionBinaryFinal[nLNEntry] == TRUE)
 				{
-					nMaxSize += 30;
+					nMaxSize += 38;
 				}
 			}
 
@@ -6858,13 +8075,12 @@ int32_t CScriptCompiler::WriteDebuggerOutputToFile(CExoString sFileName)
 			if (m_psTableFileNames[count] == sFileName)
 			{
 				// Capital F indicates the base file.
-				sprintf(m_pchDebuggerCode + m_nDebuggerCodeLength,"N%02d %s\n",count,m_psTableFileNames[count].CStr());
+				m_nDebuggerCodeLength += sprintf(m_pchDebuggerCode + m_nDebuggerCodeLength,"N%02d %s\n",count,m_psTableFileNames[count].CStr());
 			}
 			else
 			{
-				sprintf(m_pchDebuggerCode + m_nDebuggerCodeLength,"n%02d %s\n",count,m_psTableFileNames[count].CStr());
+				m_nDebuggerCodeLength += sprintf(m_pchDebuggerCode + m_nDebuggerCodeLength,"n%02d %s\n",count,m_psTableFileNames[count].CStr());
 			}
-			m_nDebuggerCodeLength += m_psTableFileNames[count].GetLength() + 5;
 		}
 
 		for (count = 0; count < m_nMaxStructures; count++)
@@ -6909,15 +8125,16 @@ int32_t CScriptCompiler::WriteDebuggerOutputToFile(CExoString sFileName)
 			int32_t nSTEntry = m_pnSymbolTableBinarySortedOrder[count];
 			if (m_pnSymbolTableBinaryFinal[nSTEntry] == TRUE)
 			{
+				int32_t nStructureName = m_pnSymbolTableVarStructureName[nSTEntry];
 				CExoString sTypeName = GenerateDebuggerTypeAbbreviation(m_pnSymbolTableVarType[nSTEntry],
-				                       m_psSymbolTableVarStructureName[nSTEntry]);
+				                       nStructureName != -1 ? m_psSymbolTableNames[nStructureName] : CExoString());
 
 				sprintf(m_pchDebuggerCode + m_nDebuggerCodeLength,"v %08x %08x %08x %s %s\n",
 				        m_pnSymbolTableVarBegin[nSTEntry],
 				        m_pnSymbolTableVarEnd[nSTEntry],
 				        m_pnSymbolTableVarStackLoc[nSTEntry],
-				        sTypeName.CStr(), m_psSymbolTableVarName[nSTEntry].CStr());
-				m_nDebuggerCodeLength += sTypeName.GetLength() + m_psSymbolTableVarName[nSTEntry].GetLength() + 31;
+				        sTypeName.CStr(), m_psSymbolTableNames[m_pnSymbolTableVarName[nSTEntry]].CStr());
+				m_nDebuggerCodeLength += sTypeName.GetLength() + m_psSymbolTableNames[m_pnSymbolTableVarName[nSTEntry]].GetLength() + 31;
 			}
 		}
 
@@ -6926,10 +8143,10 @@ int32_t CScriptCompiler::WriteDebuggerOutputToFile(CExoString sFileName)
 			int32_t nLNEntry = m_pnTableInstructionBinarySortedOrder[count];
 			if (m_pnTableInstructionBinaryFinal[nLNEntry] == TRUE)
 			{
-				sprintf(m_pchDebuggerCode + m_nDebuggerCodeLength,"l%02d %07d %08x %08x\n",
-				        m_pnTableInstructionFileReference[nLNEntry],m_pnTableInstructionLineNumber[nLNEntry],
-				        m_pnTableInstructionBinaryStart[nLNEntry],m_pnTableInstructionBinaryEnd[nLNEntry]);
-				m_nDebuggerCodeLength += 30;
+				// File references are two digits wide up to 99 files, and grow after that.
+				m_nDebuggerCodeLength += sprintf(m_pchDebuggerCode + m_nDebuggerCodeLength,"l%02d %07d %08x %08x\n",
+				                                 m_pnTableInstructionFileReference[nLNEntry],m_pnTableInstructionLineNumber[nLNEntry],
+				                                 m_pnTableInstructionBinaryStart[nLNEntry],m_pnTableInstructionBinaryEnd[nLNEntry]);
 			}
 		}
 
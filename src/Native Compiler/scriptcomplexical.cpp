@@ -1426,12 +1426,15 @@ int32_t CScriptCompiler::HandleToken()
 	}
 	else
 	{
-		nReturnValue = GenerateParseTree();
-	}
+		// Counted before the tree is built, since an #include token
+		// parses the whole included file from there.
+		if (m_bRecordIncludeGraph && m_nCompileFileLevel > 0 &&
+		        m_pcIncludeFileStack[m_nCompileFileLevel - 1].m_nIncludeGraphEntry >= 0)
+		{
+			++m_aIncludeGraph[m_pcIncludeFileStack[m_nCompileFileLevel - 1].m_nIncludeGraphEntry].m_nTokens;
+		}
 
-	if (m_nNextParseTreeFileName >= CSCRIPTCOMPILER_MAX_TABLE_FILENAMES)
-	{
-		nReturnValue = STRREF_CSCRIPTCOMPILER_ERROR_INCLUDE_TOO_MANY_LEVELS;
+		nReturnValue = GenerateParseTree();
 	}
 
 	if (nReturnValue < 0)
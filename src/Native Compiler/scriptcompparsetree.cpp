@@ -48,6 +48,7 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <chrono>
 
 // external header files
 #include "exobase.h"
@@ -205,9 +206,9 @@ CScriptParseTreeNode *CScriptCompiler::GetNewScriptParseTreeNode()
 	else
 	{
 		// So our current block doesn't have spots; that's fine ... the next
-		// one is guaranteed to have spots in it!
+		// one is guaranteed to have spots in it!  (Initialize() has already
+		// cleaned it, along with every other block past the current one.)
 		m_pCurrentParseTreeNodeBlock = m_pCurrentParseTreeNodeBlock->m_pNextBlock;
-		m_pCurrentParseTreeNodeBlock->CleanBlockEntries();
 		m_nParseTreeNodeBlockEmptyNodes = CSCRIPTCOMPILER_PARSETREENODEBLOCK_SIZE - 1;
 	}
 
@@ -263,45 +264,65 @@ CScriptParseTreeNode *CScriptCompiler::CreateScriptParseTreeNode(
 
 	if (m_nCompileFileLevel >= 1)
 	{
-		if (m_nNextParseTreeFileName != 0)
+		// The file's index is resolved once per include level, so creating a
+		// node doesn't compare any file names.
+		CScriptCompilerIncludeFileStackEntry &cFile = m_pcIncludeFileStack[m_nCompileFileLevel-1];
+		if (cFile.m_nParseTreeFileName < 0)
 		{
-			// Check the current entry.
-			if (m_nCurrentParseTreeFileName >= 0 &&
-			        m_nCurrentParseTreeFileName < m_nNextParseTreeFileName)
-			{
-				if (*(m_ppsParseTreeFileNames[m_nCurrentParseTreeFileName]) == m_pcIncludeFileStack[m_nCompileFileLevel-1].m_sCompiledScriptName)
-				{
-					pNewNode->m_nFileReference = m_nCurrentParseTreeFileName;
-					return pNewNode;
-				}
-			}
-
-			// It's not the current entry, search through all defined values.
-			int32_t nCount;
-			for (nCount = 0; nCount < m_nNextParseTreeFileName; nCount++)
-			{
-				if (m_ppsParseTreeFileNames[nCount]->CompareNoCase(m_pcIncludeFileStack[m_nCompileFileLevel-1].m_sCompiledScriptName) == TRUE)
-				{
-					m_nCurrentParseTreeFileName = nCount;
-					pNewNode->m_nFileReference = nCount;
-					return pNewNode;
-				}
-			}
+			cFile.m_nParseTreeFileName = GetParseTreeFileName(cFile.m_sCompiledScriptName, TRUE);
 		}
 
-		// Can't find it in the currently defined values ... make a new one.
-		int32_t nNewEntry = m_nNextParseTreeFileName;
-		//(m_nNextParseTreeFileName is 0 ... add the first entry.
-		pNewNode->m_nFileReference = nNewEntry;
-		m_ppsParseTreeFileNames[nNewEntry] = new CExoString(m_pcIncludeFileStack[m_nCompileFileLevel-1].m_sCompiledScriptName.CStr());
-		++m_nNextParseTreeFileName;
-		m_nCurrentParseTreeFileName = nNewEntry;
+		pNewNode->m_nFileReference = cFile.m_nParseTreeFileName;
+		m_nCurrentParseTreeFileName = cFile.m_nParseTreeFileName;
 	}
 
 	return pNewNode;
 
 }
 
+///////////////////////////////////////////////////////////////////////////////
+//  CScriptCompiler::GetParseTreeFileName()
+///////////////////////////////////////////////////////////////////////////////
+//  Description:  Returns the index of a file name (case insensitive) in the
+//                parse tree file name table, adding it at the end if bAdd is
+//                set.  Returns -1 if the name isn't in the table otherwise.
+///////////////////////////////////////////////////////////////////////////////
+
+int32_t CScriptCompiler::GetParseTreeFileName(const CExoString &sFileName, BOOL bAdd)
+{
+	CExoString sKey = sFileName.LowerCase();
+
+	auto it = m_aParseTreeFileNameByName.find(sKey);
+	if (it != m_aParseTreeFileNameByName.end())
+	{
+		return it->second;
+	}
+
+	if (bAdd == FALSE)
+	{
+		return -1;
+	}
+
+	int32_t nNewEntry = m_nNextParseTreeFileName;
+	if (nNewEntry == m_nParseTreeFileNamesSize)
+	{
+		CExoString **ppsNewFileNames = new CExoString *[m_nParseTreeFileNamesSize + CSCRIPTCOMPILER_TABLE_FILENAMES_BLOCK];
+		for (int32_t count = 0; count < m_nParseTreeFileNamesSize + CSCRIPTCOMPILER_TABLE_FILENAMES_BLOCK; count++)
+		{
+			ppsNewFileNames[count] = (count < m_nParseTreeFileNamesSize) ? m_ppsParseTreeFileNames[count] : NULL;
+		}
+		delete[] m_ppsParseTreeFileNames;
+		m_ppsParseTreeFileNames = ppsNewFileNames;
+		m_nParseTreeFileNamesSize += CSCRIPTCOMPILER_TABLE_FILENAMES_BLOCK;
+	}
+	m_ppsParseTreeFileNames[nNewEntry] = m_cCompileArena.New<CExoString>(sFileName.CStr());
+	m_pnTableFileNameReference.push_back(-1);
+	++m_nNextParseTreeFileName;
+
+	m_aParseTreeFileNameByName.emplace(sKey, nNewEntry);
+	return nNewEntry;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 //  CScriptCompiler::DuplicateScriptParseTree()
 ///////////////////////////////////////////////////////////////////////////////
@@ -334,13 +355,13 @@ CScriptParseTreeNode *CScriptCompiler::DuplicateScriptParseTree(CScriptParseTree
 
 	if (pNode->m_psStringData != NULL)
 	{
-		pNewNode->m_psStringData = new CExoString(pNode->m_psStringData->CStr());
+		pNewNode->m_psStringData = NewParseTreeString(pNode->m_psStringData->CStr());
 	}
 
 
 	if (pNode->m_psTypeName != NULL)
 	{
-		pNewNode->m_psTypeName   = new CExoString(pNode->m_psTypeName->CStr());
+		pNewNode->m_psTypeName   = NewParseTreeString(pNode->m_psTypeName->CStr());
 	}
 
 	pNewNode->pLeft  = DuplicateScriptParseTree(pNode->pLeft);
@@ -512,7 +533,7 @@ int32_t CScriptCompiler::GenerateParseTree()
 				{
 					CScriptParseTreeNode *pNewNode = CreateScriptParseTreeNode(CSCRIPTCOMPILER_OPERATION_CONSTANT_STRING,NULL,NULL);
 					m_pchToken[m_nTokenCharacters] = 0;
-					pNewNode->m_psStringData = new CExoString(m_pchToken);
+					pNewNode->m_psStringData = NewParseTreeString(m_pchToken);
 					ModifySRStackReturnTree(pNewNode);
 					return 0;
 				}
@@ -550,17 +571,17 @@ int32_t CScriptCompiler::GenerateParseTree()
 					CScriptParseTreeNode *pNewNode = CreateScriptParseTreeNode(CSCRIPTCOMPILER_OPERATION_CONSTANT_JSON,NULL,NULL);
 
                     if (m_nTokenStatus == CSCRIPTCOMPILER_TOKEN_KEYWORD_JSON_NULL)
-                        pNewNode->m_psStringData = new CExoString("null");
+                        pNewNode->m_psStringData = NewParseTreeString("null");
                     else if (m_nTokenStatus == CSCRIPTCOMPILER_TOKEN_KEYWORD_JSON_FALSE)
-                        pNewNode->m_psStringData = new CExoString("false");
+                        pNewNode->m_psStringData = NewParseTreeString("false");
                     else if (m_nTokenStatus == CSCRIPTCOMPILER_TOKEN_KEYWORD_JSON_TRUE)
-                        pNewNode->m_psStringData = new CExoString("true");
+                        pNewNode->m_psStringData = NewParseTreeString("true");
                     else if (m_nTokenStatus == CSCRIPTCOMPILER_TOKEN_KEYWORD_JSON_OBJECT)
-                        pNewNode->m_psStringData = new CExoString("{}");
+                        pNewNode->m_psStringData = NewParseTreeString("{}");
                     else if (m_nTokenStatus == CSCRIPTCOMPILER_TOKEN_KEYWORD_JSON_ARRAY)
-                        pNewNode->m_psStringData = new CExoString("[]");
+                        pNewNode->m_psStringData = NewParseTreeString("[]");
                     else if (m_nTokenStatus == CSCRIPTCOMPILER_TOKEN_KEYWORD_JSON_STRING)
-                        pNewNode->m_psStringData = new CExoString("\"\"");
+                        pNewNode->m_psStringData = NewParseTreeString("\"\"");
                     else
                         EXOASSERTNCSTR("missing impl");
 
@@ -709,7 +730,7 @@ int32_t CScriptCompiler::GenerateParseTree()
 				{
 					CScriptParseTreeNode *pNewNode2 = CreateScriptParseTreeNode(CSCRIPTCOMPILER_OPERATION_VARIABLE,NULL,NULL);
 					m_pchToken[m_nTokenCharacters] = 0;
-					pNewNode2->m_psStringData = new CExoString(m_pchToken);
+					pNewNode2->m_psStringData = NewParseTreeString(m_pchToken);
 					ModifySRStackReturnTree(pNewNode2);
 					return 0;
 				}
@@ -732,7 +753,7 @@ int32_t CScriptCompiler::GenerateParseTree()
 
 					CScriptParseTreeNode *pNewNode2 = CreateScriptParseTreeNode(CSCRIPTCOMPILER_OPERATION_ACTION_ID,NULL,NULL);
 					m_pchToken[m_nTokenCharacters] = 0;
-					pNewNode2->m_psStringData = new CExoString(m_pchToken);
+					pNewNode2->m_psStringData = NewParseTreeString(m_pchToken);
 					CScriptParseTreeNode *pNewNode = CreateScriptParseTreeNode(CSCRIPTCOMPILER_OPERATION_ACTION,NULL,pNewNode2);
 
 					if ( m_nTokenStatus == CSCRIPTCOMPILER_TOKEN_VOID_IDENTIFIER )
@@ -932,7 +953,7 @@ int32_t CScriptCompiler::GenerateParseTree()
 			{
 				CScriptParseTreeNode *pNewNode2 = CreateScriptParseTreeNode(CSCRIPTCOMPILER_OPERATION_VARIABLE,NULL,NULL);
 				m_pchToken[m_nTokenCharacters] = 0;
-				pNewNode2->m_psStringData = new CExoString(m_pchToken);
+				pNewNode2->m_psStringData = NewParseTreeString(m_pchToken);
 				ModifySRStackReturnTree(pNewNode2);
 				return 0;
 			}
@@ -1995,7 +2016,7 @@ int32_t CScriptCompiler::GenerateParseTree()
 						pNewNode3->nOperation = pTopStackCurrentNode->pLeft->pLeft->nOperation;
 						if (pNewNode3->nOperation == CSCRIPTCOMPILER_OPERATION_KEYWORD_STRUCT)
 						{
-							pNewNode3->m_psStringData = new CExoString(pTopStackCurrentNode->pLeft->pLeft->m_psStringData->CStr());
+							pNewNode3->m_psStringData = NewParseTreeString(pTopStackCurrentNode->pLeft->pLeft->m_psStringData->CStr());
 						}
 					}
 
@@ -2052,7 +2073,7 @@ int32_t CScriptCompiler::GenerateParseTree()
 				{
 					CScriptParseTreeNode *pNewNode2 = CreateScriptParseTreeNode(CSCRIPTCOMPILER_OPERATION_VARIABLE,NULL,NULL);
 					m_pchToken[m_nTokenCharacters] = 0;
-					pNewNode2->m_psStringData = new CExoString(m_pchToken);
+					pNewNode2->m_psStringData = NewParseTreeString(m_pchToken);
 
 					CScriptParseTreeNode *pNewNode = CreateScriptParseTreeNode(CSCRIPTCOMPILER_OPERATION_VARIABLE_LIST,pNewNode2,NULL);
 
@@ -2081,7 +2102,7 @@ int32_t CScriptCompiler::GenerateParseTree()
 					        pTopStackCurrentNode->pLeft->pRight != NULL &&
 					        pTopStackCurrentNode->pLeft->pRight->pLeft != NULL)
 					{
-						pNewNode0->m_psStringData = new CExoString(pTopStackCurrentNode->pLeft->pRight->pLeft->m_psStringData->CStr());
+						pNewNode0->m_psStringData = NewParseTreeString(pTopStackCurrentNode->pLeft->pRight->pLeft->m_psStringData->CStr());
 					}
 
 					CScriptParseTreeNode *pNewNode1 = CreateScriptParseTreeNode(CSCRIPTCOMPILER_OPERATION_ASSIGNMENT,NULL,pNewNode0);
@@ -2144,7 +2165,7 @@ int32_t CScriptCompiler::GenerateParseTree()
 					// Treat "vector" as a "struct vector" token.
 					CScriptParseTreeNode *pNewNode = CreateScriptParseTreeNode(CSCRIPTCOMPILER_OPERATION_KEYWORD_STRUCT,NULL,NULL);
 					m_pchToken[m_nTokenCharacters] = 0;
-					pNewNode->m_psStringData = new CExoString(m_pchToken);
+					pNewNode->m_psStringData = NewParseTreeString(m_pchToken);
 					ModifySRStackReturnTree(pNewNode);
 					return 0;
 				}
@@ -2209,7 +2230,7 @@ int32_t CScriptCompiler::GenerateParseTree()
 				if (m_nTokenStatus == CSCRIPTCOMPILER_TOKEN_VARIABLE)
 				{
 					m_pchToken[m_nTokenCharacters] = 0;
-					pTopStackCurrentNode->m_psStringData = new CExoString(m_pchToken);
+					pTopStackCurrentNode->m_psStringData = NewParseTreeString(m_pchToken);
 					ModifySRStackReturnTree(pTopStackCurrentNode);
 					return 0;
 				}
@@ -2318,7 +2339,7 @@ int32_t CScriptCompiler::GenerateParseTree()
 
 					CScriptParseTreeNode *pNewNode2 = CreateScriptParseTreeNode(CSCRIPTCOMPILER_OPERATION_ACTION_ID,NULL,NULL);
 					m_pchToken[m_nTokenCharacters] = 0;
-					pNewNode2->m_psStringData = new CExoString(m_pchToken);
+					pNewNode2->m_psStringData = NewParseTreeString(m_pchToken);
 
 					CScriptParseTreeNode *pNewNode = CreateScriptParseTreeNode(CSCRIPTCOMPILER_OPERATION_ACTION,NULL,pNewNode2);
 					PushSRStack(CSCRIPTCOMPILER_GRAMMAR_WITHIN_A_STATEMENT,2,2,pNewNode);
@@ -3152,7 +3173,7 @@ int32_t CScriptCompiler::GenerateParseTree()
 				{
 					CScriptParseTreeNode *pNewNode2 = CreateScriptParseTreeNode(CSCRIPTCOMPILER_OPERATION_VARIABLE,NULL,NULL);
 					m_pchToken[m_nTokenCharacters] = 0;
-					pNewNode2->m_psStringData = new CExoString(m_pchToken);
+					pNewNode2->m_psStringData = NewParseTreeString(m_pchToken);
 
 					CScriptParseTreeNode *pNewNode = CreateScriptParseTreeNode(CSCRIPTCOMPILER_OPERATION_VARIABLE_LIST,pNewNode2,NULL);
 
@@ -3312,7 +3333,7 @@ int32_t CScriptCompiler::GenerateParseTree()
 				{
 					CScriptParseTreeNode *pNewNode = CreateScriptParseTreeNode(CSCRIPTCOMPILER_OPERATION_FUNCTION_PARAM_NAME,NULL,pTopStackReturnNode);
 					m_pchToken[m_nTokenCharacters] = 0;
-					pNewNode->m_psStringData = new CExoString(m_pchToken);
+					pNewNode->m_psStringData = NewParseTreeString(m_pchToken);
 
 					PushSRStack(CSCRIPTCOMPILER_GRAMMAR_FUNCTION_PARAM_LIST,1,3,pNewNode);
 					return 0;
@@ -3449,7 +3470,7 @@ int32_t CScriptCompiler::GenerateParseTree()
 				{
 					CScriptParseTreeNode *pNewNode = CreateScriptParseTreeNode(CSCRIPTCOMPILER_OPERATION_FUNCTION_IDENTIFIER,pTopStackReturnNode,NULL);
 					m_pchToken[m_nTokenCharacters] = 0;
-					pNewNode->m_psStringData = new CExoString(m_pchToken);
+					pNewNode->m_psStringData = NewParseTreeString(m_pchToken);
 
 					CScriptParseTreeNode *pNewNode2 = CreateScriptParseTreeNode(CSCRIPTCOMPILER_OPERATION_FUNCTION_DECLARATION,pNewNode,NULL);
 					CScriptParseTreeNode *pNewNode3 = CreateScriptParseTreeNode(CSCRIPTCOMPILER_OPERATION_FUNCTION,pNewNode2,NULL);
@@ -3633,7 +3654,7 @@ int32_t CScriptCompiler::GenerateParseTree()
 				}
 
 				// Now, let's get the variable name from the old tree.
-				pNewNode->m_psStringData = new CExoString(pTopStackCurrentNode->pLeft->pLeft->m_psStringData->CStr());
+				pNewNode->m_psStringData = NewParseTreeString(pTopStackCurrentNode->pLeft->pLeft->m_psStringData->CStr());
 
 				// Let's verify that this is, in fact, a variable (see rule 13).
 				int32_t m_nCurrentTokenStatus = m_nTokenStatus;
@@ -3655,7 +3676,7 @@ int32_t CScriptCompiler::GenerateParseTree()
 
 				CScriptParseTreeNode *pNewNode5 = CreateScriptParseTreeNode(CSCRIPTCOMPILER_OPERATION_VARIABLE, NULL, NULL);
 				m_pchToken[m_nTokenCharacters] = 0;
-				pNewNode5->m_psStringData = new CExoString(m_pchToken);
+				pNewNode5->m_psStringData = NewParseTreeString(m_pchToken);
 
 				CScriptParseTreeNode *pNewNode6 = CreateScriptParseTreeNode(CSCRIPTCOMPILER_OPERATION_VARIABLE_LIST, pNewNode5, NULL);
 
@@ -3778,17 +3799,7 @@ int32_t CScriptCompiler::GenerateParseTree()
 					// First things first, let's check to see if the file has
 					// already been included.  If it has, ignore the directive
 					// completely!
-					BOOL bFileAlreadyIncluded = FALSE;
-					int32_t nCount = 0;
-					for (nCount = 0; nCount < m_nNextParseTreeFileName; nCount++)
-					{
-						if (m_ppsParseTreeFileNames[nCount]->CompareNoCase(sStringToCompile) == TRUE)
-						{
-							bFileAlreadyIncluded = TRUE;
-						}
-					}
-
-					if (bFileAlreadyIncluded == TRUE)
+					if (GetParseTreeFileName(sStringToCompile, FALSE) >= 0)
 					{
 						PushSRStack(CSCRIPTCOMPILER_GRAMMAR_PROGRAM,0,0,pTopStackCurrentNode);
 						return 0;
@@ -4510,7 +4521,11 @@ int32_t CScriptCompiler::ParseSource(char *pScript, int32_t nScriptLength)
 
 	if (m_nOccupiedIdentifiers == 0)
 	{
+		// Kept apart so that the include graph only charges the script
+		// for its own parsing.
+		std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
 		int32_t nReturnValue = ParseIdentifierFile();
+		m_nIdentifierFileMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - tStart).count();
 		if (nReturnValue < 0)
 		{
 			return nReturnValue;
@@ -42,6 +42,10 @@
 #ifndef __SCRIPTINTERNAL_H__
 #define __SCRIPTINTERNAL_H__
 
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 #define CSCRIPTCOMPILER_MAX_STACK_ENTRIES    1024
 #define CSCRIPTCOMPILER_MAX_OPERATIONS       88
 #define CSCRIPTCOMPILER_MAX_IDENTIFIERS      65536
@@ -435,6 +439,135 @@ const char *OperationToString(int nOperation);
 #define CVIRTUALMACHINE_AUXCODE_TYPETYPE_VECTOR_FLOAT     0x3b
 #define CVIRTUALMACHINE_AUXCODE_TYPETYPE_FLOAT_VECTOR     0x3c
 
+// Operands are stored big endian.
+inline int32_t VirtualMachineReadInt32(const uint8_t *pData)
+{
+	return (int32_t) (((uint32_t) pData[0] << 24) | ((uint32_t) pData[1] << 16) | ((uint32_t) pData[2] << 8) | (uint32_t) pData[3]);
+}
+
+inline int32_t VirtualMachineReadInt16(const uint8_t *pData)
+{
+	return (int16_t) (((uint16_t) pData[0] << 8) | (uint16_t) pData[1]);
+}
+
+// Returns the size of the instruction at nOffset, or 0 if it is unknown or
+// runs past the end of the code.
+inline int32_t VirtualMachineInstructionSize(const uint8_t *pCode, int32_t nOffset, int32_t nCodeLength)
+{
+	if (nOffset + CVIRTUALMACHINE_OPERATION_BASE_SIZE > nCodeLength)
+	{
+		return 0;
+	}
+
+	int32_t nSize;
+	switch (pCode[nOffset + CVIRTUALMACHINE_OPCODE_LOCATION])
+	{
+		case CVIRTUALMACHINE_OPCODE_ASSIGNMENT:
+		case CVIRTUALMACHINE_OPCODE_RUNSTACK_COPY:
+		case CVIRTUALMACHINE_OPCODE_DE_STRUCT:
+		case CVIRTUALMACHINE_OPCODE_ASSIGNMENT_BASE:
+		case CVIRTUALMACHINE_OPCODE_RUNSTACK_COPY_BASE:
+			nSize = CVIRTUALMACHINE_OPERATION_BASE_SIZE + 6;
+			break;
+		case CVIRTUALMACHINE_OPCODE_CONSTANT:
+			// Strings (and json) carry their own length.
+			if (pCode[nOffset + CVIRTUALMACHINE_AUXCODE_LOCATION] == CVIRTUALMACHINE_AUXCODE_TYPE_STRING ||
+			        pCode[nOffset + CVIRTUALMACHINE_AUXCODE_LOCATION] == CVIRTUALMACHINE_AUXCODE_TYPE_ENGST7)
+			{
+				if (nOffset + CVIRTUALMACHINE_OPERATION_BASE_SIZE + 2 > nCodeLength)
+				{
+					return 0;
+				}
+				nSize = CVIRTUALMACHINE_OPERATION_BASE_SIZE + 2 + (uint16_t) VirtualMachineReadInt16(pCode + nOffset + CVIRTUALMACHINE_EXTRA_DATA_LOCATION);
+			}
+			else
+			{
+				nSize = CVIRTUALMACHINE_OPERATION_BASE_SIZE + 4;
+			}
+			break;
+		case CVIRTUALMACHINE_OPCODE_EXECUTE_COMMAND:
+			nSize = CVIRTUALMACHINE_OPERATION_BASE_SIZE + 3;
+			break;
+		case CVIRTUALMACHINE_OPCODE_EQUAL:
+		case CVIRTUALMACHINE_OPCODE_NOT_EQUAL:
+			// Structure comparisons carry the size of the structures.
+			if (pCode[nOffset + CVIRTUALMACHINE_AUXCODE_LOCATION] == CVIRTUALMACHINE_AUXCODE_TYPETYPE_STRUCT_STRUCT)
+			{
+				nSize = CVIRTUALMACHINE_OPERATION_BASE_SIZE + 2;
+			}
+			else
+			{
+				nSize = CVIRTUALMACHINE_OPERATION_BASE_SIZE;
+			}
+			break;
+		case CVIRTUALMACHINE_OPCODE_MODIFY_STACK_POINTER:
+		case CVIRTUALMACHINE_OPCODE_JMP:
+		case CVIRTUALMACHINE_OPCODE_JSR:
+		case CVIRTUALMACHINE_OPCODE_JZ:
+		case CVIRTUALMACHINE_OPCODE_JNZ:
+		case CVIRTUALMACHINE_OPCODE_DECREMENT:
+		case CVIRTUALMACHINE_OPCODE_INCREMENT:
+		case CVIRTUALMACHINE_OPCODE_DECREMENT_BASE:
+		case CVIRTUALMACHINE_OPCODE_INCREMENT_BASE:
+			nSize = CVIRTUALMACHINE_OPERATION_BASE_SIZE + 4;
+			break;
+		case CVIRTUALMACHINE_OPCODE_STORE_STATE:
+			nSize = CVIRTUALMACHINE_OPERATION_BASE_SIZE + 8;
+			break;
+		case CVIRTUALMACHINE_OPCODE_RUNSTACK_ADD:
+		case CVIRTUALMACHINE_OPCODE_LOGICAL_AND:
+		case CVIRTUALMACHINE_OPCODE_LOGICAL_OR:
+		case CVIRTUALMACHINE_OPCODE_INCLUSIVE_OR:
+		case CVIRTUALMACHINE_OPCODE_EXCLUSIVE_OR:
+		case CVIRTUALMACHINE_OPCODE_BOOLEAN_AND:
+		case CVIRTUALMACHINE_OPCODE_GEQ:
+		case CVIRTUALMACHINE_OPCODE_GT:
+		case CVIRTUALMACHINE_OPCODE_LT:
+		case CVIRTUALMACHINE_OPCODE_LEQ:
+		case CVIRTUALMACHINE_OPCODE_SHIFT_LEFT:
+		case CVIRTUALMACHINE_OPCODE_SHIFT_RIGHT:
+		case CVIRTUALMACHINE_OPCODE_USHIFT_RIGHT:
+		case CVIRTUALMACHINE_OPCODE_ADD:
+		case CVIRTUALMACHINE_OPCODE_SUB:
+		case CVIRTUALMACHINE_OPCODE_MUL:
+		case CVIRTUALMACHINE_OPCODE_DIV:
+		case CVIRTUALMACHINE_OPCODE_MODULUS:
+		case CVIRTUALMACHINE_OPCODE_NEGATION:
+		case CVIRTUALMACHINE_OPCODE_ONES_COMPLEMENT:
+		case CVIRTUALMACHINE_OPCODE_RET:
+		case CVIRTUALMACHINE_OPCODE_BOOLEAN_NOT:
+		case CVIRTUALMACHINE_OPCODE_SAVE_BASE_POINTER:
+		case CVIRTUALMACHINE_OPCODE_RESTORE_BASE_POINTER:
+		case CVIRTUALMACHINE_OPCODE_NO_OPERATION:
+			nSize = CVIRTUALMACHINE_OPERATION_BASE_SIZE;
+			break;
+		default:
+			return 0;
+	}
+
+	return (nOffset + nSize <= nCodeLength) ? nSize : 0;
+}
+
+// Returns the mnemonic of an opcode, or NULL if it is unknown.
+inline const char *VirtualMachineOpCodeName(uint8_t nOpCode)
+{
+	static const char *pchOpCodeNames[] =
+	{
+		NULL, "CPDOWNSP", "RSADD", "CPTOPSP", "CONST", "ACTION", "LOGAND", "LOGOR",
+		"INCOR", "EXCOR", "BOOLAND", "EQUAL", "NEQUAL", "GEQ", "GT", "LT",
+		"LEQ", "SHLEFT", "SHRIGHT", "USHRIGHT", "ADD", "SUB", "MUL", "DIV",
+		"MOD", "NEG", "COMP", "MOVSP", "STOREIP", "JMP", "JSR", "JZ",
+		"RETN", "DESTRUCT", "NOT", "DECSP", "INCSP", "JNZ", "CPDOWNBP", "CPTOPBP",
+		"DECBP", "INCBP", "SAVEBP", "RESTOREBP", "STORESTATE", "NOP"
+	};
+
+	if (nOpCode >= sizeof(pchOpCodeNames) / sizeof(pchOpCodeNames[0]))
+	{
+		return NULL;
+	}
+	return pchOpCodeNames[nOpCode];
+}
+
 // stuff for saving out ScriptSituations and Stacks
 #define CVIRTUALMACHINE_GFF_CODESIZE                "CodeSize"
 #define CVIRTUALMACHINE_GFF_CODE                    "Code"
@@ -493,19 +626,24 @@ public:
 	CExoString *m_psTypeName;
 	/* int32_t   m_nNodeLocation; ???? */
 	int32_t   m_nStackPointer;
+	// Set once ConstantFoldNode() has tried to fold this node, so that
+	// repeated folds of an enclosing tree do not revisit it.
+	BOOL      m_bConstantFoldAttempted;
 
 	CScriptParseTreeNode() { m_psStringData = NULL; m_psTypeName = NULL; Clean(); }
 
+	// The strings live in the compiler's arena, so they are only destroyed
+	// here; the memory goes back when the arena is reset.
 	void Clean()
 	{
 		if (m_psStringData != NULL)
 		{
-			delete m_psStringData;
+			m_psStringData->~CExoString();
 			m_psStringData = NULL;
 		}
 		if (m_psTypeName != NULL)
 		{
-			delete m_psTypeName;
+			m_psTypeName->~CExoString();
 			m_psTypeName = NULL;
 		}
 
@@ -525,6 +663,7 @@ public:
 		nChar = 0;
 		nType = 0;
 		m_nStackPointer = 0;
+		m_bConstantFoldAttempted = FALSE;
 	}
 
 	~CScriptParseTreeNode()
@@ -684,6 +823,7 @@ public:
 	int32_t   m_nBinarySourceFinish;
 	int32_t   m_nBinaryDestinationStart;
 	int32_t   m_nBinaryDestinationFinish;
+	int32_t   m_nFileReference;
 
 	CScriptCompilerIdListEntry();
 	~CScriptCompilerIdListEntry();
@@ -716,6 +856,10 @@ public:
 	int32_t        m_nFieldEnd;
 	int32_t        m_nByteSize;
 
+	// Field name -> index into the structure field list, built when the
+	// definition is complete.
+	std::unordered_map<CExoString, int32_t> m_aFieldByName;
+
 	CScriptCompilerStructureEntry()
 	{
 		m_nFieldStart = 0;
@@ -769,4 +913,45 @@ public:
 
 
 
+class CScriptCompilerGlobalVariableEntry
+{
+public:
+	CExoString     m_sVarName;
+	int32_t        m_nVarType;        // CSCRIPTCOMPILER_OPERATION_KEYWORD_* of the declaration.
+	CScriptParseTreeNode *m_pDeclarationList;  // STATEMENT_LIST holding the declaration.
+	CScriptParseTreeNode *m_pDeclaration;      // STATEMENT holding the KEYWORD_DECLARATION.
+	CScriptParseTreeNode *m_pInitialization;   // STATEMENT holding the initial ASSIGNMENT (or NULL).
+	std::vector<CScriptParseTreeNode *> m_aReads;
+	BOOL           m_bWritten;
+	BOOL           m_bPinned;         // Shadowed, redeclared or used before it is declared.
+
+	CScriptCompilerGlobalVariableEntry()
+	{
+		m_nVarType = 0;
+		m_pDeclarationList = NULL;
+		m_pDeclaration = NULL;
+		m_pInitialization = NULL;
+		m_bWritten = FALSE;
+		m_bPinned = FALSE;
+	}
+};
+
+class CScriptCompilerGlobalVariableUsage
+{
+public:
+	std::vector<CScriptCompilerGlobalVariableEntry> m_aEntries;
+	std::unordered_map<std::string, int32_t> m_aEntryByName;
+
+	int32_t Find(const CExoString *psName) const
+	{
+		if (psName == NULL)
+		{
+			return -1;
+		}
+		auto it = m_aEntryByName.find(psName->CStr());
+		return it == m_aEntryByName.end() ? -1 : it->second;
+	}
+};
+
+
 #endif // __SCRIPTINTERNAL_H__
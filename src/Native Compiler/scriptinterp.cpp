@@ -0,0 +1,1075 @@
+//
+// SPDX-License-Identifier: GPL-3.0
+//
+// This file is part of the NWScript compiler open source release.
+//
+// The initial source release is licensed under GPL-3.0.
+//
+// All subsequent changes you submit are required to be licensed under MIT.
+//
+// However, the project overall will still be GPL-3.0.
+//
+// The intent is for the base game to be able to pick up changes you explicitly
+// submit for inclusion painlessly, while ensuring the overall project source code
+// remains available for everyone.
+//
+
+//::///////////////////////////////////////////////////////////////////////////
+//::
+//::  ScriptInterp.cpp
+//::
+//::  Reference interpreter for compiled scripts.  The run time stack follows
+//::  the game's virtual machine: every entry is one 4 byte cell (strings and
+//::  engine structures included, vectors take three), stack offsets in the
+//::  code are in bytes, and SAVEBP leaves the base pointer right above the
+//::  globals.
+//::
+//::///////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string_view>
+
+// external header files
+#include "exobase.h"
+#include "scriptcomp.h"
+#include "scriptinterp.h"
+
+// internal header files
+#include "scriptinternal.h"
+
+// Vectors have no type of their own on the run time stack; this only tells
+// action prototypes apart.
+#define CSCRIPTINTERPRETER_TYPE_VECTOR  0x0f
+
+const char *CScriptInterpreter::GetOpCodeName(uint8_t nOpCode)
+{
+	return VirtualMachineOpCodeName(nOpCode);
+}
+
+CScriptInterpreter::CScriptInterpreter()
+{
+	m_nMaxInstructions = CSCRIPTINTERPRETER_DEFAULT_MAX_INSTRUCTIONS;
+	m_bRunDeferredActions = TRUE;
+	m_oidSelf = 1;
+
+	m_pCode = NULL;
+	m_nCodeLength = 0;
+	m_nStackPointer = 0;
+	m_nBasePointer = 0;
+	m_nErrorOffset = -1;
+	m_bHasReturnValue = FALSE;
+	m_nReturnValue = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  Action specification
+///////////////////////////////////////////////////////////////////////////////
+
+uint8_t CScriptInterpreter::GetTypeFromName(const std::string &sType, const std::unordered_map<std::string, uint8_t> &aEngineStructures)
+{
+	if (sType == "void")   return CVIRTUALMACHINE_AUXCODE_TYPE_VOID;
+	if (sType == "action") return CVIRTUALMACHINE_AUXCODE_TYPE_COMMAND;
+	if (sType == "int")    return CVIRTUALMACHINE_AUXCODE_TYPE_INTEGER;
+	if (sType == "float")  return CVIRTUALMACHINE_AUXCODE_TYPE_FLOAT;
+	if (sType == "string") return CVIRTUALMACHINE_AUXCODE_TYPE_STRING;
+	if (sType == "object") return CVIRTUALMACHINE_AUXCODE_TYPE_OBJECT;
+	if (sType == "vector") return CSCRIPTINTERPRETER_TYPE_VECTOR;
+
+	auto it = aEngineStructures.find(sType);
+	return it != aEngineStructures.end() ? it->second : 0;
+}
+
+int32_t CScriptInterpreter::GetTypeSize(uint8_t nType)
+{
+	switch (nType)
+	{
+		case CVIRTUALMACHINE_AUXCODE_TYPE_VOID:
+		case CVIRTUALMACHINE_AUXCODE_TYPE_COMMAND:
+			return 0;
+		case CSCRIPTINTERPRETER_TYPE_VECTOR:
+			return 3;
+		default:
+			return 1;
+	}
+}
+
+// Splits nwscript.nss into identifiers, numbers, string literals and single
+// character punctuation, dropping comments.  Preprocessor lines come back
+// whole, starting with '#'.
+static void TokenizeSpecification(const char *pchSource, size_t nLength, std::vector<std::string> &asTokens)
+{
+	size_t nPos = 0;
+	while (nPos < nLength)
+	{
+		char ch = pchSource[nPos];
+		if (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n')
+		{
+			nPos++;
+		}
+		else if (ch == '/' && nPos + 1 < nLength && pchSource[nPos + 1] == '/')
+		{
+			while (nPos < nLength && pchSource[nPos] != '\n')
+			{
+				nPos++;
+			}
+		}
+		else if (ch == '/' && nPos + 1 < nLength && pchSource[nPos + 1] == '*')
+		{
+			size_t nEnd = std::string_view(pchSource, nLength).find("*/", nPos + 2);
+			nPos = (nEnd != std::string_view::npos) ? nEnd + 2 : nLength;
+		}
+		else if (ch == '#')
+		{
+			size_t nStart = nPos;
+			while (nPos < nLength && pchSource[nPos] != '\n' && pchSource[nPos] != '\r')
+			{
+				nPos++;
+			}
+			asTokens.emplace_back(pchSource + nStart, nPos - nStart);
+		}
+		else if (ch == '"')
+		{
+			size_t nStart = nPos++;
+			while (nPos < nLength && pchSource[nPos] != '"')
+			{
+				nPos += (pchSource[nPos] == '\\') ? 2 : 1;
+			}
+			nPos = std::min(nPos + 1, nLength);
+			asTokens.emplace_back(pchSource + nStart, nPos - nStart);
+		}
+		else if (isalnum((unsigned char) ch) || ch == '_' || ch == '.')
+		{
+			size_t nStart = nPos;
+			while (nPos < nLength && (isalnum((unsigned char) pchSource[nPos]) || pchSource[nPos] == '_' || pchSource[nPos] == '.'))
+			{
+				nPos++;
+			}
+			asTokens.emplace_back(pchSource + nStart, nPos - nStart);
+		}
+		else
+		{
+			asTokens.emplace_back(1, ch);
+			nPos++;
+		}
+	}
+}
+
+int32_t CScriptInterpreter::LoadActionSpecification(const char *pchSource, size_t nLength)
+{
+	std::vector<std::string> asTokens;
+	TokenizeSpecification(pchSource, nLength, asTokens);
+
+	m_aActions.clear();
+	m_aActionByName.clear();
+
+	std::unordered_map<std::string, uint8_t> aEngineStructures;
+	std::vector<std::string> asStatement;
+
+	for (const std::string &sToken : asTokens)
+	{
+		// #define ENGINE_STRUCTURE_<n> <name>
+		if (sToken[0] == '#')
+		{
+			char szStructure[64];
+			int nStructure;
+			if (sscanf(sToken.c_str(), "#define ENGINE_STRUCTURE_%d %63s", &nStructure, szStructure) == 2 &&
+			        nStructure >= 0 && nStructure <= 9)
+			{
+				aEngineStructures[szStructure] = (uint8_t) (CVIRTUALMACHINE_AUXCODE_TYPE_ENGST0 + nStructure);
+			}
+			continue;
+		}
+
+		if (sToken != ";")
+		{
+			asStatement.push_back(sToken);
+			continue;
+		}
+
+		// Only prototypes matter: <type> <name> ( <type> <name> [= default], ... ) ;
+		// Constants have no parenthesis after the name.
+		if (asStatement.size() >= 4 && asStatement[2] == "(" && asStatement.back() == ")")
+		{
+			CAction cAction;
+			cAction.m_sName = asStatement[1];
+			cAction.m_nReturnType = GetTypeFromName(asStatement[0], aEngineStructures);
+			if (cAction.m_nReturnType == 0)
+			{
+				m_sError = "unknown return type " + asStatement[0] + " on " + cAction.m_sName;
+				return STRREF_CVIRTUALMACHINE_ERROR_UNKNOWN_TYPE_ON_RUN_TIME_STACK;
+			}
+
+			int32_t nDepth = 0;
+			BOOL bParameterStart = TRUE;
+			for (size_t nToken = 3; nToken + 1 < asStatement.size(); nToken++)
+			{
+				const std::string &sParameterToken = asStatement[nToken];
+				if (sParameterToken == "(" || sParameterToken == "[")
+				{
+					nDepth++;
+				}
+				else if (sParameterToken == ")" || sParameterToken == "]")
+				{
+					nDepth--;
+				}
+				else if (sParameterToken == "," && nDepth == 0)
+				{
+					bParameterStart = TRUE;
+				}
+				else if (bParameterStart)
+				{
+					uint8_t nType = GetTypeFromName(sParameterToken, aEngineStructures);
+					if (nType == 0 || nType == CVIRTUALMACHINE_AUXCODE_TYPE_VOID)
+					{
+						m_sError = "unknown parameter type " + sParameterToken + " on " + cAction.m_sName;
+						return STRREF_CVIRTUALMACHINE_ERROR_UNKNOWN_TYPE_ON_RUN_TIME_STACK;
+					}
+					cAction.m_aParameterTypes.push_back(nType);
+					bParameterStart = FALSE;
+				}
+			}
+
+			m_aActionByName[cAction.m_sName] = (int32_t) m_aActions.size();
+			m_aActions.push_back(std::move(cAction));
+		}
+		asStatement.clear();
+	}
+
+	return (int32_t) m_aActions.size();
+}
+
+BOOL CScriptInterpreter::ParseValue(uint8_t nType, const std::string &sValue, std::vector<CCell> &aCells) const
+{
+	CCell cCell;
+	cCell.nType = nType;
+	char *pchEnd = NULL;
+
+	switch (nType)
+	{
+		case CVIRTUALMACHINE_AUXCODE_TYPE_INTEGER:
+			cCell.nInteger = (int32_t) strtol(sValue.c_str(), &pchEnd, 0);
+			break;
+		case CVIRTUALMACHINE_AUXCODE_TYPE_FLOAT:
+			cCell.fFloat = strtof(sValue.c_str(), &pchEnd);
+			break;
+		case CVIRTUALMACHINE_AUXCODE_TYPE_OBJECT:
+			if (sValue == "OBJECT_INVALID")
+			{
+				cCell.oidObject = INVALID_OBJECT_ID;
+			}
+			else if (sValue == "OBJECT_SELF")
+			{
+				cCell.oidObject = m_oidSelf;
+			}
+			else
+			{
+				cCell.oidObject = (uint32_t) strtoul(sValue.c_str(), &pchEnd, 0);
+			}
+			break;
+		case CSCRIPTINTERPRETER_TYPE_VECTOR:
+		{
+			float fX, fY, fZ;
+			if (sscanf(sValue.c_str(), "%f %f %f", &fX, &fY, &fZ) != 3)
+			{
+				return FALSE;
+			}
+			cCell.nType = CVIRTUALMACHINE_AUXCODE_TYPE_FLOAT;
+			for (float fComponent : { fX, fY, fZ })
+			{
+				cCell.fFloat = fComponent;
+				aCells.push_back(cCell);
+			}
+			return TRUE;
+		}
+		case CVIRTUALMACHINE_AUXCODE_TYPE_STRING:
+		case CVIRTUALMACHINE_AUXCODE_TYPE_ENGST7:
+			cCell.sString = sValue;
+			break;
+		default:
+			// Engine structures are opaque handles.
+			cCell.nInteger = (int32_t) strtol(sValue.c_str(), &pchEnd, 0);
+			break;
+	}
+
+	if (pchEnd != NULL && (pchEnd == sValue.c_str() || *pchEnd != 0))
+	{
+		return FALSE;
+	}
+
+	aCells.push_back(std::move(cCell));
+	return TRUE;
+}
+
+BOOL CScriptInterpreter::SetActionReturnValues(const std::string &sAction, const std::vector<std::string> &asValues)
+{
+	auto it = m_aActionByName.find(sAction);
+	if (it == m_aActionByName.end())
+	{
+		return FALSE;
+	}
+
+	CAction &cAction = m_aActions[it->second];
+	if (cAction.m_nReturnType == CVIRTUALMACHINE_AUXCODE_TYPE_VOID)
+	{
+		return FALSE;
+	}
+
+	std::vector<std::vector<CCell>> aReturnValues;
+	for (const std::string &sValue : asValues)
+	{
+		aReturnValues.emplace_back();
+		if (!ParseValue(cAction.m_nReturnType, sValue, aReturnValues.back()))
+		{
+			return FALSE;
+		}
+	}
+
+	cAction.m_aReturnValues = std::move(aReturnValues);
+	return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  Execution
+///////////////////////////////////////////////////////////////////////////////
+
+int32_t CScriptInterpreter::OutputError(int32_t nError, int32_t nOffset, const char *pchReason)
+{
+	m_sError = pchReason;
+	m_nErrorOffset = nOffset;
+	return nError;
+}
+
+BOOL CScriptInterpreter::GrowStack(int32_t nCells)
+{
+	if (m_nStackPointer + nCells <= (int32_t) m_aStack.size())
+	{
+		return TRUE;
+	}
+	if (m_nStackPointer + nCells > CSCRIPTINTERPRETER_MAX_STACK_CELLS)
+	{
+		return FALSE;
+	}
+	m_aStack.resize(std::max((size_t) (m_nStackPointer + nCells), m_aStack.size() * 2));
+	return TRUE;
+}
+
+BOOL CScriptInterpreter::GetReturnValue(int32_t &nValue) const
+{
+	nValue = m_nReturnValue;
+	return m_bHasReturnValue;
+}
+
+int32_t CScriptInterpreter::RunScript(const uint8_t *pCode, int32_t nCodeLength)
+{
+	m_cStatistics = CScriptInterpreterStatistics();
+	m_cStatistics.m_aActionCalls.assign(m_aActions.size(), 0);
+	m_sError.clear();
+	m_nErrorOffset = -1;
+	m_bHasReturnValue = FALSE;
+	m_nReturnValue = 0;
+
+	if (nCodeLength < CVIRTUALMACHINE_BINARY_SCRIPT_HEADER || memcmp(pCode, "NCS V1.0", 8) != 0 || pCode[8] != 0x42)
+	{
+		return OutputError(STRREF_CVIRTUALMACHINE_ERROR_FILE_NOT_COMPILED_SUCCESSFULLY, 0, "not a compiled script");
+	}
+	if (VirtualMachineReadInt32(pCode + 9) != nCodeLength)
+	{
+		return OutputError(STRREF_CVIRTUALMACHINE_ERROR_FILE_NOT_COMPILED_SUCCESSFULLY, 9, "the header does not match the file size");
+	}
+
+	m_pCode = pCode;
+	m_nCodeLength = nCodeLength;
+
+	// Instructions are laid out back to back, so one pass finds them all and
+	// the loop only has to check that jumps land on one.
+	m_aInstructionSize.assign(nCodeLength, 0);
+	for (int32_t nOffset = CVIRTUALMACHINE_BINARY_SCRIPT_HEADER; nOffset < nCodeLength; )
+	{
+		int32_t nSize = VirtualMachineInstructionSize(pCode, nOffset, nCodeLength);
+		if (nSize == 0)
+		{
+			return OutputError(STRREF_CVIRTUALMACHINE_ERROR_INVALID_OP_CODE, nOffset, "unknown or truncated instruction");
+		}
+		m_aInstructionSize[nOffset] = nSize;
+		nOffset += nSize;
+	}
+
+	m_nStackPointer = 0;
+	m_nBasePointer = 0;
+	m_aReturnStack.clear();
+	m_aStoredStates.clear();
+	m_aDeferredActions.clear();
+
+	auto tStart = std::chrono::steady_clock::now();
+
+	int32_t nResult = Execute(CVIRTUALMACHINE_BINARY_SCRIPT_HEADER);
+
+	if (nResult == 0 && m_nStackPointer == 1 && m_aStack[0].nType == CVIRTUALMACHINE_AUXCODE_TYPE_INTEGER)
+	{
+		m_bHasReturnValue = TRUE;
+		m_nReturnValue = m_aStack[0].nInteger;
+	}
+
+	// Deferred actions may queue more of their own.
+	for (size_t nAction = 0; nResult == 0 && m_bRunDeferredActions && nAction < m_aDeferredActions.size(); nAction++)
+	{
+		CSavedState cState = std::move(m_aDeferredActions[nAction]);
+		nResult = RunDeferredAction(cState);
+	}
+
+	m_cStatistics.m_nNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - tStart).count();
+	return nResult;
+}
+
+int32_t CScriptInterpreter::RunDeferredAction(CSavedState &cState)
+{
+	m_cStatistics.m_nDeferredActions++;
+
+	m_nStackPointer = 0;
+	m_aReturnStack.clear();
+	if (!GrowStack((int32_t) (cState.m_aBaseStack.size() + cState.m_aStack.size())))
+	{
+		return OutputError(STRREF_CVIRTUALMACHINE_ERROR_STACK_OVERFLOW, cState.m_nOffset, "stack overflow");
+	}
+
+	for (CCell &cCell : cState.m_aBaseStack)
+	{
+		m_aStack[m_nStackPointer++] = std::move(cCell);
+	}
+	m_nBasePointer = m_nStackPointer;
+	for (CCell &cCell : cState.m_aStack)
+	{
+		m_aStack[m_nStackPointer++] = std::move(cCell);
+	}
+
+	return Execute(cState.m_nOffset);
+}
+
+int32_t CScriptInterpreter::Execute(int32_t nOffset)
+{
+	CScriptInterpreterStatistics &cStats = m_cStatistics;
+	int32_t nStackHighWater = cStats.m_nStackHighWater / 4;
+
+	for (;;)
+	{
+		if (nOffset < 0 || nOffset >= m_nCodeLength || m_aInstructionSize[nOffset] == 0)
+		{
+			return OutputError(STRREF_CVIRTUALMACHINE_ERROR_IP_OUT_OF_CODE_SEGMENT, nOffset, "jump does not land on an instruction");
+		}
+		if (cStats.m_nInstructions++ >= m_nMaxInstructions)
+		{
+			return OutputError(STRREF_CVIRTUALMACHINE_ERROR_TOO_MANY_INSTRUCTIONS, nOffset, "instruction limit reached");
+		}
+
+		const uint8_t nOpCode = m_pCode[nOffset + CVIRTUALMACHINE_OPCODE_LOCATION];
+		const uint8_t nAuxCode = m_pCode[nOffset + CVIRTUALMACHINE_AUXCODE_LOCATION];
+		const uint8_t *pExtraData = m_pCode + nOffset + CVIRTUALMACHINE_EXTRA_DATA_LOCATION;
+		int32_t nNextOffset = nOffset + m_aInstructionSize[nOffset];
+
+		cStats.m_aOpCodeCount[nOpCode]++;
+
+		// Nothing pushes more than one cell, except for CPTOPSP and ACTION,
+		// which make room for themselves.
+		if (!GrowStack(1))
+		{
+			return OutputError(STRREF_CVIRTUALMACHINE_ERROR_STACK_OVERFLOW, nOffset, "stack overflow");
+		}
+
+		CCell *pStack = m_aStack.data();
+		int32_t &nSP = m_nStackPointer;
+
+		// Operands of binary operations: the right hand side is on top.
+		#define OPERAND_CELLS(n) if (nSP < (n)) { return OutputError(STRREF_CVIRTUALMACHINE_ERROR_STACK_UNDERFLOW, nOffset, "stack underflow"); }
+		#define INVALID_AUX_CODE() return OutputError(STRREF_CVIRTUALMACHINE_ERROR_INVALID_AUX_CODE, nOffset, "invalid type for the operation")
+
+		switch (nOpCode)
+		{
+			case CVIRTUALMACHINE_OPCODE_ASSIGNMENT:
+			case CVIRTUALMACHINE_OPCODE_ASSIGNMENT_BASE:
+			case CVIRTUALMACHINE_OPCODE_RUNSTACK_COPY:
+			case CVIRTUALMACHINE_OPCODE_RUNSTACK_COPY_BASE:
+			{
+				int32_t nStackOffset = VirtualMachineReadInt32(pExtraData);
+				int32_t nSize = (uint16_t) VirtualMachineReadInt16(pExtraData + 4);
+				if ((nStackOffset & 3) != 0 || (nSize & 3) != 0)
+				{
+					return OutputError(STRREF_CVIRTUALMACHINE_ERROR_INVALID_EXTRA_DATA_ON_OP_CODE, nOffset, "stack offset is not a whole cell");
+				}
+
+				BOOL bBase = (nOpCode == CVIRTUALMACHINE_OPCODE_ASSIGNMENT_BASE || nOpCode == CVIRTUALMACHINE_OPCODE_RUNSTACK_COPY_BASE);
+				int32_t nCells = nSize / 4;
+				int32_t nLocation = (bBase ? m_nBasePointer : nSP) + nStackOffset / 4;
+				if (nLocation < 0 || nLocation + nCells > nSP || nCells > nSP)
+				{
+					return OutputError(STRREF_CVIRTUALMACHINE_ERROR_STACK_UNDERFLOW, nOffset, "stack offset outside of the stack");
+				}
+
+				if (nOpCode == CVIRTUALMACHINE_OPCODE_ASSIGNMENT || nOpCode == CVIRTUALMACHINE_OPCODE_ASSIGNMENT_BASE)
+				{
+					for (int32_t nCell = 0; nCell < nCells; nCell++)
+					{
+						if (nLocation + nCell != nSP - nCells + nCell)
+						{
+							pStack[nLocation + nCell] = pStack[nSP - nCells + nCell];
+						}
+					}
+				}
+				else
+				{
+					if (!GrowStack(nCells))
+					{
+						return OutputError(STRREF_CVIRTUALMACHINE_ERROR_STACK_OVERFLOW, nOffset, "stack overflow");
+					}
+					pStack = m_aStack.data();
+					for (int32_t nCell = 0; nCell < nCells; nCell++)
+					{
+						pStack[nSP + nCell] = pStack[nLocation + nCell];
+					}
+					nSP += nCells;
+				}
+				break;
+			}
+
+			case CVIRTUALMACHINE_OPCODE_RUNSTACK_ADD:
+				if (nAuxCode != CVIRTUALMACHINE_AUXCODE_TYPE_INTEGER && nAuxCode != CVIRTUALMACHINE_AUXCODE_TYPE_FLOAT &&
+				        nAuxCode != CVIRTUALMACHINE_AUXCODE_TYPE_STRING && nAuxCode != CVIRTUALMACHINE_AUXCODE_TYPE_OBJECT &&
+				        (nAuxCode < CVIRTUALMACHINE_AUXCODE_TYPE_ENGST0 || nAuxCode > CVIRTUALMACHINE_AUXCODE_TYPE_ENGST9))
+				{
+					INVALID_AUX_CODE();
+				}
+				pStack[nSP].nType = nAuxCode;
+				pStack[nSP].nInteger = 0;
+				pStack[nSP].sString.clear();
+				if (nAuxCode == CVIRTUALMACHINE_AUXCODE_TYPE_OBJECT)
+				{
+					pStack[nSP].oidObject = INVALID_OBJECT_ID;
+				}
+				nSP++;
+				break;
+
+			case CVIRTUALMACHINE_OPCODE_CONSTANT:
+			{
+				CCell &cCell = pStack[nSP];
+				cCell.nType = nAuxCode;
+				cCell.sString.clear();
+				switch (nAuxCode)
+				{
+					case CVIRTUALMACHINE_AUXCODE_TYPE_STRING:
+					case CVIRTUALMACHINE_AUXCODE_TYPE_ENGST7:
+						cCell.nInteger = 0;
+						cCell.sString.assign((const char *) pExtraData + 2, (uint16_t) VirtualMachineReadInt16(pExtraData));
+						break;
+					case CVIRTUALMACHINE_AUXCODE_TYPE_OBJECT:
+					{
+						// The compiler writes OBJECT_SELF as 0 and OBJECT_INVALID as 1.
+						int32_t nObject = VirtualMachineReadInt32(pExtraData);
+						cCell.oidObject = (nObject == 0) ? m_oidSelf : (nObject == 1) ? INVALID_OBJECT_ID : (uint32_t) nObject;
+						break;
+					}
+					case CVIRTUALMACHINE_AUXCODE_TYPE_INTEGER:
+					case CVIRTUALMACHINE_AUXCODE_TYPE_FLOAT:
+						cCell.nInteger = VirtualMachineReadInt32(pExtraData);
+						break;
+					default:
+						if (nAuxCode < CVIRTUALMACHINE_AUXCODE_TYPE_ENGST0 || nAuxCode > CVIRTUALMACHINE_AUXCODE_TYPE_ENGST9)
+						{
+							INVALID_AUX_CODE();
+						}
+						cCell.nInteger = VirtualMachineReadInt32(pExtraData);
+						break;
+				}
+				nSP++;
+				break;
+			}
+
+			case CVIRTUALMACHINE_OPCODE_EXECUTE_COMMAND:
+			{
+				int32_t nResult = ExecuteAction(nOffset, (uint16_t) VirtualMachineReadInt16(pExtraData), pExtraData[2]);
+				if (nResult != 0)
+				{
+					return nResult;
+				}
+				break;
+			}
+
+			case CVIRTUALMACHINE_OPCODE_LOGICAL_AND:
+			case CVIRTUALMACHINE_OPCODE_LOGICAL_OR:
+			case CVIRTUALMACHINE_OPCODE_INCLUSIVE_OR:
+			case CVIRTUALMACHINE_OPCODE_EXCLUSIVE_OR:
+			case CVIRTUALMACHINE_OPCODE_BOOLEAN_AND:
+			case CVIRTUALMACHINE_OPCODE_SHIFT_LEFT:
+			case CVIRTUALMACHINE_OPCODE_SHIFT_RIGHT:
+			case CVIRTUALMACHINE_OPCODE_USHIFT_RIGHT:
+			case CVIRTUALMACHINE_OPCODE_MODULUS:
+			{
+				if (nAuxCode != CVIRTUALMACHINE_AUXCODE_TYPETYPE_INTEGER_INTEGER)
+				{
+					INVALID_AUX_CODE();
+				}
+				OPERAND_CELLS(2);
+				int32_t nLeft = pStack[nSP - 2].nInteger;
+				int32_t nRight = pStack[nSP - 1].nInteger;
+				int32_t nResult = 0;
+				switch (nOpCode)
+				{
+					case CVIRTUALMACHINE_OPCODE_LOGICAL_AND:  nResult = (nLeft && nRight); break;
+					case CVIRTUALMACHINE_OPCODE_LOGICAL_OR:   nResult = (nLeft || nRight); break;
+					case CVIRTUALMACHINE_OPCODE_INCLUSIVE_OR: nResult = nLeft | nRight; break;
+					case CVIRTUALMACHINE_OPCODE_EXCLUSIVE_OR: nResult = nLeft ^ nRight; break;
+					case CVIRTUALMACHINE_OPCODE_BOOLEAN_AND:  nResult = nLeft & nRight; break;
+					case CVIRTUALMACHINE_OPCODE_SHIFT_LEFT:   nResult = (int32_t) ((uint32_t) nLeft << (nRight & 31)); break;
+					case CVIRTUALMACHINE_OPCODE_SHIFT_RIGHT:  nResult = nLeft >> (nRight & 31); break;
+					case CVIRTUALMACHINE_OPCODE_USHIFT_RIGHT: nResult = (int32_t) ((uint32_t) nLeft >> (nRight & 31)); break;
+					case CVIRTUALMACHINE_OPCODE_MODULUS:
+						if (nRight == 0)
+						{
+							return OutputError(STRREF_CVIRTUALMACHINE_ERROR_DIVIDE_BY_ZERO, nOffset, "modulus by zero");
+						}
+						nResult = (nRight == -1) ? 0 : nLeft % nRight;
+						break;
+				}
+				pStack[nSP - 2].nInteger = nResult;
+				nSP--;
+				break;
+			}
+
+			case CVIRTUALMACHINE_OPCODE_EQUAL:
+			case CVIRTUALMACHINE_OPCODE_NOT_EQUAL:
+			{
+				int32_t nCells;
+				if (nAuxCode == CVIRTUALMACHINE_AUXCODE_TYPETYPE_STRUCT_STRUCT)
+				{
+					nCells = (uint16_t) VirtualMachineReadInt16(pExtraData) / 4;
+				}
+				else if (nAuxCode == CVIRTUALMACHINE_AUXCODE_TYPETYPE_VECTOR_VECTOR)
+				{
+					nCells = 3;
+				}
+				else if ((nAuxCode >= CVIRTUALMACHINE_AUXCODE_TYPETYPE_INTEGER_INTEGER && nAuxCode <= CVIRTUALMACHINE_AUXCODE_TYPETYPE_STRING_STRING) ||
+				         (nAuxCode >= CVIRTUALMACHINE_AUXCODE_TYPETYPE_ENGST0_ENGST0 && nAuxCode <= CVIRTUALMACHINE_AUXCODE_TYPETYPE_ENGST9_ENGST9))
+				{
+					nCells = 1;
+				}
+				else
+				{
+					INVALID_AUX_CODE();
+				}
+				OPERAND_CELLS(2 * nCells);
+
+				BOOL bEqual = TRUE;
+				for (int32_t nCell = 0; nCell < nCells && bEqual; nCell++)
+				{
+					const CCell &cLeft = pStack[nSP - 2 * nCells + nCell];
+					const CCell &cRight = pStack[nSP - nCells + nCell];
+					if (cLeft.nType == CVIRTUALMACHINE_AUXCODE_TYPE_STRING || cLeft.nType == CVIRTUALMACHINE_AUXCODE_TYPE_ENGST7)
+					{
+						bEqual = (cLeft.sString == cRight.sString);
+					}
+					else if (cLeft.nType == CVIRTUALMACHINE_AUXCODE_TYPE_FLOAT)
+					{
+						bEqual = (cLeft.fFloat == cRight.fFloat);
+					}
+					else
+					{
+						bEqual = (cLeft.nInteger == cRight.nInteger);
+					}
+				}
+
+				nSP -= 2 * nCells;
+				pStack[nSP].nType = CVIRTUALMACHINE_AUXCODE_TYPE_INTEGER;
+				pStack[nSP].nInteger = (nOpCode == CVIRTUALMACHINE_OPCODE_EQUAL) ? bEqual : !bEqual;
+				nSP++;
+				break;
+			}
+
+			case CVIRTUALMACHINE_OPCODE_GEQ:
+			case CVIRTUALMACHINE_OPCODE_GT:
+			case CVIRTUALMACHINE_OPCODE_LT:
+			case CVIRTUALMACHINE_OPCODE_LEQ:
+			{
+				OPERAND_CELLS(2);
+				int32_t nCompare;
+				if (nAuxCode == CVIRTUALMACHINE_AUXCODE_TYPETYPE_INTEGER_INTEGER)
+				{
+					int32_t nLeft = pStack[nSP - 2].nInteger, nRight = pStack[nSP - 1].nInteger;
+					nCompare = (nLeft < nRight) ? -1 : (nLeft > nRight) ? 1 : 0;
+				}
+				else if (nAuxCode == CVIRTUALMACHINE_AUXCODE_TYPETYPE_FLOAT_FLOAT)
+				{
+					float fLeft = pStack[nSP - 2].fFloat, fRight = pStack[nSP - 1].fFloat;
+					nCompare = (fLeft < fRight) ? -1 : (fLeft > fRight) ? 1 : 0;
+				}
+				else
+				{
+					INVALID_AUX_CODE();
+				}
+
+				int32_t nResult = 0;
+				switch (nOpCode)
+				{
+					case CVIRTUALMACHINE_OPCODE_GEQ: nResult = (nCompare >= 0); break;
+					case CVIRTUALMACHINE_OPCODE_GT:  nResult = (nCompare > 0);  break;
+					case CVIRTUALMACHINE_OPCODE_LT:  nResult = (nCompare < 0);  break;
+					case CVIRTUALMACHINE_OPCODE_LEQ: nResult = (nCompare <= 0); break;
+				}
+				pStack[nSP - 2].nType = CVIRTUALMACHINE_AUXCODE_TYPE_INTEGER;
+				pStack[nSP - 2].nInteger = nResult;
+				nSP--;
+				break;
+			}
+
+			case CVIRTUALMACHINE_OPCODE_ADD:
+			case CVIRTUALMACHINE_OPCODE_SUB:
+			case CVIRTUALMACHINE_OPCODE_MUL:
+			case CVIRTUALMACHINE_OPCODE_DIV:
+			{
+				switch (nAuxCode)
+				{
+					case CVIRTUALMACHINE_AUXCODE_TYPETYPE_INTEGER_INTEGER:
+					{
+						OPERAND_CELLS(2);
+						// Wrap around on overflow, as the engine does.
+						uint32_t nLeft = (uint32_t) pStack[nSP - 2].nInteger, nRight = (uint32_t) pStack[nSP - 1].nInteger;
+						uint32_t nResult = 0;
+						switch (nOpCode)
+						{
+							case CVIRTUALMACHINE_OPCODE_ADD: nResult = nLeft + nRight; break;
+							case CVIRTUALMACHINE_OPCODE_SUB: nResult = nLeft - nRight; break;
+							case CVIRTUALMACHINE_OPCODE_MUL: nResult = nLeft * nRight; break;
+							case CVIRTUALMACHINE_OPCODE_DIV:
+								if (nRight == 0)
+								{
+									return OutputError(STRREF_CVIRTUALMACHINE_ERROR_DIVIDE_BY_ZERO, nOffset, "division by zero");
+								}
+								nResult = ((int32_t) nRight == -1) ? 0u - nLeft : (uint32_t) ((int32_t) nLeft / (int32_t) nRight);
+								break;
+						}
+						pStack[nSP - 2].nInteger = (int32_t) nResult;
+						nSP--;
+						break;
+					}
+
+					case CVIRTUALMACHINE_AUXCODE_TYPETYPE_INTEGER_FLOAT:
+					case CVIRTUALMACHINE_AUXCODE_TYPETYPE_FLOAT_INTEGER:
+					case CVIRTUALMACHINE_AUXCODE_TYPETYPE_FLOAT_FLOAT:
+					{
+						OPERAND_CELLS(2);
+						CCell &cLeft = pStack[nSP - 2];
+						const CCell &cRight = pStack[nSP - 1];
+						float fLeft = (nAuxCode == CVIRTUALMACHINE_AUXCODE_TYPETYPE_INTEGER_FLOAT) ? (float) cLeft.nInteger : cLeft.fFloat;
+						float fRight = (nAuxCode == CVIRTUALMACHINE_AUXCODE_TYPETYPE_FLOAT_INTEGER) ? (float) cRight.nInteger : cRight.fFloat;
+						float fResult = 0.0f;
+						switch (nOpCode)
+						{
+							case CVIRTUALMACHINE_OPCODE_ADD: fResult = fLeft + fRight; break;
+							case CVIRTUALMACHINE_OPCODE_SUB: fResult = fLeft - fRight; break;
+							case CVIRTUALMACHINE_OPCODE_MUL: fResult = fLeft * fRight; break;
+							case CVIRTUALMACHINE_OPCODE_DIV:
+								if (fRight == 0.0f)
+								{
+									return OutputError(STRREF_CVIRTUALMACHINE_ERROR_DIVIDE_BY_ZERO, nOffset, "division by zero");
+								}
+								fResult = fLeft / fRight;
+								break;
+						}
+						cLeft.nType = CVIRTUALMACHINE_AUXCODE_TYPE_FLOAT;
+						cLeft.fFloat = fResult;
+						nSP--;
+						break;
+					}
+
+					case CVIRTUALMACHINE_AUXCODE_TYPETYPE_STRING_STRING:
+						if (nOpCode != CVIRTUALMACHINE_OPCODE_ADD)
+						{
+							INVALID_AUX_CODE();
+						}
+						OPERAND_CELLS(2);
+						pStack[nSP - 2].sString += pStack[nSP - 1].sString;
+						nSP--;
+						break;
+
+					case CVIRTUALMACHINE_AUXCODE_TYPETYPE_VECTOR_VECTOR:
+						if (nOpCode != CVIRTUALMACHINE_OPCODE_ADD && nOpCode != CVIRTUALMACHINE_OPCODE_SUB)
+						{
+							INVALID_AUX_CODE();
+						}
+						OPERAND_CELLS(6);
+						for (int32_t nCell = 0; nCell < 3; nCell++)
+						{
+							float &fLeft = pStack[nSP - 6 + nCell].fFloat;
+							float fRight = pStack[nSP - 3 + nCell].fFloat;
+							fLeft = (nOpCode == CVIRTUALMACHINE_OPCODE_ADD) ? fLeft + fRight : fLeft - fRight;
+						}
+						nSP -= 3;
+						break;
+
+					case CVIRTUALMACHINE_AUXCODE_TYPETYPE_VECTOR_FLOAT:
+					case CVIRTUALMACHINE_AUXCODE_TYPETYPE_FLOAT_VECTOR:
+					{
+						if (nOpCode != CVIRTUALMACHINE_OPCODE_MUL &&
+						        (nOpCode != CVIRTUALMACHINE_OPCODE_DIV || nAuxCode != CVIRTUALMACHINE_AUXCODE_TYPETYPE_VECTOR_FLOAT))
+						{
+							INVALID_AUX_CODE();
+						}
+						OPERAND_CELLS(4);
+						BOOL bVectorFirst = (nAuxCode == CVIRTUALMACHINE_AUXCODE_TYPETYPE_VECTOR_FLOAT);
+						float fScale = pStack[bVectorFirst ? nSP - 1 : nSP - 4].fFloat;
+						if (nOpCode == CVIRTUALMACHINE_OPCODE_DIV && fScale == 0.0f)
+						{
+							return OutputError(STRREF_CVIRTUALMACHINE_ERROR_DIVIDE_BY_ZERO, nOffset, "division by zero");
+						}
+						for (int32_t nCell = 0; nCell < 3; nCell++)
+						{
+							float fComponent = pStack[(bVectorFirst ? nSP - 4 : nSP - 3) + nCell].fFloat;
+							pStack[nSP - 4 + nCell].nType = CVIRTUALMACHINE_AUXCODE_TYPE_FLOAT;
+							pStack[nSP - 4 + nCell].fFloat = (nOpCode == CVIRTUALMACHINE_OPCODE_MUL) ? fComponent * fScale : fComponent / fScale;
+						}
+						nSP--;
+						break;
+					}
+
+					default:
+						INVALID_AUX_CODE();
+				}
+				break;
+			}
+
+			case CVIRTUALMACHINE_OPCODE_NEGATION:
+				OPERAND_CELLS(1);
+				if (nAuxCode == CVIRTUALMACHINE_AUXCODE_TYPE_INTEGER)
+				{
+					pStack[nSP - 1].nInteger = (int32_t) (0u - (uint32_t) pStack[nSP - 1].nInteger);
+				}
+				else if (nAuxCode == CVIRTUALMACHINE_AUXCODE_TYPE_FLOAT)
+				{
+					pStack[nSP - 1].fFloat = -pStack[nSP - 1].fFloat;
+				}
+				else
+				{
+					INVALID_AUX_CODE();
+				}
+				break;
+
+			case CVIRTUALMACHINE_OPCODE_ONES_COMPLEMENT:
+			case CVIRTUALMACHINE_OPCODE_BOOLEAN_NOT:
+				if (nAuxCode != CVIRTUALMACHINE_AUXCODE_TYPE_INTEGER)
+				{
+					INVALID_AUX_CODE();
+				}
+				OPERAND_CELLS(1);
+				pStack[nSP - 1].nInteger = (nOpCode == CVIRTUALMACHINE_OPCODE_BOOLEAN_NOT) ? !pStack[nSP - 1].nInteger : ~pStack[nSP - 1].nInteger;
+				break;
+
+			case CVIRTUALMACHINE_OPCODE_MODIFY_STACK_POINTER:
+			{
+				int32_t nStackOffset = VirtualMachineReadInt32(pExtraData);
+				if ((nStackOffset & 3) != 0 || nStackOffset > 0)
+				{
+					return OutputError(STRREF_CVIRTUALMACHINE_ERROR_INVALID_EXTRA_DATA_ON_OP_CODE, nOffset, "MOVSP does not remove whole cells");
+				}
+				OPERAND_CELLS(-nStackOffset / 4);
+				nSP += nStackOffset / 4;
+				break;
+			}
+
+			case CVIRTUALMACHINE_OPCODE_JMP:
+				nNextOffset = nOffset + VirtualMachineReadInt32(pExtraData);
+				break;
+
+			case CVIRTUALMACHINE_OPCODE_JSR:
+				if ((int32_t) m_aReturnStack.size() >= CSCRIPTINTERPRETER_MAX_CALL_DEPTH)
+				{
+					return OutputError(STRREF_CVIRTUALMACHINE_ERROR_TOO_MANY_LEVELS_OF_RECURSION, nOffset, "too many nested calls");
+				}
+				m_aReturnStack.push_back(nNextOffset);
+				cStats.m_nCallDepthHighWater = std::max(cStats.m_nCallDepthHighWater, (int32_t) m_aReturnStack.size());
+				nNextOffset = nOffset + VirtualMachineReadInt32(pExtraData);
+				break;
+
+			case CVIRTUALMACHINE_OPCODE_JZ:
+			case CVIRTUALMACHINE_OPCODE_JNZ:
+				OPERAND_CELLS(1);
+				nSP--;
+				if ((pStack[nSP].nInteger == 0) == (nOpCode == CVIRTUALMACHINE_OPCODE_JZ))
+				{
+					nNextOffset = nOffset + VirtualMachineReadInt32(pExtraData);
+				}
+				break;
+
+			case CVIRTUALMACHINE_OPCODE_RET:
+				if (m_aReturnStack.empty())
+				{
+					return 0;
+				}
+				nNextOffset = m_aReturnStack.back();
+				m_aReturnStack.pop_back();
+				break;
+
+			case CVIRTUALMACHINE_OPCODE_DE_STRUCT:
+			{
+				int32_t nCells = (uint16_t) VirtualMachineReadInt16(pExtraData) / 4;
+				int32_t nKeepOffset = (uint16_t) VirtualMachineReadInt16(pExtraData + 2) / 4;
+				int32_t nKeepCells = (uint16_t) VirtualMachineReadInt16(pExtraData + 4) / 4;
+				OPERAND_CELLS(nCells);
+				if (nKeepOffset + nKeepCells > nCells)
+				{
+					return OutputError(STRREF_CVIRTUALMACHINE_ERROR_INVALID_EXTRA_DATA_ON_OP_CODE, nOffset, "DESTRUCT keeps more than the structure");
+				}
+				int32_t nBase = nSP - nCells;
+				if (nKeepOffset != 0)
+				{
+					for (int32_t nCell = 0; nCell < nKeepCells; nCell++)
+					{
+						pStack[nBase + nCell] = std::move(pStack[nBase + nKeepOffset + nCell]);
+					}
+				}
+				nSP = nBase + nKeepCells;
+				break;
+			}
+
+			case CVIRTUALMACHINE_OPCODE_DECREMENT:
+			case CVIRTUALMACHINE_OPCODE_INCREMENT:
+			case CVIRTUALMACHINE_OPCODE_DECREMENT_BASE:
+			case CVIRTUALMACHINE_OPCODE_INCREMENT_BASE:
+			{
+				int32_t nStackOffset = VirtualMachineReadInt32(pExtraData);
+				BOOL bBase = (nOpCode == CVIRTUALMACHINE_OPCODE_DECREMENT_BASE || nOpCode == CVIRTUALMACHINE_OPCODE_INCREMENT_BASE);
+				int32_t nLocation = (bBase ? m_nBasePointer : nSP) + nStackOffset / 4;
+				if ((nStackOffset & 3) != 0 || nLocation < 0 || nLocation >= nSP)
+				{
+					return OutputError(STRREF_CVIRTUALMACHINE_ERROR_STACK_UNDERFLOW, nOffset, "stack offset outside of the stack");
+				}
+				BOOL bIncrement = (nOpCode == CVIRTUALMACHINE_OPCODE_INCREMENT || nOpCode == CVIRTUALMACHINE_OPCODE_INCREMENT_BASE);
+				pStack[nLocation].nInteger = (int32_t) ((uint32_t) pStack[nLocation].nInteger + (bIncrement ? 1u : 0xffffffffu));
+				break;
+			}
+
+			case CVIRTUALMACHINE_OPCODE_SAVE_BASE_POINTER:
+				pStack[nSP].nType = CVIRTUALMACHINE_AUXCODE_TYPE_INTEGER;
+				pStack[nSP].nInteger = m_nBasePointer;
+				m_nBasePointer = nSP;
+				nSP++;
+				break;
+
+			case CVIRTUALMACHINE_OPCODE_RESTORE_BASE_POINTER:
+				OPERAND_CELLS(1);
+				nSP--;
+				m_nBasePointer = pStack[nSP].nInteger;
+				break;
+
+			case CVIRTUALMACHINE_OPCODE_STORE_STATE:
+			{
+				// The action argument starts right after this and the JMP
+				// around it.  It gets copies of the globals and of the
+				// locals it can see.
+				int32_t nBaseCells = VirtualMachineReadInt32(pExtraData) / 4;
+				int32_t nStackCells = VirtualMachineReadInt32(pExtraData + 4) / 4;
+				if (nBaseCells < 0 || nBaseCells > m_nBasePointer || nStackCells < 0 || nStackCells > nSP)
+				{
+					return OutputError(STRREF_CVIRTUALMACHINE_ERROR_STACK_UNDERFLOW, nOffset, "STORE_STATE saves more than the stack");
+				}
+				CSavedState cState;
+				cState.m_nOffset = nOffset + nAuxCode;
+				cState.m_aBaseStack.assign(pStack + m_nBasePointer - nBaseCells, pStack + m_nBasePointer);
+				cState.m_aStack.assign(pStack + nSP - nStackCells, pStack + nSP);
+				m_aStoredStates.push_back(std::move(cState));
+				break;
+			}
+
+			case CVIRTUALMACHINE_OPCODE_NO_OPERATION:
+				break;
+
+			default:
+				return OutputError(STRREF_CVIRTUALMACHINE_ERROR_INVALID_OP_CODE, nOffset, "unknown instruction");
+		}
+
+		#undef OPERAND_CELLS
+		#undef INVALID_AUX_CODE
+
+		if (m_nStackPointer > nStackHighWater)
+		{
+			nStackHighWater = m_nStackPointer;
+			cStats.m_nStackHighWater = nStackHighWater * 4;
+		}
+
+		nOffset = nNextOffset;
+	}
+}
+
+int32_t CScriptInterpreter::ExecuteAction(int32_t nOffset, int32_t nAction, int32_t nArguments)
+{
+	if (nAction >= (int32_t) m_aActions.size())
+	{
+		return OutputError(STRREF_CVIRTUALMACHINE_ERROR_INVALID_COMMAND, nOffset, "unknown action (is the action specification loaded?)");
+	}
+
+	CAction &cAction = m_aActions[nAction];
+	if (nArguments > (int32_t) cAction.m_aParameterTypes.size())
+	{
+		return OutputError(STRREF_CVIRTUALMACHINE_ERROR_INVALID_COMMAND, nOffset, "too many arguments for the action");
+	}
+
+	int32_t nCells = 0;
+	for (int32_t nArgument = 0; nArgument < nArguments; nArgument++)
+	{
+		uint8_t nType = cAction.m_aParameterTypes[nArgument];
+		nCells += GetTypeSize(nType);
+
+		// Action arguments were saved by STORE_STATE rather than pushed.
+		if (nType == CVIRTUALMACHINE_AUXCODE_TYPE_COMMAND)
+		{
+			if (m_aStoredStates.empty())
+			{
+				return OutputError(STRREF_CVIRTUALMACHINE_ERROR_INVALID_COMMAND, nOffset, "action argument without STORE_STATE");
+			}
+			m_aDeferredActions.push_back(std::move(m_aStoredStates.back()));
+			m_aStoredStates.pop_back();
+		}
+	}
+
+	if (m_nStackPointer < nCells)
+	{
+		return OutputError(STRREF_CVIRTUALMACHINE_ERROR_STACK_UNDERFLOW, nOffset, "stack underflow");
+	}
+	m_nStackPointer -= nCells;
+
+	uint64_t nCall = m_cStatistics.m_aActionCalls[nAction]++;
+
+	int32_t nReturnCells = GetTypeSize(cAction.m_nReturnType);
+	if (nReturnCells == 0)
+	{
+		return 0;
+	}
+	if (!GrowStack(nReturnCells))
+	{
+		return OutputError(STRREF_CVIRTUALMACHINE_ERROR_STACK_OVERFLOW, nOffset, "stack overflow");
+	}
+
+	if (!cAction.m_aReturnValues.empty())
+	{
+		const std::vector<CCell> &aValue = cAction.m_aReturnValues[(size_t) std::min<uint64_t>(nCall, cAction.m_aReturnValues.size() - 1)];
+		for (const CCell &cCell : aValue)
+		{
+			m_aStack[m_nStackPointer++] = cCell;
+		}
+		return 0;
+	}
+
+	// Defaults: zero, an empty string or OBJECT_INVALID.
+	for (int32_t nCell = 0; nCell < nReturnCells; nCell++)
+	{
+		CCell &cCell = m_aStack[m_nStackPointer++];
+		cCell.nType = (cAction.m_nReturnType == CSCRIPTINTERPRETER_TYPE_VECTOR) ? CVIRTUALMACHINE_AUXCODE_TYPE_FLOAT : cAction.m_nReturnType;
+		cCell.nInteger = 0;
+		cCell.sString.clear();
+		if (cCell.nType == CVIRTUALMACHINE_AUXCODE_TYPE_OBJECT)
+		{
+			cCell.oidObject = INVALID_OBJECT_ID;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,172 @@
+//
+// SPDX-License-Identifier: GPL-3.0
+//
+// This file is part of the NWScript compiler open source release.
+//
+// The initial source release is licensed under GPL-3.0.
+//
+// All subsequent changes you submit are required to be licensed under MIT.
+//
+// However, the project overall will still be GPL-3.0.
+//
+// The intent is for the base game to be able to pick up changes you explicitly
+// submit for inclusion painlessly, while ensuring the overall project source code
+// remains available for everyone.
+//
+
+//::///////////////////////////////////////////////////////////////////////////
+//::
+//::  ScriptInterp.h
+//::
+//::  A reference interpreter for compiled scripts (.ncs), used to measure what
+//::  the generated code costs to run.  Engine actions are not implemented:
+//::  every ACTION is a stub that pops its arguments, counts the call and
+//::  pushes a configurable return value.  Nothing here depends on the engine
+//::  or on Windows, so it builds anywhere the compiler does.
+//::
+//::///////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "exobase.h"
+
+#define CSCRIPTINTERPRETER_DEFAULT_MAX_INSTRUCTIONS  10000000
+#define CSCRIPTINTERPRETER_MAX_STACK_CELLS           1048576
+#define CSCRIPTINTERPRETER_MAX_CALL_DEPTH            65536
+
+// Per-run counters.  Everything but the times is deterministic for a given
+// script and stub configuration.
+class CScriptInterpreterStatistics
+{
+public:
+	uint64_t m_nInstructions = 0;
+	uint64_t m_aOpCodeCount[256] = {};
+	int32_t  m_nStackHighWater = 0;       // in bytes, like the stack offsets
+	int32_t  m_nCallDepthHighWater = 0;
+	uint64_t m_nDeferredActions = 0;      // action arguments run after the script
+	std::vector<uint64_t> m_aActionCalls; // by action id
+	int64_t  m_nNanoseconds = 0;
+};
+
+class CScriptInterpreter
+{
+public:
+	CScriptInterpreter();
+
+	///////////////////////////////////////////////////////////////////////
+	int32_t LoadActionSpecification(const char *pchSource, size_t nLength);
+	//---------------------------------------------------------------------
+	// Desc.: Reads the engine action prototypes (nwscript.nss) so that
+	//        ACTION knows how much stack each call takes and gives back.
+	//        Actions are numbered in the order they are declared, as the
+	//        compiler does.  Returns the number of actions, or a negative
+	//        error code.
+	///////////////////////////////////////////////////////////////////////
+
+	///////////////////////////////////////////////////////////////////////
+	BOOL SetActionReturnValues(const std::string &sAction, const std::vector<std::string> &asValues);
+	//---------------------------------------------------------------------
+	// Desc.: Sets what the stub of an action returns: the n-th call gets
+	//        the n-th value, and the last value repeats.  Values are read
+	//        as the return type of the action (vectors as "x y z").  The
+	//        sequence restarts on every run.  Returns FALSE if there is no
+	//        such action or it returns void.
+	///////////////////////////////////////////////////////////////////////
+
+	void SetMaxInstructions(uint64_t nMaxInstructions) { m_nMaxInstructions = nMaxInstructions; }
+	void SetRunDeferredActions(BOOL bValue) { m_bRunDeferredActions = bValue; }
+	void SetObjectSelf(uint32_t oidSelf) { m_oidSelf = oidSelf; }
+
+	int32_t GetActionCount() const { return (int32_t) m_aActions.size(); }
+	const std::string &GetActionName(int32_t nAction) const { return m_aActions[nAction].m_sName; }
+
+	///////////////////////////////////////////////////////////////////////
+	int32_t RunScript(const uint8_t *pCode, int32_t nCodeLength);
+	//---------------------------------------------------------------------
+	// Desc.: Runs a compiled script from its first instruction until it
+	//        returns, then runs the action arguments it handed to the
+	//        stubs (DelayCommand, AssignCommand, ...) unless that is
+	//        turned off.  Returns 0, or a negative STRREF_CVIRTUALMACHINE
+	//        error code with the offset and a reason kept for GetError().
+	///////////////////////////////////////////////////////////////////////
+
+	const CScriptInterpreterStatistics &GetStatistics() const { return m_cStatistics; }
+	const std::string &GetError() const { return m_sError; }
+	int32_t GetErrorOffset() const { return m_nErrorOffset; }
+
+	// The integer a conditional script (StartingConditional) left behind.
+	BOOL GetReturnValue(int32_t &nValue) const;
+
+	// The usual mnemonic of an opcode, or NULL for an unknown one.
+	static const char *GetOpCodeName(uint8_t nOpCode);
+
+private:
+	class CCell
+	{
+	public:
+		uint8_t nType = 0;
+		union
+		{
+			int32_t  nInteger = 0;
+			float    fFloat;
+			uint32_t oidObject;
+		};
+		std::string sString;
+	};
+
+	class CAction
+	{
+	public:
+		std::string m_sName;
+		uint8_t m_nReturnType = 0;
+		std::vector<uint8_t> m_aParameterTypes;
+		std::vector<std::vector<CCell>> m_aReturnValues;
+	};
+
+	class CSavedState
+	{
+	public:
+		int32_t m_nOffset = 0;
+		std::vector<CCell> m_aBaseStack;
+		std::vector<CCell> m_aStack;
+	};
+
+	int32_t Execute(int32_t nOffset);
+	int32_t ExecuteAction(int32_t nOffset, int32_t nAction, int32_t nArguments);
+	int32_t RunDeferredAction(CSavedState &cState);
+	int32_t OutputError(int32_t nError, int32_t nOffset, const char *pchReason);
+
+	BOOL GrowStack(int32_t nCells);
+	BOOL ParseValue(uint8_t nType, const std::string &sValue, std::vector<CCell> &aCells) const;
+	static uint8_t GetTypeFromName(const std::string &sType, const std::unordered_map<std::string, uint8_t> &aEngineStructures);
+	static int32_t GetTypeSize(uint8_t nType);
+
+	std::vector<CAction> m_aActions;
+	std::unordered_map<std::string, int32_t> m_aActionByName;
+
+	uint64_t m_nMaxInstructions;
+	BOOL     m_bRunDeferredActions;
+	uint32_t m_oidSelf;
+
+	const uint8_t *m_pCode;
+	int32_t m_nCodeLength;
+	std::vector<int32_t> m_aInstructionSize;  // 0 where no instruction starts
+
+	std::vector<CCell> m_aStack;
+	int32_t m_nStackPointer;  // in cells
+	int32_t m_nBasePointer;   // in cells
+	std::vector<int32_t> m_aReturnStack;
+	std::vector<CSavedState> m_aStoredStates;
+	std::vector<CSavedState> m_aDeferredActions;
+
+	CScriptInterpreterStatistics m_cStatistics;
+	std::string m_sError;
+	int32_t m_nErrorOffset;
+	BOOL    m_bHasReturnValue;
+	int32_t m_nReturnValue;
+};
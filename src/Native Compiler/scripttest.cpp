@@ -0,0 +1,761 @@
+//
+// SPDX-License-Identifier: GPL-3.0
+//
+// This file is part of the NWScript compiler open source release.
+//
+// The initial source release is licensed under GPL-3.0.
+//
+// All subsequent changes you submit are required to be licensed under MIT.
+//
+// However, the project overall will still be GPL-3.0.
+//
+// The intent is for the base game to be able to pick up changes you explicitly
+// submit for inclusion painlessly, while ensuring the overall project source code
+// remains available for everyone.
+//
+
+//::///////////////////////////////////////////////////////////////////////////
+//::
+//::  ScriptTest.cpp
+//::
+//::  Compiles the scripts of the tests directory with and without global
+//::  variable folding and loop rotation, runs them in CScriptInterpreter and
+//::  checks what each script says about itself in its "// scripttest:"
+//::  lines:
+//::
+//::    // scripttest: return <value>
+//::    // scripttest: <flags> <OPCODE>=<count> [<OPCODE>=<count> ...]
+//::
+//::  The return value must come out at every optimization level; opcode
+//::  counts are the instructions executed at that level only.  Every
+//::  compile also runs the final code verifier, and the line records of the
+//::  debug file are checked against the code and the sources.  A few
+//::  scripts too large to check in are generated on the fly; run the tests
+//::  on the 1 MB stack the plugin's worker threads have, so that deep
+//::  recursion shows up.  Not part of the plugin project; build it on its
+//::  own:
+//::
+//::    g++ -std=c++17 -O2 -o scripttest scripttest.cpp scriptcomp*.cpp scriptinterp.cpp exostring.cpp -x c xxhash.c
+//::    (ulimit -s 1024 && ./scripttest tests)
+//::
+//::  With -b, it times the compiler on generated scripts, and on the
+//::  scripts of the tests directory as a batch, instead.
+//::
+//::///////////////////////////////////////////////////////////////////////////
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <new>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "exobase.h"
+#include "scriptcomp.h"
+#include "scriptinternal.h"
+#include "scriptinterp.h"
+
+// Optimization levels every script is compiled at: everything but global
+// variable folding and loop rotation, everything but loop rotation, and
+// everything.
+static const uint32_t g_anOptimizationFlags[] = { 0x07, 0x0f, 0x1f };
+
+// The tests call no actions; they only need the constants, and a few
+// prototypes keep the identifier specification from being empty.
+static const char g_pchActionSpecification[] =
+	"int TRUE = 1;\n"
+	"int FALSE = 0;\n"
+	"void PrintString(string s);\n"
+	"void PrintInteger(int n);\n"
+	"int Random(int n);\n";
+
+// Every allocation of the process goes through here, so that the benchmarks
+// can count what a compile allocates.
+static uint64_t g_nAllocations = 0;
+
+void *operator new(size_t nSize)
+{
+	++g_nAllocations;
+	void *pMemory = malloc(nSize != 0 ? nSize : 1);
+	if (pMemory == NULL)
+	{
+		throw std::bad_alloc();
+	}
+	return pMemory;
+}
+
+void operator delete(void *pMemory) noexcept
+{
+	free(pMemory);
+}
+
+void operator delete(void *pMemory, size_t nSize) noexcept
+{
+	free(pMemory);
+}
+
+static std::map<std::string, std::string> g_aSources;
+static std::string g_sCode;
+static std::string g_sDebuggerCode;
+
+static const char *LoadScriptSourceFile(const char *pchFileName, RESTYPE nResType)
+{
+	auto itSource = g_aSources.find(pchFileName);
+	if (nResType != 2009 || itSource == g_aSources.end())
+	{
+		return NULL;
+	}
+	return itSource->second.c_str();
+}
+
+static int32_t WriteToFile(const char *pchFileName, RESTYPE nResType, const uint8_t *pData, size_t nSize, bool bBinary)
+{
+	(nResType == 2010 ? g_sCode : g_sDebuggerCode).assign((const char *) pData, nSize);
+	return 0;
+}
+
+static const char *TlkResolve(STRREF nStrRef)
+{
+	static char pchError[32];
+	snprintf(pchError, sizeof(pchError), "error %d", (int) nStrRef);
+	return pchError;
+}
+
+static BOOL UpdateResourceDirectory(const char *pchAlias)
+{
+	return TRUE;
+}
+
+CScriptCompilerAPI CScriptCompiler::MakeDefaultAPI()
+{
+	CScriptCompilerAPI cAPI;
+	cAPI.ResManLoadScriptSourceFile = LoadScriptSourceFile;
+	cAPI.ResManWriteToFile = WriteToFile;
+	cAPI.TlkResolve = TlkResolve;
+	cAPI.ResManUpdateResourceDirectory = UpdateResourceDirectory;
+	return cAPI;
+}
+
+class CScriptTest
+{
+public:
+	std::string m_sName;
+	BOOL m_bHasReturnValue = FALSE;
+	int32_t m_nReturnValue = 0;
+	std::map<uint32_t, std::map<uint8_t, uint64_t>> m_aOpCodeCounts;  // by optimization flags
+};
+
+static int32_t g_nFailures = 0;
+
+static void Fail(const std::string &sTest, uint32_t nFlags, const std::string &sMessage)
+{
+	++g_nFailures;
+	printf("%s (0x%02x): FAILED: %s\n", sTest.c_str(), nFlags, sMessage.c_str());
+}
+
+static int32_t FindOpCode(const std::string &sName)
+{
+	for (int32_t nOpCode = 0; nOpCode < 256; nOpCode++)
+	{
+		const char *pchName = CScriptInterpreter::GetOpCodeName((uint8_t) nOpCode);
+		if (pchName != NULL && sName == pchName)
+		{
+			return nOpCode;
+		}
+	}
+	return -1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  ParseExpectations()
+///////////////////////////////////////////////////////////////////////////////
+//  Description: Reads the "// scripttest:" lines of a script.  Returns FALSE
+//               when one of them cannot be understood, so that a typo can't
+//               turn a check off.
+///////////////////////////////////////////////////////////////////////////////
+
+static BOOL ParseExpectations(const std::string &sSource, CScriptTest &cTest)
+{
+	static const char pchPrefix[] = "// scripttest:";
+	std::istringstream cLines(sSource);
+	std::string sLine;
+
+	while (std::getline(cLines, sLine))
+	{
+		if (sLine.compare(0, sizeof(pchPrefix) - 1, pchPrefix) != 0)
+		{
+			continue;
+		}
+
+		std::istringstream cWords(sLine.substr(sizeof(pchPrefix) - 1));
+		std::string sWord;
+		cWords >> sWord;
+
+		if (sWord == "return")
+		{
+			if (!(cWords >> cTest.m_nReturnValue))
+			{
+				return FALSE;
+			}
+			cTest.m_bHasReturnValue = TRUE;
+			continue;
+		}
+
+		char *pchEnd;
+		uint32_t nFlags = (uint32_t) strtoul(sWord.c_str(), &pchEnd, 0);
+		if (sWord.empty() || *pchEnd != '\0' ||
+		    std::find(std::begin(g_anOptimizationFlags), std::end(g_anOptimizationFlags), nFlags) == std::end(g_anOptimizationFlags))
+		{
+			return FALSE;
+		}
+
+		auto &aCounts = cTest.m_aOpCodeCounts[nFlags];
+		while (cWords >> sWord)
+		{
+			size_t nEquals = sWord.find('=');
+			int32_t nOpCode = FindOpCode(sWord.substr(0, nEquals));
+			if (nEquals == std::string::npos || nOpCode < 0)
+			{
+				return FALSE;
+			}
+			aCounts[(uint8_t) nOpCode] = strtoull(sWord.c_str() + nEquals + 1, NULL, 10);
+		}
+	}
+	return cTest.m_bHasReturnValue;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  CheckLineNumbers()
+///////////////////////////////////////////////////////////////////////////////
+//  Description: Checks the line records of the debug file: every record
+//               names a file of the compile and a line that file has, covers
+//               code that exists (lines without code, like case labels, get an
+//               empty record), and the records come in code order without
+//               overlapping.  Returns the (file, line) pairs that have code.
+///////////////////////////////////////////////////////////////////////////////
+
+static std::set<std::pair<std::string, int32_t>> CheckLineNumbers(const CScriptTest &cTest, uint32_t nFlags)
+{
+	std::set<std::pair<std::string, int32_t>> aLines;
+	std::vector<std::string> asFileNames;
+	std::istringstream cRecords(g_sDebuggerCode);
+	std::string sRecord;
+	int32_t nPreviousEnd = CVIRTUALMACHINE_BINARY_SCRIPT_HEADER;
+
+	while (std::getline(cRecords, sRecord))
+	{
+		if ((sRecord[0] == 'N' || sRecord[0] == 'n') && isdigit((unsigned char) sRecord[1]))
+		{
+			asFileNames.push_back(sRecord.substr(sRecord.find(' ') + 1));
+			continue;
+		}
+		if (sRecord[0] != 'l')
+		{
+			continue;
+		}
+
+		uint32_t nFile, nLine, nStart, nEnd;
+		if (sscanf(sRecord.c_str() + 1, "%u %u %x %x", &nFile, &nLine, &nStart, &nEnd) != 4 || nFile >= asFileNames.size())
+		{
+			Fail(cTest.m_sName, nFlags, "bad line record: " + sRecord);
+			continue;
+		}
+
+		const std::string &sFileName = asFileNames[nFile];
+		auto itSource = g_aSources.find(sFileName);
+		int32_t nLineCount = (itSource == g_aSources.end()) ? 0 :
+			(int32_t) std::count(itSource->second.begin(), itSource->second.end(), '\n') + 1;
+
+		if (nLine < 1 || (int32_t) nLine > nLineCount)
+		{
+			Fail(cTest.m_sName, nFlags, "line record past the end of " + sFileName + ": " + sRecord);
+		}
+		if (nStart > nEnd || nEnd > g_sCode.size())
+		{
+			Fail(cTest.m_sName, nFlags, "line record outside of the code: " + sRecord);
+		}
+		if ((int32_t) nStart < nPreviousEnd)
+		{
+			Fail(cTest.m_sName, nFlags, "line record out of order: " + sRecord);
+		}
+		nPreviousEnd = std::max(nPreviousEnd, (int32_t) nEnd);
+		aLines.emplace(sFileName, (int32_t) nLine);
+	}
+	return aLines;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  RunTest()
+///////////////////////////////////////////////////////////////////////////////
+//  Description: Compiles and runs one script at every optimization level.
+///////////////////////////////////////////////////////////////////////////////
+
+static void RunTest(CScriptCompiler &cCompiler, CScriptInterpreter &cInterpreter, const CScriptTest &cTest)
+{
+	std::map<uint32_t, std::set<std::pair<std::string, int32_t>>> aFirstLines;
+
+	for (uint32_t nFlags : g_anOptimizationFlags)
+	{
+		g_sCode.clear();
+		g_sDebuggerCode.clear();
+		cCompiler.SetOptimizationFlags(nFlags);
+
+		if (cCompiler.CompileFile(cTest.m_sName.c_str()) < 0 || g_sCode.empty())
+		{
+			Fail(cTest.m_sName, nFlags, std::string("does not compile: ") + cCompiler.GetCapturedError()->CStr());
+			continue;
+		}
+
+		// The code is only run once the verifier has accepted it, so every
+		// run below also checks the verifier.
+		if (cInterpreter.RunScript((const uint8_t *) g_sCode.data(), (int32_t) g_sCode.size()) != 0)
+		{
+			Fail(cTest.m_sName, nFlags, "run failed: " + cInterpreter.GetError());
+			continue;
+		}
+
+		const CScriptInterpreterStatistics &cStatistics = cInterpreter.GetStatistics();
+		int32_t nReturnValue;
+		BOOL bHasReturnValue = cInterpreter.GetReturnValue(nReturnValue);
+
+		printf("%-24s 0x%02x  returned %-10d JMP=%llu JZ=%llu JNZ=%llu  (%llu instructions)\n",
+		       cTest.m_sName.c_str(), nFlags, bHasReturnValue ? nReturnValue : 0,
+		       (unsigned long long) cStatistics.m_aOpCodeCount[CVIRTUALMACHINE_OPCODE_JMP],
+		       (unsigned long long) cStatistics.m_aOpCodeCount[CVIRTUALMACHINE_OPCODE_JZ],
+		       (unsigned long long) cStatistics.m_aOpCodeCount[CVIRTUALMACHINE_OPCODE_JNZ],
+		       (unsigned long long) cStatistics.m_nInstructions);
+
+		if (!bHasReturnValue || nReturnValue != cTest.m_nReturnValue)
+		{
+			Fail(cTest.m_sName, nFlags, "expected to return " + std::to_string(cTest.m_nReturnValue));
+		}
+
+		auto itCounts = cTest.m_aOpCodeCounts.find(nFlags);
+		if (itCounts != cTest.m_aOpCodeCounts.end())
+		{
+			for (const auto &cCount : itCounts->second)
+			{
+				if (cStatistics.m_aOpCodeCount[cCount.first] != cCount.second)
+				{
+					Fail(cTest.m_sName, nFlags, std::string("expected ") + CScriptInterpreter::GetOpCodeName(cCount.first) + "=" +
+					     std::to_string(cCount.second) + ", executed " + std::to_string(cStatistics.m_aOpCodeCount[cCount.first]));
+				}
+			}
+		}
+
+		// Moving code around must not lose a line or invent one.  Folding a
+		// global variable drops the code of its declaration, so only levels
+		// that agree on global variable folding map the same lines.
+		std::set<std::pair<std::string, int32_t>> aLines = CheckLineNumbers(cTest, nFlags);
+		auto itFirstLines = aFirstLines.emplace(nFlags & CSCRIPTCOMPILER_OPTIMIZE_GLOBAL_VARIABLES, aLines).first;
+		if (aLines != itFirstLines->second)
+		{
+			Fail(cTest.m_sName, nFlags, "the debug file maps other lines than at the first level that folds the same globals");
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  GenerateTests()
+///////////////////////////////////////////////////////////////////////////////
+//  Description: Adds the scripts too large to keep in the tests directory:
+//               100k term operator chains and a 5k branch else-if ladder.
+//               Their parse trees nest as deep as they are long, so they fail
+//               (or take minutes) as soon as something walks or folds the
+//               trees recursively again.
+///////////////////////////////////////////////////////////////////////////////
+
+static void GenerateTests(std::vector<CScriptTest> &aTests)
+{
+	const int32_t nTerms = 100000;
+	const int32_t nBranches = 5000;
+
+	auto AddTest = [&aTests](const char *pchName, const std::string &sSource, int32_t nReturnValue)
+	{
+		CScriptTest cTest;
+		cTest.m_sName = pchName;
+		cTest.m_bHasReturnValue = TRUE;
+		cTest.m_nReturnValue = nReturnValue;
+		g_aSources[pchName] = sSource;
+		aTests.push_back(std::move(cTest));
+	};
+
+	// Folded into one constant.
+	std::string sSource = "int StartingConditional()\n{\n    return 0";
+	int32_t nSum = 0;
+	for (int32_t nTerm = 1; nTerm < nTerms; nTerm++)
+	{
+		sSource += (nTerm % 3 == 0) ? " - " : " + ";
+		sSource += std::to_string(nTerm % 10);
+		nSum += (nTerm % 3 == 0) ? -(nTerm % 10) : nTerm % 10;
+	}
+	AddTest("gen_constant_chain", sSource + ";\n}\n", nSum);
+
+	// Left to run time.
+	sSource = "int StartingConditional()\n{\n    int a = 1;\n    int b = 2;\n    return a";
+	for (int32_t nTerm = 1; nTerm < nTerms; nTerm++)
+	{
+		sSource += (nTerm % 2 == 0) ? " + a" : " + b";
+	}
+	AddTest("gen_variable_chain", sSource + ";\n}\n", nTerms / 2 + (nTerms / 2) * 2);
+
+	// Constants and variables mixed, so only parts of the chain fold.
+	sSource = "int StartingConditional()\n{\n    string e = \"\";\n    return (\"ab\"";
+	for (int32_t nTerm = 1; nTerm < nTerms; nTerm++)
+	{
+		sSource += (nTerm % 2 == 0) ? " + e" : " + \"\"";
+	}
+	AddTest("gen_string_chain", sSource + " + \"cd\") == \"abcd\";\n}\n", 1);
+
+	sSource = "int Classify(int n)\n{\n    if (n == 0)\n    {\n        return 1;\n    }\n";
+	for (int32_t nBranch = 1; nBranch < nBranches; nBranch++)
+	{
+		sSource += "    else if (n == " + std::to_string(nBranch) + ")\n    {\n        return " + std::to_string(nBranch + 1) + ";\n    }\n";
+	}
+	sSource += "    else\n    {\n        return -1;\n    }\n    return 0;\n}\n\n"
+	           "int StartingConditional()\n{\n    return Classify(0) + Classify(2500) * 2 + Classify(4999) * 3 + Classify(5000);\n}\n";
+	AddTest("gen_else_if_ladder", sSource, 1 + 2501 * 2 + 5000 * 3 - 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  TimeCompile()
+///////////////////////////////////////////////////////////////////////////////
+//  Description: Compiles a script nRuns times and returns the fastest run in
+//               milliseconds, or a negative value if it does not compile.
+//               pnReachabilityMicroseconds receives the fastest time spent
+//               in DetermineLocationOfCode().
+///////////////////////////////////////////////////////////////////////////////
+
+static double TimeCompile(CScriptCompiler &cCompiler, const std::string &sName, int32_t nRuns, int64_t *pnReachabilityMicroseconds = NULL)
+{
+	double fBest = 0.0;
+	for (int32_t nRun = 0; nRun < nRuns; nRun++)
+	{
+		auto tStart = std::chrono::steady_clock::now();
+		if (cCompiler.CompileFile(sName.c_str()) < 0)
+		{
+			Fail(sName, cCompiler.GetOptimizationFlags(), std::string("does not compile: ") + cCompiler.GetCapturedError()->CStr());
+			return -1.0;
+		}
+		double fMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tStart).count();
+		fBest = (nRun == 0) ? fMilliseconds : std::min(fBest, fMilliseconds);
+
+		if (pnReachabilityMicroseconds != NULL)
+		{
+			int64_t nMicroseconds = cCompiler.GetDetermineLocationOfCodeMicroseconds();
+			*pnReachabilityMicroseconds = (nRun == 0) ? nMicroseconds : std::min(*pnReachabilityMicroseconds, nMicroseconds);
+		}
+	}
+	return fBest;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  BenchmarkReachability()
+///////////////////////////////////////////////////////////////////////////////
+//  Description: A script pulling in a 2,000 function include, all of it
+//               reachable: every function calls the next one and one
+//               further away, so the call graph is more than a chain.
+///////////////////////////////////////////////////////////////////////////////
+
+static void BenchmarkReachability(CScriptCompiler &cCompiler)
+{
+	const int32_t nFunctions = 2000;
+
+	std::string sInclude;
+	for (int32_t nFunction = 0; nFunction < nFunctions; nFunction++)
+	{
+		sInclude += "int Function" + std::to_string(nFunction) + "(int n);\n";
+	}
+	for (int32_t nFunction = 0; nFunction < nFunctions; nFunction++)
+	{
+		sInclude += "\nint Function" + std::to_string(nFunction) + "(int n)\n{\n    if (n <= 0)\n    {\n        return " +
+		            std::to_string(nFunction) + ";\n    }\n";
+		if (nFunction + 1 < nFunctions)
+		{
+			sInclude += "    if (n % 2 == 0)\n    {\n        return Function" + std::to_string(nFunction + 1) + "(n - 1);\n    }\n";
+		}
+		sInclude += "    return Function" + std::to_string((nFunction * 7 + 3) % nFunctions) + "(n - 2);\n}\n";
+	}
+	g_aSources["bench_reach_inc"] = sInclude;
+	g_aSources["bench_reach"] = "#include \"bench_reach_inc\"\n\nint StartingConditional()\n{\n    return Function0(10);\n}\n";
+
+	int64_t nReachabilityMicroseconds = 0;
+	double fMilliseconds = TimeCompile(cCompiler, "bench_reach", 20, &nReachabilityMicroseconds);
+	if (fMilliseconds >= 0.0)
+	{
+		printf("reachability: %d function include, compile %.2f ms, reachability %.3f ms\n",
+		       nFunctions, fMilliseconds, nReachabilityMicroseconds / 1000.0);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  BenchmarkDebuggerOutput()
+///////////////////////////////////////////////////////////////////////////////
+//  Description: 100 functions of 100 blocks with 10 locals each, so about
+//               100k variables enter and leave scope.  Compiled with and
+//               without the debug file; the ratio is what the symbol table
+//               bookkeeping costs.
+///////////////////////////////////////////////////////////////////////////////
+
+static void BenchmarkDebuggerOutput(CScriptCompiler &cCompiler)
+{
+	const int32_t nFunctions = 100;
+	const int32_t nBlocks = 100;
+	const int32_t nLocals = 10;
+
+	std::string sSource;
+	for (int32_t nFunction = 0; nFunction < nFunctions; nFunction++)
+	{
+		sSource += "int Function" + std::to_string(nFunction) + "(int n)\n{\n    int nSum = n;\n";
+		for (int32_t nBlock = 0; nBlock < nBlocks; nBlock++)
+		{
+			sSource += "    {\n        int nLocal0 = nSum + " + std::to_string(nBlock) + ";\n";
+			for (int32_t nLocal = 1; nLocal < nLocals; nLocal++)
+			{
+				sSource += "        int nLocal" + std::to_string(nLocal) + " = nLocal" + std::to_string(nLocal - 1) + " + 1;\n";
+			}
+			sSource += "        nSum = nLocal" + std::to_string(nLocals - 1) + " % 1000;\n    }\n";
+		}
+		sSource += "    return nSum;\n}\n\n";
+	}
+	sSource += "int StartingConditional()\n{\n    int nSum = 0;\n";
+	for (int32_t nFunction = 0; nFunction < nFunctions; nFunction++)
+	{
+		sSource += "    nSum += Function" + std::to_string(nFunction) + "(" + std::to_string(nFunction) + ");\n";
+	}
+	g_aSources["bench_debug"] = sSource + "    return nSum;\n}\n";
+
+	cCompiler.SetGenerateDebuggerOutput(FALSE);
+	double fWithout = TimeCompile(cCompiler, "bench_debug", 5);
+	cCompiler.SetGenerateDebuggerOutput(TRUE);
+	double fWith = TimeCompile(cCompiler, "bench_debug", 5);
+	cCompiler.SetGenerateDebuggerOutput(FALSE);
+
+	if (fWithout > 0.0 && fWith > 0.0)
+	{
+		printf("debugger output: %d scoped locals, compile %.2f ms without, %.2f ms with, ratio %.2f\n",
+		       nFunctions * nBlocks * nLocals, fWithout, fWith, fWith / fWithout);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  BenchmarkStructures()
+///////////////////////////////////////////////////////////////////////////////
+//  Description: 150 structures of 20 fields, each but the first also holding
+//               an earlier one (nested at most three deep), and a function
+//               per structure that reads and writes every field in a loop.
+//               Member access resolves the structure and field by name each
+//               time.
+///////////////////////////////////////////////////////////////////////////////
+
+static void BenchmarkStructures(CScriptCompiler &cCompiler)
+{
+	const int32_t nStructures = 150;
+	const int32_t nFields = 20;
+
+	std::string sSource;
+	for (int32_t nStructure = 0; nStructure < nStructures; nStructure++)
+	{
+		std::string sStructure = std::to_string(nStructure);
+		sSource += "struct Structure" + sStructure + "\n{\n";
+		for (int32_t nField = 0; nField < nFields; nField++)
+		{
+			sSource += "    int nField" + std::to_string(nField) + ";\n";
+		}
+		if (nStructure > 0)
+		{
+			sSource += "    struct Structure" + std::to_string(nStructure / 10) + " sInner;\n";
+		}
+		sSource += "};\n\n";
+
+		sSource += "int UseStructure" + sStructure + "(int n)\n{\n    struct Structure" + sStructure + " s;\n"
+		           "    int nSum = 0;\n    int i;\n    for (i = 0; i < n; i++)\n    {\n";
+		for (int32_t nField = 0; nField < nFields; nField++)
+		{
+			std::string sField = "s.nField" + std::to_string(nField);
+			sSource += "        " + sField + " = i + " + std::to_string(nField) + ";\n        nSum += " + sField + ";\n";
+		}
+		if (nStructure > 0)
+		{
+			sSource += "        s.sInner.nField0 = nSum;\n        nSum -= s.sInner.nField0 / 2;\n";
+		}
+		sSource += "    }\n    return nSum;\n}\n\n";
+	}
+	sSource += "int StartingConditional()\n{\n    int nSum = 0;\n";
+	for (int32_t nStructure = 0; nStructure < nStructures; nStructure++)
+	{
+		sSource += "    nSum += UseStructure" + std::to_string(nStructure) + "(3);\n";
+	}
+	g_aSources["bench_structures"] = sSource + "    return nSum;\n}\n";
+
+	double fMilliseconds = TimeCompile(cCompiler, "bench_structures", 20);
+	if (fMilliseconds >= 0.0)
+	{
+		printf("structures: %d structures of %d fields, compile %.2f ms\n", nStructures, nFields, fMilliseconds);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  BenchmarkBatch()
+///////////////////////////////////////////////////////////////////////////////
+//  Description: Compiles the scripts of the tests directory over and over,
+//               like a module build compiling many small scripts with one
+//               compiler, and counts the heap allocations per compile.  The
+//               first round is left out: it loads the identifier
+//               specification and sizes the buffers that later compiles reuse.
+///////////////////////////////////////////////////////////////////////////////
+
+static void BenchmarkBatch(CScriptCompiler &cCompiler, const std::vector<CScriptTest> &aTests)
+{
+	const int32_t nRounds = 300;
+
+	uint64_t nAllocations = 0;
+	std::chrono::steady_clock::time_point tStart;
+	for (int32_t nRound = 0; nRound <= nRounds; nRound++)
+	{
+		if (nRound == 1)
+		{
+			nAllocations = g_nAllocations;
+			tStart = std::chrono::steady_clock::now();
+		}
+		for (const CScriptTest &cTest : aTests)
+		{
+			if (cCompiler.CompileFile(cTest.m_sName.c_str()) < 0)
+			{
+				Fail(cTest.m_sName, cCompiler.GetOptimizationFlags(), std::string("does not compile: ") + cCompiler.GetCapturedError()->CStr());
+				return;
+			}
+		}
+	}
+
+	double fMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tStart).count();
+	size_t nCompiles = (size_t) nRounds * aTests.size();
+	if (nCompiles != 0)
+	{
+		printf("batch: %zu scripts x %d, %.1f allocations and %.3f ms per compile\n",
+		       aTests.size(), nRounds, (double) (g_nAllocations - nAllocations) / nCompiles, fMilliseconds / nCompiles);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  RunBenchmarks()
+///////////////////////////////////////////////////////////////////////////////
+//  Description: Times the compiler on generated scripts that stress one part
+//               of it each.  Nothing is checked but that they compile; the
+//               fastest of several runs is reported.
+///////////////////////////////////////////////////////////////////////////////
+
+static void RunBenchmarks(CScriptCompiler &cCompiler, const std::vector<CScriptTest> &aTests)
+{
+	cCompiler.SetGenerateDebuggerOutput(FALSE);
+	cCompiler.SetVerifyFinalCode(FALSE);
+	cCompiler.SetOptimizationFlags(CSCRIPTCOMPILER_OPTIMIZE_EVERYTHING);
+
+	// The batch goes first: buffers sized by the large scripts would slow
+	// every small compile after them.
+	BenchmarkBatch(cCompiler, aTests);
+	BenchmarkReachability(cCompiler);
+	BenchmarkDebuggerOutput(cCompiler);
+	BenchmarkStructures(cCompiler);
+}
+
+static BOOL ReadFile(const std::filesystem::path &cPath, std::string &sContents)
+{
+	std::ifstream cFile(cPath, std::ios::binary);
+	if (!cFile)
+	{
+		return FALSE;
+	}
+	sContents.assign(std::istreambuf_iterator<char>(cFile), std::istreambuf_iterator<char>());
+	return TRUE;
+}
+
+int main(int argc, char **argv)
+{
+	BOOL bBenchmark = (argc == 3 && strcmp(argv[1], "-b") == 0);
+	if (argc != 2 && !bBenchmark)
+	{
+		printf("usage: scripttest [-b] <tests directory>\n"
+		       "  -b  time the compiler on generated scripts instead of running the tests\n");
+		return 2;
+	}
+	const char *pchDirectory = argv[argc - 1];
+
+	g_aSources["nwscript"] = g_pchActionSpecification;
+
+	std::vector<CScriptTest> aTests;
+	std::error_code cError;
+	for (const auto &cEntry : std::filesystem::directory_iterator(pchDirectory, cError))
+	{
+		if (cEntry.path().extension() != ".nss")
+		{
+			continue;
+		}
+
+		std::string sName = cEntry.path().stem().string();
+		std::string &sSource = g_aSources[sName];
+		if (!ReadFile(cEntry.path(), sSource))
+		{
+			fprintf(stderr, "scripttest: cannot read %s\n", cEntry.path().string().c_str());
+			return 2;
+		}
+
+		// Scripts without expectations are include files of the others.
+		if (sSource.find("// scripttest:") == std::string::npos)
+		{
+			continue;
+		}
+
+		CScriptTest cTest;
+		cTest.m_sName = sName;
+		if (!ParseExpectations(sSource, cTest))
+		{
+			fprintf(stderr, "scripttest: %s: cannot read the scripttest lines\n", cEntry.path().string().c_str());
+			return 2;
+		}
+		aTests.push_back(std::move(cTest));
+	}
+	if (cError)
+	{
+		fprintf(stderr, "scripttest: cannot list %s\n", pchDirectory);
+		return 2;
+	}
+	std::sort(aTests.begin(), aTests.end(), [](const CScriptTest &a, const CScriptTest &b) { return a.m_sName < b.m_sName; });
+
+	CScriptCompiler cCompiler(2009, 2010, 2064);
+	cCompiler.SetIdentifierSpecification("nwscript");
+	cCompiler.SetCompileConditionalOrMain(TRUE);
+	cCompiler.SetGenerateDebuggerOutput(TRUE);
+	cCompiler.SetVerifyFinalCode(TRUE);
+
+	if (bBenchmark)
+	{
+		RunBenchmarks(cCompiler, aTests);
+		return g_nFailures == 0 ? 0 : 1;
+	}
+	GenerateTests(aTests);
+
+	CScriptInterpreter cInterpreter;
+	if (cInterpreter.LoadActionSpecification(g_pchActionSpecification, sizeof(g_pchActionSpecification) - 1) < 0)
+	{
+		fprintf(stderr, "scripttest: %s\n", cInterpreter.GetError().c_str());
+		return 2;
+	}
+
+	for (const CScriptTest &cTest : aTests)
+	{
+		RunTest(cCompiler, cInterpreter, cTest);
+	}
+
+	printf("scripttest: %zu scripts, %d failures\n", aTests.size(), g_nFailures);
+	return g_nFailures == 0 ? 0 : 1;
+}
@@ -288,6 +288,11 @@ intptr_t LoggerDialog::childrenDlgProc(UINT message, WPARAM wParam, LPARAM lPara
 				NMHDR hdr = lpnmia->hdr;
 #pragma warning (push)
 #pragma warning (disable : 26454)
+				if (hdr.code == LVN_GETDISPINFO)
+				{
+					GetErrorsListItemText(reinterpret_cast<NMLVDISPINFO*>(lParam));
+					return TRUE;
+				}
 				if (hdr.code == NM_CLICK)
 #pragma warning (pop)
 				{
@@ -295,17 +300,16 @@ intptr_t LoggerDialog::childrenDlgProc(UINT message, WPARAM wParam, LPARAM lPara
 					if (lpnmia->iItem < 0 || !_processInputForErrorList)
 						return FALSE;
 
-					HWND lstErrors = GetDlgItem(_errorDlgHwnd, IDC_LSTERRORS);
-
-					// Gather the item ID stored previously
-					int messageItem = -1;
-					LVITEM itemInfo;
-					itemInfo.mask = LVIF_PARAM;
-					itemInfo.iItem = lpnmia->iItem;
-					ListView_GetItem(lstErrors, &itemInfo);
-					messageItem = static_cast<int>(itemInfo.lParam);
+					// Gather the message index for this row
+					size_t messageItem = 0;
+					{
+						std::lock_guard<std::mutex> lock(_visibleErrorsLock);
+						if (static_cast<size_t>(lpnmia->iItem) >= _visibleErrors.size())
+							return FALSE;
+						messageItem = _visibleErrors[lpnmia->iItem];
+					}
 
-					CompilerMessage& r = _errorsList[messageItem];
+					CompilerMessage r = _errorsList.at(messageItem);
 
 					// Dispatch to Plugin for processing.
 					generic_string fileName = r.fileName.empty() ? TEXT("") : r.fileName + TEXT(".") + r.fileExt;
@@ -558,11 +562,15 @@ void LoggerDialog::LogMessage(const CompilerMessage& message, const generic_stri
 	CompilerMessage fullMessage = message;
 	fullMessage.filePath = filePath;
 
+	size_t messageIndex = 0;
 	if (message.messageType != LogType::ConsoleMessage)
+	{
 		_errorsList.push_back(fullMessage);
+		messageIndex = _errorsList.size() - 1;
+	}
 
 	// Write message to console and/or errors list
-	WriteToErrorsList(message, false);
+	WriteToErrorsList(message, messageIndex, false);
 
 	// Update counters
 	if (message.messageType == LogType::Critical || message.messageType == LogType::Error)
@@ -575,7 +583,7 @@ void LoggerDialog::LogMessage(const CompilerMessage& message, const generic_stri
 	UpdateToolButtonLabels();
 }
 
-void LoggerDialog::WriteToErrorsList(const CompilerMessage& message, bool ignoreConsole)
+void LoggerDialog::WriteToErrorsList(const CompilerMessage& message, size_t messageIndex, bool ignoreConsole)
 {
 	HWND lstErrors = GetDlgItem(_errorDlgHwnd, IDC_LSTERRORS);
 
@@ -619,37 +627,58 @@ void LoggerDialog::WriteToErrorsList(const CompilerMessage& message, bool ignore
 	if (message.messageType == LogType::Info && !_settings->compilerWindowShowInfos)
 		return;
 
-	// Retrieve the message index on list and store for future reference.
-	size_t itemIndex = 0;
-	for (; itemIndex < _errorsList.size(); itemIndex++)
+	// The list is virtual (texts come from GetErrorsListItemText), so we only add the row
+	size_t itemCount = 0;
 	{
-		if (_errorsList[itemIndex] == message)
-			break;
+		std::lock_guard<std::mutex> lock(_visibleErrorsLock);
+		_visibleErrors.push_back(static_cast<uint32_t>(messageIndex));
+		itemCount = _visibleErrors.size();
+	}
+	ListView_SetItemCountEx(lstErrors, itemCount, LVSICF_NOINVALIDATEALL | LVSICF_NOSCROLL);
+}
+
+void LoggerDialog::GetErrorsListItemText(NMLVDISPINFO* dispInfo)
+{
+	// Rows are requested one column at a time, so we keep the last message fetched
+	if (dispInfo->item.iItem != _dispInfoItem)
+	{
+		size_t messageIndex = 0;
+		{
+			std::lock_guard<std::mutex> lock(_visibleErrorsLock);
+			if (dispInfo->item.iItem < 0 || static_cast<size_t>(dispInfo->item.iItem) >= _visibleErrors.size())
+				return;
+			messageIndex = _visibleErrors[dispInfo->item.iItem];
+		}
+		_dispInfoMessage = _errorsList.at(messageIndex);
+		_dispInfoItem = dispInfo->item.iItem;
 	}
 
-	// Create the list item
-	size_t currentItem = ListView_GetItemCount(lstErrors);
-	LVITEM newItem;
-	ZeroMemory(&newItem, sizeof(LVITEM));
-	newItem.mask = LVIF_PARAM;
-	newItem.iItem = currentItem;
-	newItem.lParam = (LPARAM)itemIndex;
-	currentItem = ListView_InsertItem(lstErrors, &newItem);
-
-	// Update all visible columns
-	newItem.iItem = currentItem;
-	newItem.mask = LVIF_TEXT | LVIF_IMAGE;  // Icon column
-	newItem.iSubItem = ERRORCOLUMN_MESSAGECODE;
-	newItem.iImage = (int)message.messageType;
-	generic_string code = message.messageCode.empty() ? messageType : message.messageCode;
-	newItem.pszText = (LPWSTR)code.c_str();
-	ListView_SetItem(lstErrors, &newItem);
-	ListView_SetItemText(lstErrors, currentItem, ERRORCOLUMN_MESSAGETEXT, (LPWSTR)message.messageText.c_str());
-	generic_string fileName = message.fileName.empty() ? TEXT("-") : message.fileName + TEXT(".") + message.fileExt;
-	ListView_SetItemText(lstErrors, currentItem, ERRORCOLUMN_FILENAME, (LPWSTR)fileName.c_str());
-	generic_string lineNumber = message.lineNumber.empty() ? TEXT("-") : message.lineNumber;
-	ListView_SetItemText(lstErrors, currentItem, ERRORCOLUMN_FILELINE, (LPWSTR)lineNumber.c_str());
+	const CompilerMessage& message = _dispInfoMessage;
+	generic_string text;
+	switch (dispInfo->item.iSubItem)
+	{
+		case ERRORCOLUMN_MESSAGECODE:
+		{
+			if (dispInfo->item.mask & LVIF_IMAGE)
+				dispInfo->item.iImage = (int)message.messageType;
+			generic_string messageType = message.messageType == LogType::Error ? TEXT("Error") :
+				message.messageType == LogType::Warning ? TEXT("Warning") : TEXT("Info");
+			text = message.messageCode.empty() ? messageType : message.messageCode;
+			break;
+		}
+		case ERRORCOLUMN_MESSAGETEXT:
+			text = message.messageText;
+			break;
+		case ERRORCOLUMN_FILENAME:
+			text = message.fileName.empty() ? TEXT("-") : message.fileName + TEXT(".") + message.fileExt;
+			break;
+		case ERRORCOLUMN_FILELINE:
+			text = message.lineNumber.empty() ? TEXT("-") : message.lineNumber;
+			break;
+	}
 
+	if ((dispInfo->item.mask & LVIF_TEXT) && dispInfo->item.cchTextMax > 0)
+		_tcsncpy_s(dispInfo->item.pszText, dispInfo->item.cchTextMax, text.c_str(), _TRUNCATE);
 }
 
 void LoggerDialog::AppendConsoleText(const generic_string& newText)
@@ -658,6 +687,21 @@ void LoggerDialog::AppendConsoleText(const generic_string& newText)
 	cr.cpMin = -1;
 	cr.cpMax = -1;
 	HWND editControl = GetDlgItem(_consoleDlgHwnd, IDC_TXTCONSOLE);
+
+	// Keep the console bounded: once it would pass the limit, cut the oldest lines down to 3/4 of it.
+	SendMessage(editControl, EM_EXLIMITTEXT, 0, _maxConsoleChars * 2);
+	int textLength = GetWindowTextLength(editControl);
+	if (textLength + static_cast<int>(newText.size()) > _maxConsoleChars)
+	{
+		LONG cutChar = std::min(textLength, textLength + static_cast<int>(newText.size()) - (_maxConsoleChars / 4) * 3);
+		LRESULT cutLine = SendMessage(editControl, EM_EXLINEFROMCHAR, 0, cutChar);
+		CHARRANGE cut = { 0, static_cast<LONG>(SendMessage(editControl, EM_LINEINDEX, cutLine + 1, 0)) };
+		if (cut.cpMax <= 0)
+			cut.cpMax = textLength;
+		SendMessage(editControl, EM_EXSETSEL, 0, reinterpret_cast<LPARAM>(&cut));
+		SendMessage(editControl, EM_REPLACESEL, 0, reinterpret_cast<LPARAM>(TEXT("")));
+	}
+
 	SendMessage(editControl, EM_EXSETSEL, 0, reinterpret_cast<LPARAM>(&cr));
 	CHARFORMAT ch = {};
 	ch.cbSize = sizeof(ch);
@@ -671,19 +715,24 @@ void LoggerDialog::AppendConsoleText(const generic_string& newText)
 
 void LoggerDialog::RebuildErrorsList()
 {
-	// Clear current Errors List
-	ListView_DeleteAllItems(GetDlgItem(_errorDlgHwnd, IDC_LSTERRORS));
-
-	// Redo with filters (also ignore console messages)
-	for (CompilerMessage m : _errorsList)
+	// Redo with filters (also ignore console messages). Only message types are needed here,
+	// so spilled messages are not read back.
+	size_t itemCount = 0;
 	{
-		if ((m.messageType == LogType::Critical || m.messageType == LogType::Error) && _settings->compilerWindowShowErrors)
-			WriteToErrorsList(m, true);
-		if (m.messageType == LogType::Warning && _settings->compilerWindowShowWarnings)
-			WriteToErrorsList(m, true);
-		if (m.messageType == LogType::Info && _settings->compilerWindowShowInfos)
-			WriteToErrorsList(m, true);
+		std::lock_guard<std::mutex> lock(_visibleErrorsLock);
+		_visibleErrors.clear();
+		for (size_t i = 0; i < _errorsList.size(); i++)
+		{
+			LogType messageType = _errorsList.typeAt(i);
+			if (((messageType == LogType::Critical || messageType == LogType::Error) && _settings->compilerWindowShowErrors) ||
+				(messageType == LogType::Warning && _settings->compilerWindowShowWarnings) ||
+				(messageType == LogType::Info && _settings->compilerWindowShowInfos))
+				_visibleErrors.push_back(static_cast<uint32_t>(i));
+		}
+		itemCount = _visibleErrors.size();
 	}
+	_dispInfoItem = -1;
+	ListView_SetItemCountEx(GetDlgItem(_errorDlgHwnd, IDC_LSTERRORS), itemCount, 0);
 
 	// Update tool buttons captions.
 	UpdateToolButtonLabels();
@@ -733,6 +782,18 @@ void LoggerDialog::LockControls(bool toLock)
 	EnableWindow(GetDlgItem(_consoleDlgHwnd, IDC_BTFILTERINFO), !toLock);
 }
 
+void LoggerDialog::showInfosList()
+{
+	if (!_settings->compilerWindowShowInfos)
+	{
+		::SendMessage(_toolBar, TB_CHECKBUTTON, IDM_MESSAGETOGGLE, TRUE);
+		_settings->compilerWindowShowInfos = true;
+		RebuildErrorsList();
+	}
+
+	switchToErrors();
+}
+
 void LoggerDialog::RecreateTxtConsole()
 {
 	RECT editRect;
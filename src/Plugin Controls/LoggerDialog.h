@@ -76,6 +76,9 @@ namespace NWScriptPlugin {
 				switchToErrors();
 		}
 
+		// Shows the errors list with infos enabled, for results logged as infos (eg: references found)
+		void showInfosList();
+
 		void LogMessage(const CompilerMessage& message, const generic_string& filePath = TEXT(""));
 
 		void LockControls(bool toLock);
@@ -101,7 +104,8 @@ namespace NWScriptPlugin {
 		void ResizeList();
 		void AppendConsoleText(const generic_string& newText);
 		void RebuildErrorsList();
-		void WriteToErrorsList(const CompilerMessage& message, bool ignoreConsole = false);
+		void WriteToErrorsList(const CompilerMessage& message, size_t messageIndex, bool ignoreConsole = false);
+		void GetErrorsListItemText(NMLVDISPINFO* dispInfo);
 		void UpdateToolButtonLabels();
 		void RecreateTxtConsole();
 		void RecreateIcons();
@@ -127,8 +131,13 @@ namespace NWScriptPlugin {
 
 		void clearErrors()
 		{
-			ListView_DeleteAllItems(GetDlgItem(_errorDlgHwnd, IDC_LSTERRORS));
+			ListView_SetItemCount(GetDlgItem(_errorDlgHwnd, IDC_LSTERRORS), 0);
 			_errorsList.clear();
+			{
+				std::lock_guard<std::mutex> lock(_visibleErrorsLock);
+				_visibleErrors.clear();
+			}
+			_dispInfoItem = -1;
 			_errorCount = 0;
 			_warningCount = 0;
 			_infoCount = 0;
@@ -150,7 +159,16 @@ namespace NWScriptPlugin {
 
 		Settings* _settings = nullptr;
 
-		std::vector<CompilerMessage> _errorsList;
+		// All non-console messages (bounded in memory, see NWScriptLogger::MessageStore) and the ones
+		// passing the current filters. The errors list is virtual: rows are fetched when they are drawn.
+		NWScriptLogger::MessageStore _errorsList;
+		std::vector<uint32_t> _visibleErrors;
+		std::mutex _visibleErrorsLock;
+		CompilerMessage _dispInfoMessage;
+		int _dispInfoItem = -1;
+
+		// The console keeps at most this many characters; older text is cut away in large chunks.
+		static const int _maxConsoleChars = 1024 * 1024;
 		int _errorCount = 0;
 		int _warningCount = 0;
 		int _infoCount = 0;
@@ -126,6 +126,7 @@
 #define IDC_LNKWHATISTHIS               1084
 #define IDC_LBLTARGETVERSION            1085
 #define IDC_TXTHELP                     1086
+#define IDC_CHKWRITEDISPLAYEDOUTPUT     1087
 #define IDC_STATIC                      -1
 #define IDC_HEREBEDRAGONS               -1
 #define IDC_LBLSOLUTION                 -1
@@ -136,7 +137,7 @@
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NEXT_RESOURCE_VALUE        195
 #define _APS_NEXT_COMMAND_VALUE         40001
-#define _APS_NEXT_CONTROL_VALUE         1087
+#define _APS_NEXT_CONTROL_VALUE         1088
 #define _APS_NEXT_SYMED_VALUE           101
 #endif
 #endif
@@ -29,6 +29,7 @@ intptr_t CALLBACK UsersPreferencesDialog::run_dlgProc(UINT message, WPARAM wPara
 		{
 			CheckDlgButton(_hSelf, IDC_CHKAUTOOPENDISASSEMBLED, _settings->autoDisplayDisassembled ? BST_CHECKED : BST_UNCHECKED);
 			CheckDlgButton(_hSelf, IDC_CHKAUTOOPENDEBUGSYMBOLS, _settings->autoDisplayDebugSymbols ? BST_CHECKED : BST_UNCHECKED);
+			CheckDlgButton(_hSelf, IDC_CHKWRITEDISPLAYEDOUTPUT, _settings->writeDisplayedOutputToDisk ? BST_CHECKED : BST_UNCHECKED);
 
 			if (_darkModeInstalled)
 				CheckDlgButton(_hSelf, IDC_CHKAUTOINSTALLDARKTHEME, _settings->autoInstallDarkTheme ? BST_CHECKED : BST_UNCHECKED);
@@ -86,6 +87,7 @@ void UsersPreferencesDialog::keepSettings()
 {
 	_settings->autoDisplayDisassembled = IsDlgButtonChecked(_hSelf, IDC_CHKAUTOOPENDISASSEMBLED);
 	_settings->autoDisplayDebugSymbols = IsDlgButtonChecked(_hSelf, IDC_CHKAUTOOPENDEBUGSYMBOLS);
+	_settings->writeDisplayedOutputToDisk = IsDlgButtonChecked(_hSelf, IDC_CHKWRITEDISPLAYEDOUTPUT);
 
 	if (_darkModeInstalled)
 		_settings->autoInstallDarkTheme = IsDlgButtonChecked(_hSelf, IDC_CHKAUTOINSTALLDARKTHEME);
@@ -49,6 +49,7 @@
 //#define DEBUG_AUTO_INDENT_833      // Uncomment to test auto-indent with message
 #define USE_THREADS                  // Process compilations and batchs in multi-threaded operations
 #define NAGIVATECALLBACKTIMER 0x800  // Temporary timer to schedule navigations
+#define FINDREFERENCESTIMER 0x801    // Polls the references search for results
 
 
 using namespace NWScriptPlugin;
@@ -65,25 +66,30 @@ generic_string Plugin::pluginName = TEXT("NWScript Tools");
 #define PLUGINMENU_DISASSEMBLESCRIPT 3
 #define PLUGINMENU_BATCHPROCESSING 4
 #define PLUGINMENU_RUNLASTBATCH 5
-#define PLUGINMENU_DASH2 6
-#define PLUGINMENU_FETCHPREPROCESSORTEXT 7
-#define PLUGINMENU_VIEWSCRIPTDEPENDENCIES 8
-#define PLUGINMENU_DASH3 9
-#define PLUGINMENU_SHOWCONSOLE 10
-#define PLUGINMENU_DASH4 11
-#define PLUGINMENU_SETTINGS 12
-#define PLUGINMENU_USERPREFERENCES 13
-#define PLUGINMENU_DASH5 14
-#define PLUGINMENU_INSTALLDARKTHEME 15
-#define PLUGINMENU_IMPORTDEFINITIONS 16
-#define PLUGINMENU_IMPORTUSERTOKENS 17
-#define PLUGINMENU_RESETUSERTOKENS 18
-#define PLUGINMENU_RESETEDITORCOLORS 19
-#define PLUGINMENU_REPAIRXMLASSOCIATION 20
-#define PLUGINMENU_DASH6 21
-#define PLUGINMENU_INSTALLCOMPLEMENTFILES 22
-#define PLUGINMENU_DASH7 23
-#define PLUGINMENU_ABOUTME 24
+#define PLUGINMENU_COMPILESNIPPETS 6
+#define PLUGINMENU_COMPILEOPENSCRIPTS 7
+#define PLUGINMENU_COMPAREENGINES 8
+#define PLUGINMENU_DASH2 9
+#define PLUGINMENU_FETCHPREPROCESSORTEXT 10
+#define PLUGINMENU_VIEWSCRIPTDEPENDENCIES 11
+#define PLUGINMENU_VIEWINCLUDEGRAPH 12
+#define PLUGINMENU_FINDREFERENCES 13
+#define PLUGINMENU_DASH3 14
+#define PLUGINMENU_SHOWCONSOLE 15
+#define PLUGINMENU_DASH4 16
+#define PLUGINMENU_SETTINGS 17
+#define PLUGINMENU_USERPREFERENCES 18
+#define PLUGINMENU_DASH5 19
+#define PLUGINMENU_INSTALLDARKTHEME 20
+#define PLUGINMENU_IMPORTDEFINITIONS 21
+#define PLUGINMENU_IMPORTUSERTOKENS 22
+#define PLUGINMENU_RESETUSERTOKENS 23
+#define PLUGINMENU_RESETEDITORCOLORS 24
+#define PLUGINMENU_REPAIRXMLASSOCIATION 25
+#define PLUGINMENU_DASH6 26
+#define PLUGINMENU_INSTALLCOMPLEMENTFILES 27
+#define PLUGINMENU_DASH7 28
+#define PLUGINMENU_ABOUTME 29
 
 #define PLUGIN_HOMEPATH TEXT("https://github.com/Leonard-The-Wise/NWScript-Npp")
 #define PLUGIN_ONLINEHELP TEXT("https://github.com/Leonard-The-Wise/NWScript-Npp/blob/master/OnlineHelp.md")
@@ -101,9 +107,14 @@ FuncItem Plugin::pluginFunctions[] = {
     {TEXT("Disassemble NWScript file..."), Plugin::DisassembleFile, 0, false, &disassembleScriptKey },
     {TEXT("Batch Process NWScript Files..."), Plugin::BatchProcessFiles, 0, false, &batchScriptKey },
     {TEXT("Run last batch"), Plugin::RunLastBatch, 0, false, &runLastBatchKey},
+    {TEXT("Compile snippets manifest..."), Plugin::CompileSnippets},
+    {TEXT("Compile all open scripts"), Plugin::CompileAllOpenScripts},
+    {TEXT("Compare compiler engines on batch folder"), Plugin::CompareCompilerEngines},
     {TEXT("---")},
     {TEXT("Fetch preprocessed output"), Plugin::FetchPreprocessorText},
     {TEXT("View NWScript dependencies"), Plugin::ViewScriptDependencies},
+    {TEXT("View NWScript include graph"), Plugin::ViewIncludeGraph},
+    {TEXT("Find references"), Plugin::FindReferences},
     {TEXT("---")},
     {TEXT("Toggle NWScript Compiler Console"), Plugin::ToggleLogger, 0, false, &toggleConsoleKey},
     {TEXT("---")},
@@ -152,6 +163,8 @@ constexpr const TCHAR PseudoBatchRestartFile[] = TEXT("~doNWScriptNotepadRestart
 constexpr const TCHAR NWScriptEngineObjectsFile[] = TEXT("NWScript-Npp-EngineObjects.bin");
 // NWScript known user objects file
 constexpr const TCHAR NWScriptUserObjectsFile[] = TEXT("NWScript-Npp-UserObjects.bin");
+// Token index of the scripts searched by "Find references"
+constexpr const TCHAR NWScriptReferenceIndexFile[] = TEXT("NWScript-Npp-ReferenceIndex.bin");
 
 
 #pragma region
@@ -273,6 +286,10 @@ void Plugin::MakePluginFilePaths()
     sPath.append(TEXT("\\")).append(NWScriptUserObjectsFile);
     _pluginPaths.insert({ "NWScriptUserObjectsFile", fs::path(sPath) });
 
+    sPath = _pluginPaths["PluginConfigDir"];
+    sPath.append(TEXT("\\")).append(NWScriptReferenceIndexFile);
+    _pluginPaths.insert({ "NWScriptReferenceIndexFile", fs::path(sPath) });
+
     // Step 2:
     // For any file not present on Plugins Config Dir, we then check on the Notepad++ executable sPath.
 
@@ -698,6 +715,10 @@ void Plugin::ProcessMessagesSci(SCNotification* notifyCode)
         _isReady = false;
         Settings().Save();
 
+        // Stop any references search while the editor is still around. What it indexed so far is kept.
+        KillTimer(NotepadHwnd(), FINDREFERENCESTIMER);
+        _referenceFinder.cancel();
+
         // If we have a restart hook setup, call out shell to execute it.
         if (Settings().notepadRestartMode != RestartMode::None)
         {
@@ -859,6 +880,32 @@ void Plugin::LoadNotepadLexer()
 
     //Update Lexer
     _notepadCurrentLexer.SetLexer(currLang, lexerName.get(), isPluginLanguage, langIndent);
+
+    if (isPluginLanguage)
+        CheckLargeFileLexing();
+}
+
+// Passes the large file threshold to our lexer and tells the user when the current document
+// is big enough to be lexed with the simplified rules.
+void Plugin::CheckLargeFileLexing()
+{
+    PluginMessenger& msg = Messenger();
+
+    // Lexer threshold is in bytes
+    std::string threshold = std::to_string(static_cast<int64_t>(Settings().largeFileLexingThreshold) * 1024);
+    msg.SendSciMessage<void>(SCI_SETPROPERTY, reinterpret_cast<WPARAM>("lexer.nwscript.large.file.threshold"),
+        reinterpret_cast<LPARAM>(threshold.c_str()));
+
+    if (Settings().largeFileLexingThreshold == 0)
+        return;
+
+    size_t docLength = msg.SendSciMessage<size_t>(SCI_GETLENGTH);
+    if (docLength > static_cast<size_t>(Settings().largeFileLexingThreshold) * 1024)
+    {
+        generic_string notice = std::format(TEXT("NWScript - large file ({} MB): simplified highlighting and folding"),
+            docLength / (1024 * 1024));
+        msg.SendNppMessage<void>(NPPM_SETSTATUSBAR, STATUSBAR_DOC_TYPE, reinterpret_cast<LPARAM>(notice.c_str()));
+    }
 }
 
 // Detects if Dark Theme is already installed
@@ -1134,8 +1181,13 @@ void Plugin::SetupPluginMenuItems()
     SetPluginMenuBitmap(PLUGINMENU_DISASSEMBLESCRIPT, _menuBitmaps[5], true, false);
     SetPluginMenuBitmap(PLUGINMENU_BATCHPROCESSING, _menuBitmaps[1], true, false);
     SetPluginMenuBitmap(PLUGINMENU_RUNLASTBATCH, _menuBitmaps[9], true, false);
+    SetPluginMenuBitmap(PLUGINMENU_COMPILESNIPPETS, _menuBitmaps[1], true, false);
+    SetPluginMenuBitmap(PLUGINMENU_COMPILEOPENSCRIPTS, _menuBitmaps[2], true, false);
+    SetPluginMenuBitmap(PLUGINMENU_COMPAREENGINES, _menuBitmaps[1], true, false);
     SetPluginMenuBitmap(PLUGINMENU_FETCHPREPROCESSORTEXT, _menuBitmaps[11], true, false);
     SetPluginMenuBitmap(PLUGINMENU_VIEWSCRIPTDEPENDENCIES, _menuBitmaps[4], true, false);
+    SetPluginMenuBitmap(PLUGINMENU_VIEWINCLUDEGRAPH, _menuBitmaps[4], true, false);
+    SetPluginMenuBitmap(PLUGINMENU_FINDREFERENCES, _menuBitmaps[11], true, false);
     SetPluginMenuBitmap(PLUGINMENU_SHOWCONSOLE, _menuBitmaps[6], true, true);
     SetPluginMenuBitmap(PLUGINMENU_SETTINGS, _menuBitmaps[13], true, false);
     SetPluginMenuBitmap(PLUGINMENU_USERPREFERENCES, _menuBitmaps[14], true, false);
@@ -1212,6 +1264,11 @@ void Plugin::LockPluginMenu(bool toLock)
     EnablePluginMenuItem(PLUGINMENU_COMPILESCRIPT, !toLock);
     EnablePluginMenuItem(PLUGINMENU_DISASSEMBLESCRIPT, !toLock);
     EnablePluginMenuItem(PLUGINMENU_BATCHPROCESSING, !toLock);
+    EnablePluginMenuItem(PLUGINMENU_COMPILESNIPPETS, !toLock);
+    EnablePluginMenuItem(PLUGINMENU_COMPILEOPENSCRIPTS, !toLock);
+    EnablePluginMenuItem(PLUGINMENU_COMPAREENGINES, !toLock);
+    EnablePluginMenuItem(PLUGINMENU_VIEWINCLUDEGRAPH, !toLock);
+    EnablePluginMenuItem(PLUGINMENU_FINDREFERENCES, !toLock);
 
     // These depend also on engine settings
     if (!toLock)
@@ -2473,6 +2530,14 @@ void Plugin::BatchProcessDialogCallback(HRESULT decision)
         return;
     }
 
+    inst.StartBatchProcessing(false);
+}
+
+// Starts a batch over the files of the batch settings
+void Plugin::StartBatchProcessing(bool compareEngines)
+{
+    Plugin& inst = Instance();
+
     // Start counting ticks
     Instance()._clockStart = GetTickCount64();
 
@@ -2486,10 +2551,16 @@ void Plugin::BatchProcessDialogCallback(HRESULT decision)
 
     // Reset batch state
     inst.ResetBatchStates();
+    inst._batchCompareEngines = compareEngines;
 
     // Prepare compiler
     inst.Compiler().reset();
-    inst.Compiler().setMode(inst._settings.batchCompileMode);
+    if (compareEngines)
+        inst.Compiler().setCompareEngines();
+    else
+        inst.Compiler().setMode(inst._settings.batchCompileMode);
+    // Native compiler batches also aggregate the module-wide usage report
+    inst.Compiler().setGatherUsageReport(!compareEngines && inst._settings.batchCompileMode == 0 && inst._settings.compilerEngine == 0);
     // Set callback to batch process
     inst.Compiler().setProcessingEndCallback(BatchProcessFilesCallback);
 
@@ -2554,8 +2625,8 @@ void Plugin::DoCompileOrDisasm(generic_string filePath, bool fromCurrentScintill
         scriptPath = generic_string(nameBuffer);
     }
 
-    // Get output sPath
-    if (!batchOperations)
+    // Get output sPath. Open scripts are processed as a batch, but they keep the single file output settings.
+    if (!batchOperations || _batchOpenFiles)
     {
         if (Settings().useScriptPathToCompile)
             outputDir = scriptPath.parent_path();
@@ -2593,7 +2664,8 @@ void Plugin::DoCompileOrDisasm(generic_string filePath, bool fromCurrentScintill
     _loggerWindow->LockControls(true);
 
     // Increment statistics
-    if (_compiler.getMode() == 0 && !_compiler.isFetchPreprocessorOnly() && !_compiler.isViewDependencies())
+    if (_compiler.getMode() == 0 && !_compiler.isFetchPreprocessorOnly() && !_compiler.isViewDependencies() && !_compiler.isCompileSnippets()
+        && !_compiler.isCompareEngines() && !_compiler.isViewIncludeGraph())
         Settings().compileAttempts++;
     if (_compiler.getMode() == 1)
         Settings().disassembledFiles++;
@@ -2608,11 +2680,42 @@ void Plugin::DoCompileOrDisasm(generic_string filePath, bool fromCurrentScintill
 #endif
 }
 
+// Shows generated text on a new document. Big contents are appended in chunks with undo collection and
+// redraw suspended: the editor never keeps an undo copy of them, and (since the callers run on the compiler
+// thread) Notepad++ keeps processing its messages between chunks.
+void Plugin::DisplayGeneratedDocument(const std::string& contents, bool setPluginLexer)
+{
+    constexpr size_t chunkSize = 1024 * 1024;
+
+    // Creates a new document...
+    Messenger().SendNppMessage<void>(NPPM_MENUCOMMAND, 0, IDM_FILE_NEW);
+    // Sets the language to NWScript (because color syntax WILL work for assembled symbols)
+    if (setPluginLexer)
+        SetNotepadToPluginLexer();
+
+    HWND scintillaHwnd = Messenger().GetCurentScintillaHwnd();
+    ::SendMessage(scintillaHwnd, WM_SETREDRAW, FALSE, 0);
+    Messenger().SendSciMessage<void>(SCI_SETUNDOCOLLECTION, false);
+    Messenger().SendSciMessage<void>(SCI_ALLOCATE, contents.size() + 1);
+
+    for (size_t offset = 0; offset < contents.size(); offset += chunkSize)
+    {
+        size_t length = std::min(chunkSize, contents.size() - offset);
+        Messenger().SendSciMessage<void>(SCI_APPENDTEXT, length, reinterpret_cast<LPARAM>(contents.data() + offset));
+    }
+
+    Messenger().SendSciMessage<void>(SCI_SETUNDOCOLLECTION, true);
+    Messenger().SendSciMessage<void>(SCI_EMPTYUNDOBUFFER);
+    Messenger().SendSciMessage<void>(SCI_GOTOPOS, 0);
+    ::SendMessage(scintillaHwnd, WM_SETREDRAW, TRUE, 0);
+    ::InvalidateRect(scintillaHwnd, NULL, TRUE);
+}
+
 // Builds Batch File List
 void Plugin::BuildFilesList()
 {
     std::vector<generic_string> fileFilters;
-    if (_settings.batchCompileMode == 0)
+    if (_settings.batchCompileMode == 0 || _batchCompareEngines)
         fileFilters = _settings.getFileFiltersCompileV();
     else
         fileFilters = _settings.getFileFiltersDisasmV();
@@ -2638,6 +2741,7 @@ void Plugin::CompileEndingCallback(HRESULT decision)
     // Unlock controls to compiler log window
     Instance()._loggerWindow->LockControls(false);
     Instance().LockPluginMenu(false);
+    Instance().Compiler().releaseArchives();
 
     // Check if logger window need to switch to errors panel
     Instance()._loggerWindow->checkSwitchToErrors();
@@ -2651,15 +2755,25 @@ void Plugin::CompileEndingCallback(HRESULT decision)
     Instance().Settings().compileSuccesses++;
     WriteToCompilerLog({ LogType::ConsoleMessage, TEXT("") });
     WriteToCompilerLog({ LogType::ConsoleMessage, TEXT("File compiled successfully!") });
+    if (compiler.verifiedScripts() > 0)
+        WriteToCompilerLog({ LogType::ConsoleMessage, std::format(TEXT("(code verification: {:.2f} ms)"), compiler.verificationMilliseconds()) });
 
     // Options to generate symbols and auto display must be set.
     if (Instance().Settings().autoDisplayDebugSymbols && Instance().Settings().generateSymbols)
     {
-        generic_string resultPath = str2wstr(properDirNameA(compiler.getDestinationDirectory().string()) + "\\" + compiler.getSourceFilePath().stem().string() + debugSymbolsFileSuffix);
-        // Points notepad++ to open that file
-        std::ignore = Instance().Messenger().SendNppMessage<bool>(NPPM_DOOPEN, 0, reinterpret_cast<LPARAM>(resultPath.c_str()));
-        //Sets language to NWScript (because color syntax WILL work for assembled symbols)
-        Instance().SetNotepadToPluginLexer();
+        // Symbols come straight from memory (while written to disk in background), else from the file
+        std::shared_ptr<const std::string> symbols = compiler.takeDisplayedOutput();
+        if (symbols)
+            Instance().DisplayGeneratedDocument(*symbols, true);
+        else
+        {
+            generic_string resultPath = str2wstr(properDirNameA(compiler.getDestinationDirectory().string()) + "\\" + compiler.getSourceFilePath().stem().string() + debugSymbolsFileSuffix);
+            // Points notepad++ to open that file
+            std::ignore = Instance().Messenger().SendNppMessage<bool>(NPPM_DOOPEN, 0, reinterpret_cast<LPARAM>(resultPath.c_str()));
+            //Sets language to NWScript (because color syntax WILL work for assembled symbols)
+            Instance().SetNotepadToPluginLexer();
+        }
+        compiler.finishDisplayedOutputWrite();
     }
 
     // Mark compilation time.
@@ -2675,6 +2789,7 @@ void Plugin::DisassembleEndingCallback(HRESULT decision)
     // Unlock controls to compiler log window
     Instance()._loggerWindow->LockControls(false);
     Instance().LockPluginMenu(false);
+    Instance().Compiler().releaseArchives();
 
     // Check if logger window need to switch to errors panel
     Instance()._loggerWindow->checkSwitchToErrors();
@@ -2684,11 +2799,19 @@ void Plugin::DisassembleEndingCallback(HRESULT decision)
 
     if (Instance().Settings().autoDisplayDisassembled)
     {
-        generic_string resultPath = str2wstr(properDirNameA(compiler.getDestinationDirectory().string()) + "\\" + compiler.getSourceFilePath().stem().string() + disassembledScriptSuffix);
-        // Points notepad++ to open that file
-        std::ignore = Instance().Messenger().SendNppMessage<bool>(NPPM_DOOPEN, 0, reinterpret_cast<LPARAM>(resultPath.c_str()));
-        //Sets language to NWScript (because color syntax WILL work for assembled symbols)
-        Instance().SetNotepadToPluginLexer();
+        // Listing comes straight from memory (while written to disk in background), else from the file
+        std::shared_ptr<const std::string> listing = compiler.takeDisplayedOutput();
+        if (listing)
+            Instance().DisplayGeneratedDocument(*listing, true);
+        else
+        {
+            generic_string resultPath = str2wstr(properDirNameA(compiler.getDestinationDirectory().string()) + "\\" + compiler.getSourceFilePath().stem().string() + disassembledScriptSuffix);
+            // Points notepad++ to open that file
+            std::ignore = Instance().Messenger().SendNppMessage<bool>(NPPM_DOOPEN, 0, reinterpret_cast<LPARAM>(resultPath.c_str()));
+            //Sets language to NWScript (because color syntax WILL work for assembled symbols)
+            Instance().SetNotepadToPluginLexer();
+        }
+        compiler.finishDisplayedOutputWrite();
     }
 
     // Mark compilation time.
@@ -2701,8 +2824,12 @@ void Plugin::BatchProcessFilesCallback(HRESULT decision)
 {
     Plugin& inst = Instance();
 
-    // Check for failed results
-    if (static_cast<int>(decision) == static_cast<int>(false) && !inst._settings.continueCompileOnFail)
+    // Keep the result of the previous file (first call is just the kickstart)
+    if (inst._batchCurrentFileIndex > 0)
+        inst._batchFileResults.push_back(static_cast<int>(decision) != static_cast<int>(false));
+
+    // Check for failed results. Open scripts always run to the end, since we want diagnostics for every tab.
+    if (static_cast<int>(decision) == static_cast<int>(false) && !inst._settings.continueCompileOnFail && !inst._batchOpenFiles)
     {
         WriteToCompilerLog({ LogType::ConsoleMessage, TEXT("") });
         WriteToCompilerLog({ LogType::ConsoleMessage, TEXT("Failed to process file... batch processing stopped.") });
@@ -2711,6 +2838,7 @@ void Plugin::BatchProcessFilesCallback(HRESULT decision)
         inst._processingFilesDialog->display(false);
         inst._loggerWindow->LockControls(false);
         inst.LockPluginMenu(false);
+        inst.Compiler().releaseArchives();
 
         // Check if logger window need to switch to errors panel
         Instance()._loggerWindow->checkSwitchToErrors();
@@ -2727,6 +2855,7 @@ void Plugin::BatchProcessFilesCallback(HRESULT decision)
         inst._processingFilesDialog->display(false);
         inst._loggerWindow->LockControls(false);
         inst.LockPluginMenu(false);
+        inst.Compiler().releaseArchives();
         return;
     }
 
@@ -2746,15 +2875,51 @@ void Plugin::BatchProcessFilesCallback(HRESULT decision)
     {
         // Done processing, write messages to log, close processing dialog.
         WriteToCompilerLog({ LogType::ConsoleMessage, TEXT("") });
-        WriteToCompilerLog({ LogType::ConsoleMessage, TEXT("Finished processing ") +
-            std::to_wstring(inst._batchFilesToProcess.size()) + TEXT(" files successfully.") });
+        if (inst._batchOpenFiles)
+        {
+            // Summary per open tab
+            size_t failed = 0;
+            for (size_t i = 0; i < inst._batchFilesToProcess.size(); i++)
+            {
+                bool success = i < inst._batchFileResults.size() && inst._batchFileResults[i];
+                failed += success ? 0 : 1;
+                WriteToCompilerLog({ LogType::ConsoleMessage, inst._batchFilesToProcess[i].filename().wstring() +
+                    (success ? TEXT(": OK") : TEXT(": FAILED")) });
+            }
+            WriteToCompilerLog({ LogType::ConsoleMessage, TEXT("") });
+            WriteToCompilerLog({ LogType::ConsoleMessage, TEXT("Compiled ") + std::to_wstring(inst._batchFilesToProcess.size()) +
+                TEXT(" open scripts, ") + std::to_wstring(failed) + TEXT(" failed.") });
+        }
+        else
+            WriteToCompilerLog({ LogType::ConsoleMessage, TEXT("Finished processing ") +
+                std::to_wstring(inst._batchFilesToProcess.size()) + TEXT(" files successfully.") });
+
+        if (inst.Compiler().verifiedScripts() > 0)
+            WriteToCompilerLog({ LogType::ConsoleMessage, std::format(TEXT("(code verification: {} scripts in {:.2f} ms)"),
+                inst.Compiler().verifiedScripts(), inst.Compiler().verificationMilliseconds()) });
+
+        if (inst.Compiler().fastPathScripts() > 0)
+            WriteToCompilerLog({ LogType::ConsoleMessage, std::format(TEXT("(fast path: {} of {} scripts had no includes)"),
+                inst.Compiler().fastPathScripts(), inst._batchFilesToProcess.size()) });
+
+        // Write the aggregated usage report next to the compiled files
+        if (inst.Compiler().isGatherUsageReport())
+            inst.Compiler().writeUsageReport(inst._settings.useScriptPathToBatchCompile ?
+                inst._settings.startingBatchFolder : inst._settings.batchOutputCompileDir);
+
+        // Engine comparisons only write their report
+        if (inst.Compiler().isCompareEngines())
+            inst.Compiler().writeComparisonReport(inst._settings.useScriptPathToBatchCompile ?
+                inst._settings.startingBatchFolder : inst._settings.batchOutputCompileDir);
 
         inst._processingFilesDialog->display(false);
 
         // Enable run last batch (after unlocking controls)
         inst._loggerWindow->LockControls(false);
         inst.LockPluginMenu(false);
-        Instance().EnablePluginMenuItem(PLUGINMENU_RUNLASTBATCH, true);
+        inst.Compiler().releaseArchives();
+        if (!inst._batchOpenFiles && !inst._batchCompareEngines)
+            Instance().EnablePluginMenuItem(PLUGINMENU_RUNLASTBATCH, true);
 
         // Check if logger window need to switch to errors panel
         Instance()._loggerWindow->checkSwitchToErrors();
@@ -2774,6 +2939,7 @@ void Plugin::FetchPreprocessedEndingCallback(HRESULT decision)
     // Unlock controls to compiler log window
     Instance()._loggerWindow->LockControls(false);
     Instance().LockPluginMenu(false);
+    Instance().Compiler().releaseArchives();
 
     // Check if logger window need to switch to errors panel
     Instance()._loggerWindow->checkSwitchToErrors();
@@ -2782,12 +2948,8 @@ void Plugin::FetchPreprocessedEndingCallback(HRESULT decision)
     if (static_cast<int>(decision) == static_cast<int>(false))
         return;
 
-    // Creates a new document...
-    Instance().Messenger().SendNppMessage<void>(NPPM_MENUCOMMAND, 0, IDM_FILE_NEW);
-    // Sets the language to NWScript
-    Instance().SetNotepadToPluginLexer();
-    // Sets document data
-    Instance().Messenger().SendSciMessage<void>(SCI_SETTEXT, 0, reinterpret_cast<LPARAM>(Instance().Compiler().logger().getProcessorString().c_str()));
+    // Creates a new NWScript document with the preprocessed output
+    Instance().DisplayGeneratedDocument(Instance().Compiler().logger().getProcessorString(), true);
 
     // Mark compilation time.
     double durationFloat = (double)(GetTickCount64() - Instance()._clockStart) / (double)1000;
@@ -2795,12 +2957,32 @@ void Plugin::FetchPreprocessedEndingCallback(HRESULT decision)
 
 }
 
-// Receives notifications when a "View Script Dependencies" menu command ends
+// Receives notifications when a "Compile snippets manifest" menu command ends
+void Plugin::CompileSnippetsEndingCallback(HRESULT decision)
+{
+    // Unlock controls to compiler log window
+    Instance()._loggerWindow->LockControls(false);
+    Instance().LockPluginMenu(false);
+    Instance().Compiler().releaseArchives();
+
+    // Check if logger window need to switch to errors panel
+    Instance()._loggerWindow->checkSwitchToErrors();
+
+    if (static_cast<int>(decision) == static_cast<int>(true))
+        WriteToCompilerLog({ LogType::ConsoleMessage, TEXT("All snippets compiled successfully!") });
+
+    // Mark compilation time.
+    double durationFloat = (double)(GetTickCount64() - Instance()._clockStart) / (double)1000;
+    WriteToCompilerLog({ LogType::ConsoleMessage, std::format(TEXT("(total execution time: {:.2f} seconds)\n"), durationFloat) });
+}
+
+// Receives notifications when a "View Script Dependencies" or "View NWScript include graph" menu command ends
 void Plugin::ViewDependenciesEndingCallback(HRESULT decision)
 {
     // Unlock controls to compiler log window
     Instance()._loggerWindow->LockControls(false);
     Instance().LockPluginMenu(false);
+    Instance().Compiler().releaseArchives();
 
     // Check if logger window need to switch to errors panel
     Instance()._loggerWindow->checkSwitchToErrors();
@@ -2808,10 +2990,8 @@ void Plugin::ViewDependenciesEndingCallback(HRESULT decision)
     if (static_cast<int>(decision) == static_cast<int>(false))
         return;
 
-    // Creates a new document...
-    Instance().Messenger().SendNppMessage<void>(NPPM_MENUCOMMAND, 0, IDM_FILE_NEW);
-    // Sets document data
-    Instance().Messenger().SendSciMessage<void>(SCI_SETTEXT, 0, reinterpret_cast<LPARAM>(Instance().Compiler().logger().getProcessorString().c_str()));
+    // Creates a new document with the dependencies
+    Instance().DisplayGeneratedDocument(Instance().Compiler().logger().getProcessorString(), false);
 
     // Mark compilation time.
     double durationFloat = (double)(GetTickCount64() - Instance()._clockStart) / (double)1000;
@@ -2924,6 +3104,42 @@ void CALLBACK Plugin::RunScheduledReposition(HWND hwnd, UINT message, UINT idTim
     KillTimer(hwnd, NAGIVATECALLBACKTIMER);
 }
 
+// Moves the references found so far into the compiler window, and finishes the search once it's done.
+// Results are only ever written from here, so the compiler window is always updated from its own thread.
+void CALLBACK Plugin::ReportFoundReferences(HWND hwnd, UINT message, UINT idTimer, DWORD dwTime)
+{
+    Plugin& inst = Instance();
+
+    std::vector<ReferenceFinder::Reference> references;
+    bool searching = inst._referenceFinder.takeResults(references);
+
+    for (const ReferenceFinder::Reference& r : references)
+    {
+        generic_string fileExt = r.filePath.extension().wstring();
+        if (!fileExt.empty())
+            fileExt.erase(0, 1);
+
+        inst._loggerWindow->LogMessage({ LogType::Info, str2wstr(r.lineText), TEXT("Reference"),
+            r.filePath.stem().wstring(), fileExt, std::to_wstring(r.line) }, r.filePath.wstring());
+    }
+    inst._referencesFound += references.size();
+
+    if (searching)
+        return;
+
+    KillTimer(hwnd, FINDREFERENCESTIMER);
+
+    size_t filesSearched = inst._referenceFinder.filesSearched();
+    WriteToCompilerLog({ LogType::ConsoleMessage, TEXT("") });
+    WriteToCompilerLog({ LogType::ConsoleMessage, std::format(TEXT("Found {} references to \"{}\" in {} files ({} answered by the token index)."),
+        inst._referencesFound, str2wstr(inst._referenceIdentifier), filesSearched, inst._referenceFinder.filesFromIndex()) });
+
+    double durationFloat = (double)(GetTickCount64() - inst._clockStart) / (double)1000;
+    WriteToCompilerLog({ LogType::ConsoleMessage, std::format(TEXT("(total execution time: {:.2f} seconds)\n"), durationFloat) });
+
+    inst.LockPluginMenu(false);
+}
+
 #pragma endregion Compiler Funcionality
 
 #pragma region
@@ -2989,6 +3205,8 @@ PLUGINCOMMAND Plugin::CompileScript()
     Instance().Compiler().reset();
     // Set mode to compile script
     Instance().Compiler().setMode(0);
+    // Symbols to auto-display are kept in memory
+    Instance().Compiler().setKeepDisplayedOutput(Instance().Settings().autoDisplayDebugSymbols && Instance().Settings().generateSymbols);
     // Set our caller callback
     Instance().Compiler().setProcessingEndCallback(CompileEndingCallback);
     // Pass the control to core function calling compile from current document
@@ -3014,6 +3232,8 @@ PLUGINCOMMAND Plugin::DisassembleFile()
         Instance().Compiler().reset();
         // Set mode to disassemble script
         Instance().Compiler().setMode(1);
+        // Listing to auto-display is kept in memory
+        Instance().Compiler().setKeepDisplayedOutput(Instance().Settings().autoDisplayDisassembled);
         // Set our caller callback
         Instance().Compiler().setProcessingEndCallback(DisassembleEndingCallback);
         // Pass the control to core function calling disassemble from file
@@ -3027,6 +3247,137 @@ PLUGINCOMMAND Plugin::RunLastBatch()
     BatchProcessDialogCallback(static_cast<HRESULT>(static_cast<int>(true)));
 }
 
+// Menu Command "Compile snippets manifest" function handler. 
+PLUGINCOMMAND Plugin::CompileSnippets()
+{
+    std::vector<generic_string> nFileName;
+    if (openFileDialog(Instance().NotepadHwnd(), nFileName,
+        TEXT("Snippet Manifests (*.txt)\0*.txt\0All Files (*.*)\0*.*"),
+        properDirNameW(Instance().Settings().lastOpenedDir)))
+    {
+        // Start counting ticks
+        Instance()._clockStart = GetTickCount64();
+
+        // Display and clear compiler log window
+        Instance().DisplayCompilerLogWindow(true);
+        Instance()._loggerWindow->reset();
+
+        // Reset compiler cache and clear log so we catch all possible dependencies editions.
+        Instance().Compiler().reset();
+        // Set mode to compile snippets
+        Instance().Compiler().setCompileSnippets();
+        // Set our caller callback
+        Instance().Compiler().setProcessingEndCallback(CompileSnippetsEndingCallback);
+        // Pass the control to core function calling compile from the manifest file
+        Instance().DoCompileOrDisasm(nFileName[0]);
+    }
+}
+
+// Menu Command "Compile all open scripts" function handler. 
+PLUGINCOMMAND Plugin::CompileAllOpenScripts()
+{
+    Plugin& inst = Instance();
+    std::vector<fs::path> openScripts;
+    std::map<std::string, std::string> sourceOverlay;
+
+    // Remember the active document of both views, since we need to activate every tab to read its contents
+    int currentView = inst.Messenger().SendNppMessage<int>(NPPM_GETCURRENTVIEW);
+    int activeIndex[2] = {
+        inst.Messenger().SendNppMessage<int>(NPPM_GETCURRENTDOCINDEX, 0, MAIN_VIEW),
+        inst.Messenger().SendNppMessage<int>(NPPM_GETCURRENTDOCINDEX, 0, SUB_VIEW) };
+
+    for (int view : { MAIN_VIEW, SUB_VIEW })
+    {
+        int fileCount = inst.Messenger().SendNppMessage<int>(NPPM_GETNBOPENFILES, 0, view == MAIN_VIEW ? PRIMARY_VIEW : SECOND_VIEW);
+        for (int i = 0; i < fileCount; i++)
+        {
+            LRESULT bufferID = inst.Messenger().SendNppMessage<LRESULT>(NPPM_GETBUFFERIDFROMPOS, i, view);
+            if (bufferID == 0)
+                continue;
+
+            TCHAR pathBuffer[MAX_PATH] = { 0 };
+            inst.Messenger().SendNppMessage<void>(NPPM_GETFULLPATHFROMBUFFERID, bufferID, reinterpret_cast<LPARAM>(pathBuffer));
+            fs::path scriptPath = pathBuffer;
+
+            // Only scripts that exist on disk (even if modified) can be compiled: new documents have no name to include.
+            // Documents cloned on both views are only read once.
+            std::string scriptKey = NWScriptCompiler::sourceOverlayKey(scriptPath);
+            if (_wcsicmp(scriptPath.extension().c_str(), TEXT(".nss")) != 0 || _wcsicmp(scriptPath.filename().c_str(), TEXT("nwscript.nss")) == 0
+                || !PathFileExists(scriptPath.c_str()) || sourceOverlay.contains(scriptKey))
+                continue;
+
+            inst.Messenger().SendNppMessage<void>(NPPM_ACTIVATEDOC, view, i);
+            size_t size = inst.Messenger().SendSciMessage<size_t>(SCI_GETLENGTH) + 1;
+            std::string contents(size, '\0');
+            inst.Messenger().SendSciMessage<void>(SCI_GETTEXT, size, reinterpret_cast<LPARAM>(contents.data()));
+            contents.resize(size - 1);
+
+            sourceOverlay.insert({ scriptKey, std::move(contents) });
+            openScripts.push_back(scriptPath);
+        }
+    }
+
+    // Put back the other view first, so the focus ends on the view that had it
+    int otherView = currentView == MAIN_VIEW ? SUB_VIEW : MAIN_VIEW;
+    if (activeIndex[otherView] >= 0)
+        inst.Messenger().SendNppMessage<void>(NPPM_ACTIVATEDOC, otherView, activeIndex[otherView]);
+    if (activeIndex[currentView] >= 0)
+        inst.Messenger().SendNppMessage<void>(NPPM_ACTIVATEDOC, currentView, activeIndex[currentView]);
+
+    if (openScripts.empty())
+    {
+        MessageBox(inst.NotepadHwnd(), TEXT("There are no saved NWScript files (.nss) open to compile."), TEXT("Compile all open scripts"), MB_OK | MB_ICONINFORMATION);
+        return;
+    }
+
+    // Start counting ticks
+    inst._clockStart = GetTickCount64();
+
+    if (!inst._processingFilesDialog->isCreated())
+    {
+        inst._processingFilesDialog->init(inst.DllHModule(), inst.NotepadHwnd());
+    }
+
+    // Setup interrupt flag
+    inst._processingFilesDialog->setInterruptFlag(inst._batchInterrupt);
+
+    // Reset batch state and add the open scripts to it
+    inst.ResetBatchStates();
+    inst._batchFilesToProcess = std::move(openScripts);
+    inst._batchOpenFiles = true;
+
+    // Prepare compiler: all scripts share the same resource cache, with the editor contents over the disk ones
+    inst.Compiler().reset();
+    inst.Compiler().setMode(0);
+    inst.Compiler().setSourceOverlay(std::move(sourceOverlay));
+    inst.Compiler().setProcessingEndCallback(BatchProcessFilesCallback);
+
+    // Display and clear compiler log window
+    inst._loggerWindow->reset();
+    inst.DisplayCompilerLogWindow(true);
+
+    inst._processingFilesDialog->setStatus(TEXT("Compiling open scripts..."));
+    inst._processingFilesDialog->showDialog();
+
+    BatchProcessFilesCallback(static_cast<HRESULT>(static_cast<int>(true)));
+}
+
+// Menu Command "Compare compiler engines on batch folder" function handler. 
+PLUGINCOMMAND Plugin::CompareCompilerEngines()
+{
+    Plugin& inst = Instance();
+
+    // The corpus is the one set up in the batch processing dialog
+    if (inst._settings.startingBatchFolder.empty() || !isValidDirectory(inst._settings.startingBatchFolder.c_str()))
+    {
+        MessageBox(inst.NotepadHwnd(), TEXT("Please choose a starting folder on \"Batch Process NWScript Files...\" first. Its compile filters and subfolder settings are used for the comparison."),
+            TEXT("Compare compiler engines"), MB_OK | MB_ICONINFORMATION);
+        return;
+    }
+
+    inst.StartBatchProcessing(true);
+}
+
 // Opens the Plugin's Batch process files dialog
 PLUGINCOMMAND Plugin::BatchProcessFiles()
 {
@@ -3105,6 +3456,90 @@ PLUGINCOMMAND Plugin::ViewScriptDependencies()
     Instance().DoCompileOrDisasm(TEXT(""), true);
 }
 
+// Menu Command "View NWScript include graph" function handler. 
+PLUGINCOMMAND Plugin::ViewIncludeGraph()
+{
+    // Do a check of the current script for the user.
+    if (!Instance().CheckScintillaDocument())
+        return;
+
+    // Start counting ticks
+    Instance()._clockStart = GetTickCount64();
+
+    // Display and clear compiler log window
+    Instance().DisplayCompilerLogWindow(true);
+    Instance()._loggerWindow->reset();
+
+    // Reset compiler so we catch all possible include editions.
+    Instance().Compiler().reset();
+    // Tells compiler to only record and report the include graph
+    Instance().Compiler().setViewIncludeGraph();
+    // The generated document is displayed the same way as the dependencies view
+    Instance().Compiler().setProcessingEndCallback(ViewDependenciesEndingCallback);
+    // Pass the control to core function calling compile from current document
+    Instance().DoCompileOrDisasm(TEXT(""), true);
+}
+
+// Menu Command "Find references" function handler. 
+PLUGINCOMMAND Plugin::FindReferences()
+{
+    Plugin& inst = Instance();
+
+    // Search for the selected text, or else for the word under the caret
+    size_t selectionStart = inst.Messenger().SendSciMessage<size_t>(SCI_GETSELECTIONSTART);
+    size_t selectionEnd = inst.Messenger().SendSciMessage<size_t>(SCI_GETSELECTIONEND);
+    if (selectionStart == selectionEnd)
+    {
+        size_t position = inst.Messenger().SendSciMessage<size_t>(SCI_GETCURRENTPOS);
+        selectionStart = inst.Messenger().SendSciMessage<size_t>(SCI_WORDSTARTPOSITION, position, true);
+        selectionEnd = inst.Messenger().SendSciMessage<size_t>(SCI_WORDENDPOSITION, position, true);
+    }
+
+    std::string identifier;
+    if (selectionEnd > selectionStart && selectionEnd - selectionStart <= UINT16_MAX)
+    {
+        identifier.resize(selectionEnd - selectionStart + 1);
+        Sci_TextRange range = { { static_cast<Sci_PositionCR>(selectionStart), static_cast<Sci_PositionCR>(selectionEnd) }, identifier.data() };
+        inst.Messenger().SendSciMessage<void>(SCI_GETTEXTRANGE, 0, reinterpret_cast<LPARAM>(&range));
+        identifier.resize(selectionEnd - selectionStart);
+    }
+
+    if (!ReferenceFinder::isIdentifier(identifier))
+    {
+        MessageBox(inst.NotepadHwnd(), TEXT("Place the caret on (or select) the identifier to search for."), TEXT("Find references"), MB_OK | MB_ICONINFORMATION);
+        return;
+    }
+
+    // The module is the folder of the current script, then we look on every include path
+    std::vector<fs::path> folders;
+    TCHAR directoryBuffer[MAX_PATH] = { 0 };
+    inst.Messenger().SendNppMessage<void>(NPPM_GETCURRENTDIRECTORY, std::size(directoryBuffer), reinterpret_cast<LPARAM>(directoryBuffer));
+    if (directoryBuffer[0] != 0)
+        folders.push_back(directoryBuffer);
+    for (const generic_string& includeDir : inst.Settings().getIncludeDirsV())
+        folders.push_back(includeDir);
+
+    // The token index is only loaded when first needed
+    if (inst._referenceFinder.indexFile().empty())
+        inst._referenceFinder.setIndexFile(inst._pluginPaths["NWScriptReferenceIndexFile"]);
+
+    // Start counting ticks
+    inst._clockStart = GetTickCount64();
+
+    // Display and clear compiler log window. Its controls stay unlocked, so results can be opened while the search goes on.
+    inst._loggerWindow->reset();
+    inst.DisplayCompilerLogWindow(true);
+    inst._loggerWindow->showInfosList();
+    inst.LockPluginMenu(true);
+
+    WriteToCompilerLog({ LogType::ConsoleMessage, TEXT("Searching references to \"") + str2wstr(identifier) + TEXT("\"...") });
+
+    inst._referenceIdentifier = identifier;
+    inst._referencesFound = 0;
+    inst._referenceFinder.start(identifier, folders);
+    SetTimer(inst.NotepadHwnd(), FINDREFERENCESTIMER, 100, (TIMERPROC)ReportFoundReferences);
+}
+
 //-------------------------------------------------------------
 
 // Opens the Plugin's Compiler Settings panel
@@ -19,6 +19,7 @@
 #include "Settings.h"
 #include "NWScriptParser.h"
 #include "NWScriptCompiler.h"
+#include "ReferenceFinder.h"
 
 #include "AboutDialog.h"
 #include "LoggerDialog.h"
@@ -137,12 +138,22 @@ namespace NWScriptPlugin {
 		static PLUGINCOMMAND BatchProcessFiles();
 		// Menu Command "Run last successful batch" function handler. 
 		static PLUGINCOMMAND RunLastBatch();
+		// Menu Command "Compile snippets manifest" function handler. 
+		static PLUGINCOMMAND CompileSnippets();
+		// Menu Command "Compile all open scripts" function handler. 
+		static PLUGINCOMMAND CompileAllOpenScripts();
+		// Menu Command "Compare compiler engines on batch folder" function handler. 
+		static PLUGINCOMMAND CompareCompilerEngines();
 		// Menu Command "Run last successful batch" function handler. 
 		static PLUGINCOMMAND ToggleLogger();
 		// Menu Command "Fetch preprocessor text" function handler. 
 		static PLUGINCOMMAND FetchPreprocessorText();
 		// Menu Command "View Script Dependencies" function handler. 
 		static PLUGINCOMMAND ViewScriptDependencies();
+		// Menu Command "View NWScript include graph" function handler. 
+		static PLUGINCOMMAND ViewIncludeGraph();
+		// Menu Command "Find references" function handler. 
+		static PLUGINCOMMAND FindReferences();
 		// Menu Command "Compiler settings" function handler. 
 		static PLUGINCOMMAND CompilerSettings();
 		// Menu Command "Compiler settings" function handler. 
@@ -194,6 +205,8 @@ namespace NWScriptPlugin {
 		// Load current Notepad++ Language Lexer when language changed.
 		// Called from messages: NPPN_READY, NPPN_LANGCHANGED and NPPN_BUFFERACTIVATED
 		void LoadNotepadLexer();
+		// Sets the large file lexing threshold on our lexer and shows a status bar notice for large documents
+		void CheckLargeFileLexing();
 		// Finds the language ID for our plugin
 		int FindPluginLangID();
 		// Initializes the compiler log window
@@ -244,10 +257,17 @@ namespace NWScriptPlugin {
 		void ResetBatchStates() {
 			_batchCurrentFileIndex = 0;
 			_batchInterrupt = 0;
+			_batchOpenFiles = false;
+			_batchCompareEngines = false;
 			_batchFilesToProcess.clear();
+			_batchFileResults.clear();
 		}
+		// Starts a batch over the files of the batch settings (optionally comparing both compiler engines)
+		void StartBatchProcessing(bool compareEngines);
 		// Build the batch files list in async thread
 		void BuildFilesList();
+		// Shows generated text (preprocessed output, listings) on a new document
+		void DisplayGeneratedDocument(const std::string& contents, bool setPluginLexer);
 
 		// Some callback functions for different operations
 
@@ -257,9 +277,11 @@ namespace NWScriptPlugin {
 		static void DisassembleEndingCallback(HRESULT decision);
 		// Receives notifications for each file processed
 		static void BatchProcessFilesCallback(HRESULT decision);
+		// Receives notifications when a "Compile snippets manifest" menu command ends
+		static void CompileSnippetsEndingCallback(HRESULT decision);
 		// Receives notifications when a "Fetch preprocessed" menu command ends
 		static void FetchPreprocessedEndingCallback(HRESULT decision);
-		// Receives notifications when a "Fetch preprocessed" menu command ends
+		// Receives notifications when a "View Script Dependencies" or "View NWScript include graph" menu command ends
 		static void ViewDependenciesEndingCallback(HRESULT decision);
 		// Receives log notification messages and write to the compiler window
 		static void WriteToCompilerLog(const NWScriptLogger::CompilerMessage& message);
@@ -268,6 +290,8 @@ namespace NWScriptPlugin {
 			const fs::path& filePath = TEXT(""));
 		// Reposition the navigation cursor assynchronously
 		static void CALLBACK RunScheduledReposition(HWND hwnd, UINT message, UINT idTimer, DWORD dwTime);
+		// Moves the references found so far into the compiler window, and finishes the search once it's done
+		static void CALLBACK ReportFoundReferences(HWND hwnd, UINT message, UINT idTimer, DWORD dwTime);
 
 		// ### XML config files management
 
@@ -354,6 +378,16 @@ namespace NWScriptPlugin {
 		std::vector<fs::path> _batchFilesToProcess;
 		size_t _batchCurrentFileIndex = 0;
 		std::atomic<bool> _batchInterrupt = false;
+		// Batch made of the scripts open in the editor ("Compile all open scripts")
+		bool _batchOpenFiles = false;
+		std::vector<bool> _batchFileResults;
+		// Batch compiling every file with both engines ("Compare compiler engines")
+		bool _batchCompareEngines = false;
+
+		// "Find references" search and the identifier it's looking for
+		ReferenceFinder _referenceFinder;
+		std::string _referenceIdentifier;
+		size_t _referencesFound = 0;
 
 		// Meta Information about the plugin paths
 		std::map<std::string, fs::path> _pluginPaths;
@@ -0,0 +1,473 @@
+/** @file ReferenceFinder.cpp
+ * Finds every reference to an identifier across the scripts of a module and its include paths
+ *
+ **/
+ // Copyright (C) 2022 - Leonardo Silva
+ // The License.txt file describes the conditions under which this software may be distributed.
+
+#include "pch.h"
+
+#include <algorithm>
+#include <cwctype>
+#include <functional>
+#include <set>
+
+#include "Common.h"
+#include "ReferenceFinder.h"
+
+using namespace NWScriptPlugin;
+namespace fs = std::filesystem;
+
+// Index file layout: header, then for each file its key, write time, size, identifier names,
+// name offsets and positions. All values are native endian; the file never leaves the machine.
+constexpr uint32_t indexFileMagic = 0x4952574E;     // "NWRI"
+constexpr uint32_t indexFileVersion = 1;
+
+static bool isIdentifierStart(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static bool isIdentifierChar(char c)
+{
+    return isIdentifierStart(c) || (c >= '0' && c <= '9');
+}
+
+template <typename T>
+static void writeValue(std::ostream& out, const T& value)
+{
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+namespace {
+
+// Bounds checked reads over the loaded index file
+class IndexReader {
+public:
+    IndexReader(const std::vector<char>& data) : _p(data.data()), _end(data.data() + data.size()) {}
+
+    template <typename T>
+    bool read(T& value) {
+        return readBytes(&value, sizeof(T));
+    }
+
+    bool readBytes(void* dest, size_t size) {
+        if (static_cast<size_t>(_end - _p) < size)
+            return false;
+        memcpy(dest, _p, size);
+        _p += size;
+        return true;
+    }
+
+private:
+    const char* _p;
+    const char* _end;
+};
+
+}
+
+bool ReferenceFinder::isIdentifier(std::string_view text)
+{
+    if (text.empty() || !isIdentifierStart(text[0]))
+        return false;
+    return std::all_of(text.begin(), text.end(), isIdentifierChar);
+}
+
+void ReferenceFinder::setIndexFile(const fs::path& indexFile)
+{
+    cancel();
+
+    _indexFile = indexFile;
+    _index.clear();
+    _indexChanged = false;
+    if (!loadIndex())
+        _index.clear();
+}
+
+void ReferenceFinder::start(const std::string& identifier, const std::vector<fs::path>& folders)
+{
+    cancel();
+
+    _results.clear();
+    _nextFile = 0;
+    _filesSearched = 0;
+    _filesFromIndex = 0;
+    _cancel = false;
+    _running = true;
+    _searcher = std::thread(&ReferenceFinder::run, this, identifier, folders);
+}
+
+void ReferenceFinder::cancel()
+{
+    _cancel = true;
+    if (_searcher.joinable())
+        _searcher.join();
+    _running = false;
+}
+
+bool ReferenceFinder::takeResults(std::vector<Reference>& results)
+{
+    // Read before taking: once the search is seen as over, everything it found is already queued
+    bool wasRunning = _running;
+
+    std::lock_guard<std::mutex> lock(_resultsLock);
+    bool taken = !_results.empty();
+    std::move(_results.begin(), _results.end(), std::back_inserter(results));
+    _results.clear();
+
+    return wasRunning || taken;
+}
+
+void ReferenceFinder::run(std::string identifier, std::vector<fs::path> folders)
+{
+    // Gather the scripts first, so the workers can split them. Folders listed twice
+    // (eg: the module folder is also an include path) are only searched once.
+    std::vector<fs::path> files;
+    std::set<IndexKey> seen;
+    for (const fs::path& folder : folders)
+    {
+        std::error_code ec;
+        for (const fs::directory_entry& entry : fs::directory_iterator(folder, ec))
+        {
+            if (_cancel)
+                break;
+
+            std::error_code fileEc;
+            if (!entry.is_regular_file(fileEc) || _wcsicmp(entry.path().extension().c_str(), L".nss") != 0)
+                continue;
+            if (seen.insert(indexKey(entry.path())).second)
+                files.push_back(entry.path());
+        }
+    }
+
+    // Scanning is mostly waiting on the disk for new files and on memory for indexed ones
+    size_t workerCount = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, 8);
+    workerCount = std::min(workerCount, files.size());
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < workerCount; i++)
+        workers.emplace_back(&ReferenceFinder::worker, this, std::cref(identifier), std::cref(files));
+    for (std::thread& t : workers)
+        t.join();
+
+    // Whatever got indexed is kept, even from a canceled search
+    {
+        std::lock_guard<std::mutex> lock(_indexLock);
+        if (_indexChanged && !_indexFile.empty() && saveIndex())
+            _indexChanged = false;
+    }
+
+    _running = false;
+}
+
+void ReferenceFinder::worker(const std::string& identifier, const std::vector<fs::path>& files)
+{
+    std::vector<Position> found;
+    for (size_t i = _nextFile++; i < files.size() && !_cancel; i = _nextFile++)
+    {
+        found.clear();
+        if (!searchFile(identifier, files[i], found))
+            continue;
+
+        _filesSearched++;
+        if (!found.empty())
+            queueResults(files[i], found);
+    }
+}
+
+bool ReferenceFinder::searchFile(const std::string& identifier, const fs::path& filePath, std::vector<Position>& found)
+{
+    std::error_code ec;
+    uint64_t fileSize = fs::file_size(filePath, ec);
+    if (ec)
+        return false;
+    int64_t lastWrite = fs::last_write_time(filePath, ec).time_since_epoch().count();
+    if (ec)
+        return false;
+
+    IndexKey key = indexKey(filePath);
+
+    const auto findPositions = [&identifier, &found](const FileIndex& fileIndex) {
+        auto it = std::lower_bound(fileIndex.names.begin(), fileIndex.names.end(), identifier);
+        if (it == fileIndex.names.end() || *it != identifier)
+            return;
+        size_t name = it - fileIndex.names.begin();
+        found.assign(fileIndex.positions.begin() + fileIndex.first[name], fileIndex.positions.begin() + fileIndex.first[name + 1]);
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(_indexLock);
+        auto it = _index.find(key);
+        if (it != _index.end() && it->second.lastWrite == lastWrite && it->second.fileSize == fileSize)
+        {
+            findPositions(it->second);
+            _filesFromIndex++;
+            return true;
+        }
+    }
+
+    std::string contents;
+    if (!fileToBuffer(filePath.c_str(), contents))
+        return false;
+
+    FileIndex fileIndex;
+    fileIndex.lastWrite = lastWrite;
+    fileIndex.fileSize = fileSize;
+    tokenize(contents, fileIndex);
+    findPositions(fileIndex);
+
+    std::lock_guard<std::mutex> lock(_indexLock);
+    _index[key] = std::move(fileIndex);
+    _indexChanged = true;
+
+    return true;
+}
+
+// The index only keeps positions, so the text of the matching lines is read back here
+void ReferenceFinder::queueResults(const fs::path& filePath, const std::vector<Position>& found)
+{
+    std::string contents;
+    fileToBuffer(filePath.c_str(), contents);
+
+    std::vector<Reference> references;
+    const char* p = contents.data();
+    const char* end = p + contents.size();
+    uint32_t line = 1;
+    for (const Position& position : found)
+    {
+        while (p < end && line < position.line)
+        {
+            if (*p++ == '\n')
+                line++;
+        }
+
+        const char* lineStart = p;
+        const char* lineEnd = p;
+        while (lineEnd < end && *lineEnd != '\n' && *lineEnd != '\r')
+            lineEnd++;
+        while (lineStart < lineEnd && (*lineStart == ' ' || *lineStart == '\t'))
+            lineStart++;
+
+        Reference& reference = references.emplace_back();
+        reference.filePath = filePath;
+        reference.line = position.line;
+        reference.column = position.column;
+        if (line == position.line)
+            reference.lineText.assign(lineStart, lineEnd);
+    }
+
+    std::lock_guard<std::mutex> lock(_resultsLock);
+    std::move(references.begin(), references.end(), std::back_inserter(_results));
+}
+
+ReferenceFinder::IndexKey ReferenceFinder::indexKey(const fs::path& filePath)
+{
+    IndexKey key = filePath.lexically_normal().native();
+#ifdef _WINDOWS
+    for (auto& c : key)
+        c = static_cast<fs::path::value_type>(std::towlower(c));
+#endif
+    return key;
+}
+
+// Same rules the compiler's include scanner uses for comments and strings. Tokens starting with
+// a digit are numbers (with any suffix or fraction), so "1.5f" never yields an "f" identifier.
+void ReferenceFinder::tokenize(std::string_view contents, FileIndex& index)
+{
+    std::vector<std::pair<std::string_view, Position>> tokens;
+
+    const char* start = contents.data();
+    const char* p = start;
+    const char* end = p + contents.size();
+    const char* lineStart = p;
+    uint32_t line = 1;
+
+    const auto newLine = [&](const char* at) {
+        line++;
+        lineStart = at + 1;
+    };
+
+    while (p < end)
+    {
+        if (*p == '\n')
+        {
+            newLine(p);
+            p++;
+        }
+        else if (p[0] == '/' && p + 1 < end && p[1] == '/')
+        {
+            while (p < end && *p != '\n')
+                p++;
+        }
+        else if (p[0] == '/' && p + 1 < end && p[1] == '*')
+        {
+            p += 2;
+            while (p + 1 < end && !(p[0] == '*' && p[1] == '/'))
+            {
+                if (*p == '\n')
+                    newLine(p);
+                p++;
+            }
+            p += 2;
+        }
+        else if (*p == '"')
+        {
+            p++;
+            while (p < end && *p != '"' && *p != '\n')
+            {
+                if (*p == '\\' && p + 1 < end && p[1] != '\n')
+                    p++;
+                p++;
+            }
+            if (p < end && *p == '"')
+                p++;
+        }
+        else if (*p >= '0' && *p <= '9')
+        {
+            while (p < end && (isIdentifierChar(*p) || *p == '.'))
+                p++;
+        }
+        else if (isIdentifierStart(*p))
+        {
+            const char* tokenStart = p;
+            while (p < end && isIdentifierChar(*p))
+                p++;
+            if (p - tokenStart <= UINT16_MAX)
+                tokens.push_back({ std::string_view(tokenStart, p - tokenStart),
+                    { line, static_cast<uint32_t>(tokenStart - lineStart) + 1 } });
+        }
+        else
+            p++;
+    }
+
+    // Stable, so each name keeps its positions in file order
+    std::stable_sort(tokens.begin(), tokens.end(), [](const auto& l, const auto& r) { return l.first < r.first; });
+
+    index.names.clear();
+    index.first.clear();
+    index.positions.clear();
+    index.positions.reserve(tokens.size());
+    for (const auto& token : tokens)
+    {
+        if (index.names.empty() || index.names.back() != token.first)
+        {
+            index.names.emplace_back(token.first);
+            index.first.push_back(static_cast<uint32_t>(index.positions.size()));
+        }
+        index.positions.push_back(token.second);
+    }
+    index.first.push_back(static_cast<uint32_t>(index.positions.size()));
+}
+
+bool ReferenceFinder::loadIndex()
+{
+    std::ifstream file(_indexFile, std::ios::binary);
+    if (!file)
+        return true;
+
+    std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    IndexReader reader(data);
+
+    uint32_t magic = 0, version = 0, fileCount = 0;
+    if (!reader.read(magic) || !reader.read(version) || !reader.read(fileCount) ||
+        magic != indexFileMagic || version != indexFileVersion)
+        return false;
+
+    for (uint32_t i = 0; i < fileCount; i++)
+    {
+        uint32_t keyLength = 0;
+        if (!reader.read(keyLength) || keyLength > data.size())
+            return false;
+        IndexKey key(keyLength, 0);
+        if (!reader.readBytes(key.data(), keyLength * sizeof(IndexKey::value_type)))
+            return false;
+
+        FileIndex fileIndex;
+        uint32_t nameCount = 0, positionCount = 0;
+        if (!reader.read(fileIndex.lastWrite) || !reader.read(fileIndex.fileSize) || !reader.read(nameCount) ||
+            nameCount > data.size())
+            return false;
+
+        fileIndex.names.resize(nameCount);
+        for (std::string& name : fileIndex.names)
+        {
+            uint16_t nameLength = 0;
+            if (!reader.read(nameLength))
+                return false;
+            name.resize(nameLength);
+            if (!reader.readBytes(name.data(), nameLength))
+                return false;
+        }
+
+        // Lookups binary search the names
+        if (std::adjacent_find(fileIndex.names.begin(), fileIndex.names.end(), std::greater_equal<std::string>()) != fileIndex.names.end())
+            return false;
+
+        // Name i owns positions [first[i], first[i + 1]): the offsets must start at 0, never
+        // decrease and end at the position count, or a stale file could point past the positions
+        fileIndex.first.resize(nameCount + 1);
+        if (!reader.readBytes(fileIndex.first.data(), fileIndex.first.size() * sizeof(uint32_t)) ||
+            !reader.read(positionCount) || positionCount > data.size() ||
+            fileIndex.first.front() != 0 || fileIndex.first.back() != positionCount ||
+            !std::is_sorted(fileIndex.first.begin(), fileIndex.first.end()))
+            return false;
+
+        fileIndex.positions.resize(positionCount);
+        if (!reader.readBytes(fileIndex.positions.data(), positionCount * sizeof(Position)))
+            return false;
+
+        _index[std::move(key)] = std::move(fileIndex);
+    }
+
+    return true;
+}
+
+// Called with the index lock held
+bool ReferenceFinder::saveIndex()
+{
+    // Forget the files that are gone since they were indexed
+    std::erase_if(_index, [](const auto& entry) {
+        std::error_code ec;
+        return !fs::exists(fs::path(entry.first), ec);
+    });
+
+    fs::path tempFile = _indexFile;
+    tempFile += L".tmp";
+
+    {
+        std::ofstream file(tempFile, std::ios::binary | std::ios::trunc);
+        if (!file)
+            return false;
+
+        writeValue(file, indexFileMagic);
+        writeValue(file, indexFileVersion);
+        writeValue(file, static_cast<uint32_t>(_index.size()));
+
+        for (const auto& [key, fileIndex] : _index)
+        {
+            writeValue(file, static_cast<uint32_t>(key.size()));
+            file.write(reinterpret_cast<const char*>(key.data()), key.size() * sizeof(IndexKey::value_type));
+
+            writeValue(file, fileIndex.lastWrite);
+            writeValue(file, fileIndex.fileSize);
+            writeValue(file, static_cast<uint32_t>(fileIndex.names.size()));
+            for (const std::string& name : fileIndex.names)
+            {
+                writeValue(file, static_cast<uint16_t>(name.size()));
+                file.write(name.data(), static_cast<std::streamsize>(name.size()));
+            }
+
+            file.write(reinterpret_cast<const char*>(fileIndex.first.data()), fileIndex.first.size() * sizeof(uint32_t));
+            writeValue(file, static_cast<uint32_t>(fileIndex.positions.size()));
+            file.write(reinterpret_cast<const char*>(fileIndex.positions.data()), fileIndex.positions.size() * sizeof(Position));
+        }
+
+        if (!file)
+            return false;
+    }
+
+    // Replace the old index only once the new one is complete
+    std::error_code ec;
+    fs::rename(tempFile, _indexFile, ec);
+    return !ec;
+}
@@ -0,0 +1,119 @@
+/** @file ReferenceFinder.h
+ * Finds every reference to an identifier across the scripts of a module and its include paths
+ *
+ **/
+ // Copyright (C) 2022 - Leonardo Silva
+ // The License.txt file describes the conditions under which this software may be distributed.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace NWScriptPlugin {
+
+	// Scripts are scanned on worker threads by a small tokenizer that skips comments, string literals and
+	// numbers, so only whole identifiers match. Each scanned file leaves behind a token index (every identifier
+	// with its positions), which is persisted to disk and reused while the file's size and write time are
+	// unchanged, so repeated searches only read the files where something was found.
+	// Results are queued as they are found; the owner drains them with takeResults() from its own thread.
+	class ReferenceFinder {
+	public:
+		struct Reference {
+			std::filesystem::path filePath;
+			uint32_t line = 0;
+			uint32_t column = 0;
+			std::string lineText;
+		};
+
+		ReferenceFinder() = default;
+		ReferenceFinder(const ReferenceFinder&) = delete;
+		ReferenceFinder& operator=(const ReferenceFinder&) = delete;
+
+		~ReferenceFinder() {
+			cancel();
+		}
+
+		// Sets the file the token index is persisted to, loading whatever it holds
+		void setIndexFile(const std::filesystem::path& indexFile);
+
+		const std::filesystem::path& indexFile() const {
+			return _indexFile;
+		}
+
+		// Searches every .nss file inside folders (not recursive) for identifier. Cancels any running search.
+		void start(const std::string& identifier, const std::vector<std::filesystem::path>& folders);
+
+		// Stops the running search and waits for its threads
+		void cancel();
+
+		bool isRunning() const {
+			return _running;
+		}
+
+		// Moves the references found since the last call into results. Returns false once the
+		// search is over and there is nothing left to take.
+		bool takeResults(std::vector<Reference>& results);
+
+		size_t filesSearched() const {
+			return _filesSearched;
+		}
+
+		// Files answered by the token index, without being read or tokenized
+		size_t filesFromIndex() const {
+			return _filesFromIndex;
+		}
+
+		// Whether a string is a single NWScript identifier, and thus searchable
+		static bool isIdentifier(std::string_view text);
+
+	private:
+		struct Position {
+			uint32_t line;
+			uint32_t column;
+		};
+
+		// Identifiers are kept sorted, with the positions of names[i] at positions[first[i], first[i + 1])
+		struct FileIndex {
+			int64_t lastWrite = 0;
+			uint64_t fileSize = 0;
+			std::vector<std::string> names;
+			std::vector<uint32_t> first;
+			std::vector<Position> positions;
+		};
+
+		using IndexKey = std::filesystem::path::string_type;
+
+		void run(std::string identifier, std::vector<std::filesystem::path> folders);
+		void worker(const std::string& identifier, const std::vector<std::filesystem::path>& files);
+		bool searchFile(const std::string& identifier, const std::filesystem::path& filePath, std::vector<Position>& found);
+		void queueResults(const std::filesystem::path& filePath, const std::vector<Position>& found);
+
+		static IndexKey indexKey(const std::filesystem::path& filePath);
+		static void tokenize(std::string_view contents, FileIndex& index);
+		bool loadIndex();
+		bool saveIndex();
+
+		std::filesystem::path _indexFile;
+		std::map<IndexKey, FileIndex> _index;
+		bool _indexChanged = false;
+		std::mutex _indexLock;
+
+		std::vector<Reference> _results;
+		std::mutex _resultsLock;
+
+		std::thread _searcher;
+		std::atomic<size_t> _nextFile = 0;
+		std::atomic<size_t> _filesSearched = 0;
+		std::atomic<size_t> _filesFromIndex = 0;
+		std::atomic<bool> _running = false;
+		std::atomic<bool> _cancel = false;
+	};
+}
@@ -74,8 +74,12 @@ void Settings::Load()
 	// User's Preferences
 	autoDisplayDisassembled = GetBoolean(TEXT("User's Preferences"), TEXT("autoDisplayDisassembled"));
 	autoDisplayDebugSymbols = GetBoolean(TEXT("User's Preferences"), TEXT("autoDisplayDebugSymbols"));
+	if ((*iniFile)[TEXT("User's Preferences")].has(TEXT("writeDisplayedOutputToDisk")))
+		writeDisplayedOutputToDisk = GetBoolean(TEXT("User's Preferences"), TEXT("writeDisplayedOutputToDisk"));
 	autoInstallDarkTheme = GetBoolean(TEXT("User's Preferences"), TEXT("autoInstallDarkTheme"));
 	legacyDarkModeUse = GetBoolean(TEXT("User's Preferences"), TEXT("legacyDarkModeUse"));
+	if ((*iniFile)[TEXT("User's Preferences")].has(TEXT("largeFileLexingThreshold")))
+		largeFileLexingThreshold = GetNumber<int>(TEXT("User's Preferences"), TEXT("largeFileLexingThreshold"));
 	lastOpenedDir = properDirNameW(GetString(TEXT("User's Preferences"), TEXT("lastOpenedDir")));
 
 	// Dark Theme auto-install support
@@ -149,6 +153,9 @@ void Settings::Load()
 	if (!isValidDirectoryS(lastOpenedDir))
 		lastOpenedDir = TEXT("");
 
+	if (largeFileLexingThreshold < 0)
+		largeFileLexingThreshold = 8192;
+
 	// We aren't checking batch operations settings here, 
 	// since the user will have to run the Dialog first to run a batch...
 
@@ -196,8 +203,10 @@ void Settings::Save()
 	// User's Preferences
 	SetBoolean(TEXT("User's Preferences"), TEXT("autoDisplayDisassembled"), autoDisplayDisassembled);
 	SetBoolean(TEXT("User's Preferences"), TEXT("autoDisplayDebugSymbols"), autoDisplayDebugSymbols);
+	SetBoolean(TEXT("User's Preferences"), TEXT("writeDisplayedOutputToDisk"), writeDisplayedOutputToDisk);
 	SetBoolean(TEXT("User's Preferences"), TEXT("autoInstallDarkTheme"), autoInstallDarkTheme);
 	SetBoolean(TEXT("User's Preferences"), TEXT("legacyDarkModeUse"), legacyDarkModeUse);
+	SetNumber<int>(TEXT("User's Preferences"), TEXT("largeFileLexingThreshold"), largeFileLexingThreshold);
 	SetString(TEXT("User's Preferences"), TEXT("lastOpenedDir"), lastOpenedDir);
 
 	// Dark Theme auto-install support
@@ -71,8 +71,12 @@ namespace NWScriptPlugin {
 		// User's preferences
 		bool autoDisplayDisassembled = true;
 		bool autoDisplayDebugSymbols = true;
+		// Auto-displayed files are shown from memory; this also writes them to disk, in background
+		bool writeDisplayedOutputToDisk = true;
 		bool autoInstallDarkTheme = false;
 		bool legacyDarkModeUse = false;
+		// Scripts bigger than this (in KB) are lexed in large file mode. 0 = always use the full lexer
+		int largeFileLexingThreshold = 8192;
 		generic_string lastOpenedDir;
 
 		// Plugin statistics